@@ -4,7 +4,8 @@
 
 include Config.mk
 
-OBJS		:=	src/config.o \
+OBJS		:=	src/bootprofiler.o \
+				src/config.o \
 				src/control/control.o \
 				src/control/mister.o \
 				src/control/rotaryencoder.o \
@@ -19,13 +20,23 @@ OBJS		:=	src/config.o \
 				src/lcd/synthlcd.o \
 				src/main.o \
 				src/midiparser.o \
+				src/midiplayer.o \
+				src/mixer.o \
 				src/mt32pi.o \
+				src/pcmconverter.o \
 				src/pisound.o \
+				src/polyphonygovernor.o \
 				src/power.o \
+				src/renderprofiler.o \
 				src/rommanager.o \
 				src/soundfontmanager.o \
 				src/synth/mt32synth.o \
+				src/synth/polyphaseresampler.o \
 				src/synth/soundfontsynth.o \
+				src/synth/synthbase.o \
+				src/telemetry.o \
+				src/throttlepolicy.o \
+				src/wavrecorder.o \
 				src/zoneallocator.o
 
 EXTRACLEAN	+=	src/*.d src/*.o \
@@ -0,0 +1,64 @@
+//
+// bootprofiler.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _bootprofiler_h
+#define _bootprofiler_h
+
+#include <circle/types.h>
+
+// Records how long each stage of startup takes; only used from core 0 during initialization
+class CBootProfiler
+{
+public:
+	CBootProfiler();
+	~CBootProfiler();
+
+	// Ends the current stage (if any) and starts a new one; pName must be a string literal
+	void BeginStage(const char* pName);
+
+	// Ends the current stage and logs a summary
+	void Finish();
+
+	// Time from power-on until Finish() was called, in microseconds
+	unsigned int GetBootTime() const { return m_nFinishTime; }
+
+	static CBootProfiler* Get() { return s_pThis; }
+
+private:
+	static constexpr size_t MaxStages = 24;
+
+	struct TStage
+	{
+		const char* pName;
+		unsigned int nStartTime;
+	};
+
+	unsigned int m_nKernelStartTime;
+	unsigned int m_nFinishTime;
+
+	TStage m_Stages[MaxStages];
+	size_t m_nStages;
+
+	static CBootProfiler* s_pThis;
+};
+
+#endif
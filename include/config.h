@@ -36,6 +36,11 @@ public:
 		ENUM(MT32, mt32)                  \
 		ENUM(SoundFont, soundfont)
 
+	#define ENUM_MIDIUSBROUTING(ENUM) \
+		ENUM(Merged, merged)          \
+		ENUM(Device, device)          \
+		ENUM(Cable, cable)
+
 	#define ENUM_AUDIOOUTPUTDEVICE(ENUM) \
 		ENUM(PWM, pwm)                   \
 		ENUM(I2SDAC, i2s)
@@ -65,11 +70,15 @@ public:
 		ENUM(SSD1306I2C, ssd1306_i2c)
 
 	CONFIG_ENUM(TSystemDefaultSynth, ENUM_SYSTEMDEFAULTSYNTH);
+	CONFIG_ENUM(TMIDIUSBRouting, ENUM_MIDIUSBROUTING);
 	CONFIG_ENUM(TAudioOutputDevice, ENUM_AUDIOOUTPUTDEVICE);
 	CONFIG_ENUM(TAudioI2CDACInit, ENUM_AUDIOI2CDACINIT);
 	CONFIG_ENUM(TControlScheme, ENUM_CONTROLSCHEME);
 	CONFIG_ENUM(TLCDType, ENUM_LCDTYPE);
 
+	static constexpr const char* FileName = "mt32-pi.cfg";
+
+	// The first instance is the live configuration returned by Get(); others can be used to read the file again
 	CConfig();
 	bool Initialize(const char* pPath);
 
@@ -87,6 +96,7 @@ private:
 	static bool ParseOption(const char* pString, int* pOut, bool bHex = false);
 	static bool ParseOption(const char* pString, float* pOutFloat);
 	static bool ParseOption(const char* pString, TSystemDefaultSynth* pOut);
+	static bool ParseOption(const char* pString, TMIDIUSBRouting* pOut);
 	static bool ParseOption(const char* pString, TAudioOutputDevice* pOut);
 	static bool ParseOption(const char* pString, TAudioI2CDACInit* pOut);
 	static bool ParseOption(const char* pString, TMT32EmuResamplerQuality* pOut);
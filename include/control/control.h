@@ -23,6 +23,7 @@
 #ifndef _control_h
 #define _control_h
 
+#include <circle/gpiomanager.h>
 #include <circle/gpiopin.h>
 #include <circle/types.h>
 #include <circle/usertimer.h>
@@ -31,6 +32,7 @@
 #include "event.h"
 #include "utility.h"
 
+// Inputs are read on GPIO edge interrupts, and events are enqueued straight from interrupt context
 class CControl
 {
 public:
@@ -38,38 +40,35 @@ public:
 	virtual ~CControl() = default;
 
 	bool Initialize();
-	virtual void Update();
 	u8 GetButtonState() const { return m_nButtonState; }
 
 protected:
-	// Called from interrupt context
-	virtual void ReadGPIOPins() = 0;
+	// Interrupts on both edges of an input pin
+	void ConnectGPIOPin(CGPIOPin& Pin);
+	virtual void ConnectGPIOPins() = 0;
 
-	void DebounceButtonState(u8 nState, u8 nMask);
+	// Called from interrupt context; returns the buttons held down in a GPIO state
+	virtual u8 GetPressedButtons(u32 nGPIOState) const = 0;
+	virtual void OnGPIOEdge(u32 nGPIOState, unsigned int nTimestamp);
 
-	// Must be power of two
-	static constexpr size_t ButtonStateHistoryLength = 16;
-	static constexpr size_t ButtonStateHistoryMask   = ButtonStateHistoryLength - 1;
+	void SetButtonState(u8 nState);
 
 	TEventQueue* m_pEventQueue;
-	CUserTimer m_Timer;
-
-	// Debouncing
-	u8 m_ButtonStateHistory[ButtonStateHistoryLength];
-	size_t m_nButtonStateHistoryIndex;
+	CUserTimer m_DebounceTimer;
 	u8 m_nButtonState;
-	u8 m_nLastButtonState;
 
-	static void InterruptHandler(CUserTimer* pUserTimer, void* pParam);
+	static void GPIOInterruptHandler(void* pParam);
+	static void DebounceTimerHandler(CUserTimer* pUserTimer, void* pParam);
 };
 
 class CControlSimpleButtons : public CControl
 {
 public:
-	CControlSimpleButtons(TEventQueue& pEventQueue);
+	CControlSimpleButtons(TEventQueue& pEventQueue, CGPIOManager* pGPIOManager);
 
 protected:
-	virtual void ReadGPIOPins() override;
+	virtual void ConnectGPIOPins() override;
+	virtual u8 GetPressedButtons(u32 nGPIOState) const override;
 
 	CGPIOPin m_GPIOButton1;
 	CGPIOPin m_GPIOButton2;
@@ -80,16 +79,18 @@ protected:
 class CControlSimpleEncoder : public CControl
 {
 public:
-	CControlSimpleEncoder(TEventQueue& pEventQueue, CRotaryEncoder::TEncoderType EncoderType);
-
-	virtual void Update() override;
+	CControlSimpleEncoder(TEventQueue& pEventQueue, CGPIOManager* pGPIOManager, CRotaryEncoder::TEncoderType EncoderType);
 
 protected:
-	virtual void ReadGPIOPins() override;
+	virtual void ConnectGPIOPins() override;
+	virtual u8 GetPressedButtons(u32 nGPIOState) const override;
+	virtual void OnGPIOEdge(u32 nGPIOState, unsigned int nTimestamp) override;
 
 	CGPIOPin m_GPIOEncoderButton;
 	CGPIOPin m_GPIOButton1;
 	CGPIOPin m_GPIOButton2;
+	CGPIOPin m_GPIOEncoderCLK;
+	CGPIOPin m_GPIOEncoderDAT;
 
 	CRotaryEncoder m_Encoder;
 };
@@ -35,9 +35,19 @@ class CMisterControl
 public:
 	CMisterControl(CI2CMaster* pI2CMaster, TEventQueue& EventQueue);
 
+	// The MiSTer can't signal a change, so it's polled; quickly after a change, backing off while nothing happens
 	void Update(const TMisterStatus& SystemStatus);
+	unsigned int GetUpdatePeriodMillis() const { return m_nUpdatePeriodMillis; }
+
+	// Our own changes are pushed to the MiSTer straight away, without waiting for the next poll
+	bool IsSystemStatusChanged(const TMisterStatus& SystemStatus) const { return bMisterActive && SystemStatus != m_LastSystemStatus; }
 
 private:
+	static constexpr unsigned int MinUpdatePeriodMillis = 50;
+	static constexpr unsigned int MaxUpdatePeriodMillis = 1000;
+
+	bool Poll(const TMisterStatus& SystemStatus);
+
 	bool WriteConfigToMister(const TMisterStatus& NewStatus);
 	void ResetState();
 	void ApplyConfig(const TMisterStatus& NewStatus, const TMisterStatus& SystemStatus);
@@ -50,6 +60,7 @@ private:
 	bool bMisterActive;
 	TMisterStatus m_LastSystemStatus;
 	TMisterStatus m_LastMisterStatus;
+	unsigned int m_nUpdatePeriodMillis;
 };
 
 #endif
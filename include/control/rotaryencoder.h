@@ -23,7 +23,6 @@
 #ifndef _rotaryencoder_h
 #define _rotaryencoder_h
 
-#include <circle/gpiopin.h>
 #include <circle/types.h>
 
 #include "utility.h"
@@ -38,16 +37,13 @@ public:
 
 	CONFIG_ENUM(TEncoderType, ENUM_ENCODERTYPE);
 
-	CRotaryEncoder(TEncoderType Type, unsigned GPIOPinCLK, unsigned GPIOPinDAT);
+	CRotaryEncoder(TEncoderType Type, bool bCLKValue, bool bDATValue);
 
-	s8 Read();
-	void ReadGPIOPins();
+	// Returns the detents turned since the last call, accelerated according to the time of the latest one
+	s8 Read(unsigned int nTimestamp);
 	void ReadGPIOPins(bool bCLKValue, bool bDATValue);
 
 private:
-	CGPIOPin m_CLKPin;
-	CGPIOPin m_DATPin;
-
 	TEncoderType m_Type;
 	s8 m_nDelta;
 	s8 m_nPreviousState;
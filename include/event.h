@@ -65,6 +65,22 @@ struct TDisplayImageEvent
 	CSynthLCD::TImage Image;
 };
 
+enum class TMIDIPlayerAction
+{
+	Play,
+	Stop,
+	Next,
+	Previous,
+};
+
+struct TMIDIPlayerEvent
+{
+	TMIDIPlayerAction Action;
+
+	// File to play, for the Play action
+	size_t Index;
+};
+
 enum class TEventType
 {
 	Button,
@@ -74,6 +90,7 @@ enum class TEventType
 	SwitchSoundFont,
 	AllSoundOff,
 	DisplayImage,
+	MIDIPlayer,
 };
 
 struct TEvent
@@ -89,10 +106,12 @@ struct TEvent
 		TSwitchSoundFontEvent SwitchSoundFont;
 		TAllSoundOffEvent AllSoundOff;
 		TDisplayImageEvent DisplayImage;
+		TMIDIPlayerEvent MIDIPlayer;
 	};
 };
 
+// Each event source is given its own queue, so a lock-free queue can be used
 constexpr size_t EventQueueSize = 32;
-using TEventQueue               = CRingBuffer<TEvent, EventQueueSize>;
+using TEventQueue               = CRingBuffer<TEvent, EventQueueSize, TRingBufferSync::SPSC>;
 
 #endif
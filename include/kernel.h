@@ -26,11 +26,13 @@
 #include <circle_stdlib_app.h>
 #include <circle/cputhrottle.h>
 #include <circle/gpiomanager.h>
+#include <circle/gpiopin.h>
 #include <circle/i2cmaster.h>
 #include <circle/sched/scheduler.h>
 #include <circle/spimaster.h>
 #include <circle/timer.h>
 
+#include "bootprofiler.h"
 #include "config.h"
 #include "mt32pi.h"
 #include "zoneallocator.h"
@@ -60,6 +62,12 @@ protected:
 	CGPIOManager m_GPIOManager;
 
 private:
+	void EnableSerialFlowControl();
+
+	CGPIOPin m_SerialCTSPin;
+	CGPIOPin m_SerialRTSPin;
+
+	CBootProfiler m_BootProfiler;
 	CZoneAllocator m_Allocator;
 	CConfig m_Config;
 	CMT32Pi m_MT32Pi;
@@ -67,10 +67,17 @@ protected:
 	void WriteCommand(u8 nByte);
 	void WriteData(u8 nByte);
 	void WriteData(const u8* pBytes, size_t nSize);
+	void WriteCells(u8 nRow, u8 nColumn, const char* pChars, size_t nCount);
+	void ResetShadow();
 
 	void SetCustomChar(u8 nIndex, const u8 nCharData[8]);
 	void SetBarChars(TBarCharSet CharSet);
 	void DrawChannelLevels(u8 nFirstRow, u8 nRows, u8 nBarXOffset, u8 nBarSpacing, u8 nChannels, bool bDrawBarBases = true);
+	void DrawDSPLoad();
+
+	static constexpr u8 MaxRows        = 4;
+	static constexpr u8 MaxColumns     = 20;
+	static constexpr u8 InvalidAddress = 0xFF;
 
 	u8 m_nRows;
 	u8 m_nColumns;
@@ -78,6 +85,12 @@ protected:
 	u8 m_RowOffsets[4];
 
 	TBarCharSet m_BarCharSet;
+
+	// Shadow copies of the display's memory, so that only changed characters and glyphs are sent
+	u8 m_DDRAM[MaxRows][MaxColumns];
+	u8 m_CGRAM[8][8];
+	u8 m_nCGRAMValidMask;
+	u8 m_nCursorAddress;
 };
 
 class CHD44780FourBit : public CHD44780Base
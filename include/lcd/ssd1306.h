@@ -50,6 +50,7 @@ public:
 	// CSynthLCD
 	virtual void Update(CMT32Synth& Synth) override;
 	virtual void Update(CSoundFontSynth& Synth) override;
+	virtual bool Flush() override;
 
 protected:
 	struct TFrameBufferUpdatePacket
@@ -60,8 +61,12 @@ protected:
 	PACKED;
 
 	void WriteCommand(u8 nCommand) const;
-	virtual void WriteFrameBuffer(bool bForceFullUpdate = false) const;
+	void WriteFrameBuffer(bool bForceFullUpdate = false);
+	virtual bool WriteNextWindow(bool bFullUpdate, u8& nPage) const;
+	bool StartFrame(bool bForceFullUpdate);
+	void QueueFrame();
 	void SwapFrameBuffers();
+	bool GetDirtyColumns(u8 nPage, bool bFullUpdate, u8& nFirstColumn, u8& nLastColumn) const;
 
 	void SetPixel(u8 nX, u8 nY);
 	void ClearPixel(u8 nX, u8 nY);
@@ -73,6 +78,7 @@ protected:
 	void DrawChannelLevels(u8 nBarXOffset, u8 nBarYOffset, u8 nBarWidth, u8 nBarHeight, u8 nBarSpacing, u8 nChannels, bool bDrawPeaks = true,
 						   bool bDrawBarBases = true);
 	void DrawSC55Dots(u8 nFirstRow, u8 nRows);
+	void DrawDSPLoad();
 
 	CI2CMaster* m_pI2CMaster;
 	u8 m_nAddress;
@@ -83,6 +89,17 @@ protected:
 	// Double framebuffers
 	TFrameBufferUpdatePacket m_FrameBuffers[2];
 	u8 m_nCurrentFrameBuffer;
+
+	// Set when the display no longer shows the previous framebuffer (e.g. after an immediate update)
+	bool m_bFullUpdateRequired;
+
+	// A frame being sent one window at a time; the framebuffers are swapped once it's done
+	bool m_bFramePending;
+	bool m_bFrameFullUpdate;
+	u8 m_nFramePage;
+
+private:
+	void WriteWindow(u8 nFirstPage, u8 nLastPage, u8 nFirstColumn, u8 nLastColumn) const;
 };
 
 class CSH1106 : public CSSD1306
@@ -92,7 +109,7 @@ public:
 
 private:
 	void WriteData(const u8* pData, size_t nSize) const;
-	virtual void WriteFrameBuffer(bool bForceFullUpdate = false) const override;
+	virtual bool WriteNextWindow(bool bFullUpdate, u8& nPage) const override;
 };
 
 #endif
@@ -26,6 +26,7 @@
 #include <circle/types.h>
 
 #include "lcd/clcd.h"
+#include "renderprofiler.h"
 #include "synth/mt32synth.h"
 #include "synth/soundfontsynth.h"
 #include "synth/synthbase.h"
@@ -63,6 +64,7 @@ public:
 	void OnDisplayImage(TImage Image);
 	void EnterPowerSavingMode();
 	void ExitPowerSavingMode();
+	bool IsInPowerSavingMode() const { return m_SystemState == TSystemState::InPowerSavingMode; }
 
 	void OnMT32Message(const char* pMessage);
 	void OnProgramChanged(u8 nPartNum, const char* pSoundGroupName, const char* pPatchName);
@@ -70,14 +72,27 @@ public:
 	void OnSC55DisplayText(const char* pMessage);
 	void OnSC55DisplayDots(const u8* pData);
 
+	// Replaces the channel level display with render statistics
+	void SetRenderProfiler(const CRenderProfiler* pRenderProfiler) { m_pRenderProfiler = pRenderProfiler; }
+
 	virtual void Update(CMT32Synth& Synth) = 0;
 	virtual void Update(CSoundFontSynth& Synth) = 0;
 
+	// Returns false if an update wouldn't change anything on the display
+	bool IsUpdateNeeded(CMT32Synth& Synth);
+	bool IsUpdateNeeded(CSoundFontSynth& Synth);
+
+	// Send the next part of a frame that Update() left in flight; returns true once the display is up to date
+	virtual bool Flush() { return true; }
+
 protected:
+	bool IsUpdateNeeded(CSynthBase& Synth);
 	void UpdateSystem(unsigned int nTicks);
 	void UpdatePartStateText(const CMT32Synth& Synth);
 	void UpdateChannelLevels(CSynthBase& Synth);
 	void UpdateChannelPeakLevels();
+	void UpdateDSPLoadText(CSynthBase& Synth);
+	bool IsShowingDSPLoad() const { return m_pRenderProfiler && m_SystemState == TSystemState::None; }
 
 	static constexpr size_t MIDIChannelCount = 16;
 	static constexpr size_t MT32ChannelCount = 9;
@@ -86,6 +101,8 @@ protected:
 	static constexpr size_t SystemMessageTextBufferSize = 20 + 1;
 	static constexpr size_t MT32TextBufferSize = 20 + 1;
 	static constexpr size_t SC55TextBufferSize = 32 + 1;
+	static constexpr size_t DSPLoadTextBufferSize = 20 + 1;
+	static constexpr size_t DSPLoadTextLines = 3;
 
 	// 64 bytes; each byte representing 5 pixels (see p78 of SC-55 manual)
 	static constexpr size_t SC55PixelBufferSize = 64;
@@ -99,6 +116,9 @@ protected:
 	static constexpr float BarFalloff  = 1.0f / 16.0f;
 	static constexpr float PeakFalloff = 1.0f / 64.0f;
 
+	// Set by the On*() notifications, which may be called from another core; cleared by Update()
+	volatile bool m_bStateChanged;
+
 	// System state
 	TSystemState m_SystemState;
 	unsigned m_nSystemStateTime;
@@ -125,6 +145,10 @@ protected:
 	float m_ChannelLevels[MIDIChannelCount];
 	float m_ChannelPeakLevels[MIDIChannelCount];
 	u8 m_ChannelPeakTimes[MIDIChannelCount];
+
+	// DSP load display
+	const CRenderProfiler* m_pRenderProfiler;
+	char m_DSPLoadTextBuffer[DSPLoadTextLines][DSPLoadTextBufferSize];
 };
 
 #endif
@@ -28,13 +28,32 @@
 class CMIDIParser
 {
 public:
+	// Matches mt32emu's SysEx buffer size
+	static constexpr size_t DefaultSysExBufferSize = 1000;
+	static constexpr size_t MaxSysExBufferSize     = 65536;
+
 	CMIDIParser();
+	~CMIDIParser();
+
+	// SysEx messages up to this size are delivered whole; a larger buffer is allocated from the zone heap on the first
+	// SysEx message, and longer messages are streamed to OnSysExFragment() in buffer-sized pieces
+	void SetSysExBufferSize(size_t nSize);
 
-	void ParseMIDIBytes(const u8* pData, size_t nSize);
+	// The timestamp is passed through to the message handlers
+	void ParseMIDIBytes(const u8* pData, size_t nSize, unsigned int nTimestamp);
+
+	// As above, but for data that arrives framed as one message or SysEx fragment per call (e.g. USB MIDI event
+	// packets); complete messages and SysEx continuations skip the byte-by-byte state machine
+	void ParseMIDIEventPacket(const u8* pData, size_t nSize, unsigned int nTimestamp);
 
 protected:
-	virtual void OnShortMessage(u32 nMessage) = 0;
-	virtual void OnSysExMessage(const u8* pData, size_t nSize) = 0;
+	virtual void OnShortMessage(u32 nMessage, unsigned int nTimestamp) = 0;
+	virtual void OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) = 0;
+
+	// Called instead of OnSysExMessage() for messages that don't fit the buffer; nOffset is the number of bytes already
+	// delivered, and the last fragment has bComplete set and ends with EOX. Return false to give up on the message,
+	// which is then reported as an overflow.
+	virtual bool OnSysExFragment(const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp);
 
 	virtual void OnUnexpectedStatus();
 	virtual void OnSysExOverflow();
@@ -47,17 +66,24 @@ private:
 		SysExByte
 	};
 
-	// Matches mt32emu's SysEx buffer size
-	static constexpr size_t SysExBufferSize = 1000;
+	static size_t GetShortMessageLength(u8 nStatus);
 
+	void AllocateSysExBuffer();
+	bool FlushSysExFragment();
+	void EndSysEx();
 	void ParseStatusByte(u8 nByte);
 	bool CheckCompleteShortMessage();
 	u32 PrepareShortMessage() const;
 	void ResetState(bool bClearStatusByte);
 
 	TState m_State;
-	u8 m_MessageBuffer[SysExBufferSize];
+	u8 m_DefaultBuffer[DefaultSysExBufferSize];
+	u8* m_pMessageBuffer;
+	size_t m_nMessageBufferSize;
+	size_t m_nRequestedBufferSize;
 	size_t m_nMessageLength;
+	size_t m_nSysExOffset;
+	unsigned int m_nTimestamp;
 };
 
 #endif
@@ -0,0 +1,116 @@
+//
+// midiplayer.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _midiplayer_h
+#define _midiplayer_h
+
+#include <circle/string.h>
+#include <circle/types.h>
+#include <fatfs/ff.h>
+
+// Plays Standard MIDI Files (types 0 and 1) from the midi directory of each disk
+// Tracks are streamed from the file through a small buffer each, and merged in time order as they're played
+class CMIDIPlayer
+{
+public:
+	CMIDIPlayer();
+	virtual ~CMIDIPlayer();
+
+	bool ScanFiles();
+	size_t GetFileCount() const { return m_nFiles; }
+	const char* GetFileName(size_t nIndex) const;
+
+	bool Play(size_t nIndex);
+	void Stop();
+	bool IsPlaying() const { return m_bPlaying; }
+	size_t GetFileIndex() const { return m_nFileIndex; }
+
+	// Hands over every event that has become due, stamped with the time it should sound; returns false once the file
+	// has finished
+	bool Update();
+
+protected:
+	virtual void OnShortMessage(u32 nMessage, unsigned int nTimestamp) = 0;
+	virtual void OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) = 0;
+
+private:
+	struct TTrack
+	{
+		// File offsets of the next unread byte and the end of the track data
+		u32 nPosition;
+		u32 nEnd;
+
+		// Read-ahead for bytes starting at nBufferOffset
+		u32 nBufferOffset;
+		u16 nBufferLength;
+		u8 Buffer[256];
+
+		u32 nNextTick;
+		u8 nRunningStatus;
+	};
+
+	static constexpr size_t MaxFiles     = 256;
+	static constexpr size_t MaxTracks    = 64;
+	static constexpr size_t MaxSysExSize = 1024;
+
+	bool ReadByte(TTrack& Track, u8& nByte);
+	bool ReadVarLength(TTrack& Track, u32& nValue);
+	void Skip(TTrack& Track, u32 nBytes);
+	bool ReadDeltaTime(TTrack& Track);
+	void ReadEvent(TTrack& Track, unsigned int nTimestamp);
+
+	u32 TicksToMicros(u32 nTick) const;
+
+	// Min-heap of track indices, ordered by the tick of the track's next event
+	bool HeapLess(size_t nA, size_t nB) const;
+	void HeapPush(u8 nTrack);
+	void HeapPop();
+	void HeapSiftDown(size_t nIndex);
+
+	CString m_FileList[MaxFiles];
+	size_t m_nFiles;
+
+	FIL m_File;
+	bool m_bFileOpen;
+	bool m_bPlaying;
+	size_t m_nFileIndex;
+
+	TTrack* m_pTracks;
+	size_t m_nTracks;
+	u8 m_Heap[MaxTracks];
+	size_t m_nHeapSize;
+
+	// Ticks per quarter note, or ticks per second for SMPTE time division
+	u32 m_nDivision;
+	bool m_bSMPTE;
+
+	// Tempo in microseconds per quarter note, and the point at which it took effect
+	u32 m_nTempo;
+	u32 m_nTempoTick;
+	u32 m_nTempoMicros;
+
+	unsigned int m_nStartTime;
+
+	u8 m_SysExBuffer[MaxSysExSize];
+};
+
+#endif
@@ -0,0 +1,46 @@
+//
+// mixer.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _mixer_h
+#define _mixer_h
+
+#include <circle/types.h>
+
+// Mixing kernels for interleaved sample buffers, vectorized with NEON where available
+namespace Mixer
+{
+	// pOutBuffer += pInBuffer
+	void Add(float* pOutBuffer, const float* pInBuffer, size_t nSamples);
+
+	// pOutBuffer += pInBuffer, saturating
+	void Add(s16* pOutBuffer, const s16* pInBuffer, size_t nSamples);
+
+	// pOutBuffer += pInBuffer * gain for stereo frames, where the gain starts at nStartGain, changes by nGainStep every
+	// frame, and stops at zero
+	void AddRamp(float* pOutBuffer, const float* pInBuffer, float nStartGain, float nGainStep, size_t nFrames);
+
+	// Largest absolute sample value, scaled to [0.0, 1.0] for integer samples
+	float GetPeak(const float* pBuffer, size_t nSamples);
+	float GetPeak(const s16* pBuffer, size_t nSamples);
+}
+
+#endif
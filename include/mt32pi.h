@@ -33,6 +33,7 @@
 #include <circle/multicore.h>
 #include <circle/sched/scheduler.h>
 #include <circle/soundbasedevice.h>
+#include <circle/spinlock.h>
 #include <circle/spimaster.h>
 #include <circle/timer.h>
 #include <circle/types.h>
@@ -47,13 +48,20 @@
 #include "event.h"
 #include "lcd/synthlcd.h"
 #include "midiparser.h"
+#include "midiplayer.h"
+#include "pcmconverter.h"
 #include "pisound.h"
+#include "polyphonygovernor.h"
 #include "power.h"
+#include "renderprofiler.h"
 #include "ringbuffer.h"
 #include "synth/mt32romset.h"
 #include "synth/mt32synth.h"
 #include "synth/soundfontsynth.h"
 #include "synth/synth.h"
+#include "telemetry.h"
+#include "throttlepolicy.h"
+#include "wavrecorder.h"
 
 class CMT32Pi : public CMultiCoreSupport, CPower, CMIDIParser
 {
@@ -75,44 +83,143 @@ private:
 		Spinner,
 	};
 
+	// Raw MIDI data received in interrupt context, stamped with its time of arrival and the input it came from
+	// A USB MIDI event carries up to 3 bytes; byte streams (serial, Pisound) also fill what would otherwise be padding
+	struct TMIDIRxPacket
+	{
+		unsigned int nTimestamp;
+		u8 nInput;
+		u8 nSize;
+		u8 Data[6];
+	};
+
 	static constexpr size_t MIDIRxBufferSize = 2048;
+	static constexpr size_t SerialThruBufferSize = 8192;
+
+	static constexpr size_t MaxUSBMIDIDevices = 4;
+	static constexpr size_t USBMIDICables     = 16;
+
+	// Input 0 is GPIO/Pisound MIDI, followed by every cable of each USB MIDI device
+	static constexpr u8 GPIOMIDIInput         = 0;
+	static constexpr size_t USBMIDIInputCount = MaxUSBMIDIDevices * USBMIDICables;
+
+	// Which synth plays the messages from an input; Default follows the active synth (or layering channel mask)
+	enum class TMIDIRoute
+	{
+		Default,
+		MT32,
+		SoundFont,
+	};
+
+	// Keeps running status and SysEx state separate for each USB MIDI cable
+	class CMIDIInput : public CMIDIParser
+	{
+	public:
+		CMIDIInput();
+
+		void SetRoute(CMT32Pi* pMT32Pi, TMIDIRoute Route);
+
+	protected:
+		// CMIDIParser
+		virtual void OnShortMessage(u32 nMessage, unsigned int nTimestamp) override;
+		virtual void OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override;
+		virtual bool OnSysExFragment(const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp) override;
+		virtual void OnUnexpectedStatus() override;
+		virtual void OnSysExOverflow() override;
+
+	private:
+		CMT32Pi* m_pMT32Pi;
+		TMIDIRoute m_Route;
+	};
+
+	// Plays MIDI files from disk as if they came from the default input
+	class CMIDIFilePlayer : public CMIDIPlayer
+	{
+	public:
+		CMIDIFilePlayer(CMT32Pi* pMT32Pi);
+
+	protected:
+		// CMIDIPlayer
+		virtual void OnShortMessage(u32 nMessage, unsigned int nTimestamp) override;
+		virtual void OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override;
+
+	private:
+		CMT32Pi* m_pMT32Pi;
+	};
 
 	// CPower
 	virtual void OnEnterPowerSavingMode() override;
 	virtual void OnExitPowerSavingMode() override;
 	virtual void OnThrottleDetected() override;
 	virtual void OnUnderVoltageDetected() override;
+	virtual void OnThrottleCleared() override;
 
 	// CMIDIParser
-	virtual void OnShortMessage(u32 nMessage) override;
-	virtual void OnSysExMessage(const u8* pData, size_t nSize) override;
+	virtual void OnShortMessage(u32 nMessage, unsigned int nTimestamp) override;
+	virtual void OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override;
+	virtual bool OnSysExFragment(const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp) override;
 	virtual void OnUnexpectedStatus() override;
 	virtual void OnSysExOverflow() override;
 
+	void PlayShortMessage(u32 nMessage, unsigned int nTimestamp, TMIDIRoute Route);
+	void PlaySysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp, TMIDIRoute Route, bool bCustomSysEx = true);
+	bool PlaySysExFragment(const void* pSource, const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp, TMIDIRoute Route);
+	TMIDIRoute GetUSBMIDIRoute(size_t nDevice, size_t nCable) const;
+
 	// Initialization
+	CSynthLCD* CreateLCD();
 	bool InitMT32Synth();
 	bool InitSoundFontSynth();
+	bool InitSynth(TSynth Synth, bool bBackground = false);
+	CSynthBase* GetSynth(TSynth Synth) const;
+	void InitBackgroundSynth();
+	void InitLayering();
 
 	// Tasks for specific CPU cores
 	void MainTask();
 	void UITask();
 	void AudioTask();
+	void RenderTask();
 
 	void UpdateUSB(bool bStartup = false);
-	void UpdateMIDI();
+	bool UpdateMIDI();
 	size_t ReceiveSerialMIDI(u8* pOutData, size_t nSize);
+	void UpdateSerialThru();
 	bool ParseCustomSysEx(const u8* pData, size_t nSize);
+	void SendMemoryStats();
+	void SendSysExValues(u8 nCommand, const u32* pValues, size_t nValues);
+	void SendSysEx(const u8* pData, size_t nSize);
+	void RunBenchmark(unsigned int nSeconds);
 
 	void ProcessEventQueue();
+	void ProcessEventQueue(TEventQueue& Queue);
 	void ProcessButtonEvent(const TButtonEvent& Event);
 
+	void LogRenderStats();
+	void SendTelemetry();
+	void UpdatePolyphonyGovernor();
+	void ThrottlePolyphony();
+	void ApplyThrottleLevel();
+	void ApplyQualitySettings();
+
+	// Applies what it can of the config file's changes without rebooting
+	void ReloadConfig();
+	void ReinitLCD();
+
 	// Actions that can be triggered via events
 	void SwitchSynth(TSynth Synth);
+	void RenderFade(CSynthBase* pFadingSynth, float* pFadeBuffer, float* pOutBuffer, size_t nFrames, size_t& nFadePosition);
 	void SwitchMT32ROMSet(TMT32ROMSet ROMSet);
 	void NextMT32ROMSet();
 	void SwitchSoundFont(size_t nIndex);
 	void DeferSwitchSoundFont(size_t nIndex);
 	void SetMasterVolume(s32 nVolume);
+	void PlayMIDIFile(size_t nIndex);
+	void StopMIDIFile();
+	void SkipMIDIFile(bool bForward);
+	void StartRecording(const char* pDisk);
+	void StopRecording();
+	void ProcessMIDIPlayerEvent(const TMIDIPlayerEvent& Event);
 
 	void LEDOn();
 	void LCDLog(TLCDLogType Type, const char* pFormat...);
@@ -149,39 +256,126 @@ private:
 	bool m_bSerialMIDIEnabled;
 
 	// USB MIDI
-	CUSBMIDIDevice* volatile m_pUSBMIDIDevice;
+	CUSBMIDIDevice* volatile m_pUSBMIDIDevices[MaxUSBMIDIDevices];
+	CMIDIInput m_USBMIDIInputs[USBMIDIInputCount];
 	CUSBBulkOnlyMassStorageDevice* volatile m_pUSBMassStorageDevice;
+	unsigned m_nUSBUpdateTime;
 
 	bool m_bActiveSenseFlag;
 	unsigned m_nActiveSenseTime;
 
 	volatile bool m_bRunning;
 	volatile bool m_bUITaskDone;
+
+	// The UI task stands aside while the display is replaced
+	volatile bool m_bUIPauseRequest;
+	volatile bool m_bUIPaused;
 	bool m_bLEDOn;
 	unsigned m_nLEDOnTime;
 
 	// Audio output
 	CSoundBaseDevice* m_pSound;
 
+	// Set from the sound device's interrupt when it has taken data from the queue (low latency mode)
+	volatile bool m_bSoundDataNeeded;
+
+	// Deep power saving; the audio and UI tasks sleep until the main task wakes them on MIDI activity
+	volatile bool m_bDeepIdle;
+	volatile unsigned int m_nDeepIdleWakeTime;
+
+	// Counts MIDI messages sent to the synths; the audio task stops rendering while they're silent until this changes
+	volatile unsigned int m_nMIDIEventCount;
+
 	// Extra devices
 	CPisound* m_pPisound;
 
+	// Render performance statistics
+	CRenderProfiler* m_pRenderProfiler;
+	unsigned m_nRenderProfilerLogTime;
+	unsigned m_nRenderProfilerVoiceTime;
+
+	// Health records for monitoring on a host
+	CTelemetry m_Telemetry;
+	unsigned m_nTelemetryTime;
+
+	// Automatic FluidSynth polyphony
+	CPolyphonyGovernor* m_pPolyphonyGovernor;
+
+	// Quality scaling in response to firmware throttling
+	CThrottlePolicy m_ThrottlePolicy;
+
+	// Secondary render worker and SoundFont preloader (core 3)
+	CSpinLock m_RenderWorkerLock;
+	volatile bool m_bRenderWorkerReady;
+	volatile bool m_bRenderWorkerRequest;
+	CSynthBase* volatile m_pRenderWorkerSynth;
+	size_t m_nRenderWorkerFrames;
+	float* m_pRenderWorkerBuffer;
+
 	// Synthesizers
 	u8 m_nMasterVolume;
 	CSynthBase* m_pCurrentSynth;
-	CMT32Synth* m_pMT32Synth;
-	CSoundFontSynth* m_pSoundFontSynth;
+
+	// Synth switch fade; the outgoing synth is rendered by the audio task with decreasing gain until it's done
+	// m_pCurrentSynth only changes under the lock, so the audio task sees both synths of a switch together
+	CSpinLock m_FadeLock;
+	size_t m_nSwitchFadeFrames;
+	CSynthBase* m_pFadingSynth;
+	bool m_bFadeRestart;
+
+	// Layering; both synths play at once, with MIDI channels routed to mt32emu according to the mask
+	volatile bool m_bLayering;
+	u16 m_nMT32ChannelMask;
+	CMT32Synth* volatile m_pMT32Synth;
+	CSoundFontSynth* volatile m_pSoundFontSynth;
+
+	// The non-default synth is brought up on core 3 after boot; switching to it meanwhile is deferred until it's ready
+	volatile bool m_bBackgroundInitPending;
+	TSynth m_BackgroundSynth;
+	bool m_bDeferredSynthSwitchFlag;
+	bool m_bDeferredConfigReloadFlag;
+
+	// A MIDI file selected while a SoundFont was being loaded in the background
+	bool m_bDeferredMIDIFileFlag;
+	size_t m_nDeferredMIDIFileIndex;
+
+	// MIDI file playback; autoplay moves on to the next file whenever one finishes, until playback is stopped
+	CMIDIFilePlayer m_MIDIPlayer;
+	bool m_bMIDIPlayerAutoplay;
+
+	// Output recording; filled by the audio task and written to disk by the main task
+	CWAVRecorder m_WAVRecorder;
+
+	// Benchmark; the audio task hands the current synth over to the main task while it runs
+	unsigned int m_nDeferredBenchmarkSeconds;
+	volatile bool m_bAudioPauseRequest;
+	volatile bool m_bAudioPaused;
 
 	// MIDI receive buffer
-	CRingBuffer<u8, MIDIRxBufferSize> m_MIDIRxBuffer;
+	// Produced from interrupt context on core 0 only
+	CRingBuffer<TMIDIRxPacket, MIDIRxBufferSize, TRingBufferSync::SPSC> m_MIDIRxBuffer;
+
+	// Set from interrupt context when the receive buffer was full; reported by the main task
+	volatile bool m_bMIDIRxOverrun;
 
-	// Event handling
+	// Software thru data waiting for space in the serial device's transmit buffer
+	// Produced and consumed by the main task
+	CRingBuffer<u8, SerialThruBufferSize, TRingBufferSync::SPSC> m_SerialThruBuffer;
+
+	// Event handling; the MiSTer interface runs on another core, so it gets its own queue
 	TEventQueue m_EventQueue;
+	TEventQueue m_MisterEventQueue;
 
 	static void EventHandler(const TEvent& Event);
 	static void USBMIDIDeviceRemovedHandler(CDevice* pDevice, void* pContext);
+	template <size_t N>
 	static void USBMIDIPacketHandler(unsigned nCable, u8* pPacket, unsigned nLength);
 	static void MIDIReceiveHandler(const u8* pData, size_t nSize);
+	static void SoundNeedDataHandler(void* pParam);
+	static void EnqueueMIDIData(u8 nInput, const u8* pData, size_t nSize);
+
+	// One packet handler per USB MIDI device, as the handler isn't told which device the packet came from
+	static TMIDIPacketHandler* const USBMIDIPacketHandlers[MaxUSBMIDIDevices];
 
 	static CMT32Pi* s_pThis;
 };
@@ -0,0 +1,48 @@
+//
+// pcmconverter.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _pcmconverter_h
+#define _pcmconverter_h
+
+#include <circle/types.h>
+
+// Converts interleaved floating point samples into the integer formats expected by the sound devices
+class CPCMConverter
+{
+public:
+	CPCMConverter(bool bDither = false);
+
+	// Input samples are clamped to [-1.0, 1.0]; the output may overlap the start of the input, so a buffer can be
+	// converted in place (each output sample is written no later in the buffer than the input it came from)
+	// Samples are read and written as bytes, so the two views of a shared buffer never alias as different types
+	void ConvertS24(const float* pInBuffer, s32* pOutBuffer, size_t nSamples) const;
+	void ConvertS16(const float* pInBuffer, s16* pOutBuffer, size_t nSamples);
+
+private:
+	static constexpr size_t DitherLanes = 4;
+
+	// Adds triangular (TPDF) dither of up to +/-1 LSB before truncating to 16 bits
+	bool m_bDither;
+	u32 m_DitherState[DitherLanes];
+};
+
+#endif
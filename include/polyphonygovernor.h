@@ -0,0 +1,67 @@
+//
+// polyphonygovernor.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _polyphonygovernor_h
+#define _polyphonygovernor_h
+
+#include <circle/types.h>
+
+#include "renderprofiler.h"
+
+// Adjusts a synth's voice limit to keep render time comfortably inside the chunk deadline
+class CPolyphonyGovernor
+{
+public:
+	CPolyphonyGovernor(u32 nMaxPolyphony);
+
+	// Returns true if the polyphony limit should be changed
+	bool Update(const CRenderProfiler::TStats& Stats, u32 nActiveVoices);
+	void OnThrottleDetected();
+
+	u32 GetPolyphony() const { return m_nPolyphony; }
+
+private:
+	static constexpr u32 MinPolyphony = 16;
+
+	// Load thresholds as a percentage of the chunk period
+	static constexpr u32 HighLoadThreshold = 90;
+	static constexpr u32 LowLoadThreshold  = 65;
+
+	// Number of consecutive quiet measurement windows before the limit is raised again
+	static constexpr u8 RaiseWindows = 3;
+
+	static constexpr unsigned ThrottleHoldMillis = 30000;
+
+	void Lower(u32 nDivisor);
+
+	u32 m_nMaxPolyphony;
+	u32 m_nPolyphony;
+
+	u32 m_nLastChunks;
+	u32 m_nLastLateChunks;
+	u8 m_nQuietWindows;
+
+	bool m_bThrottled;
+	unsigned m_nThrottleTime;
+};
+
+#endif
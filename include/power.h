@@ -35,14 +35,20 @@ public:
 	void Awaken();
 	void SetPowerSaveTimeout(u16 nSeconds) { m_nPowerSaveTimeout = nSeconds; }
 
+	// True from throttling or undervoltage being reported until the firmware has reported normal status for a while
+	bool IsThrottled() const { return m_bThrottled; }
+
 protected:
 	virtual void OnEnterPowerSavingMode();
 	virtual void OnExitPowerSavingMode();
 
 	virtual void OnThrottleDetected();
 	virtual void OnUnderVoltageDetected();
+	virtual void OnThrottleCleared();
 
 private:
+	static constexpr unsigned ThrottleClearHoldMillis = 30000;
+
 	enum class TState
 	{
 		Normal,
@@ -57,6 +63,8 @@ private:
 
 	CBcmPropertyTags m_Tags;
 	u32 m_LastThrottledStatus;
+	bool m_bThrottled;
+	unsigned int m_nLastThrottledTime;
 };
 
 #endif
@@ -0,0 +1,99 @@
+//
+// renderprofiler.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _renderprofiler_h
+#define _renderprofiler_h
+
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+// Measures how much of each chunk's playback time is spent producing it
+class CRenderProfiler
+{
+public:
+	static constexpr size_t LateChunkBuckets = 5;
+
+	// Lower bound of each late chunk histogram bucket, as a percentage of the chunk period
+	static constexpr u32 LateChunkThresholds[LateChunkBuckets] = { 100, 110, 125, 150, 200 };
+
+	struct TStats
+	{
+		// Percentages of the chunk period over the most recent measurement window
+		u32 nMinLoad;
+		u32 nAvgLoad;
+		u32 nMaxLoad;
+		u32 nAvgConversionLoad;
+
+		// Audio time produced per unit of time spent producing it, times 100, over the window and since startup
+		u32 nRealTimeFactor;
+		u32 nTotalRealTimeFactor;
+
+		// Totals since startup
+		u32 nChunks;
+		u32 nLateChunks[LateChunkBuckets];
+		u32 nUnderruns;
+		u32 nDroppedChunks;
+		u32 nPeakVoices;
+	};
+
+	CRenderProfiler(unsigned int nSampleRate);
+
+	// Called by the audio thread around each chunk
+	void BeginChunk(size_t nFrames, bool bUnderrun);
+	void EndRender();
+	void EndChunk(bool bDropped);
+
+	// Called periodically by the main thread with the active synth's current voice count
+	void SampleVoices(u32 nVoices);
+
+	// Safe to call from any core
+	TStats GetStats() const;
+
+private:
+	static constexpr unsigned WindowMicros = 1000000;
+
+	void PublishWindow();
+
+	unsigned int m_nSampleRate;
+
+	// Current chunk
+	unsigned int m_nChunkStartTime;
+	unsigned int m_nRenderEndTime;
+	unsigned int m_nChunkPeriod;
+
+	// Current window; all times in microseconds
+	unsigned int m_nWindowPeriod;
+	unsigned int m_nWindowBusyTime;
+	unsigned int m_nWindowConversionTime;
+	u32 m_nWindowMinLoad;
+	u32 m_nWindowMaxLoad;
+
+	TStats m_Totals;
+	u64 m_nTotalPeriod;
+	u64 m_nTotalBusyTime;
+	volatile u32 m_nPeakVoices;
+
+	mutable CSpinLock m_Lock;
+	TStats m_PublishedStats;
+};
+
+#endif
@@ -25,10 +25,22 @@
 
 #include <circle/spinlock.h>
 #include <circle/types.h>
+#include <circle/util.h>
+
+#include <type_traits>
 
 #include "utility.h"
 
-template <class T, size_t N>
+enum class TRingBufferSync
+{
+	// Any number of producers/consumers; IRQs are disabled while the buffer is accessed
+	SpinLock,
+
+	// Lock-free; exactly one producer and one consumer, which must not preempt each other's own side
+	SPSC,
+};
+
+template <class T, size_t N, TRingBufferSync Sync = TRingBufferSync::SpinLock>
 class CRingBuffer
 {
 public:
@@ -87,7 +99,7 @@ public:
 		size_t nDequeued = 0;
 		m_Lock.Acquire();
 
-		while (m_nInPtr != m_nOutPtr)
+		while (m_nInPtr != m_nOutPtr && nDequeued < nMaxCount)
 		{
 			pOutBuffer[nDequeued++] = m_Data[m_nOutPtr++];
 			m_nOutPtr &= BufferMask;
@@ -97,6 +109,21 @@ public:
 		return nDequeued;
 	}
 
+	bool Peek(T& OutItem)
+	{
+		bool bSuccess = false;
+		m_Lock.Acquire();
+
+		if (m_nInPtr != m_nOutPtr)
+		{
+			OutItem = m_Data[m_nOutPtr];
+			bSuccess = true;
+		}
+
+		m_Lock.Release();
+		return bSuccess;
+	}
+
 private:
 	static_assert(Utility::IsPowerOfTwo(N), "Ring buffer size must be a power of 2");
 
@@ -120,4 +147,151 @@ private:
 	T m_Data[N];
 };
 
+// Single-producer/single-consumer variant; the producer only writes m_nInPtr and the consumer only writes m_nOutPtr
+template <class T, size_t N>
+class CRingBuffer<T, N, TRingBufferSync::SPSC>
+{
+public:
+	CRingBuffer()
+		: m_nInPtr(0),
+		  m_nOutPtr(0),
+		  m_nHighWaterMark(0),
+		  m_Data{}
+	{
+	}
+
+	bool Enqueue(const T& Item)
+	{
+		const size_t nInPtr     = __atomic_load_n(&m_nInPtr, __ATOMIC_RELAXED);
+		const size_t nNextInPtr = (nInPtr + 1) & BufferMask;
+
+		if (nNextInPtr == __atomic_load_n(&m_nOutPtr, __ATOMIC_ACQUIRE))
+			return false;
+
+		m_Data[nInPtr] = Item;
+		__atomic_store_n(&m_nInPtr, nNextInPtr, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	size_t Enqueue(const T* pItems, size_t nCount)
+	{
+		const size_t nInPtr  = __atomic_load_n(&m_nInPtr, __ATOMIC_RELAXED);
+		const size_t nOutPtr = __atomic_load_n(&m_nOutPtr, __ATOMIC_ACQUIRE);
+
+		nCount = Utility::Min(nCount, (nOutPtr - nInPtr - 1) & BufferMask);
+		if (nCount == 0)
+			return 0;
+
+		// Copy up to the end of the buffer, then wrap around
+		const size_t nFirst = Utility::Min(nCount, N - nInPtr);
+		memcpy(&m_Data[nInPtr], pItems, nFirst * sizeof(T));
+		memcpy(&m_Data[0], pItems + nFirst, (nCount - nFirst) * sizeof(T));
+
+		__atomic_store_n(&m_nInPtr, (nInPtr + nCount) & BufferMask, __ATOMIC_RELEASE);
+		return nCount;
+	}
+
+	// Enqueue either all of the items or none of them, so that the consumer never sees a partial record
+	bool EnqueueAll(const T* pItems, size_t nCount)
+	{
+		const size_t nInPtr  = __atomic_load_n(&m_nInPtr, __ATOMIC_RELAXED);
+		const size_t nOutPtr = __atomic_load_n(&m_nOutPtr, __ATOMIC_ACQUIRE);
+
+		if (nCount > ((nOutPtr - nInPtr - 1) & BufferMask))
+			return false;
+
+		return Enqueue(pItems, nCount) == nCount;
+	}
+
+	bool Dequeue(T& OutItem)
+	{
+		UpdateHighWaterMark();
+		if (!Peek(OutItem))
+			return false;
+
+		const size_t nOutPtr = __atomic_load_n(&m_nOutPtr, __ATOMIC_RELAXED);
+		__atomic_store_n(&m_nOutPtr, (nOutPtr + 1) & BufferMask, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	size_t Dequeue(T* pOutBuffer, size_t nMaxCount)
+	{
+		UpdateHighWaterMark();
+		const size_t nCount = Peek(pOutBuffer, nMaxCount);
+		Skip(nCount);
+		return nCount;
+	}
+
+	// Copy items without removing them, e.g. when the consumer might only be able to use some of them
+	size_t Peek(T* pOutBuffer, size_t nMaxCount) const
+	{
+		const size_t nOutPtr = __atomic_load_n(&m_nOutPtr, __ATOMIC_RELAXED);
+		const size_t nInPtr  = __atomic_load_n(&m_nInPtr, __ATOMIC_ACQUIRE);
+
+		const size_t nCount = Utility::Min(nMaxCount, (nInPtr - nOutPtr) & BufferMask);
+		if (nCount == 0)
+			return 0;
+
+		// Copy up to the end of the buffer, then wrap around
+		const size_t nFirst = Utility::Min(nCount, N - nOutPtr);
+		memcpy(pOutBuffer, &m_Data[nOutPtr], nFirst * sizeof(T));
+		memcpy(pOutBuffer + nFirst, &m_Data[0], (nCount - nFirst) * sizeof(T));
+
+		return nCount;
+	}
+
+	// Number of items waiting; may grow (from the consumer's view) or shrink (from the producer's) meanwhile
+	size_t GetCount() const
+	{
+		const size_t nOutPtr = __atomic_load_n(&m_nOutPtr, __ATOMIC_ACQUIRE);
+		const size_t nInPtr  = __atomic_load_n(&m_nInPtr, __ATOMIC_ACQUIRE);
+		return (nInPtr - nOutPtr) & BufferMask;
+	}
+
+	// Most items found waiting by Dequeue() since the last call, which starts a new measurement; consumer only
+	size_t TakeHighWaterMark()
+	{
+		const size_t nHighWaterMark = m_nHighWaterMark;
+		m_nHighWaterMark = 0;
+		return nHighWaterMark;
+	}
+
+	// Remove items previously copied with Peek()
+	void Skip(size_t nCount)
+	{
+		const size_t nOutPtr = __atomic_load_n(&m_nOutPtr, __ATOMIC_RELAXED);
+		__atomic_store_n(&m_nOutPtr, (nOutPtr + nCount) & BufferMask, __ATOMIC_RELEASE);
+	}
+
+	bool Peek(T& OutItem)
+	{
+		const size_t nOutPtr = __atomic_load_n(&m_nOutPtr, __ATOMIC_RELAXED);
+
+		if (nOutPtr == __atomic_load_n(&m_nInPtr, __ATOMIC_ACQUIRE))
+			return false;
+
+		OutItem = m_Data[nOutPtr];
+		return true;
+	}
+
+private:
+	static_assert(Utility::IsPowerOfTwo(N), "Ring buffer size must be a power of 2");
+	static_assert(std::is_trivially_copyable<T>::value, "Lock-free ring buffer items must be trivially copyable");
+
+	static constexpr size_t BufferMask = N - 1;
+
+	void UpdateHighWaterMark()
+	{
+		m_nHighWaterMark = Utility::Max(m_nHighWaterMark, GetCount());
+	}
+
+	size_t m_nInPtr;
+	size_t m_nOutPtr;
+
+	// Written by the consumer only
+	size_t m_nHighWaterMark;
+
+	T m_Data[N];
+};
+
 #endif
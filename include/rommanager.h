@@ -23,6 +23,9 @@
 #ifndef _rommanager_h
 #define _rommanager_h
 
+#include <circle/string.h>
+#include <circle/types.h>
+
 #include <mt32emu/mt32emu.h>
 
 #include "synth/mt32romset.h"
@@ -38,8 +41,30 @@ public:
 	bool GetROMSet(TMT32ROMSet ROMSet, TMT32ROMSet& pOutROMSet, const MT32Emu::ROMImage*& pOutControl, const MT32Emu::ROMImage*& pOutPCM) const;
 
 private:
-	bool CheckROM(const char* pPath);
-	bool StoreROM(const MT32Emu::ROMImage& ROMImage);
+	// Cached identification of one file, so that unchanged files don't need to be read and hashed again
+	struct TIndexEntry
+	{
+		CString FileName;
+		u32 nSize;
+		u16 nDate;
+		u16 nTime;
+		u8 nSlot;
+	};
+
+	static constexpr size_t MaxIndexEntries = 256;
+
+	// ROM slots are numbered in the order of the members below; a file that wasn't needed is left unidentified until it is
+	static constexpr u8 SlotCount        = 5;
+	static constexpr u8 NotROMSlot       = 0xFF;
+	static constexpr u8 UnidentifiedSlot = 0xFE;
+
+	bool CheckROM(const char* pPath, u8& nOutSlot);
+	bool StoreROM(const MT32Emu::ROMImage& ROMImage, u8& nOutSlot);
+	bool IsNeeded(size_t nSize) const;
+	const MT32Emu::ROMImage** GetSlot(u8 nSlot);
+
+	static size_t LoadIndex(const char* pIndexPath, TIndexEntry* pEntries);
+	static bool SaveIndex(const char* pIndexPath, const TIndexEntry* pEntries, size_t nEntries);
 
 	// Control ROMs
 	const MT32Emu::ROMImage* m_pMT32OldControl;
@@ -24,6 +24,7 @@
 #define _soundfontmanager_h
 
 #include <circle/string.h>
+#include <circle/types.h>
 
 class CSoundFontManager
 {
@@ -37,17 +38,49 @@ public:
 	const char* GetSoundFontName(size_t nIndex) const;
 	const char* GetFirstValidSoundFontPath() const;
 
+	// Approximate heap needed to load a SoundFont, or 0 if unknown
+	size_t GetSoundFontMemorySize(size_t nIndex, bool bIncludeSampleData = true) const;
+
+	// Sizes of the 16-bit sample data and the optional 24-bit extension (the low byte of each sample)
+	void GetSampleDataSizes(size_t nIndex, size_t& nSample16DataSize, size_t& nSample24DataSize) const;
+
 private:
 	struct TSoundFontListEntry
 	{
 		CString Name;
 		CString Path;
+		u16 nPresets;
+		u16 nSamples;
+		size_t nSampleDataSize;
+		size_t nSample16DataSize;
+		size_t nSample24DataSize;
+		size_t nPresetMemorySize;
+	};
+
+	// Cached result of checking one file, so that unchanged files don't need to be parsed again
+	struct TIndexEntry
+	{
+		CString FileName;
+		CString Name;
+		u32 nSize;
+		u16 nDate;
+		u16 nTime;
+		bool bValid;
+		u16 nPresets;
+		u16 nSamples;
+		u32 nSampleDataSize;
+		u32 nSample16DataSize;
+		u32 nSample24DataSize;
+		u32 nPresetDataSize;
+		u32 nZones;
 	};
 
 	static constexpr size_t MaxSoundFonts = 256;
 	static constexpr size_t MaxSoundFontNameLength = 256;
 
-	void CheckSoundFont(const char* pFullPath, const char* pFileName);
+	static bool CheckSoundFont(const char* pFullPath, TIndexEntry& Entry);
+	static size_t LoadIndex(const char* pIndexPath, TIndexEntry* pEntries);
+	static bool SaveIndex(const char* pIndexPath, const TIndexEntry* pEntries, size_t nEntries);
 
 	size_t m_nSoundFonts;
 	TSoundFontListEntry m_SoundFontList[MaxSoundFonts];
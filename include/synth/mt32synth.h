@@ -29,6 +29,7 @@
 
 #include "rommanager.h"
 #include "synth/mt32romset.h"
+#include "synth/polyphaseresampler.h"
 #include "synth/synthbase.h"
 #include "utility.h"
 
@@ -40,7 +41,8 @@ public:
 		ENUM(Fastest, fastest)          \
 		ENUM(Fast, fast)                \
 		ENUM(Good, good)                \
-		ENUM(Best, best)
+		ENUM(Best, best)                \
+		ENUM(Polyphase, polyphase)
 
 	#define ENUM_MIDICHANNELS(ENUM) \
 		ENUM(Standard, standard)    \
@@ -49,22 +51,30 @@ public:
 	CONFIG_ENUM(TResamplerQuality, ENUM_RESAMPLERQUALITY);
 	CONFIG_ENUM(TMIDIChannels, ENUM_MIDICHANNELS);
 
-	CMT32Synth(unsigned nSampleRate, float nGain, float nReverbGain, TResamplerQuality ResamplerQuality);
+	// With bIntegerRenderer set, mt32emu synthesizes in 16-bit fixed point, which is cheaper when the output is 16-bit
+	CMT32Synth(unsigned nSampleRate, float nGain, float nReverbGain, TResamplerQuality ResamplerQuality, bool bIntegerRenderer = false);
 	virtual ~CMT32Synth();
 
 	// CSynthBase
 	virtual bool Initialize() override;
-	virtual void HandleMIDIShortMessage(u32 nMessage) override;
-	virtual void HandleMIDISysExMessage(const u8* pData, size_t nSize) override;
+	virtual void HandleMIDIShortMessage(u32 nMessage, unsigned int nTimestamp) override;
+	virtual void HandleMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override;
 	virtual bool IsActive() override { return m_pSynth->isActive(); }
 	virtual void AllSoundOff() override;
 	virtual void SetMasterVolume(u8 nVolume) override;
 	virtual size_t Render(s16* pBuffer, size_t nFrames) override;
 	virtual size_t Render(float* pBuffer, size_t nFrames) override;
 	virtual u8 GetChannelVelocities(u8* pOutVelocities, size_t nMaxChannels) override;
+	virtual u32 GetActiveVoiceCount() override;
 	virtual void ReportStatus() const override;
 
+	// Plays a Roland data set (DT1) message that was too large to buffer whole, as a series of smaller DT1 messages;
+	// returns false if it isn't a DT1 message for the MT-32, or another source is still streaming one
+	bool HandleMIDISysExFragment(const void* pSource, const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp);
+
+	void SetGain(float nGain, float nReverbGain);
 	void SetMIDIChannels(TMIDIChannels Channels);
+	void SetResamplerQuality(TResamplerQuality ResamplerQuality);
 	bool SwitchROMSet(TMT32ROMSet ROMSet);
 	bool NextROMSet();
 	TMT32ROMSet GetROMSet() const;
@@ -74,6 +84,19 @@ public:
 	u8 GetMasterVolume() const;
 
 private:
+	// CSynthBase
+	virtual void PlayMIDIShortMessage(u32 nMessage, unsigned int nTimestamp) override;
+	virtual void PlayMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override;
+
+	MT32Emu::Synth* OpenSynth(const MT32Emu::ROMImage& ControlROMImage, const MT32Emu::ROMImage& PCMROMImage);
+	MT32Emu::SampleRateConverter* CreateSampleRateConverter(MT32Emu::Synth& Synth) const;
+	CPolyphaseResampler* CreatePolyphaseResampler(MT32Emu::Synth& Synth) const;
+	bool CacheROMSets();
+	void PlaySysExStreamData(size_t nSize, unsigned int nTimestamp);
+
+	void UpdateRenderTiming(unsigned int nRenderStartTime);
+	MT32Emu::Bit32u GetMIDITimestamp(unsigned int nTimestamp) const;
+
 	// ReportHandler
 	virtual bool onMIDIQueueOverflow() override;
 	virtual void onProgramChanged(MT32Emu::Bit8u nPartNum, const char* pSoundGroupName, const char* pPatchName) override;
@@ -82,14 +105,42 @@ private:
 
 	static const u8 StandardMIDIChannelsSysEx[];
 	static const u8 AlternateMIDIChannelsSysEx[];
+	static const u8 ResetSysEx[];
+
+	static constexpr size_t ROMSetCount = 3;
+
+	// The most data a real MT-32 sends in a single DT1 message
+	static constexpr size_t SysExStreamChunkSize = 256;
+
+	// A stream that hasn't received anything for this long was abandoned, and another source may start one
+	static constexpr unsigned int SysExStreamTimeoutMicros = 1000000;
 
 	MT32Emu::Synth* m_pSynth;
+	MT32Emu::Bit32u m_nRenderedSampleCount;
 
 	float m_nGain;
 	float m_nReverbGain;
 
 	TResamplerQuality m_ResamplerQuality;
 	MT32Emu::SampleRateConverter* m_pSampleRateConverter;
+	CPolyphaseResampler* m_pPolyphaseResampler;
+	bool m_bIntegerRenderer;
+
+	// One opened synth per available ROM set, so that switching doesn't have to reopen
+	MT32Emu::Synth* m_pCachedSynths[ROMSetCount];
+	MT32Emu::SampleRateConverter* m_pCachedSampleRateConverters[ROMSetCount];
+	CPolyphaseResampler* m_pCachedPolyphaseResamplers[ROMSetCount];
+	bool m_bROMSetsCached;
+
+	// Oversized DT1 message being streamed; the last data byte received is held back as it may be the checksum
+	bool m_bSysExStreaming;
+	const void* m_pSysExStreamSource;
+	unsigned int m_nSysExStreamTime;
+	u8 m_nSysExStreamDeviceID;
+	u32 m_nSysExStreamAddress;
+	u8 m_nSysExStreamChecksum;
+	u8 m_SysExStreamData[SysExStreamChunkSize + 1];
+	size_t m_nSysExStreamLength;
 
 	CROMManager m_ROMManager;
 	TMT32ROMSet m_CurrentROMSet;
@@ -0,0 +1,72 @@
+//
+// polyphaseresampler.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _polyphaseresampler_h
+#define _polyphaseresampler_h
+
+#include <circle/types.h>
+
+#include <mt32emu/mt32emu.h>
+
+// Fixed-ratio FIR resampler for mt32emu's output, for when the output rate is a small rational multiple of the synth's
+// rate (e.g. 32kHz to 48kHz or 96kHz); much cheaper than a general purpose converter of similar quality
+class CPolyphaseResampler
+{
+public:
+	CPolyphaseResampler(MT32Emu::Synth& Synth, unsigned int nInputRate, unsigned int nOutputRate);
+
+	static bool IsSupported(unsigned int nInputRate, unsigned int nOutputRate);
+
+	// Renders as much from the synth as is needed to produce nFrames of interleaved stereo output
+	void GetOutputSamples(float* pOutBuffer, size_t nFrames);
+	void GetOutputSamples(s16* pOutBuffer, size_t nFrames);
+
+private:
+	static constexpr size_t MaxPhases      = 8;
+	static constexpr size_t TapsPerPhase   = 32;
+	static constexpr size_t MaxInputFrames = 128;
+	static constexpr size_t HistoryFrames  = TapsPerPhase - 1;
+
+	template <class T>
+	void Resample(T* pOutBuffer, size_t nFrames);
+	void RenderInput(size_t nFrames);
+
+	MT32Emu::Synth& m_Synth;
+
+	// Upsampling and downsampling factors
+	size_t m_nInterpolation;
+	size_t m_nDecimation;
+
+	// One set of coefficients per phase, stored in reverse to line up with the input history
+	alignas(16) float m_Coefficients[MaxPhases][TapsPerPhase];
+
+	// Deinterleaved input; the oldest TapsPerPhase - 1 frames are history carried over from the previous render
+	alignas(16) float m_InputLeft[HistoryFrames + MaxInputFrames];
+	alignas(16) float m_InputRight[HistoryFrames + MaxInputFrames];
+	size_t m_nInputFrames;
+
+	// Newest input frame and phase used by the next output frame
+	size_t m_nPosition;
+	size_t m_nPhase;
+};
+
+#endif
@@ -27,43 +27,198 @@
 
 #include <fluidsynth.h>
 
+#include "ringbuffer.h"
 #include "soundfontmanager.h"
 #include "synth/synthbase.h"
 
 class CSoundFontSynth : public CSynthBase
 {
 public:
-	CSoundFontSynth(unsigned nSampleRate, float nGain = 0.2f, u32 nPolyphony = 256);
+	CSoundFontSynth(unsigned nSampleRate, float nGain = 0.2f, u32 nPolyphony = 256, int nVoiceCullFloor = 0, bool bSplitRender = false, bool bDynamicSampleLoading = false);
 	virtual ~CSoundFontSynth() override;
 
 	// CSynthBase
 	virtual bool Initialize() override;
-	virtual void HandleMIDIShortMessage(u32 nMessage) override;
-	virtual void HandleMIDISysExMessage(const u8* pData, size_t nSize) override;
+	virtual void HandleMIDIShortMessage(u32 nMessage, unsigned int nTimestamp) override;
+	virtual void HandleMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override;
 	virtual bool IsActive() override;
 	virtual void AllSoundOff() override;
 	virtual void SetMasterVolume(u8 nVolume) override;
 	virtual size_t Render(s16* pOutBuffer, size_t nFrames) override;
 	virtual size_t Render(float* pOutBuffer, size_t nFrames) override;
 	virtual u8 GetChannelVelocities(u8* pOutVelocities, size_t nMaxChannels) override;
+	virtual u32 GetActiveVoiceCount() override;
 	virtual void ReportStatus() const override;
+	virtual void ProcessMIDICommands() override;
 
 	bool SwitchSoundFont(size_t nIndex);
 	size_t GetSoundFontIndex() const { return m_nCurrentSoundFontIndex; }
 	CSoundFontManager& GetSoundFontManager() { return m_SoundFontManager; }
 
+	// Background loading; a standby synth is loaded by another CPU core while the current one keeps playing
+	void SetPreloadEnabled(bool bEnabled) { m_bPreloadEnabled = bEnabled; }
+	void PreloadSoundFont(size_t nIndex);
+	bool CancelPreload();
+	bool IsPreloadRequested() const { return m_PreloadState == TPreloadState::Requested; }
+	bool IsPreloadBusy() const { return m_PreloadState == TPreloadState::Requested || m_PreloadState == TPreloadState::Loading; }
+	void RunPreload();
+
+	// Hold back messages that may load samples (with dynamic sample loading) while another core uses the file system
+	void SetSampleLoadingDeferred(bool bDeferred);
+	bool IsSampleLoadingDeferred() const { return m_bSampleLoadingDeferred; }
+
+	void SetGain(float nGain);
+	void SetPolyphony(u32 nPolyphony);
+	u32 GetPolyphony() const { return m_nPolyphony; }
+	void SetVoiceCullFloor(int nVoiceCullFloor);
+
+	// Reverb and chorus; also applies to synths created later, e.g. by switching SoundFont
+	void SetEffectsEnabled(bool bEnabled);
+
+	// Split rendering; odd MIDI channels are rendered by a secondary synth instance which may run on another CPU core
+	bool IsSplitRenderEnabled() const { return m_pSecondarySynth != nullptr; }
+	size_t RenderPrimary(float* pOutBuffer, size_t nFrames);
+	size_t RenderSecondary(float* pOutBuffer, size_t nFrames);
+
 private:
+	// A short MIDI message to be played at a position on the synth's sample timeline
+	struct TTimedMIDIMessage
+	{
+		u32 nPosition;
+		u32 nMessage;
+	};
+
+	static constexpr size_t MIDIChannelCount   = 16;
+	static constexpr size_t MIDIEventQueueSize = 1024;
+	static constexpr size_t DeferredMIDIBufferSize = 1024;
+	// Filled by the MIDI thread; drained by the render thread, or by the MIDI thread while holding the synth's lock
+	using TMIDIEventQueue = CRingBuffer<TTimedMIDIMessage, MIDIEventQueueSize, TRingBufferSync::SPSC>;
+	using TWriteFunction  = int (*)(fluid_synth_t*, int, void*, int, int, void*, int, int);
+
+	enum class TPreloadState
+	{
+		Idle,
+		Requested,
+		Loading,
+		Ready,
+		Failed,
+	};
+
+	// Per-channel note velocities, published by the render thread after each chunk so that the UI can read them without locking
+	struct TVelocitySnapshot
+	{
+		volatile unsigned int nSequence;
+		volatile u8 Velocities[MIDIChannelCount];
+	};
+
+	// Released voices being timed for culling, by voice ID (plus one, so that zero means unused), and the timeline
+	// position at which each is expected to have faded below the floor; owned by the render thread
+	struct TVoiceCullState
+	{
+		static constexpr size_t Slots = 512;
+
+		unsigned int VoiceTags[Slots];
+		u32 CullPositions[Slots];
+	};
+
+	// Enough to run FluidSynth's mixer for one internal block
+	static constexpr size_t VoiceReleaseFrames = 64;
+
+	// CSynthBase
+	virtual void PlayMIDIShortMessage(u32 nMessage, unsigned int nTimestamp) override;
+	virtual void PlayMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override;
+
 	bool Reinitialize(const char* pSoundFontPath);
+	bool LoadSoundFont(const char* pSoundFontPath);
+	fluid_synth_t* LoadSynth(const char* pSoundFontPath, bool bPreload);
+	bool UnloadSoundFont();
+	bool SwapPreloadedSynth();
+	bool HasMemoryFor(size_t nIndex, bool bReplaceCurrent) const;
+	void WaitForPreload() const;
+	void DiscardPreload();
+	void DestroySynths();
+
+	// Odd channel indices (MIDI channels 2, 4, ..., including drums on 10) go to the secondary synth
+	fluid_synth_t* GetChannelSynth(u8 nChannel) const { return m_pSecondarySynth && (nChannel & 1) ? m_pSecondarySynth : m_pSynth; }
+	CSpinLock& GetChannelLock(u8 nChannel) { return m_pSecondarySynth && (nChannel & 1) ? m_SecondaryLock : m_Lock; }
+	TMIDIEventQueue& GetChannelEventQueue(u8 nChannel) { return m_pSecondarySynth && (nChannel & 1) ? m_SecondaryEventQueue : m_PrimaryEventQueue; }
+	void PlayShortMessageNow(u32 nMessage);
+	void CreateLoaderSynth();
+	void ShareSoundFontWithLoader(fluid_sfont_t* pSoundFont);
+	void UnshareSoundFontWithLoader(fluid_sfont_t* pSoundFont);
+	bool LoadPresetSamples(u32 nMessage);
+	bool LoadDefaultPresetSamples();
+	void ReleasePresetSamples();
+	static bool SelectsDefaultPresets(const u8* pData, size_t nSize);
+	void QueueShortMessage(TMIDIEventQueue& Queue, fluid_synth_t* pSynth, const TTimedMIDIMessage& Message);
+	void FlushAllEvents();
+	void AcquireAll();
+	void ReleaseAll();
+
+	static bool SelectsPreset(u32 nMessage) { return (nMessage & 0xF0) == 0xC0 || (nMessage & 0xFF) == 0xFF; }
+	static bool SelectsBank(u32 nMessage) { return (nMessage & 0xF0) == 0xB0 && (((nMessage >> 8) & 0xFF) == 0 || ((nMessage >> 8) & 0xFF) == 32); }
+	void DeferMIDIMessage(const u8* pData, size_t nSize);
+	void PlaySysExNow(const u8* pData, size_t nSize, unsigned int nTimestamp);
+	static bool ReleaseVoices(fluid_synth_t* pSynth);
+	static void CopySynthState(fluid_synth_t* pFromSynth, fluid_synth_t* pToSynth);
+	static void PlayShortMessage(fluid_synth_t* pSynth, u32 nMessage);
+	static void FlushEvents(fluid_synth_t* pSynth, TMIDIEventQueue& Queue);
+	static void DiscardEvents(TMIDIEventQueue& Queue);
+	static void RenderWithEvents(fluid_synth_t* pSynth, TMIDIEventQueue& Queue, u32& nPosition, void* pOutBuffer, size_t nFrames, TWriteFunction pWriteFunction);
+	static void GetVoiceVelocities(fluid_synth_t* pSynth, u8* pOutVelocities, size_t nMaxChannels);
+	static void PublishVelocities(fluid_synth_t* pSynth, TVelocitySnapshot& Snapshot);
+	static void ReadVelocities(const TVelocitySnapshot& Snapshot, u8* pOutVelocities, size_t nMaxChannels);
+	void CullVoices(fluid_synth_t* pSynth, TVoiceCullState& State, u32 nPosition) const;
+	u32 GetCullDelayFrames(fluid_voice_t* pVoice) const;
 
 	fluid_settings_t* m_pSettings;
 	fluid_synth_t* m_pSynth;
 
+	bool m_bSplitRender;
+	CSpinLock m_SecondaryLock;
+	fluid_synth_t* m_pSecondarySynth;
+
+	// Timestamped MIDI events waiting to be played by the render thread
+	// Samples are loaded when a preset is selected, so preset changes must not be played by the render thread
+	bool m_bDynamicSampleLoading;
+
+	// Shares the primary synth's SoundFont but is never rendered; presets are selected on it first so that their samples
+	// are read from disk without holding the render locks, then left to the live synths; only used by the MIDI thread
+	fluid_settings_t* m_pLoaderSettings;
+	fluid_synth_t* m_pLoaderSynth;
+
+	// Raw MIDI bytes held back by SetSampleLoadingDeferred(); only used by the MIDI thread
+	bool m_bSampleLoadingDeferred;
+	u8 m_DeferredMIDIBuffer[DeferredMIDIBufferSize];
+	size_t m_nDeferredMIDIBytes;
+
+	TMIDIEventQueue m_PrimaryEventQueue;
+	TMIDIEventQueue m_SecondaryEventQueue;
+	u32 m_nPrimaryPosition;
+	u32 m_nSecondaryPosition;
+	u32 m_nLastEventPosition;
+
+	TVelocitySnapshot m_PrimaryVelocities;
+	TVelocitySnapshot m_SecondaryVelocities;
+
+	// Released voices are stopped once they're estimated to be this many dB below full scale; 0 disables culling
+	u8 m_nVoiceCullFloor;
+	TVoiceCullState m_PrimaryCullState;
+	TVoiceCullState m_SecondaryCullState;
+
 	float m_nInitialGain;
 	float m_nCurrentGain;
 
 	u32 m_nPolyphony;
 	size_t m_nCurrentSoundFontIndex;
 
+	// Standby synth; owned by the loader core while requested or loading, otherwise by the MIDI thread
+	bool m_bPreloadEnabled;
+	CSpinLock m_PreloadLock;
+	volatile TPreloadState m_PreloadState;
+	size_t m_nPreloadIndex;
+	fluid_synth_t* m_pPreloadSynth;
+
 	CSoundFontManager m_SoundFontManager;
 
 	static void FluidSynthLogCallback(int nLevel, const char* pMessage, void* pUser);
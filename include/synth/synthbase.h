@@ -26,6 +26,9 @@
 #include <circle/synchronize.h>
 #include <circle/types.h>
 
+#include "ringbuffer.h"
+#include "utility.h"
+
 class CSynthLCD;
 
 class CSynthBase
@@ -34,28 +37,129 @@ public:
 	CSynthBase(unsigned int nSampleRate)
 		: m_Lock(TASK_LEVEL),
 		  m_nSampleRate(nSampleRate),
-		  m_pLCD(nullptr)
+		  m_pLCD(nullptr),
+
+		  m_bMIDICommandQueueEnabled(false),
+
+		  m_nTimingSequence(0),
+		  m_nRenderStartTime(0),
+		  m_nNextChunkPosition(0),
+		  m_nChunkLength(0)
 	{
 	}
 
 	virtual ~CSynthBase() = default;
 
 	virtual bool Initialize() = 0;
-	virtual void HandleMIDIShortMessage(u32 nMessage) = 0;
-	virtual void HandleMIDISysExMessage(const u8* pData, size_t nSize) = 0;
+
+	// MIDI timestamps are CTimer::GetClockTicks() values taken when the data arrived
+	virtual void HandleMIDIShortMessage(u32 nMessage, unsigned int nTimestamp) = 0;
+	virtual void HandleMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) = 0;
+
 	virtual bool IsActive() = 0;
 	virtual void AllSoundOff() = 0;
 	virtual void SetMasterVolume(u8 nVolume) = 0;
 	virtual size_t Render(s16* pOutBuffer, size_t nFrames) = 0;
 	virtual size_t Render(float* pOutBuffer, size_t nFrames) = 0;
 	virtual u8 GetChannelVelocities(u8* pOutVelocities, size_t nMaxChannels) = 0;
+	virtual u32 GetActiveVoiceCount() = 0;
 	virtual void ReportStatus() const = 0;
-	void SetLCD(CSynthLCD* pLCD) { m_pLCD = pLCD; }
+
+	// Rendering only uses the display with the synth's lock held, so the main task can replace it while audio is running
+	void SetLCD(CSynthLCD* pLCD)
+	{
+		m_Lock.Acquire();
+		m_pLCD = pLCD;
+		m_Lock.Release();
+	}
+
+	// When enabled, incoming MIDI is queued without taking the synth's lock and played by the render thread
+	void SetMIDICommandQueueEnabled(bool bEnabled) { m_bMIDICommandQueueEnabled = bEnabled; }
+
+	// Play any queued MIDI; called by the render thread before each chunk
+	virtual void ProcessMIDICommands();
+
+	// Called by the render thread in place of a chunk it skipped because the synth was silent; MIDI that arrives
+	// meanwhile is timed from nRenderStartTime, as if the chunk had been rendered
+	void SkipRender(unsigned int nRenderStartTime) { UpdateRenderTiming(nRenderStartTime, m_nNextChunkPosition, m_nChunkLength); }
 
 protected:
+	bool IsMIDICommandQueueEnabled() const { return m_bMIDICommandQueueEnabled; }
+
+	// Returns false if the command queue is disabled or the message could not be queued; the caller should play it directly
+	bool QueueMIDIShortMessage(u32 nMessage, unsigned int nTimestamp);
+	bool QueueMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp);
+
+	// Consumer side of the command queue; the caller must hold every lock needed by PlayMIDI*()
+	void DrainMIDICommands();
+	void DiscardMIDICommands();
+
+	// Play a message that was taken from the command queue
+	virtual void PlayMIDIShortMessage(u32 nMessage, unsigned int nTimestamp) = 0;
+	virtual void PlayMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) = 0;
+
+	// Called by the render thread after each chunk; positions are in units of the synth's own sample timeline
+	void UpdateRenderTiming(unsigned int nRenderStartTime, u32 nNextChunkPosition, u32 nChunkLength)
+	{
+		// Odd sequence number while the timing data is being written
+		++m_nTimingSequence;
+		DataMemBarrier();
+		m_nRenderStartTime   = nRenderStartTime;
+		m_nNextChunkPosition = nNextChunkPosition;
+		m_nChunkLength       = nChunkLength;
+		DataMemBarrier();
+		++m_nTimingSequence;
+	}
+
+	// Map a MIDI arrival timestamp onto the sample timeline, delayed by one chunk so that events keep their relative spacing
+	u32 GetTimelinePosition(unsigned int nTimestamp, unsigned int nTimelineRate) const
+	{
+		unsigned int nSequence, nRenderStartTime;
+		u32 nNextChunkPosition, nChunkLength;
+
+		do
+		{
+			nSequence = m_nTimingSequence;
+			DataMemBarrier();
+			nRenderStartTime   = m_nRenderStartTime;
+			nNextChunkPosition = m_nNextChunkPosition;
+			nChunkLength       = m_nChunkLength;
+			DataMemBarrier();
+		} while ((nSequence & 1) || nSequence != m_nTimingSequence);
+
+		// Events that arrived before the chunk started rendering are played at the start of the next one
+		const s32 nElapsedMicros = static_cast<s32>(nTimestamp - nRenderStartTime);
+		if (nElapsedMicros <= 0)
+			return nNextChunkPosition;
+
+		const u32 nOffset = static_cast<u64>(nElapsedMicros) * nTimelineRate / 1000000;
+		return nNextChunkPosition + Utility::Min(nOffset, nChunkLength);
+	}
+
 	CSpinLock m_Lock;
 	unsigned int m_nSampleRate;
 	CSynthLCD* m_pLCD;
+
+private:
+	// Each queued command is a header, followed by nSysExSize bytes of SysEx data
+	struct TMIDICommandHeader
+	{
+		unsigned int nTimestamp;
+		u32 nMessage;
+		u32 nSysExSize;
+	};
+
+	static constexpr size_t MIDICommandQueueSize = 4096;
+
+	bool QueueMIDICommand(const TMIDICommandHeader& Header, const u8* pSysExData);
+
+	bool m_bMIDICommandQueueEnabled;
+	CRingBuffer<u8, MIDICommandQueueSize, TRingBufferSync::SPSC> m_MIDICommandQueue;
+
+	volatile unsigned int m_nTimingSequence;
+	volatile unsigned int m_nRenderStartTime;
+	volatile u32 m_nNextChunkPosition;
+	volatile u32 m_nChunkLength;
 };
 
 #endif
@@ -0,0 +1,112 @@
+//
+// telemetry.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _telemetry_h
+#define _telemetry_h
+
+#include <circle/types.h>
+
+// Sends a fixed-size binary record of system health to the log once a second, for monitoring on a host
+// Each record is written as a single line of hex digits so that it survives any log device alongside text messages;
+// see scripts/decode_telemetry.py
+class CTelemetry
+{
+public:
+	static constexpr unsigned PeriodMillis = 1000;
+	static constexpr u8 RecordVersion      = 1;
+
+	enum class TMIDISource
+	{
+		GPIO,
+		USB,
+		Player,
+
+		Count
+	};
+
+	static constexpr size_t MIDISourceCount = static_cast<size_t>(TMIDISource::Count);
+
+	// All fields are little-endian; counts are totals since startup, so that rates survive lost records
+	struct TRecord
+	{
+		u8 Magic[2];
+		u8 nVersion;
+		u8 nSize;
+		u32 nSequence;
+		u32 nUptime;
+
+		// Render load over the last second, as percentages of the chunk period
+		u16 nAvgLoad;
+		u16 nMaxLoad;
+		u32 nChunks;
+		u32 nLateChunks;
+		u32 nUnderruns;
+		u32 nDroppedChunks;
+
+		// The MIDI file player only counts events
+		u32 nMIDIBytes[MIDISourceCount];
+		u32 nMIDIEvents[MIDISourceCount];
+		u32 nMIDIOverruns;
+
+		// Most items waiting to be processed since the previous record
+		u16 nMIDIRxHighWaterMark;
+		u8 nEventQueueHighWaterMark;
+		u8 nMisterEventQueueHighWaterMark;
+
+		u16 nMT32Partials;
+		u16 nSoundFontVoices;
+		u16 nSoundFontPolyphony;
+
+		// Zone allocator heap, in kilobytes
+		u32 nHeapUsed;
+		u32 nHeapPeakUsed;
+		u32 nHeapFluidSynthUsed;
+		u32 nHeapLargestFreeBlock;
+
+		// Fletcher-16 of all of the preceding bytes
+		u16 nChecksum;
+	}
+	PACKED;
+
+	static_assert(sizeof(TRecord) == 88, "Telemetry record layout changed; bump RecordVersion and update the decoder");
+
+	CTelemetry();
+
+	// Safe to call from interrupt context on core 0
+	void CountMIDIBytes(TMIDISource Source, size_t nBytes) { m_nMIDIBytes[static_cast<size_t>(Source)] += nBytes; }
+	void CountMIDIEvent(TMIDISource Source) { ++m_nMIDIEvents[static_cast<size_t>(Source)]; }
+	void CountMIDIOverrun() { ++m_nMIDIOverruns; }
+
+	// Called by the main task with every other field filled in
+	void Send(TRecord& Record);
+
+private:
+	static u16 GetChecksum(const u8* pData, size_t nSize);
+
+	u32 m_nSequence;
+
+	volatile u32 m_nMIDIBytes[MIDISourceCount];
+	volatile u32 m_nMIDIEvents[MIDISourceCount];
+	volatile u32 m_nMIDIOverruns;
+};
+
+#endif
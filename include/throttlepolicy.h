@@ -0,0 +1,58 @@
+//
+// throttlepolicy.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _throttlepolicy_h
+#define _throttlepolicy_h
+
+#include <circle/types.h>
+
+// Steps sound quality down while the firmware is throttling the CPU or reporting undervoltage, and back up once it stops
+class CThrottlePolicy
+{
+public:
+	enum class TLevel
+	{
+		Full,
+		ReducedResampler,
+		NoEffects,
+	};
+
+	CThrottlePolicy();
+
+	// Each returns true if the quality level has changed
+	bool OnThrottleDetected();
+	bool Update(bool bThrottled);
+	bool OnThrottleCleared();
+
+	TLevel GetLevel() const { return m_Level; }
+
+private:
+	// Time to let a step take effect before stepping down again if still throttled
+	static constexpr unsigned StepHoldMillis = 10000;
+
+	bool StepDown();
+
+	TLevel m_Level;
+	unsigned m_nStepTime;
+};
+
+#endif
@@ -0,0 +1,88 @@
+//
+// wavrecorder.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _wavrecorder_h
+#define _wavrecorder_h
+
+#include <circle/string.h>
+#include <circle/types.h>
+#include <fatfs/ff.h>
+
+#include "ringbuffer.h"
+
+// Records the audio output to a WAV file in the recordings directory of a disk
+// The audio task only copies samples into a buffer; they're written to the file from the main task
+class CWAVRecorder
+{
+public:
+	CWAVRecorder();
+	~CWAVRecorder();
+
+	// Samples are 16-bit, or 24-bit values in 32-bit words, as sent to the sound device
+	bool Start(const char* pDisk, unsigned int nSampleRate, bool b24Bit);
+	void Stop();
+	bool IsRecording() const { return m_bRecording; }
+	const char* GetFileName() const { return m_FileName; }
+
+	// Called by the audio task; never waits, and drops the samples if the buffer is full
+	void WriteSamples(const void* pData, size_t nSize);
+
+	// Called by the main task; writes a block to the file whenever a whole one is buffered
+	void Update();
+
+private:
+	// About 2.7 seconds of 24-bit stereo at 48kHz
+	static constexpr size_t BufferSize = 1 << 20;
+
+	// Whole 16-bit and 24-bit stereo frames and whole sectors, so that FatFs can write straight from our buffer
+	static constexpr size_t WriteBlockSize = 48 * 1024;
+
+	// Data starts on a sector boundary, with a JUNK chunk padding out the header
+	static constexpr size_t HeaderSize = 512;
+
+	// Contiguous space reserved up front where supported; about 4 minutes of 24-bit stereo at 48kHz
+	static constexpr size_t PreallocateSize = 64 * 1024 * 1024;
+
+	using TSampleBuffer = CRingBuffer<u8, BufferSize, TRingBufferSync::SPSC>;
+
+	// Buffered bytes that make up one block in the file; 24-bit samples are buffered as 32-bit words
+	size_t GetReadBlockSize() const { return m_b24Bit ? WriteBlockSize / 3 * 4 : WriteBlockSize; }
+	bool WriteBlock(size_t nBufferedBytes);
+	bool WriteHeader();
+
+	TSampleBuffer* m_pBuffer;
+	volatile bool m_bRecording;
+
+	FIL m_File;
+	CString m_FileName;
+	unsigned int m_nSampleRate;
+	bool m_b24Bit;
+	u32 m_nDataSize;
+	bool m_bWriteError;
+
+	// Written by the audio task only
+	volatile size_t m_nDroppedBytes;
+
+	alignas(64) u8 m_WriteBuffer[WriteBlockSize / 3 * 4];
+};
+
+#endif
@@ -23,6 +23,7 @@
 #ifndef _zoneallocator_h
 #define _zoneallocator_h
 
+#include <circle/spinlock.h>
 #include <circle/types.h>
 
 // Block allocation tags
@@ -36,6 +37,27 @@ enum TZoneTag : u32
 class CZoneAllocator
 {
 public:
+	static constexpr size_t TagCount = TZoneTag::FluidSynth + 1;
+
+	// Sizes include block headers; call times are in microseconds
+	struct TStats
+	{
+		size_t nHeapSize;
+		size_t nUsedBytes;
+		size_t nPeakUsedBytes;
+		size_t nTagUsedBytes[TagCount];
+		size_t nLargestFreeBlock;
+		size_t nFreeBlocks;
+		size_t nAllocCount;
+
+		u32 nAllocCalls;
+		u32 nReallocCalls;
+		u32 nFreeCalls;
+		u64 nAllocTime;
+		u64 nReallocTime;
+		u64 nFreeTime;
+	};
+
 	CZoneAllocator();
 	~CZoneAllocator();
 
@@ -45,6 +67,8 @@ public:
 	void* Realloc(void* pPtr, size_t nSize, TZoneTag Tag);
 	void Free(void* pPtr);
 	size_t GetAllocCount() const { return m_nAllocCount; }
+	TStats GetStats();
+	void LogStats();
 
 	void FreeTag(u32 nTag);
 	void Clear();
@@ -66,9 +90,49 @@ private:
 #endif
 	};
 
+	// Links to neighbouring blocks in the same size class; stored in the body of a free block
+	struct TFreeLinks
+	{
+		TBlock* pNextFree;
+		TBlock* pPreviousFree;
+	};
+
 	// Constants
 	static constexpr u32 BlockMagic         = 0xDA1EDEAD;
-	static constexpr size_t MinFragmentSize = 16;
+	static constexpr size_t BlockAlignment  = 16;
+	static constexpr size_t MinBlockSize    = (sizeof(TBlock) + sizeof(TFreeLinks) + BlockAlignment - 1) & ~(BlockAlignment - 1);
+
+	// Free blocks up to this size (including header) are binned by exact size, larger ones by power of two
+	static constexpr size_t SmallBlockLimitLog2 = 10;
+	static constexpr size_t SmallBlockLimit     = 1 << SmallBlockLimitLog2;
+	static constexpr size_t SmallBinCount       = (SmallBlockLimit - MinBlockSize) / BlockAlignment + 1;
+	static constexpr size_t LargeBinCount       = sizeof(size_t) * 8 - SmallBlockLimitLog2;
+	static constexpr size_t BinCount            = SmallBinCount + LargeBinCount;
+	static constexpr size_t BinMapWords         = (BinCount + 31) / 32;
+
+	void* AllocUnlocked(size_t nSize, TZoneTag Tag);
+	void* ReallocUnlocked(void* pPtr, size_t nSize, TZoneTag Tag);
+	TBlock* FreeUnlocked(void* pPtr);
+
+	TBlock* FindFreeBlock(size_t nSize) const;
+	void InsertFreeBlock(TBlock* pBlock);
+	void RemoveFreeBlock(TBlock* pBlock);
+	void SplitBlock(TBlock* pBlock, size_t nSize);
+	static void JoinNextBlock(TBlock* pBlock);
+	static size_t GetBinIndex(size_t nSize);
+
+	// Account for size of block header and magic number at end of zone (for corruption detection), padded to 16 bytes
+	static size_t GetBlockSize(size_t nSize)
+	{
+		nSize = (nSize + sizeof(TBlock) + sizeof(BlockMagic) + BlockAlignment - 1) & ~(BlockAlignment - 1);
+		return nSize < MinBlockSize ? MinBlockSize : nSize;
+	}
+
+	void AddUsage(const TBlock* pBlock);
+	void RemoveUsage(const TBlock* pBlock);
+	size_t GetLargestFreeBlock() const;
+
+	static TFreeLinks& GetFreeLinks(TBlock* pBlock) { return *reinterpret_cast<TFreeLinks*>(pBlock + 1); }
 
 	inline u32& GetEndMagic(TBlock* pBlock) const
 	{
@@ -78,9 +142,27 @@ private:
 	void* m_pHeap;
 	size_t m_nHeapSize;
 	TBlock m_MainBlock;
-	TBlock* m_pCurrentBlock;
+
+	// Segregated free lists, and a bitmap of which of them are non-empty
+	TBlock* m_pFreeBins[BinCount];
+	u32 m_BinMap[BinMapWords];
 
 	size_t m_nAllocCount;
+	size_t m_nFreeBlocks;
+
+	// Statistics
+	size_t m_nUsedBytes;
+	size_t m_nPeakUsedBytes;
+	size_t m_nTagUsedBytes[TagCount];
+	u32 m_nAllocCalls;
+	u32 m_nReallocCalls;
+	u32 m_nFreeCalls;
+	u64 m_nAllocTime;
+	u64 m_nReallocTime;
+	u64 m_nFreeTime;
+
+	// FluidSynth may allocate from more than one CPU core (e.g. background SoundFont loading)
+	CSpinLock m_Lock;
 
 	static CZoneAllocator* s_pThis;
 };
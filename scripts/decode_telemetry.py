@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+
+# Decodes the telemetry records that mt32-pi logs once a second when "telemetry = on" is set in mt32-pi.cfg.
+# Reads a captured log from the given file, or standard input, and prints one line per record.
+#
+# The record layout matches CTelemetry::TRecord in include/telemetry.h.
+
+import argparse
+import re
+import struct
+import sys
+
+RECORD_VERSION = 1
+RECORD_FORMAT = "<2sBBII" "HHIIII" "3I3II" "HBB" "HHH" "IIII" "H"
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+RECORD_PATTERN = re.compile(r"telemetry: ([0-9a-f]{%d})(?![0-9a-f])" % (RECORD_SIZE * 2))
+
+MIDI_SOURCES = ("gpio", "usb", "player")
+
+
+def fletcher16(data):
+    sum1 = 0
+    sum2 = 0
+    for byte in data:
+        sum1 = (sum1 + byte) % 255
+        sum2 = (sum2 + sum1) % 255
+    return sum2 << 8 | sum1
+
+
+def decode(data):
+    fields = struct.unpack(RECORD_FORMAT, data)
+    magic, version, size, sequence, uptime = fields[0:5]
+
+    if magic != b"MT" or version != RECORD_VERSION or size != RECORD_SIZE:
+        return None
+
+    if fields[-1] != fletcher16(data[:-2]):
+        return None
+
+    return {
+        "sequence": sequence,
+        "uptime": uptime,
+        "avg_load": fields[5],
+        "max_load": fields[6],
+        "chunks": fields[7],
+        "late_chunks": fields[8],
+        "underruns": fields[9],
+        "dropped_chunks": fields[10],
+        "midi_bytes": fields[11:14],
+        "midi_events": fields[14:17],
+        "midi_overruns": fields[17],
+        "midi_rx_high_water": fields[18],
+        "event_queue_high_water": fields[19],
+        "mister_event_queue_high_water": fields[20],
+        "mt32_partials": fields[21],
+        "soundfont_voices": fields[22],
+        "soundfont_polyphony": fields[23],
+        "heap_used_kb": fields[24],
+        "heap_peak_used_kb": fields[25],
+        "heap_fluidsynth_kb": fields[26],
+        "heap_largest_free_kb": fields[27],
+    }
+
+
+def format_record(record, previous):
+    # Counters are totals since startup; show how much they grew since the previous record, when there is one
+    def delta(name, index=None):
+        value = record[name] if index is None else record[name][index]
+        if previous is None:
+            return value
+        last = previous[name] if index is None else previous[name][index]
+        return (value - last) & 0xFFFFFFFF
+
+    midi = ", ".join(
+        "{} {}B/{}ev".format(source, delta("midi_bytes", i), delta("midi_events", i))
+        for i, source in enumerate(MIDI_SOURCES)
+    )
+
+    return (
+        "#{sequence} {uptime}s: load avg {avg_load}% max {max_load}%, "
+        "late {late}, underruns {underruns}, dropped {dropped}; "
+        "MIDI {midi}, overruns {overruns}; "
+        "high water rx {midi_rx_high_water} events {event_queue_high_water}/{mister_event_queue_high_water}; "
+        "partials {mt32_partials}, voices {soundfont_voices}/{soundfont_polyphony}; "
+        "heap {heap_used_kb} KB (peak {heap_peak_used_kb} KB, FluidSynth {heap_fluidsynth_kb} KB, "
+        "largest free {heap_largest_free_kb} KB)"
+    ).format(
+        **dict(
+            record,
+            late=delta("late_chunks"),
+            underruns=delta("underruns"),
+            dropped=delta("dropped_chunks"),
+            midi=midi,
+            overruns=delta("midi_overruns"),
+        )
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode mt32-pi telemetry records from a log.")
+    parser.add_argument("log", nargs="?", help="log file (default: standard input)")
+    args = parser.parse_args()
+
+    log = open(args.log, errors="replace") if args.log else sys.stdin
+    previous = None
+    bad_records = 0
+
+    for line in log:
+        match = RECORD_PATTERN.search(line)
+        if not match:
+            continue
+
+        record = decode(bytes.fromhex(match.group(1)))
+        if record is None:
+            bad_records += 1
+            continue
+
+        # A restart begins a new sequence, so there's nothing to compare with
+        if previous is not None and record["sequence"] <= previous["sequence"]:
+            previous = None
+
+        print(format_record(record, previous))
+        previous = record
+
+    if bad_records:
+        print("{} records were corrupt or from another version".format(bad_records), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,79 @@
+//
+// bootprofiler.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <circle/logger.h>
+#include <circle/timer.h>
+
+#include <assert.h>
+
+#include "bootprofiler.h"
+
+const char BootProfilerName[] = "bootprofiler";
+
+CBootProfiler* CBootProfiler::s_pThis = nullptr;
+
+CBootProfiler::CBootProfiler()
+	// The system timer starts counting at power-on, so this includes the firmware's boot time
+	: m_nKernelStartTime(CTimer::GetClockTicks()),
+	  m_nFinishTime(0),
+
+	  m_Stages{},
+	  m_nStages(0)
+{
+	assert(s_pThis == nullptr);
+	s_pThis = this;
+}
+
+CBootProfiler::~CBootProfiler()
+{
+	s_pThis = nullptr;
+}
+
+void CBootProfiler::BeginStage(const char* pName)
+{
+	if (m_nFinishTime || m_nStages == MaxStages)
+		return;
+
+	m_Stages[m_nStages].pName      = pName;
+	m_Stages[m_nStages].nStartTime = CTimer::GetClockTicks();
+	++m_nStages;
+}
+
+void CBootProfiler::Finish()
+{
+	if (m_nFinishTime)
+		return;
+
+	m_nFinishTime = CTimer::GetClockTicks();
+
+	CLogger* const pLogger = CLogger::Get();
+	pLogger->Write(BootProfilerName, LogNotice, "Boot profile:");
+	pLogger->Write(BootProfilerName, LogNotice, "  %-16s %6d ms", "Firmware", m_nKernelStartTime / 1000);
+
+	for (size_t i = 0; i < m_nStages; ++i)
+	{
+		const unsigned int nEndTime = i + 1 < m_nStages ? m_Stages[i + 1].nStartTime : m_nFinishTime;
+		pLogger->Write(BootProfilerName, LogNotice, "  %-16s %6d ms", m_Stages[i].pName, (nEndTime - m_Stages[i].nStartTime) / 1000);
+	}
+
+	pLogger->Write(BootProfilerName, LogNotice, "  %-16s %6d ms", "Total", m_nFinishTime / 1000);
+}
@@ -58,6 +58,7 @@ const char* FalseStrings[] = {"false", "off", "0"};
 
 // Enum string tables
 CONFIG_ENUM_STRINGS(TSystemDefaultSynth, ENUM_SYSTEMDEFAULTSYNTH);
+CONFIG_ENUM_STRINGS(TMIDIUSBRouting, ENUM_MIDIUSBROUTING);
 CONFIG_ENUM_STRINGS(TAudioOutputDevice, ENUM_AUDIOOUTPUTDEVICE);
 CONFIG_ENUM_STRINGS(TAudioI2CDACInit, ENUM_AUDIOI2CDACINIT);
 CONFIG_ENUM_STRINGS(TMT32EmuResamplerQuality, ENUM_RESAMPLERQUALITY);
@@ -76,7 +77,8 @@ CConfig::CConfig()
 	#define CFG(_1, _2, MEMBER_NAME, DEFAULT, _3...) MEMBER_NAME = DEFAULT;
 	#include "config.def"
 
-	s_pThis = this;
+	if (!s_pThis)
+		s_pThis = this;
 }
 
 bool CConfig::Initialize(const char* pPath)
@@ -167,6 +169,7 @@ bool CConfig::ParseOption(const char* pString, float* pOutFloat)
 
 // Define template function wrappers for parsing enums
 CONFIG_ENUM_PARSER(TSystemDefaultSynth);
+CONFIG_ENUM_PARSER(TMIDIUSBRouting);
 CONFIG_ENUM_PARSER(TAudioOutputDevice);
 CONFIG_ENUM_PARSER(TAudioI2CDACInit);
 CONFIG_ENUM_PARSER(TMT32EmuResamplerQuality);
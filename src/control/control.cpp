@@ -21,76 +21,76 @@
 //
 
 #include <circle/interrupt.h>
+#include <circle/timer.h>
 
 #include "control/control.h"
 
-constexpr u16 PollRateMicros = 1000;
+// Buttons must be released for this long before the release is reported; bounces in between are ignored
+constexpr unsigned int DebounceMicros = 16000;
 
 CControl::CControl(TEventQueue& pEventQueue)
 	: m_pEventQueue(&pEventQueue),
-	  m_Timer(CInterruptSystem::Get(), InterruptHandler, this),
-
-	  m_ButtonStateHistory{0},
-	  m_nButtonStateHistoryIndex(0),
-	  m_nButtonState(0),
-	  m_nLastButtonState(0)
+	  m_DebounceTimer(CInterruptSystem::Get(), DebounceTimerHandler, this),
+	  m_nButtonState(0)
 {
 }
 
 bool CControl::Initialize()
 {
-	if (!m_Timer.Initialize())
+	if (!m_DebounceTimer.Initialize())
 		return false;
 
-	m_Timer.Start(PollRateMicros);
+	ConnectGPIOPins();
 
 	return true;
 }
 
-void CControl::Update()
+void CControl::ConnectGPIOPin(CGPIOPin& Pin)
+{
+	Pin.ConnectInterrupt(GPIOInterruptHandler, this);
+	Pin.EnableInterrupt(TGPIOInterrupt::GPIOInterruptOnRisingEdge);
+	Pin.EnableInterrupt2(TGPIOInterrupt::GPIOInterruptOnFallingEdge);
+}
+
+void CControl::OnGPIOEdge(u32 nGPIOState, unsigned int nTimestamp)
+{
+	// Presses are reported straight away, but a button only counts as released once it has stopped bouncing
+	SetButtonState(m_nButtonState | GetPressedButtons(nGPIOState));
+	m_DebounceTimer.Start(DebounceMicros);
+}
+
+void CControl::SetButtonState(u8 nState)
 {
+	const u8 nChanged = nState ^ m_nButtonState;
+	if (!nChanged)
+		return;
+
 	TEvent Event;
+	Event.Type = TEventType::Button;
 
-	if (m_nButtonState != m_nLastButtonState)
+	for (u8 i = 0; i < 8; ++i)
 	{
-		Event.Type = TEventType::Button;
-
-		for (u8 i = 0; i < 8; ++i)
+		if (nChanged & (1 << i))
 		{
-			const bool bCurrentState = m_nButtonState & (1 << i);
-			const bool bLastState    = m_nLastButtonState & (1 << i);
-
-			if (bCurrentState != bLastState)
-			{
-				Event.Button.Button   = static_cast<TButton>(i);
-				Event.Button.bPressed = bCurrentState;
-				m_pEventQueue->Enqueue(Event);
-			}
+			Event.Button.Button   = static_cast<TButton>(i);
+			Event.Button.bPressed = nState & (1 << i);
+			m_pEventQueue->Enqueue(Event);
 		}
-
-		m_nLastButtonState = m_nButtonState;
 	}
+
+	m_nButtonState = nState;
 }
 
-void CControl::DebounceButtonState(u8 nState, u8 nMask)
+void CControl::GPIOInterruptHandler(void* pParam)
 {
-	// Use ring buffer for debouncing
-	m_ButtonStateHistory[m_nButtonStateHistoryIndex++] = nState;
-	m_nButtonStateHistoryIndex &= ButtonStateHistoryMask;
-
-	u8 nDebouncedButtonState = 0xFF;
-	for (size_t i = 0; i < ButtonStateHistoryLength; ++i)
-		nDebouncedButtonState &= m_ButtonStateHistory[i];
-
-	// Invert so that 1 == "pressed"; mask off button bits
-	m_nButtonState = (~nDebouncedButtonState) & nMask;
+	CControl* const pThis = static_cast<CControl*>(pParam);
+	pThis->OnGPIOEdge(CGPIOPin::ReadAll(), CTimer::GetClockTicks());
 }
 
-void CControl::InterruptHandler(CUserTimer* pUserTimer, void* pParam)
+void CControl::DebounceTimerHandler(CUserTimer* pUserTimer, void* pParam)
 {
 	CControl* const pThis = static_cast<CControl*>(pParam);
 
-	// Re-arm timer
-	pUserTimer->Start(PollRateMicros);
-	pThis->ReadGPIOPins();
+	// No edges for a while; the pins have settled
+	pThis->SetButtonState(pThis->GetPressedButtons(CGPIOPin::ReadAll()));
 }
@@ -23,6 +23,7 @@
 #include <circle/logger.h>
 
 #include "control/mister.h"
+#include "utility.h"
 
 const char MisterControlName[] = "mistercontrol";
 
@@ -34,11 +35,21 @@ CMisterControl::CMisterControl(CI2CMaster* pI2CMaster, TEventQueue& EventQueue)
 
 	  bMisterActive(false),
 	  m_LastSystemStatus{TMisterSynth::Unknown, 0xFF, 0xFF},
-	  m_LastMisterStatus{TMisterSynth::Unknown, 0xFF, 0xFF}
+	  m_LastMisterStatus{TMisterSynth::Unknown, 0xFF, 0xFF},
+	  m_nUpdatePeriodMillis(MinUpdatePeriodMillis)
 {
 }
 
 void CMisterControl::Update(const TMisterStatus& SystemStatus)
+{
+	// Changes tend to come in bursts (e.g. scrolling through OSD options), so start again from the fastest rate after one
+	if (Poll(SystemStatus))
+		m_nUpdatePeriodMillis = MinUpdatePeriodMillis;
+	else
+		m_nUpdatePeriodMillis = Utility::Min(m_nUpdatePeriodMillis * 2, MaxUpdatePeriodMillis);
+}
+
+bool CMisterControl::Poll(const TMisterStatus& SystemStatus)
 {
 	assert(m_pI2CMaster != nullptr);
 
@@ -47,7 +58,7 @@ void CMisterControl::Update(const TMisterStatus& SystemStatus)
 	if (m_pI2CMaster->Read(MisterI2CAddress, &MisterStatus, sizeof(MisterStatus)) < 0)
 	{
 		ResetState();
-		return;
+		return false;
 	}
 
 	//CLogger::Get()->Write(MisterControlName, LogDebug, "MiSTer Rx: 0x%02x 0x%02x 0x%02x", static_cast<u8>(MisterStatus.Synth), MisterStatus.MT32ROMSet, MisterStatus.SoundFontIndex);
@@ -58,7 +69,7 @@ void CMisterControl::Update(const TMisterStatus& SystemStatus)
 		CLogger::Get()->Write(MisterControlName, LogNotice, "Stopping synth activity");
 		EnqueueAllSoundOffEvent();
 		WriteConfigToMister(SystemStatus);
-		return;
+		return true;
 	}
 
 	if (bMisterActive)
@@ -70,10 +81,11 @@ void CMisterControl::Update(const TMisterStatus& SystemStatus)
 			if (!WriteConfigToMister(SystemStatus))
 			{
 				ResetState();
-				return;
+				return false;
 			}
 
 			m_LastSystemStatus = SystemStatus;
+			return true;
 		}
 		else if (MisterStatus != m_LastMisterStatus)
 		{
@@ -84,11 +96,14 @@ void CMisterControl::Update(const TMisterStatus& SystemStatus)
 			if (!WriteConfigToMister(MisterStatus))
 			{
 				ResetState();
-				return;
+				return false;
 			}
 
 			m_LastMisterStatus = MisterStatus;
+			return true;
 		}
+
+		return false;
 	}
 	else
 	{
@@ -97,13 +112,14 @@ void CMisterControl::Update(const TMisterStatus& SystemStatus)
 
 		// Write config back to MiSTer
 		if (!WriteConfigToMister(MisterStatus))
-			return;
+			return false;
 
 		// Show MiSTer logo
 		EnqueueDisplayImageEvent();
 
 		m_LastMisterStatus = MisterStatus;
 		bMisterActive = true;
+		return true;
 	}
 }
 
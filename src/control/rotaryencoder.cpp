@@ -20,8 +20,6 @@
 // mt32-pi. If not, see <http://www.gnu.org/licenses/>.
 //
 
-#include <circle/timer.h>
-
 #include "control/rotaryencoder.h"
 
 // Based on encoder reading algorithm by Peter Dannegger: https://embdev.net/articles/Rotary_Encoders
@@ -51,24 +49,21 @@ constexpr u8 AccelThresholdMillis = 32;
 // Compile-time quadratic acceleration curve lookup table
 constexpr auto RotaryAccelLookupTable = QuadraticLookupTable<u8, 5, 16, AccelThresholdMillis>();
 
-CRotaryEncoder::CRotaryEncoder(TEncoderType Type, unsigned GPIOPinCLK, unsigned GPIOPinDAT)
-	: m_CLKPin(GPIOPinCLK, GPIOModeInputPullUp),
-	  m_DATPin(GPIOPinDAT, GPIOModeInputPullUp),
-
-	  m_Type(Type),
+CRotaryEncoder::CRotaryEncoder(TEncoderType Type, bool bCLKValue, bool bDATValue)
+	: m_Type(Type),
 	  m_nDelta(0),
 	  m_nPreviousState(0),
 
 	  m_nLastReadTime(0)
 {
-	if (m_CLKPin.Read() == LOW)
+	if (bCLKValue == LOW)
 		m_nPreviousState = 3;
 
-	if (m_DATPin.Read() == LOW)
+	if (bDATValue == LOW)
 		m_nPreviousState ^= 1;
 }
 
-s8 CRotaryEncoder::Read()
+s8 CRotaryEncoder::Read(unsigned int nTimestamp)
 {
 	s8 nResult = 0;
 
@@ -95,23 +90,17 @@ s8 CRotaryEncoder::Read()
 	// Apply acceleration curve
 	if (nResult != 0)
 	{
-		const unsigned int nTicks = CTimer::Get()->GetClockTicks();
-		const unsigned int nDeltaMillis = (nTicks - m_nLastReadTime) / 1000;
+		const unsigned int nDeltaMillis = (nTimestamp - m_nLastReadTime) / 1000;
 
 		if (nDeltaMillis < AccelThresholdMillis)
 			nResult *= RotaryAccelLookupTable[nDeltaMillis];
 
-		m_nLastReadTime = nTicks;
+		m_nLastReadTime = nTimestamp;
 	}
 
 	return nResult;
 }
 
-void CRotaryEncoder::ReadGPIOPins()
-{
-	ReadGPIOPins(m_CLKPin.Read(), m_CLKPin.Read());
-}
-
 void CRotaryEncoder::ReadGPIOPins(bool bCLKValue, bool bDATValue)
 {
 	s8 nNewState = 0;
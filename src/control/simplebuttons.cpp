@@ -28,29 +28,30 @@ constexpr u8 GPIOPinButton2 = 27;
 constexpr u8 GPIOPinButton3 = 22;
 constexpr u8 GPIOPinButton4 = 23;
 
-constexpr u8 ButtonMask = 1 << static_cast<u8>(TButton::Button1) |
-						  1 << static_cast<u8>(TButton::Button2) |
-						  1 << static_cast<u8>(TButton::Button3) |
-						  1 << static_cast<u8>(TButton::Button4);
-
-CControlSimpleButtons::CControlSimpleButtons(TEventQueue& pEventQueue)
+CControlSimpleButtons::CControlSimpleButtons(TEventQueue& pEventQueue, CGPIOManager* pGPIOManager)
 	: CControl(pEventQueue),
 
-	  m_GPIOButton1(GPIOPinButton1, TGPIOMode::GPIOModeInputPullUp),
-	  m_GPIOButton2(GPIOPinButton2, TGPIOMode::GPIOModeInputPullUp),
-	  m_GPIOButton3(GPIOPinButton3, TGPIOMode::GPIOModeInputPullUp),
-	  m_GPIOButton4(GPIOPinButton4, TGPIOMode::GPIOModeInputPullUp)
+	  m_GPIOButton1(GPIOPinButton1, TGPIOMode::GPIOModeInputPullUp, pGPIOManager),
+	  m_GPIOButton2(GPIOPinButton2, TGPIOMode::GPIOModeInputPullUp, pGPIOManager),
+	  m_GPIOButton3(GPIOPinButton3, TGPIOMode::GPIOModeInputPullUp, pGPIOManager),
+	  m_GPIOButton4(GPIOPinButton4, TGPIOMode::GPIOModeInputPullUp, pGPIOManager)
 {
 }
 
-void CControlSimpleButtons::ReadGPIOPins()
+void CControlSimpleButtons::ConnectGPIOPins()
 {
-	// Read current button state from GPIO pins
-	const u32 nGPIOState  = CGPIOPin::ReadAll();
-	const u8 nButtonState = (((nGPIOState >> GPIOPinButton1) & 1) << static_cast<u8>(TButton::Button1)) |
-							(((nGPIOState >> GPIOPinButton2) & 1) << static_cast<u8>(TButton::Button2)) |
-							(((nGPIOState >> GPIOPinButton3) & 1) << static_cast<u8>(TButton::Button3)) |
-							(((nGPIOState >> GPIOPinButton4) & 1) << static_cast<u8>(TButton::Button4));
+	ConnectGPIOPin(m_GPIOButton1);
+	ConnectGPIOPin(m_GPIOButton2);
+	ConnectGPIOPin(m_GPIOButton3);
+	ConnectGPIOPin(m_GPIOButton4);
+}
 
-	DebounceButtonState(nButtonState, ButtonMask);
+u8 CControlSimpleButtons::GetPressedButtons(u32 nGPIOState) const
+{
+	// Invert so that 1 == "pressed"
+	const u32 nPressed = ~nGPIOState;
+	return (((nPressed >> GPIOPinButton1) & 1) << static_cast<u8>(TButton::Button1)) |
+		   (((nPressed >> GPIOPinButton2) & 1) << static_cast<u8>(TButton::Button2)) |
+		   (((nPressed >> GPIOPinButton3) & 1) << static_cast<u8>(TButton::Button3)) |
+		   (((nPressed >> GPIOPinButton4) & 1) << static_cast<u8>(TButton::Button4));
 }
@@ -30,26 +30,45 @@ constexpr u8 GPIOPinEncoderButton = 4;
 constexpr u8 GPIOPinEncoderCLK    = 22;
 constexpr u8 GPIOPinEncoderDAT    = 23;
 
-constexpr u8 ButtonMask = 1 << static_cast<u8>(TButton::Button1) |
-						  1 << static_cast<u8>(TButton::Button2) |
-						  1 << static_cast<u8>(TButton::EncoderButton);
-
-CControlSimpleEncoder::CControlSimpleEncoder(TEventQueue& pEventQueue, CRotaryEncoder::TEncoderType EncoderType)
+CControlSimpleEncoder::CControlSimpleEncoder(TEventQueue& pEventQueue, CGPIOManager* pGPIOManager, CRotaryEncoder::TEncoderType EncoderType)
 	: CControl(pEventQueue),
 
-	  m_GPIOEncoderButton(GPIOPinEncoderButton, TGPIOMode::GPIOModeInputPullUp),
-	  m_GPIOButton1(GPIOPinButton1, TGPIOMode::GPIOModeInputPullUp),
-	  m_GPIOButton2(GPIOPinButton2, TGPIOMode::GPIOModeInputPullUp),
+	  m_GPIOEncoderButton(GPIOPinEncoderButton, TGPIOMode::GPIOModeInputPullUp, pGPIOManager),
+	  m_GPIOButton1(GPIOPinButton1, TGPIOMode::GPIOModeInputPullUp, pGPIOManager),
+	  m_GPIOButton2(GPIOPinButton2, TGPIOMode::GPIOModeInputPullUp, pGPIOManager),
+	  m_GPIOEncoderCLK(GPIOPinEncoderCLK, TGPIOMode::GPIOModeInputPullUp, pGPIOManager),
+	  m_GPIOEncoderDAT(GPIOPinEncoderDAT, TGPIOMode::GPIOModeInputPullUp, pGPIOManager),
+
+	  m_Encoder(EncoderType, m_GPIOEncoderCLK.Read(), m_GPIOEncoderDAT.Read())
+{
+}
+
+void CControlSimpleEncoder::ConnectGPIOPins()
+{
+	ConnectGPIOPin(m_GPIOEncoderButton);
+	ConnectGPIOPin(m_GPIOButton1);
+	ConnectGPIOPin(m_GPIOButton2);
+	ConnectGPIOPin(m_GPIOEncoderCLK);
+	ConnectGPIOPin(m_GPIOEncoderDAT);
+}
 
-	  m_Encoder(EncoderType, GPIOPinEncoderCLK, GPIOPinEncoderDAT)
+u8 CControlSimpleEncoder::GetPressedButtons(u32 nGPIOState) const
 {
+	// Invert so that 1 == "pressed"
+	const u32 nPressed = ~nGPIOState;
+	return (((nPressed >> GPIOPinButton1) & 1) << static_cast<u8>(TButton::Button1)) |
+		   (((nPressed >> GPIOPinButton2) & 1) << static_cast<u8>(TButton::Button2)) |
+		   (((nPressed >> GPIOPinEncoderButton) & 1) << static_cast<u8>(TButton::EncoderButton));
 }
 
-void CControlSimpleEncoder::Update()
+void CControlSimpleEncoder::OnGPIOEdge(u32 nGPIOState, unsigned int nTimestamp)
 {
-	CControl::Update();
+	CControl::OnGPIOEdge(nGPIOState, nTimestamp);
 
-	const s8 nEncoderDelta = m_Encoder.Read();
+	// The encoder's Gray code decoding reverses any bounces by itself, so every edge is used
+	m_Encoder.ReadGPIOPins((nGPIOState >> GPIOPinEncoderCLK) & 1, (nGPIOState >> GPIOPinEncoderDAT) & 1);
+
+	const s8 nEncoderDelta = m_Encoder.Read(nTimestamp);
 	if (nEncoderDelta != 0)
 	{
 		TEvent Event;
@@ -58,17 +77,3 @@ void CControlSimpleEncoder::Update()
 		m_pEventQueue->Enqueue(Event);
 	}
 }
-
-void CControlSimpleEncoder::ReadGPIOPins()
-{
-	// Read current button state from GPIO pins
-	const u32 nGPIOState  = CGPIOPin::ReadAll();
-	const u8 nButtonState = (((nGPIOState >> GPIOPinButton1) & 1) << static_cast<u8>(TButton::Button1)) |
-							(((nGPIOState >> GPIOPinButton2) & 1) << static_cast<u8>(TButton::Button2)) |
-							(((nGPIOState >> GPIOPinEncoderButton) & 1) << static_cast<u8>(TButton::EncoderButton));
-
-	DebounceButtonState(nButtonState, ButtonMask);
-
-	// Update rotary encoder state
-	m_Encoder.ReadGPIOPins((nGPIOState >> GPIOPinEncoderCLK) & 1, (nGPIOState >> GPIOPinEncoderDAT) & 1);
-}
@@ -20,12 +20,24 @@
 // mt32-pi. If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <circle/bcm2835.h>
+#include <circle/memio.h>
+
 #include "kernel.h"
 
 #ifndef MT32_PI_VERSION
 #define MT32_PI_VERSION "<unknown>"
 #endif
 
+// PL011 control register and its hardware flow control enable bits
+#define ARM_UART0_CR	(ARM_UART0_BASE + 0x30)
+#define CR_CTSEN_MASK	(1 << 15)
+#define CR_RTSEN_MASK	(1 << 14)
+
+// UART0 CTS/RTS (alternate function 3)
+constexpr unsigned GPIOPinSerialCTS = 16;
+constexpr unsigned GPIOPinSerialRTS = 17;
+
 CKernel::CKernel(void)
 	: CStdlibApp("mt32-pi"),
 
@@ -49,6 +61,7 @@ CKernel::CKernel(void)
 
 bool CKernel::Initialize(void)
 {
+	m_BootProfiler.BeginStage("Circle");
 	if (!CStdlibApp::Initialize())
 		return false;
 
@@ -75,9 +88,11 @@ bool CKernel::Initialize(void)
 	if (!m_Timer.Initialize())
 		return false;
 
+	m_BootProfiler.BeginStage("EMMC");
 	if (!m_EMMC.Initialize())
 		return false;
 
+	m_BootProfiler.BeginStage("SD card mount");
 	if (f_mount(&m_SDFileSystem, "SD:", 1) != FR_OK)
 	{
 		m_Logger.Write(GetKernelName(), LogError, "Failed to mount SD card");
@@ -88,13 +103,18 @@ bool CKernel::Initialize(void)
 	CGlueStdioInit(m_SDFileSystem);
 
 	// Load configuration file
-	if (!m_Config.Initialize("mt32-pi.cfg"))
+	m_BootProfiler.BeginStage("Config");
+	if (!m_Config.Initialize(CConfig::FileName))
 		m_Logger.Write(GetKernelName(), LogWarning, "Unable to find or parse config file; using defaults");
 
 	// Init serial port for MIDI with preferred baud rate if not used for logging
+	m_BootProfiler.BeginStage("Peripherals");
 	if (bSerialMIDIEnabled && !m_Serial.Initialize(m_Config.MIDIGPIOBaudRate))
 		return false;
 
+	if (bSerialMIDIEnabled && m_Config.MIDIGPIOFlowControl)
+		EnableSerialFlowControl();
+
 	// Init I2C; don't bother with Initialize() as it only sets the clock to 100/400KHz
 	m_I2CMaster.SetClock(m_Config.SystemI2CBaudRate);
 
@@ -107,6 +127,7 @@ bool CKernel::Initialize(void)
 		return false;
 
 	// Init custom memory allocator
+	m_BootProfiler.BeginStage("Allocator");
 	if (!m_Allocator.Initialize())
 		return false;
 
@@ -116,6 +137,25 @@ bool CKernel::Initialize(void)
 	return true;
 }
 
+void CKernel::EnableSerialFlowControl()
+{
+	// The simple button and encoder control schemes have a button on the RTS pin
+	if (m_Config.ControlScheme != CConfig::TControlScheme::None)
+	{
+		m_Logger.Write(GetKernelName(), LogWarning, "GPIO %d is in use by controls; flow control disabled", GPIOPinSerialRTS);
+		return;
+	}
+
+	m_SerialCTSPin.AssignPin(GPIOPinSerialCTS);
+	m_SerialCTSPin.SetMode(GPIOModeAlternateFunction3, false);
+	m_SerialRTSPin.AssignPin(GPIOPinSerialRTS);
+	m_SerialRTSPin.SetMode(GPIOModeAlternateFunction3, false);
+
+	// The UART now holds off transmitting while CTS is deasserted, and deasserts RTS while its receive FIFO is full
+	write32(ARM_UART0_CR, read32(ARM_UART0_CR) | CR_CTSEN_MASK | CR_RTSEN_MASK);
+	m_Logger.Write(GetKernelName(), LogNotice, "Serial RTS/CTS flow control enabled");
+}
+
 CStdlibApp::TShutdownMode CKernel::Run(void)
 {
 	m_Logger.Write(GetKernelName(), LogNotice, "mt32-pi " MT32_PI_VERSION);
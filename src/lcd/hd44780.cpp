@@ -31,7 +31,12 @@ CHD44780Base::CHD44780Base(u8 nColumns, u8 nRows)
 	  m_nRows(nRows),
 	  m_nColumns(nColumns),
 	  m_RowOffsets{ 0, 0x40, m_nColumns, u8(0x40 + m_nColumns) },
-	  m_BarCharSet(TBarCharSet::None)
+	  m_BarCharSet(TBarCharSet::None),
+
+	  m_DDRAM{{0}},
+	  m_CGRAM{{0}},
+	  m_nCGRAMValidMask(0),
+	  m_nCursorAddress(InvalidAddress)
 {
 }
 
@@ -59,13 +64,52 @@ void CHD44780Base::WriteData(const u8* pBytes, size_t nSize)
 		WriteData(pBytes[i]);
 }
 
+void CHD44780Base::WriteCells(u8 nRow, u8 nColumn, const char* pChars, size_t nCount)
+{
+	assert(nRow < m_nRows);
+
+	for (size_t i = 0; i < nCount && nColumn < m_nColumns; ++i, ++nColumn)
+	{
+		const u8 nChar = pChars[i];
+		if (m_DDRAM[nRow][nColumn] == nChar)
+			continue;
+
+		// The address counter advances after each write, so only move the cursor when skipping over unchanged cells
+		const u8 nAddress = m_RowOffsets[nRow] + nColumn;
+		if (m_nCursorAddress != nAddress)
+			WriteCommand(0x80 | nAddress);
+
+		WriteData(nChar);
+		m_DDRAM[nRow][nColumn] = nChar;
+		m_nCursorAddress       = nAddress + 1;
+	}
+}
+
+void CHD44780Base::ResetShadow()
+{
+	// A cleared display is filled with spaces, and the cursor is at home
+	memset(m_DDRAM, ' ', sizeof(m_DDRAM));
+	m_nCursorAddress = 0;
+}
+
 void CHD44780Base::SetCustomChar(u8 nIndex, const u8 nCharData[8])
 {
 	assert(nIndex < 8);
+
+	// Already loaded
+	if ((m_nCGRAMValidMask & (1 << nIndex)) && memcmp(m_CGRAM[nIndex], nCharData, sizeof(m_CGRAM[nIndex])) == 0)
+		return;
+
 	WriteCommand(0x40 | (nIndex << 3));
 
 	for (u8 i = 0; i < 8; ++i)
 		WriteData(nCharData[i]);
+
+	memcpy(m_CGRAM[nIndex], nCharData, sizeof(m_CGRAM[nIndex]));
+	m_nCGRAMValidMask |= 1 << nIndex;
+
+	// The address counter now points into CGRAM
+	m_nCursorAddress = InvalidAddress;
 }
 
 void CHD44780Base::SetBarChars(TBarCharSet CharSet)
@@ -119,6 +163,7 @@ bool CHD44780Base::Initialize()
 	// Home cursor
 	WriteCommand(0b0010);
 	CTimer::SimpleMsDelay(2);
+	ResetShadow();
 
 	// Function set (4-bit, 2-line)
 	WriteCommand(0b101000);
@@ -137,17 +182,25 @@ bool CHD44780Base::Initialize()
 
 void CHD44780Base::Print(const char* pText, u8 nCursorX, u8 nCursorY, bool bClearLine, bool bImmediate)
 {
-	WriteCommand(0x80 | m_RowOffsets[nCursorY] + nCursorX);
+	if (nCursorX >= m_nColumns)
+		return;
 
-	const char* p = pText;
-	while (*p && (p - pText) < m_nColumns)
-		WriteData(*p++);
+	char LineBuf[m_nColumns];
+	size_t nLength = 0;
+
+	while (pText[nLength] && nCursorX + nLength < m_nColumns)
+	{
+		LineBuf[nLength] = pText[nLength];
+		++nLength;
+	}
 
 	if (bClearLine)
 	{
-		while ((p++ - pText) < (m_nColumns - nCursorX))
-			WriteData(' ');
+		while (nCursorX + nLength < m_nColumns)
+			LineBuf[nLength++] = ' ';
 	}
+
+	WriteCells(nCursorY, nCursorX, LineBuf, nLength);
 }
 
 void CHD44780Base::Clear(bool bImmediate)
@@ -157,6 +210,7 @@ void CHD44780Base::Clear(bool bImmediate)
 
 	WriteCommand(0b0001);
 	CTimer::SimpleMsDelay(50);
+	ResetShadow();
 }
 
 void CHD44780Base::DrawChannelLevels(u8 nFirstRow, u8 nRows, u8 nBarXOffset, u8 nBarSpacing, u8 nChannels, bool bDrawBarBases)
@@ -191,11 +245,13 @@ void CHD44780Base::DrawChannelLevels(u8 nFirstRow, u8 nRows, u8 nBarXOffset, u8
 	}
 
 	for (u8 nRow = 0; nRow < nRows; ++nRow)
-	{
-		WriteCommand(0x80 | m_RowOffsets[nFirstRow + nRow]);
-		for (u8 nColumn = 0; nColumn < m_nColumns; ++nColumn)
-			WriteData(LineBuf[nRow][nColumn]);
-	}
+		WriteCells(nFirstRow + nRow, 0, LineBuf[nRow], m_nColumns);
+}
+
+void CHD44780Base::DrawDSPLoad()
+{
+	for (u8 nRow = 0; nRow < m_nRows; ++nRow)
+		Print(nRow < DSPLoadTextLines ? m_DSPLoadTextBuffer[nRow] : "", 0, nRow, true);
 }
 
 void CHD44780Base::Update(CMT32Synth& Synth)
@@ -206,6 +262,12 @@ void CHD44780Base::Update(CMT32Synth& Synth)
 	if (!m_bBacklightEnabled)
 		return;
 
+	if (IsShowingDSPLoad())
+	{
+		DrawDSPLoad();
+		return;
+	}
+
 	SetBarChars(TBarCharSet::Wide);
 	UpdateChannelLevels(Synth);
 
@@ -246,6 +308,12 @@ void CHD44780Base::Update(CSoundFontSynth& Synth)
 	if (!m_bBacklightEnabled)
 		return;
 
+	if (IsShowingDSPLoad())
+	{
+		DrawDSPLoad();
+		return;
+	}
+
 	SetBarChars(TBarCharSet::Narrow);
 	UpdateChannelLevels(Synth);
 
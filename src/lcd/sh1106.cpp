@@ -26,7 +26,6 @@ enum TSH1106Command : u8
 {
 	SetColumnAddressLow  = 0x00,
 	SetColumnAddressHigh = 0x10,
-	SetStartLine         = 0x40,
 	SetPageAddress       = 0xB0,
 };
 
@@ -35,34 +34,41 @@ CSH1106::CSH1106(CI2CMaster *pI2CMaster, u8 nAddress, u8 nWidth, u8 nHeight, TLC
 {
 }
 
-void CSH1106::WriteFrameBuffer(bool bForceFullUpdate) const
+bool CSH1106::WriteNextWindow(bool bFullUpdate, u8& nPage) const
 {
-	// Reset start line
-	WriteCommand(SetStartLine | 0x00);
-
 	const size_t nPages = m_nHeight / 8;
 	constexpr size_t nPageSize = 128;
 
-	// Copy framebuffer one page at a time
-	for (u8 nPage = 0; nPage < nPages; ++nPage)
+	// Copy the changed columns of the framebuffer one page at a time
+	while (nPage < nPages)
 	{
-		const size_t nOffset = nPage * nPageSize;
-		const bool bNeedsUpdate = bForceFullUpdate || memcmp(&m_FrameBuffers[0].FrameBuffer[nOffset], &m_FrameBuffers[1].FrameBuffer[nOffset], nPageSize) != 0;
-
-		if (bNeedsUpdate)
+		u8 nFirstColumn, nLastColumn;
+		if (!GetDirtyColumns(nPage, bFullUpdate, nFirstColumn, nLastColumn))
 		{
-			WriteCommand(SetPageAddress | nPage);
-
-			// SH1106 displays have a 132x64 pixel memory, but most modules have a visible width of 128 centred on this buffer
-			WriteCommand(SetColumnAddressLow | 0x02);
-			WriteCommand(SetColumnAddressHigh | 0x00);
+			++nPage;
+			continue;
+		}
 
-			// Prefix this page's pixel data with a data control byte
-			u8 Buffer[nPageSize + 1] = { 0x40 };
-			memcpy(Buffer + 1, &m_FrameBuffers[m_nCurrentFrameBuffer].FrameBuffer[nOffset], nPageSize);
+		// SH1106 displays have a 132x64 pixel memory, but most modules have a visible width of 128 centred on this buffer
+		const u8 nColumnAddress = nFirstColumn + 0x02;
+		const u8 Commands[] =
+		{
+			0x00,
+			static_cast<u8>(SetPageAddress | nPage),
+			static_cast<u8>(SetColumnAddressLow | (nColumnAddress & 0x0F)),
+			static_cast<u8>(SetColumnAddressHigh | (nColumnAddress >> 4)),
+		};
+		m_pI2CMaster->Write(m_nAddress, Commands, sizeof(Commands));
 
-			m_pI2CMaster->Write(m_nAddress, Buffer, sizeof(Buffer));
+		// Prefix this page's pixel data with a data control byte
+		const size_t nColumns = nLastColumn - nFirstColumn + 1;
+		u8 Buffer[nPageSize + 1] = { 0x40 };
+		memcpy(Buffer + 1, &m_FrameBuffers[m_nCurrentFrameBuffer].FrameBuffer[nPage * nPageSize + nFirstColumn], nColumns);
 
-		}
+		m_pI2CMaster->Write(m_nAddress, Buffer, nColumns + 1);
+		++nPage;
+		return true;
 	}
+
+	return false;
 }
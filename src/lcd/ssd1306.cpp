@@ -103,6 +103,52 @@ namespace
 		ColumnData mCharData[N];
 	};
 
+	// Templated array-like structure with each glyph precomputed as it's laid out in the framebuffer: double-height,
+	// shifted down by 2 pixels and split into upper and lower pages, at W columns wide (6 or 12) and optionally inverted
+	template<size_t N, size_t W>
+	class GlyphTable
+	{
+	public:
+		struct TGlyph
+		{
+			u8 UpperPage[W];
+			u8 LowerPage[W];
+		};
+
+		constexpr GlyphTable(const CharData(&CharData)[N], bool bInverted) : m_Glyphs{}
+		{
+			for (size_t i = 0; i < N; ++i)
+			{
+				for (size_t j = 0; j < W; ++j)
+				{
+					const u8 nColumn = j * 6 / W;
+					u16 nFontColumn = DoubleColumn(CharData[i], nColumn);
+
+					// Don't invert the leftmost column or last two rows
+					if (nColumn > 0 && bInverted)
+						nFontColumn ^= 0x3FFF;
+
+					nFontColumn <<= 2;
+					m_Glyphs[i].UpperPage[j] = nFontColumn & 0xFF;
+					m_Glyphs[i].LowerPage[j] = nFontColumn >> 8;
+				}
+			}
+		}
+
+		const TGlyph& operator[](size_t nIndex) const { return m_Glyphs[nIndex]; }
+
+	private:
+		TGlyph m_Glyphs[N];
+	};
+
+	// Copy a whole glyph into the framebuffer, one page at a time
+	template<class T>
+	inline void BlitGlyph(const T& Glyph, u8* pFrameBuffer, size_t nPageSize)
+	{
+		memcpy(pFrameBuffer, Glyph.UpperPage, sizeof(Glyph.UpperPage));
+		memcpy(pFrameBuffer + nPageSize, Glyph.LowerPage, sizeof(Glyph.LowerPage));
+	}
+
 	// Templated array-like structure with precomputed pixel data
 	template<size_t W, size_t H>
 	class CSSD1306Image
@@ -139,9 +185,14 @@ namespace
 	};
 }
 
-// Single and double-height versions of the font
+// Single-height version of the font
 constexpr auto FontSingle = Font<Utility::ArraySize(Font6x8), decltype(SingleColumn)>(Font6x8, SingleColumn);
-constexpr auto FontDouble = Font<Utility::ArraySize(Font6x8), decltype(DoubleColumn)>(Font6x8, DoubleColumn);
+
+// Glyphs for text, in normal and double width
+constexpr auto Glyphs             = GlyphTable<Utility::ArraySize(Font6x8), 6>(Font6x8, false);
+constexpr auto GlyphsInverted     = GlyphTable<Utility::ArraySize(Font6x8), 6>(Font6x8, true);
+constexpr auto GlyphsWide         = GlyphTable<Utility::ArraySize(Font6x8), 12>(Font6x8, false);
+constexpr auto GlyphsWideInverted = GlyphTable<Utility::ArraySize(Font6x8), 12>(Font6x8, true);
 
 constexpr auto MisterLogo = CSSD1306Image<128, 32>(MisterLogo128x32);
 
@@ -157,7 +208,13 @@ CSSD1306::CSSD1306(CI2CMaster *pI2CMaster, u8 nAddress, u8 nWidth, u8 nHeight, T
 	  m_Rotation(Rotation),
 
 	  m_FrameBuffers{{0x40, {0}}, {0x40, {0}}},
-	  m_nCurrentFrameBuffer(0)
+	  m_nCurrentFrameBuffer(0),
+
+	  m_bFullUpdateRequired(true),
+
+	  m_bFramePending(false),
+	  m_bFrameFullUpdate(false),
+	  m_nFramePage(0)
 {
 }
 
@@ -210,18 +267,147 @@ void CSSD1306::WriteCommand(u8 nCommand) const
 	m_pI2CMaster->Write(m_nAddress, Buffer, sizeof(Buffer));
 }
 
-void CSSD1306::WriteFrameBuffer(bool bForceFullUpdate) const
+void CSSD1306::WriteFrameBuffer(bool bForceFullUpdate)
+{
+	// Everything is sent now, so a frame still in flight is superseded
+	m_bFramePending = false;
+
+	const bool bFullUpdate = StartFrame(bForceFullUpdate);
+	u8 nPage = 0;
+
+	while (WriteNextWindow(bFullUpdate, nPage))
+		;
+}
+
+bool CSSD1306::StartFrame(bool bForceFullUpdate)
 {
 	// Reset start line
 	WriteCommand(SetStartLine | 0x00);
 
-	// Compare two framebuffers
-	const size_t nFrameBufferSize = m_nWidth * m_nHeight / 8;
-	const bool bNeedsUpdate = bForceFullUpdate || memcmp(m_FrameBuffers[0].FrameBuffer, m_FrameBuffers[1].FrameBuffer, nFrameBufferSize) != 0;
+	// Immediate updates show the current framebuffer before it's swapped, so the next comparison would be against the wrong frame
+	const bool bFullUpdate = bForceFullUpdate || m_bFullUpdateRequired;
+	m_bFullUpdateRequired  = bForceFullUpdate;
+
+	return bFullUpdate;
+}
+
+void CSSD1306::QueueFrame()
+{
+	m_bFrameFullUpdate = StartFrame(false);
+	m_nFramePage       = 0;
+	m_bFramePending    = true;
+}
+
+bool CSSD1306::Flush()
+{
+	if (!m_bFramePending)
+		return true;
+
+	// Sent one window; more may follow
+	if (WriteNextWindow(m_bFrameFullUpdate, m_nFramePage))
+		return false;
+
+	// The display now shows this frame; draw the next one into the other framebuffer
+	m_bFramePending = false;
+	SwapFrameBuffers();
+	return true;
+}
+
+bool CSSD1306::WriteNextWindow(bool bFullUpdate, u8& nPage) const
+{
+	const u8 nPages = m_nHeight / 8;
+
+	// Send the next run of changed pages as one window, spanning the changed columns
+	while (nPage < nPages)
+	{
+		u8 nFirstColumn, nLastColumn;
+		if (!GetDirtyColumns(nPage, bFullUpdate, nFirstColumn, nLastColumn))
+		{
+			++nPage;
+			continue;
+		}
+
+		u8 nLastPage = nPage;
+		u8 nPageFirstColumn, nPageLastColumn;
+		while (nLastPage + 1 < nPages && GetDirtyColumns(nLastPage + 1, bFullUpdate, nPageFirstColumn, nPageLastColumn))
+		{
+			nFirstColumn = Utility::Min(nFirstColumn, nPageFirstColumn);
+			nLastColumn  = Utility::Max(nLastColumn, nPageLastColumn);
+			++nLastPage;
+		}
+
+		WriteWindow(nPage, nLastPage, nFirstColumn, nLastColumn);
+		nPage = nLastPage + 1;
+		return true;
+	}
+
+	return false;
+}
+
+void CSSD1306::WriteWindow(u8 nFirstPage, u8 nLastPage, u8 nFirstColumn, u8 nLastColumn) const
+{
+	// Command stream; the display's address pointer wraps within this window in horizontal addressing mode
+	const u8 Commands[] =
+	{
+		0x00,
+		SetColumnAddress,	nFirstColumn,	nLastColumn,
+		SetPageAddress,		nFirstPage,		nLastPage,
+	};
+	m_pI2CMaster->Write(m_nAddress, Commands, sizeof(Commands));
+
+	const TFrameBufferUpdatePacket& Packet = m_FrameBuffers[m_nCurrentFrameBuffer];
+	const u8 nColumns = nLastColumn - nFirstColumn + 1;
+	const u8 nPages   = nLastPage - nFirstPage + 1;
+
+	// Whole framebuffer; send it as-is
+	if (nColumns == m_nWidth && nPages == m_nHeight / 8)
+	{
+		m_pI2CMaster->Write(m_nAddress, &Packet, sizeof(TFrameBufferUpdatePacket::DataControlByte) + m_nWidth * m_nHeight / 8);
+		return;
+	}
+
+	// Gather the window's pixel data behind a data control byte
+	u8 Buffer[sizeof(TFrameBufferUpdatePacket)] = { 0x40 };
+	size_t nSize = 1;
+
+	for (u8 nPage = nFirstPage; nPage <= nLastPage; ++nPage)
+	{
+		memcpy(Buffer + nSize, &Packet.FrameBuffer[nPage * m_nWidth + nFirstColumn], nColumns);
+		nSize += nColumns;
+	}
+
+	m_pI2CMaster->Write(m_nAddress, Buffer, nSize);
+}
+
+bool CSSD1306::GetDirtyColumns(u8 nPage, bool bFullUpdate, u8& nFirstColumn, u8& nLastColumn) const
+{
+	if (bFullUpdate)
+	{
+		nFirstColumn = 0;
+		nLastColumn  = m_nWidth - 1;
+		return true;
+	}
+
+	// Compare this page against the frame that's currently on the display
+	const size_t nOffset = nPage * m_nWidth;
+	const u8* pCurrent   = &m_FrameBuffers[m_nCurrentFrameBuffer].FrameBuffer[nOffset];
+	const u8* pPrevious  = &m_FrameBuffers[m_nCurrentFrameBuffer ^ 1].FrameBuffer[nOffset];
+
+	u8 nFirst = 0;
+	while (nFirst < m_nWidth && pCurrent[nFirst] == pPrevious[nFirst])
+		++nFirst;
+
+	// Unchanged
+	if (nFirst == m_nWidth)
+		return false;
+
+	u8 nLast = m_nWidth - 1;
+	while (pCurrent[nLast] == pPrevious[nLast])
+		--nLast;
 
-	// Copy entire framebuffer
-	if (bNeedsUpdate)
-		m_pI2CMaster->Write(m_nAddress, &m_FrameBuffers[m_nCurrentFrameBuffer], sizeof(TFrameBufferUpdatePacket::DataControlByte) + nFrameBufferSize);
+	nFirstColumn = nFirst;
+	nLastColumn  = nLast;
+	return true;
 }
 
 void CSSD1306::SwapFrameBuffers()
@@ -312,28 +498,13 @@ void CSSD1306::DrawChar(char chChar, u8 nCursorX, u8 nCursorY, bool bInverted, b
 	if (chChar == '\xFF')
 		chChar = '\x80';
 
-	for (u8 i = 0; i < 6; ++i)
-	{
-		u16 nFontColumn = FontDouble[static_cast<u8>(chChar - ' ')][i];
-
-		// Don't invert the leftmost column or last two rows
-		if (i > 0 && bInverted)
-			nFontColumn ^= 0x3FFF;
-
-		// Shift down by 2 pixels
-		nFontColumn <<= 2;
-
-		// Upper half of font
-		const size_t nOffset = nRowOffset + nColumnOffset + (bDoubleWidth ? i * 2 : i);
+	const size_t nGlyph = static_cast<u8>(chChar - ' ');
+	u8* pGlyphStart     = pFrameBuffer + nRowOffset + nColumnOffset;
 
-		pFrameBuffer[nOffset] = nFontColumn & 0xFF;
-		pFrameBuffer[nOffset + m_nWidth] = (nFontColumn >> 8) & 0xFF;
-		if (bDoubleWidth)
-		{
-			pFrameBuffer[nOffset + 1] = pFrameBuffer[nOffset];
-			pFrameBuffer[nOffset + m_nWidth + 1] = pFrameBuffer[nOffset + m_nWidth];
-		}
-	}
+	if (bDoubleWidth)
+		BlitGlyph((bInverted ? GlyphsWideInverted : GlyphsWide)[nGlyph], pGlyphStart, m_nWidth);
+	else
+		BlitGlyph((bInverted ? GlyphsInverted : Glyphs)[nGlyph], pGlyphStart, m_nWidth);
 }
 
 void CSSD1306::DrawImage()
@@ -387,6 +558,13 @@ void CSSD1306::DrawSystemState()
 	}
 }
 
+void CSSD1306::DrawDSPLoad()
+{
+	const u8 nRows = Utility::Min(static_cast<size_t>(m_nHeight / 16), DSPLoadTextLines);
+	for (u8 nRow = 0; nRow < nRows; ++nRow)
+		Print(m_DSPLoadTextBuffer[nRow], 0, nRow, true);
+}
+
 void CSSD1306::DrawChannelLevels(u8 nBarXOffset, u8 nBarYOffset, u8 nBarWidth, u8 nBarHeight, u8 nBarSpacing, u8 nChannels, bool bDrawPeaks, bool bDrawBarBases)
 {
 	const u8 nBarMaxY = nBarHeight - 1;
@@ -457,10 +635,15 @@ void CSSD1306::Print(const char* pText, u8 nCursorX, u8 nCursorY, bool bClearLin
 		++nCursorX;
 	}
 
-	if (bClearLine)
+	// Blank glyphs are all zeroes, so clear the rest of the line in one go
+	if (bClearLine && nCursorX < 20)
 	{
-		while (nCursorX < 20)
-			DrawChar(' ', nCursorX++, nCursorY);
+		u8* pLineStart      = m_FrameBuffers[m_nCurrentFrameBuffer].FrameBuffer + nCursorY * m_nWidth * 2;
+		const size_t nStart = nCursorX * 6 + 4;
+		const size_t nEnd   = 20 * 6 + 4;
+
+		memset(pLineStart + nStart, 0, nEnd - nStart);
+		memset(pLineStart + m_nWidth + nStart, 0, nEnd - nStart);
 	}
 
 	if (bImmediate)
@@ -492,11 +675,17 @@ void CSSD1306::Update(CMT32Synth& Synth)
 	if (!m_bBacklightEnabled)
 		return;
 
+	// The previous frame must be on the display before drawing over it
+	while (!Flush())
+		;
+
 	Clear(false);
 	UpdateChannelLevels(Synth);
 	UpdateChannelPeakLevels();
 
-	if (m_SystemState != TSystemState::None)
+	if (IsShowingDSPLoad())
+		DrawDSPLoad();
+	else if (m_SystemState != TSystemState::None)
 		DrawSystemState();
 	else
 	{
@@ -506,14 +695,14 @@ void CSSD1306::Update(CMT32Synth& Synth)
 	}
 
 	// MT-32 status row
-	if (m_SystemState != TSystemState::EnteringPowerSavingMode && m_SystemState != TSystemState::DisplayingImage)
+	if (!IsShowingDSPLoad() && m_SystemState != TSystemState::EnteringPowerSavingMode && m_SystemState != TSystemState::DisplayingImage)
 	{
 		const u8 nStatusRow = m_nHeight == 32 ? 1 : 3;
 		Print(m_MT32TextBuffer, 0, nStatusRow, true);
 	}
 
-	WriteFrameBuffer();
-	SwapFrameBuffers();
+	// Sent piecewise by Flush(); the framebuffers are swapped once it's done
+	QueueFrame();
 }
 
 void CSSD1306::Update(CSoundFontSynth& Synth)
@@ -524,11 +713,17 @@ void CSSD1306::Update(CSoundFontSynth& Synth)
 	if (!m_bBacklightEnabled)
 		return;
 
+	// The previous frame must be on the display before drawing over it
+	while (!Flush())
+		;
+
 	Clear(false);
 	UpdateChannelLevels(Synth);
 	UpdateChannelPeakLevels();
 
-	if (m_SystemState != TSystemState::None)
+	if (IsShowingDSPLoad())
+		DrawDSPLoad();
+	else if (m_SystemState != TSystemState::None)
 		DrawSystemState();
 	else
 	{
@@ -541,6 +736,5 @@ void CSSD1306::Update(CSoundFontSynth& Synth)
 		}
 	}
 
-	WriteFrameBuffer();
-	SwapFrameBuffers();
+	QueueFrame();
 }
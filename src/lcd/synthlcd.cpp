@@ -30,7 +30,9 @@
 constexpr u8 SpinnerChars[] = {'_', '_', '_', '-', '\'', '\'', '^', '^', '`', '`', '-', '_', '_', '_'};
 
 CSynthLCD::CSynthLCD()
-	: m_SystemState(TSystemState::None),
+	: m_bStateChanged(true),
+
+	  m_SystemState(TSystemState::None),
 	  m_nSystemStateTime(0),
 	  m_nCurrentSpinnerChar(0),
 	  m_CurrentImage(TImage::None),
@@ -51,7 +53,10 @@ CSynthLCD::CSynthLCD()
 	  m_ChannelVelocities{0},
 	  m_ChannelLevels{0},
 	  m_ChannelPeakLevels{0},
-	  m_ChannelPeakTimes{0}
+	  m_ChannelPeakTimes{0},
+
+	  m_pRenderProfiler(nullptr),
+	  m_DSPLoadTextBuffer{{'\0'}}
 {
 }
 
@@ -73,12 +78,14 @@ void CSynthLCD::OnSystemMessage(const char* pMessage, bool bSpinner)
 	}
 
 	m_nSystemStateTime = nTicks;
+	m_bStateChanged = true;
 }
 
 void CSynthLCD::ClearSpinnerMessage()
 {
 	m_SystemState = TSystemState::None;
 	m_nCurrentSpinnerChar = 0;
+	m_bStateChanged = true;
 }
 
 void CSynthLCD::OnDisplayImage(TImage Image)
@@ -87,6 +94,7 @@ void CSynthLCD::OnDisplayImage(TImage Image)
 	m_CurrentImage = Image;
 	m_SystemState = TSystemState::DisplayingImage;
 	m_nSystemStateTime = nTicks;
+	m_bStateChanged = true;
 }
 
 void CSynthLCD::EnterPowerSavingMode()
@@ -94,12 +102,14 @@ void CSynthLCD::EnterPowerSavingMode()
 	snprintf(m_SystemMessageTextBuffer, sizeof(m_SystemMessageTextBuffer), "Power saving mode");
 	m_SystemState = TSystemState::EnteringPowerSavingMode;
 	m_nSystemStateTime = CTimer::Get()->GetTicks();
+	m_bStateChanged = true;
 }
 
 void CSynthLCD::ExitPowerSavingMode()
 {
 	SetBacklightEnabled(true);
 	m_SystemState = TSystemState::None;
+	m_bStateChanged = true;
 }
 
 void CSynthLCD::OnMT32Message(const char* pMessage)
@@ -110,6 +120,7 @@ void CSynthLCD::OnMT32Message(const char* pMessage)
 
 	m_MT32State = TMT32State::DisplayingMessage;
 	m_nMT32StateTime = nTicks;
+	m_bStateChanged = true;
 }
 
 void CSynthLCD::OnProgramChanged(u8 nPartNum, const char* pSoundGroupName, const char* pPatchName)
@@ -124,6 +135,7 @@ void CSynthLCD::OnProgramChanged(u8 nPartNum, const char* pSoundGroupName, const
 
 	m_MT32State = TMT32State::DisplayingTimbreName;
 	m_nMT32StateTime = ticks;
+	m_bStateChanged = true;
 }
 
 void CSynthLCD::OnSC55DisplayText(const char* pMessage)
@@ -134,6 +146,7 @@ void CSynthLCD::OnSC55DisplayText(const char* pMessage)
 
 	m_bSC55DisplayingText = true;
 	m_nSC55DisplayTextTime = ticks;
+	m_bStateChanged = true;
 }
 
 void CSynthLCD::OnSC55DisplayDots(const u8* pData)
@@ -144,11 +157,47 @@ void CSynthLCD::OnSC55DisplayDots(const u8* pData)
 
 	m_bSC55DisplayingDots = true;
 	m_nSC55DisplayDotsTime = ticks;
+	m_bStateChanged = true;
+}
+
+bool CSynthLCD::IsUpdateNeeded(CMT32Synth& Synth)
+{
+	// Master volume is shown in the part status row
+	return IsUpdateNeeded(static_cast<CSynthBase&>(Synth)) || Synth.GetMasterVolume() != m_nPreviousMasterVolume;
+}
+
+bool CSynthLCD::IsUpdateNeeded(CSoundFontSynth& Synth)
+{
+	return IsUpdateNeeded(static_cast<CSynthBase&>(Synth));
+}
+
+bool CSynthLCD::IsUpdateNeeded(CSynthBase& Synth)
+{
+	if (m_bStateChanged)
+		return true;
+
+	// Messages waiting to time out, spinners and other animations
+	if ((m_SystemState != TSystemState::None && m_SystemState != TSystemState::InPowerSavingMode) || m_MT32State != TMT32State::DisplayingPartStates ||
+		m_bSC55DisplayingText || m_bSC55DisplayingDots || m_pRenderProfiler)
+		return true;
+
+	// Level meters still falling
+	for (size_t i = 0; i < MIDIChannelCount; ++i)
+	{
+		if (m_ChannelLevels[i] > 0.0f || m_ChannelPeakLevels[i] > 0.0f)
+			return true;
+	}
+
+	// New notes
+	u8 ChannelVelocities[MIDIChannelCount];
+	const u8 nChannelCount = Synth.GetChannelVelocities(ChannelVelocities, Utility::ArraySize(ChannelVelocities));
+	return memcmp(ChannelVelocities, m_ChannelVelocities, nChannelCount) != 0;
 }
 
 void CSynthLCD::Update(CMT32Synth& Synth)
 {
 	const unsigned nTicks = CTimer::Get()->GetTicks();
+	m_bStateChanged = false;
 	UpdateSystem(nTicks);
 
 	const u8 nMasterVolume = Synth.GetMasterVolume();
@@ -173,11 +222,15 @@ void CSynthLCD::Update(CMT32Synth& Synth)
 
 	if (m_MT32State == TMT32State::DisplayingPartStates)
 		UpdatePartStateText(Synth);
+
+	if (m_pRenderProfiler)
+		UpdateDSPLoadText(Synth);
 }
 
 void CSynthLCD::Update(CSoundFontSynth& Synth)
 {
 	const unsigned nTicks = CTimer::Get()->GetTicks();
+	m_bStateChanged = false;
 	UpdateSystem(nTicks);
 
 	// Displaying text timeout
@@ -187,6 +240,9 @@ void CSynthLCD::Update(CSoundFontSynth& Synth)
 	// Displaying text timeout
 	if (m_bSC55DisplayingDots && (nTicks - m_nSC55DisplayDotsTime) > MSEC2HZ(SC55DisplayTimeMillis))
 		m_bSC55DisplayingDots = false;
+
+	if (m_pRenderProfiler)
+		UpdateDSPLoadText(Synth);
 }
 
 void CSynthLCD::UpdateSystem(unsigned int nTicks)
@@ -273,3 +329,16 @@ void CSynthLCD::UpdateChannelPeakLevels()
 			--m_ChannelPeakTimes[i];
 	}
 }
+
+void CSynthLCD::UpdateDSPLoadText(CSynthBase& Synth)
+{
+	const CRenderProfiler::TStats Stats = m_pRenderProfiler->GetStats();
+
+	u32 nLateChunks = 0;
+	for (size_t i = 0; i < CRenderProfiler::LateChunkBuckets; ++i)
+		nLateChunks += Stats.nLateChunks[i];
+
+	snprintf(m_DSPLoadTextBuffer[0], DSPLoadTextBufferSize, "DSP avg%3u%% max%3u%%", Stats.nAvgLoad, Stats.nMaxLoad);
+	snprintf(m_DSPLoadTextBuffer[1], DSPLoadTextBufferSize, "Late:%-5u Voices:%u", nLateChunks, Synth.GetActiveVoiceCount());
+	snprintf(m_DSPLoadTextBuffer[2], DSPLoadTextBufferSize, "Underruns:%u", Stats.nUnderruns);
+}
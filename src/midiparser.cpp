@@ -21,20 +21,62 @@
 //
 
 #include <circle/logger.h>
+#include <circle/util.h>
 
 #include "midiparser.h"
+#include "utility.h"
+#include "zoneallocator.h"
 
 const char MIDIParserName[] = "midiparser";
 
+// Returns the length of the run of data bytes (high bit clear) at the start of pData, checking a word at a time
+static size_t GetDataByteRunLength(const u8* pData, size_t nSize)
+{
+	size_t nLength = 0;
+
+	while (nLength + sizeof(u64) <= nSize)
+	{
+		u64 nWord;
+		memcpy(&nWord, pData + nLength, sizeof(nWord));
+		if (nWord & 0x8080808080808080)
+			break;
+
+		nLength += sizeof(nWord);
+	}
+
+	while (nLength < nSize && !(pData[nLength] & 0x80))
+		++nLength;
+
+	return nLength;
+}
+
 CMIDIParser::CMIDIParser()
 	: m_State(TState::StatusByte),
-	  m_MessageBuffer{0},
-	  m_nMessageLength(0)
+	  m_DefaultBuffer{0},
+	  m_pMessageBuffer(m_DefaultBuffer),
+	  m_nMessageBufferSize(DefaultSysExBufferSize),
+	  m_nRequestedBufferSize(DefaultSysExBufferSize),
+	  m_nMessageLength(0),
+	  m_nSysExOffset(0),
+	  m_nTimestamp(0)
 {
 }
 
-void CMIDIParser::ParseMIDIBytes(const u8* pData, size_t nSize)
+CMIDIParser::~CMIDIParser()
 {
+	if (m_pMessageBuffer != m_DefaultBuffer)
+		CZoneAllocator::Get()->Free(m_pMessageBuffer);
+}
+
+void CMIDIParser::SetSysExBufferSize(size_t nSize)
+{
+	m_nRequestedBufferSize = Utility::Clamp(nSize, DefaultSysExBufferSize, MaxSysExBufferSize);
+}
+
+void CMIDIParser::ParseMIDIBytes(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	m_nTimestamp = nTimestamp;
+
 	// Process MIDI messages
 	// See: https://www.midi.org/specifications/item/table-1-summary-of-midi-message
 	for (size_t i = 0; i < nSize; ++i)
@@ -47,11 +89,80 @@ void CMIDIParser::ParseMIDIBytes(const u8* pData, size_t nSize)
 		{
 			// Ignore undefined System Real-Time
 			if (nByte != 0xF9 && nByte != 0xFD)
-				OnShortMessage(nByte);
+				OnShortMessage(nByte, m_nTimestamp);
 
 			continue;
 		}
 
+		// Runs of data bytes are consumed in bulk where possible, leaving i on the last byte consumed
+		if (!(nByte & 0x80))
+		{
+			const size_t nRunLength = GetDataByteRunLength(pData + i, nSize - i);
+
+			// SysEx body
+			if (m_State == TState::SysExByte)
+			{
+				const u8* pRun    = pData + i;
+				size_t nRemaining = nRunLength;
+
+				while (true)
+				{
+					const size_t nCopy = Utility::Min(nRemaining, m_nMessageBufferSize - m_nMessageLength);
+					memcpy(m_pMessageBuffer + m_nMessageLength, pRun, nCopy);
+					m_nMessageLength += nCopy;
+					pRun += nCopy;
+					nRemaining -= nCopy;
+
+					if (!nRemaining)
+						break;
+
+					// The rest of the run has no status to belong to, and is ignored
+					if (!FlushSysExFragment())
+					{
+						OnSysExOverflow();
+						ResetState(true);
+						break;
+					}
+				}
+
+				i += nRunLength - 1;
+				continue;
+			}
+
+			if (m_State == TState::StatusByte)
+			{
+				const u8 nStatus = m_pMessageBuffer[0];
+
+				// No running status; data bytes are ignored
+				if (!nStatus)
+				{
+					i += nRunLength - 1;
+					continue;
+				}
+
+				// Whole messages under running status (only channel messages leave a status byte that can be reused)
+				const size_t nDataLength = nStatus < 0xF0 && !m_nMessageLength ? GetShortMessageLength(nStatus) - 1 : 0;
+				const size_t nMessages   = nDataLength ? nRunLength / nDataLength : 0;
+				const u8* pMessageData   = pData + i;
+
+				for (size_t j = 0; j < nMessages; ++j, pMessageData += nDataLength)
+				{
+					u32 nMessage = nStatus | pMessageData[0] << 8;
+					if (nDataLength == 2)
+						nMessage |= pMessageData[1] << 16;
+
+					OnShortMessage(nMessage, m_nTimestamp);
+				}
+
+				// A trailing partial message is handled below
+				if (nMessages)
+				{
+					i += nMessages * nDataLength - 1;
+					continue;
+				}
+			}
+		}
+
 		switch (m_State)
 		{
 			// Expecting a status byte
@@ -70,7 +181,7 @@ void CMIDIParser::ParseMIDIBytes(const u8* pData, size_t nSize)
 					break;
 				}
 
-				m_MessageBuffer[m_nMessageLength++] = nByte;
+				m_pMessageBuffer[m_nMessageLength++] = nByte;
 				CheckCompleteShortMessage();
 				break;
 
@@ -85,8 +196,8 @@ void CMIDIParser::ParseMIDIBytes(const u8* pData, size_t nSize)
 					break;
 				}
 
-				// Buffer overflow
-				if (m_nMessageLength == sizeof(m_MessageBuffer))
+				// Buffer overflow, unless it can be passed on as a fragment
+				if (m_nMessageLength == m_nMessageBufferSize && !FlushSysExFragment())
 				{
 					OnSysExOverflow();
 					ResetState(true);
@@ -94,20 +205,90 @@ void CMIDIParser::ParseMIDIBytes(const u8* pData, size_t nSize)
 					break;
 				}
 
-				m_MessageBuffer[m_nMessageLength++] = nByte;
+				m_pMessageBuffer[m_nMessageLength++] = nByte;
 
 				// End of SysEx
 				if (nByte == 0xF7)
-				{
-					OnSysExMessage(m_MessageBuffer, m_nMessageLength);
-					ResetState(true);
-				}
+					EndSysEx();
 
 				break;
 		}
 	}
 }
 
+void CMIDIParser::ParseMIDIEventPacket(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	if (nSize == 0)
+		return;
+
+	const u8 nStatus = pData[0];
+
+	// A whole channel, System Common or System Real-Time message
+	if (m_State == TState::StatusByte && nSize == GetShortMessageLength(nStatus))
+	{
+		u32 nMessage = 0;
+		for (size_t i = 0; i < nSize; ++i)
+			nMessage |= pData[i] << 8 * i;
+
+		// Keep running status the same as if the bytes had been parsed individually
+		if (nStatus < 0xF0)
+			m_pMessageBuffer[0] = nStatus;
+		else if (nStatus < 0xF8)
+			m_pMessageBuffer[0] = 0;
+
+		m_nTimestamp = nTimestamp;
+		OnShortMessage(nMessage, nTimestamp);
+		return;
+	}
+
+	// A SysEx continuation; only data bytes, optionally terminated by EOX
+	if (m_State == TState::SysExByte && m_nMessageLength + nSize <= m_nMessageBufferSize)
+	{
+		size_t nDataBytes = 0;
+		while (nDataBytes < nSize && !(pData[nDataBytes] & 0x80))
+			++nDataBytes;
+
+		const bool bEndOfSysEx = nDataBytes + 1 == nSize && pData[nDataBytes] == 0xF7;
+		if (nDataBytes == nSize || bEndOfSysEx)
+		{
+			memcpy(m_pMessageBuffer + m_nMessageLength, pData, nSize);
+			m_nMessageLength += nSize;
+			m_nTimestamp = nTimestamp;
+
+			if (bEndOfSysEx)
+				EndSysEx();
+
+			return;
+		}
+	}
+
+	// Start of SysEx, running status, errors etc.
+	ParseMIDIBytes(pData, nSize, nTimestamp);
+}
+
+size_t CMIDIParser::GetShortMessageLength(u8 nStatus)
+{
+	// Data byte, or a status that can't form a complete message by itself
+	if (nStatus < 0x80 || nStatus == 0xF0 || nStatus == 0xF4 || nStatus == 0xF5 || nStatus == 0xF7 || nStatus == 0xF9 || nStatus == 0xFD)
+		return 0;
+
+	// Program Change, Channel Pressure/Aftertouch, Time Code Quarter Frame, Song Select
+	if ((nStatus >= 0xC0 && nStatus <= 0xDF) || nStatus == 0xF1 || nStatus == 0xF3)
+		return 2;
+
+	// Tune Request, System Real-Time
+	if (nStatus == 0xF6 || nStatus >= 0xF8)
+		return 1;
+
+	return 3;
+}
+
+bool CMIDIParser::OnSysExFragment(const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp)
+{
+	// Not supported by default; the message overflows
+	return false;
+}
+
 void CMIDIParser::OnUnexpectedStatus()
 {
 	if (m_State == TState::SysExByte)
@@ -121,6 +302,47 @@ void CMIDIParser::OnSysExOverflow()
 	CLogger::Get()->Write(MIDIParserName, LogWarning, "Buffer overrun when receiving SysEx message; SysEx ignored");
 }
 
+void CMIDIParser::AllocateSysExBuffer()
+{
+	if (m_nMessageBufferSize >= m_nRequestedBufferSize)
+		return;
+
+	u8* pBuffer = static_cast<u8*>(CZoneAllocator::Get()->Alloc(m_nRequestedBufferSize, TZoneTag::Uncategorized));
+	if (!pBuffer)
+	{
+		CLogger::Get()->Write(MIDIParserName, LogWarning, "Couldn't allocate %d byte SysEx buffer", m_nRequestedBufferSize);
+		m_nRequestedBufferSize = m_nMessageBufferSize;
+		return;
+	}
+
+	memcpy(pBuffer, m_pMessageBuffer, m_nMessageLength);
+	if (m_pMessageBuffer != m_DefaultBuffer)
+		CZoneAllocator::Get()->Free(m_pMessageBuffer);
+
+	m_pMessageBuffer     = pBuffer;
+	m_nMessageBufferSize = m_nRequestedBufferSize;
+}
+
+bool CMIDIParser::FlushSysExFragment()
+{
+	if (!OnSysExFragment(m_pMessageBuffer, m_nMessageLength, m_nSysExOffset, false, m_nTimestamp))
+		return false;
+
+	m_nSysExOffset += m_nMessageLength;
+	m_nMessageLength = 0;
+	return true;
+}
+
+void CMIDIParser::EndSysEx()
+{
+	if (m_nSysExOffset)
+		OnSysExFragment(m_pMessageBuffer, m_nMessageLength, m_nSysExOffset, true, m_nTimestamp);
+	else
+		OnSysExMessage(m_pMessageBuffer, m_nMessageLength, m_nTimestamp);
+
+	ResetState(true);
+}
+
 void CMIDIParser::ParseStatusByte(u8 nByte)
 {
 	// Is it a status byte?
@@ -132,18 +354,19 @@ void CMIDIParser::ParseStatusByte(u8 nByte)
 			case 0xF4:
 			case 0xF5:
 			case 0xF7:
-				m_MessageBuffer[0] = 0;
+				m_pMessageBuffer[0] = 0;
 				return;
 
 			// Start of SysEx message
 			case 0xF0:
+				AllocateSysExBuffer();
 				m_State = TState::SysExByte;
 				break;
 
 			// Tune Request - single byte, handle immediately and clear running status
 			case 0xF6:
-				OnShortMessage(nByte);
-				m_MessageBuffer[0] = 0;
+				OnShortMessage(nByte, m_nTimestamp);
+				m_pMessageBuffer[0] = 0;
 				break;
 
 			// Channel or System Common message
@@ -152,13 +375,13 @@ void CMIDIParser::ParseStatusByte(u8 nByte)
 				break;
 		}
 
-		m_MessageBuffer[m_nMessageLength++] = nByte;
+		m_pMessageBuffer[m_nMessageLength++] = nByte;
 	}
 
 	// Data byte, use Running Status if we've stored a status byte
-	else if (m_MessageBuffer[0])
+	else if (m_pMessageBuffer[0])
 	{
-		m_MessageBuffer[1] = nByte;
+		m_pMessageBuffer[1] = nByte;
 		m_nMessageLength = 2;
 
 		// We could have a complete 2-byte message, otherwise wait for third byte
@@ -169,14 +392,14 @@ void CMIDIParser::ParseStatusByte(u8 nByte)
 
 bool CMIDIParser::CheckCompleteShortMessage()
 {
-	const u8 nStatus = m_MessageBuffer[0];
+	const u8 nStatus = m_pMessageBuffer[0];
 
 	// MIDI message is complete if we receive 3 bytes,
 	// or 2 bytes if it's a Program Change, Channel Pressure/Aftertouch, Time Code Quarter Frame, or Song Select
 	if (m_nMessageLength == 3 ||
 		(m_nMessageLength == 2 && ((nStatus >= 0xC0 && nStatus <= 0xDF) || nStatus == 0xF1 || nStatus == 0xF3)))
 	{
-		OnShortMessage(PrepareShortMessage());
+		OnShortMessage(PrepareShortMessage(), m_nTimestamp);
 
 		// Clear running status if System Common
 		ResetState(nStatus >= 0xF1 && nStatus <= 0xF7);
@@ -192,7 +415,7 @@ u32 CMIDIParser::PrepareShortMessage() const
 
 	u32 nMessage = 0;
 	for (size_t i = 0; i < m_nMessageLength; ++i)
-		nMessage |= m_MessageBuffer[i] << 8 * i;
+		nMessage |= m_pMessageBuffer[i] << 8 * i;
 
 	return nMessage;
 }
@@ -200,8 +423,9 @@ u32 CMIDIParser::PrepareShortMessage() const
 void CMIDIParser::ResetState(bool bClearStatusByte)
 {
 	if (bClearStatusByte)
-		m_MessageBuffer[0] = 0;
+		m_pMessageBuffer[0] = 0;
 
 	m_nMessageLength = 0;
+	m_nSysExOffset = 0;
 	m_State = TState::StatusByte;
 }
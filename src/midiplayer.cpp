@@ -0,0 +1,507 @@
+//
+// midiplayer.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+
+#include "midiplayer.h"
+#include "utility.h"
+
+const char MIDIPlayerName[] = "midiplayer";
+const char* const Disks[] = { "SD", "USB" };
+const char MIDIDirectory[] = "midi";
+const char* const FileExtensions[] = { ".mid", ".midi", ".smf" };
+
+// 120 BPM until the file says otherwise
+constexpr u32 DefaultTempo = 500000;
+
+constexpr u8 MetaEvent      = 0xFF;
+constexpr u8 MetaEndOfTrack = 0x2F;
+constexpr u8 MetaSetTempo   = 0x51;
+
+namespace
+{
+	inline u16 ReadBigEndian16(const u8* pData)
+	{
+		return pData[0] << 8 | pData[1];
+	}
+
+	inline u32 ReadBigEndian32(const u8* pData)
+	{
+		return pData[0] << 24 | pData[1] << 16 | pData[2] << 8 | pData[3];
+	}
+
+	bool HasMIDIFileExtension(const char* pFileName)
+	{
+		const size_t nLength = strlen(pFileName);
+		for (const char* pExtension : FileExtensions)
+		{
+			const size_t nExtensionLength = strlen(pExtension);
+			if (nLength > nExtensionLength && strcasecmp(pFileName + nLength - nExtensionLength, pExtension) == 0)
+				return true;
+		}
+
+		return false;
+	}
+}
+
+CMIDIPlayer::CMIDIPlayer()
+	: m_nFiles(0),
+
+	  m_File{},
+	  m_bFileOpen(false),
+	  m_bPlaying(false),
+	  m_nFileIndex(0),
+
+	  m_pTracks(new TTrack[MaxTracks]),
+	  m_nTracks(0),
+	  m_Heap{0},
+	  m_nHeapSize(0),
+
+	  m_nDivision(0),
+	  m_bSMPTE(false),
+
+	  m_nTempo(DefaultTempo),
+	  m_nTempoTick(0),
+	  m_nTempoMicros(0),
+
+	  m_nStartTime(0),
+
+	  m_SysExBuffer{0}
+{
+}
+
+CMIDIPlayer::~CMIDIPlayer()
+{
+	Stop();
+	delete[] m_pTracks;
+}
+
+bool CMIDIPlayer::ScanFiles()
+{
+	for (size_t i = 0; i < m_nFiles; ++i)
+		m_FileList[i] = CString();
+
+	m_nFiles = 0;
+
+	DIR Dir;
+	FILINFO FileInfo;
+	FRESULT Result;
+	CString DirectoryPath;
+
+	for (auto pDisk : Disks)
+	{
+		DirectoryPath.Format("%s:/%s", pDisk, MIDIDirectory);
+		Result = f_findfirst(&Dir, &FileInfo, DirectoryPath, "*");
+
+		while (Result == FR_OK && *FileInfo.fname && m_nFiles < MaxFiles)
+		{
+			if (!(FileInfo.fattrib & (AM_DIR | AM_HID | AM_SYS)) && HasMIDIFileExtension(FileInfo.fname))
+			{
+				CString& Path = m_FileList[m_nFiles++];
+				Path = static_cast<const char*>(DirectoryPath);
+				Path.Append("/");
+				Path.Append(FileInfo.fname);
+			}
+
+			Result = f_findnext(&Dir, &FileInfo);
+		}
+
+		f_closedir(&Dir);
+	}
+
+	if (m_nFiles > 1)
+		Utility::QSort(m_FileList, Utility::Comparator::CaseInsensitiveAscending, 0, m_nFiles - 1);
+
+	CLogger::Get()->Write(MIDIPlayerName, LogNotice, "%d MIDI files found", m_nFiles);
+	return m_nFiles > 0;
+}
+
+const char* CMIDIPlayer::GetFileName(size_t nIndex) const
+{
+	if (nIndex >= m_nFiles)
+		return nullptr;
+
+	const char* pPath = m_FileList[nIndex];
+	const char* pFileName = strrchr(pPath, '/');
+	return pFileName ? pFileName + 1 : pPath;
+}
+
+bool CMIDIPlayer::Play(size_t nIndex)
+{
+	CLogger* const pLogger = CLogger::Get();
+
+	Stop();
+
+	if (nIndex >= m_nFiles)
+		return false;
+
+	const char* pPath = m_FileList[nIndex];
+	if (f_open(&m_File, pPath, FA_READ) != FR_OK)
+	{
+		pLogger->Write(MIDIPlayerName, LogError, "Couldn't open '%s'", pPath);
+		return false;
+	}
+
+	m_bFileOpen = true;
+
+	u8 Header[14];
+	UINT nRead;
+	if (f_read(&m_File, Header, sizeof(Header), &nRead) != FR_OK || nRead != sizeof(Header) || memcmp(Header, "MThd", 4) != 0 || ReadBigEndian32(Header + 4) < 6)
+	{
+		pLogger->Write(MIDIPlayerName, LogError, "'%s' is not a Standard MIDI File", pPath);
+		Stop();
+		return false;
+	}
+
+	const u16 nFormat     = ReadBigEndian16(Header + 8);
+	const u16 nTrackCount = ReadBigEndian16(Header + 10);
+	const u16 nDivision   = ReadBigEndian16(Header + 12);
+
+	if (nFormat > 1)
+	{
+		pLogger->Write(MIDIPlayerName, LogError, "'%s' is a type %d MIDI file; only types 0 and 1 are supported", pPath, nFormat);
+		Stop();
+		return false;
+	}
+
+	// SMPTE division is a negative frame rate and ticks per frame; kept as ticks per 100 seconds so that 29.97fps is exact
+	m_bSMPTE = nDivision & 0x8000;
+	if (m_bSMPTE)
+	{
+		const u8 nFramesPerSecond = -static_cast<s8>(nDivision >> 8);
+		m_nDivision = (nFramesPerSecond == 29 ? 2997 : nFramesPerSecond * 100) * (nDivision & 0xFF);
+	}
+	else
+		m_nDivision = nDivision;
+
+	if (!m_nDivision)
+	{
+		pLogger->Write(MIDIPlayerName, LogError, "'%s' has an invalid time division", pPath);
+		Stop();
+		return false;
+	}
+
+	if (nTrackCount > MaxTracks)
+		pLogger->Write(MIDIPlayerName, LogWarning, "'%s' has %d tracks; only the first %d will be played", pPath, nTrackCount, MaxTracks);
+
+	// Locate each track chunk, skipping any chunk types we don't know
+	u32 nOffset = 8 + ReadBigEndian32(Header + 4);
+	while (m_nTracks < Utility::Min(static_cast<size_t>(nTrackCount), MaxTracks))
+	{
+		u8 ChunkHeader[8];
+		if (f_lseek(&m_File, nOffset) != FR_OK || f_read(&m_File, ChunkHeader, sizeof(ChunkHeader), &nRead) != FR_OK || nRead != sizeof(ChunkHeader))
+			break;
+
+		const u32 nLength = ReadBigEndian32(ChunkHeader + 4);
+		nOffset += sizeof(ChunkHeader);
+
+		if (memcmp(ChunkHeader, "MTrk", 4) == 0)
+		{
+			TTrack& Track        = m_pTracks[m_nTracks];
+			Track.nPosition      = nOffset;
+			Track.nEnd           = nOffset + nLength;
+			Track.nBufferOffset  = nOffset;
+			Track.nBufferLength  = 0;
+			Track.nNextTick      = 0;
+			Track.nRunningStatus = 0;
+
+			if (ReadDeltaTime(Track))
+				HeapPush(m_nTracks);
+
+			++m_nTracks;
+		}
+
+		nOffset += nLength;
+	}
+
+	if (!m_nHeapSize)
+	{
+		pLogger->Write(MIDIPlayerName, LogError, "'%s' has no events", pPath);
+		Stop();
+		return false;
+	}
+
+	m_nTempo       = DefaultTempo;
+	m_nTempoTick   = 0;
+	m_nTempoMicros = 0;
+	m_nStartTime   = CTimer::GetClockTicks();
+	m_nFileIndex   = nIndex;
+	m_bPlaying     = true;
+
+	pLogger->Write(MIDIPlayerName, LogNotice, "Playing '%s' (type %d, %d tracks)", pPath, nFormat, m_nTracks);
+	return true;
+}
+
+void CMIDIPlayer::Stop()
+{
+	if (m_bFileOpen)
+	{
+		f_close(&m_File);
+		m_bFileOpen = false;
+	}
+
+	m_bPlaying  = false;
+	m_nTracks   = 0;
+	m_nHeapSize = 0;
+}
+
+bool CMIDIPlayer::Update()
+{
+	if (!m_bPlaying)
+		return false;
+
+	const unsigned int nElapsed = CTimer::GetClockTicks() - m_nStartTime;
+
+	// Events are passed on as soon as they're due with their exact time, which the synth uses to place them within the
+	// next chunk it renders
+	while (m_nHeapSize)
+	{
+		TTrack& Track = m_pTracks[m_Heap[0]];
+		const u32 nEventTime = TicksToMicros(Track.nNextTick);
+		if (nEventTime > nElapsed)
+			return true;
+
+		ReadEvent(Track, m_nStartTime + nEventTime);
+
+		if (ReadDeltaTime(Track))
+			HeapSiftDown(0);
+		else
+			HeapPop();
+	}
+
+	CLogger::Get()->Write(MIDIPlayerName, LogNotice, "Finished playing '%s'", GetFileName(m_nFileIndex));
+	Stop();
+	return false;
+}
+
+bool CMIDIPlayer::ReadByte(TTrack& Track, u8& nByte)
+{
+	if (Track.nPosition >= Track.nEnd)
+		return false;
+
+	if (Track.nPosition - Track.nBufferOffset >= Track.nBufferLength)
+	{
+		const UINT nSize = Utility::Min(static_cast<u32>(sizeof(Track.Buffer)), Track.nEnd - Track.nPosition);
+		UINT nRead;
+
+		// Treat a read error as the end of the track
+		if (f_lseek(&m_File, Track.nPosition) != FR_OK || f_read(&m_File, Track.Buffer, nSize, &nRead) != FR_OK || !nRead)
+		{
+			Track.nPosition = Track.nEnd;
+			return false;
+		}
+
+		Track.nBufferOffset = Track.nPosition;
+		Track.nBufferLength = nRead;
+	}
+
+	nByte = Track.Buffer[Track.nPosition++ - Track.nBufferOffset];
+	return true;
+}
+
+bool CMIDIPlayer::ReadVarLength(TTrack& Track, u32& nValue)
+{
+	nValue = 0;
+
+	// At most 4 bytes of 7 bits each
+	for (size_t i = 0; i < 4; ++i)
+	{
+		u8 nByte;
+		if (!ReadByte(Track, nByte))
+			return false;
+
+		nValue = nValue << 7 | (nByte & 0x7F);
+		if (!(nByte & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+void CMIDIPlayer::Skip(TTrack& Track, u32 nBytes)
+{
+	Track.nPosition = Utility::Min(Track.nPosition + nBytes, Track.nEnd);
+}
+
+bool CMIDIPlayer::ReadDeltaTime(TTrack& Track)
+{
+	u32 nDelta;
+	if (!ReadVarLength(Track, nDelta))
+		return false;
+
+	Track.nNextTick += nDelta;
+	return true;
+}
+
+void CMIDIPlayer::ReadEvent(TTrack& Track, unsigned int nTimestamp)
+{
+	u8 nStatus;
+	if (!ReadByte(Track, nStatus))
+		return;
+
+	if (nStatus == MetaEvent)
+	{
+		u8 nType;
+		u32 nLength;
+		if (!ReadByte(Track, nType) || !ReadVarLength(Track, nLength))
+			return;
+
+		if (nType == MetaEndOfTrack)
+			Track.nPosition = Track.nEnd;
+		else if (nType == MetaSetTempo && nLength == 3)
+		{
+			u8 Tempo[3];
+			for (u8& nByte : Tempo)
+			{
+				if (!ReadByte(Track, nByte))
+					return;
+			}
+
+			// Later events are timed relative to the tempo change
+			m_nTempoMicros = TicksToMicros(Track.nNextTick);
+			m_nTempoTick   = Track.nNextTick;
+			m_nTempo       = Tempo[0] << 16 | Tempo[1] << 8 | Tempo[2];
+		}
+		else
+			Skip(Track, nLength);
+
+		return;
+	}
+
+	if (nStatus == 0xF0 || nStatus == 0xF7)
+	{
+		u32 nLength;
+		if (!ReadVarLength(Track, nLength))
+			return;
+
+		// Only complete SysEx messages are sent; escaped data (F7) and messages split into packets are skipped
+		if (nStatus == 0xF7 || nLength + 1 > MaxSysExSize)
+		{
+			Skip(Track, nLength);
+			return;
+		}
+
+		m_SysExBuffer[0] = nStatus;
+		for (size_t i = 1; i <= nLength; ++i)
+		{
+			if (!ReadByte(Track, m_SysExBuffer[i]))
+				return;
+		}
+
+		if (m_SysExBuffer[nLength] == 0xF7)
+			OnSysExMessage(m_SysExBuffer, nLength + 1, nTimestamp);
+
+		return;
+	}
+
+	u8 nData1;
+	if (nStatus & 0x80)
+	{
+		Track.nRunningStatus = nStatus;
+		if (!ReadByte(Track, nData1))
+			return;
+	}
+	else if (Track.nRunningStatus)
+	{
+		nData1  = nStatus;
+		nStatus = Track.nRunningStatus;
+	}
+	else
+		return;
+
+	u32 nMessage = nStatus | nData1 << 8;
+
+	// Program change and channel pressure have only one data byte
+	const u8 nType = nStatus & 0xF0;
+	if (nType != 0xC0 && nType != 0xD0)
+	{
+		u8 nData2;
+		if (!ReadByte(Track, nData2))
+			return;
+
+		nMessage |= nData2 << 16;
+	}
+
+	OnShortMessage(nMessage, nTimestamp);
+}
+
+u32 CMIDIPlayer::TicksToMicros(u32 nTick) const
+{
+	if (m_bSMPTE)
+		return static_cast<u64>(nTick) * 100000000 / m_nDivision;
+
+	return m_nTempoMicros + static_cast<u64>(nTick - m_nTempoTick) * m_nTempo / m_nDivision;
+}
+
+bool CMIDIPlayer::HeapLess(size_t nA, size_t nB) const
+{
+	const u32 nTickA = m_pTracks[m_Heap[nA]].nNextTick;
+	const u32 nTickB = m_pTracks[m_Heap[nB]].nNextTick;
+
+	// Events on the same tick play in track order, so tempo changes in the first track take effect first
+	return nTickA < nTickB || (nTickA == nTickB && m_Heap[nA] < m_Heap[nB]);
+}
+
+void CMIDIPlayer::HeapPush(u8 nTrack)
+{
+	size_t nIndex = m_nHeapSize++;
+	m_Heap[nIndex] = nTrack;
+
+	while (nIndex)
+	{
+		const size_t nParent = (nIndex - 1) / 2;
+		if (!HeapLess(nIndex, nParent))
+			break;
+
+		Utility::Swap(m_Heap[nIndex], m_Heap[nParent]);
+		nIndex = nParent;
+	}
+}
+
+void CMIDIPlayer::HeapPop()
+{
+	m_Heap[0] = m_Heap[--m_nHeapSize];
+	HeapSiftDown(0);
+}
+
+void CMIDIPlayer::HeapSiftDown(size_t nIndex)
+{
+	while (true)
+	{
+		const size_t nLeft  = nIndex * 2 + 1;
+		const size_t nRight = nLeft + 1;
+		size_t nSmallest    = nIndex;
+
+		if (nLeft < m_nHeapSize && HeapLess(nLeft, nSmallest))
+			nSmallest = nLeft;
+		if (nRight < m_nHeapSize && HeapLess(nRight, nSmallest))
+			nSmallest = nRight;
+
+		if (nSmallest == nIndex)
+			break;
+
+		Utility::Swap(m_Heap[nIndex], m_Heap[nSmallest]);
+		nIndex = nSmallest;
+	}
+}
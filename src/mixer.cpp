@@ -0,0 +1,118 @@
+//
+// mixer.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIXER_NEON
+#endif
+
+#include "mixer.h"
+#include "utility.h"
+
+namespace Mixer
+{
+	void Add(float* pOutBuffer, const float* pInBuffer, size_t nSamples)
+	{
+		size_t i = 0;
+
+#ifdef MIXER_NEON
+		for (; i + 8 <= nSamples; i += 8)
+		{
+			vst1q_f32(pOutBuffer + i, vaddq_f32(vld1q_f32(pOutBuffer + i), vld1q_f32(pInBuffer + i)));
+			vst1q_f32(pOutBuffer + i + 4, vaddq_f32(vld1q_f32(pOutBuffer + i + 4), vld1q_f32(pInBuffer + i + 4)));
+		}
+#endif
+
+		for (; i < nSamples; ++i)
+			pOutBuffer[i] += pInBuffer[i];
+	}
+
+	void Add(s16* pOutBuffer, const s16* pInBuffer, size_t nSamples)
+	{
+		size_t i = 0;
+
+#ifdef MIXER_NEON
+		for (; i + 8 <= nSamples; i += 8)
+			vst1q_s16(pOutBuffer + i, vqaddq_s16(vld1q_s16(pOutBuffer + i), vld1q_s16(pInBuffer + i)));
+#endif
+
+		for (; i < nSamples; ++i)
+			pOutBuffer[i] = Utility::Clamp(pOutBuffer[i] + pInBuffer[i], -32768, 32767);
+	}
+
+	void AddRamp(float* pOutBuffer, const float* pInBuffer, float nStartGain, float nGainStep, size_t nFrames)
+	{
+		size_t i = 0;
+
+#ifdef MIXER_NEON
+		// Two stereo frames at a time; the gains are computed from the frame index rather than accumulated, so that
+		// rounding errors don't build up over a long ramp
+		const float FrameOffsets[] = { 0.0f, 0.0f, 1.0f, 1.0f };
+		const float32x4_t Offsets = vld1q_f32(FrameOffsets);
+		const float32x4_t Zero    = vdupq_n_f32(0.0f);
+
+		for (; i + 2 <= nFrames; i += 2)
+		{
+			const float32x4_t Index = vaddq_f32(Offsets, vdupq_n_f32(static_cast<float>(i)));
+			const float32x4_t Gain  = vmaxq_f32(vmlaq_n_f32(vdupq_n_f32(nStartGain), Index, nGainStep), Zero);
+			vst1q_f32(pOutBuffer + i * 2, vmlaq_f32(vld1q_f32(pOutBuffer + i * 2), vld1q_f32(pInBuffer + i * 2), Gain));
+		}
+#endif
+
+		for (; i < nFrames; ++i)
+		{
+			const float nGain = Utility::Max(nStartGain + i * nGainStep, 0.0f);
+			pOutBuffer[i * 2]     += pInBuffer[i * 2] * nGain;
+			pOutBuffer[i * 2 + 1] += pInBuffer[i * 2 + 1] * nGain;
+		}
+	}
+
+	float GetPeak(const float* pBuffer, size_t nSamples)
+	{
+		size_t i = 0;
+		float nPeak = 0.0f;
+
+#ifdef MIXER_NEON
+		float32x4_t Peak = vdupq_n_f32(0.0f);
+		for (; i + 4 <= nSamples; i += 4)
+			Peak = vmaxq_f32(Peak, vabsq_f32(vld1q_f32(pBuffer + i)));
+
+		const float32x2_t PeakPair = vpmax_f32(vget_low_f32(Peak), vget_high_f32(Peak));
+		nPeak = Utility::Max(vget_lane_f32(PeakPair, 0), vget_lane_f32(PeakPair, 1));
+#endif
+
+		for (; i < nSamples; ++i)
+			nPeak = Utility::Max(nPeak, pBuffer[i] < 0.0f ? -pBuffer[i] : pBuffer[i]);
+
+		return nPeak;
+	}
+
+	float GetPeak(const s16* pBuffer, size_t nSamples)
+	{
+		int nPeak = 0;
+
+		for (size_t i = 0; i < nSamples; ++i)
+			nPeak = Utility::Max(nPeak, pBuffer[i] < 0 ? -pBuffer[i] : pBuffer[i]);
+
+		return Utility::Min(nPeak, 32767) / 32767.0f;
+	}
+}
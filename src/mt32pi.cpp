@@ -24,22 +24,66 @@
 #include <circle/memory.h>
 #include <circle/pwmsoundbasedevice.h>
 #include <circle/serial.h>
+#include <circle/string.h>
+#include <circle/synchronize.h>
 
 #include <cstdarg>
 
+#include "bootprofiler.h"
 #include "lcd/hd44780.h"
 #include "lcd/ssd1306.h"
+#include "mixer.h"
 #include "mt32pi.h"
+#include "zoneallocator.h"
 
 const char MT32PiName[] = "mt32-pi";
 
 constexpr u32 LCDUpdatePeriodMillis                = 16;
-constexpr u32 MisterUpdatePeriodMillis             = 50;
 constexpr u32 LEDTimeoutMillis                     = 50;
+constexpr u32 USBUpdatePeriodMillis                = 100;
 constexpr u32 ActiveSenseTimeoutMillis             = 330;
+constexpr u32 RenderProfilerLogPeriodMillis        = 10000;
+constexpr u32 RenderProfilerVoicePeriodMillis      = 20;
 
-constexpr float Sample16BitMax = (1 << 16 - 1) - 1;
-constexpr float Sample24BitMax = (1 << 24 - 1) - 1;
+constexpr u8 BenchmarkDefaultSeconds               = 10;
+constexpr u8 BenchmarkMaxSeconds                   = 60;
+constexpr u32 BenchmarkNoteIntervalMillis          = 25;
+constexpr u8 BenchmarkChord[]                      = { 0, 4, 7, 11 };
+constexpr u32 DeepIdleWakeLatencyBudgetMicros      = 10000;
+
+// Rendering stops once the synths have no voices and their output has stayed below half a 16-bit LSB for this long
+constexpr float SilenceThreshold                   = 0.5f / 32768;
+constexpr u32 SilenceHoldMillis                    = 100;
+
+// Sleep until an interrupt is taken or another core executes SEV
+static inline void CPUWaitForEvent()
+{
+	asm volatile("wfe");
+}
+
+// Have the generic timer signal an event on this core whenever bit nBit of the counter goes from 0 to 1, so that WFE
+// returns periodically on a core that takes no interrupts
+static void EnableTimerEventStream(unsigned int nBit)
+{
+#if AARCH == 32
+	u32 nCNTKCTL;
+	asm volatile("mrc p15, 0, %0, c14, c1, 0" : "=r"(nCNTKCTL));
+	nCNTKCTL = (nCNTKCTL & ~0xF0) | (nBit << 4) | (1 << 2);
+	asm volatile("mcr p15, 0, %0, c14, c1, 0" : : "r"(nCNTKCTL));
+#else
+	u64 nCNTKCTL;
+	asm volatile("mrs %0, cntkctl_el1" : "=r"(nCNTKCTL));
+	nCNTKCTL = (nCNTKCTL & ~0xF0) | (nBit << 4) | (1 << 2);
+	asm volatile("msr cntkctl_el1, %0" : : "r"(nCNTKCTL));
+#endif
+}
+
+// Wake any cores waiting in WFE, after making our writes visible to them
+static inline void CPUSendEvent()
+{
+	DataSyncBarrier();
+	asm volatile("sev");
+}
 
 enum class TCustomSysExCommand : u8
 {
@@ -47,6 +91,13 @@ enum class TCustomSysExCommand : u8
 	SwitchMT32ROMSet = 0x01,
 	SwitchSoundFont  = 0x02,
 	SwitchSynth      = 0x03,
+	MemoryStats      = 0x04,
+	Benchmark        = 0x05,
+	PlayMIDIFile     = 0x06,
+	StopMIDIFile     = 0x07,
+	SkipMIDIFile     = 0x08,
+	Record           = 0x09,
+	ReloadConfig     = 0x0A,
 };
 
 CMT32Pi* CMT32Pi::s_pThis = nullptr;
@@ -70,7 +121,7 @@ CMT32Pi::CMT32Pi(CI2CMaster* pI2CMaster, CSPIMaster* pSPIMaster, CInterruptSyste
 	  m_nLCDUpdateTime(0),
 
 	  m_pControl(nullptr),
-	  m_MisterControl(pI2CMaster, m_EventQueue),
+	  m_MisterControl(pI2CMaster, m_MisterEventQueue),
 	  m_nMisterUpdateTime(0),
 
 	  m_bDeferredSoundFontSwitchFlag(false),
@@ -79,24 +130,70 @@ CMT32Pi::CMT32Pi(CI2CMaster* pI2CMaster, CSPIMaster* pSPIMaster, CInterruptSyste
 
 	  m_bSerialMIDIAvailable(false),
 	  m_bSerialMIDIEnabled(false),
-	  m_pUSBMIDIDevice(nullptr),
+	  m_pUSBMIDIDevices{nullptr},
 	  m_pUSBMassStorageDevice(nullptr),
+	  m_nUSBUpdateTime(0),
 
 	  m_bActiveSenseFlag(false),
 	  m_nActiveSenseTime(0),
 
 	  m_bRunning(true),
 	  m_bUITaskDone(false),
+	  m_bUIPauseRequest(false),
+	  m_bUIPaused(false),
 	  m_bLEDOn(false),
 	  m_nLEDOnTime(0),
 
 	  m_pSound(nullptr),
+	  m_bSoundDataNeeded(false),
+
+	  m_bDeepIdle(false),
+	  m_nDeepIdleWakeTime(0),
+	  m_nMIDIEventCount(0),
 	  m_pPisound(nullptr),
 
+	  m_pRenderProfiler(nullptr),
+	  m_nRenderProfilerLogTime(0),
+	  m_nRenderProfilerVoiceTime(0),
+
+	  m_nTelemetryTime(0),
+
+	  m_pPolyphonyGovernor(nullptr),
+
+	  m_RenderWorkerLock(TASK_LEVEL),
+	  m_bRenderWorkerReady(false),
+	  m_bRenderWorkerRequest(false),
+	  m_pRenderWorkerSynth(nullptr),
+	  m_nRenderWorkerFrames(0),
+	  m_pRenderWorkerBuffer(nullptr),
+
 	  m_nMasterVolume(100),
 	  m_pCurrentSynth(nullptr),
+	  m_FadeLock(TASK_LEVEL),
+	  m_nSwitchFadeFrames(0),
+	  m_pFadingSynth(nullptr),
+	  m_bFadeRestart(false),
+
+	  m_bLayering(false),
+	  m_nMT32ChannelMask(0),
 	  m_pMT32Synth(nullptr),
-	  m_pSoundFontSynth(nullptr)
+	  m_pSoundFontSynth(nullptr),
+
+	  m_bBackgroundInitPending(false),
+	  m_BackgroundSynth(TSynth::SoundFont),
+	  m_bDeferredSynthSwitchFlag(false),
+	  m_bDeferredConfigReloadFlag(false),
+	  m_bDeferredMIDIFileFlag(false),
+	  m_nDeferredMIDIFileIndex(0),
+
+	  m_MIDIPlayer(this),
+	  m_bMIDIPlayerAutoplay(false),
+
+	  m_nDeferredBenchmarkSeconds(0),
+	  m_bAudioPauseRequest(false),
+	  m_bAudioPaused(false),
+
+	  m_bMIDIRxOverrun(false)
 {
 	s_pThis = this;
 }
@@ -110,59 +207,39 @@ bool CMT32Pi::Initialize(bool bSerialMIDIAvailable)
 	CConfig* const pConfig = CConfig::Get();
 	CLogger* const pLogger = CLogger::Get();
 
+	CBootProfiler* const pBootProfiler = CBootProfiler::Get();
+
 	m_bSerialMIDIAvailable = bSerialMIDIAvailable;
 	m_bSerialMIDIEnabled = bSerialMIDIAvailable;
 
-	switch (pConfig->LCDType)
+	SetSysExBufferSize(pConfig->MIDISysExBufferSize);
+	for (size_t i = 0; i < USBMIDIInputCount; ++i)
 	{
-		case CConfig::TLCDType::HD44780FourBit:
-			m_pLCD = new CHD44780FourBit(pConfig->LCDWidth, pConfig->LCDHeight);
-			break;
-
-		case CConfig::TLCDType::HD44780I2C:
-			m_pLCD = new CHD44780I2C(m_pI2CMaster, pConfig->LCDI2CLCDAddress, pConfig->LCDWidth, pConfig->LCDHeight);
-			break;
-
-		case CConfig::TLCDType::SH1106I2C:
-			m_pLCD = new CSH1106(m_pI2CMaster, pConfig->LCDI2CLCDAddress, pConfig->LCDWidth, pConfig->LCDHeight, pConfig->LCDRotation);
-			break;
-
-		case CConfig::TLCDType::SSD1306I2C:
-			m_pLCD = new CSSD1306(m_pI2CMaster, pConfig->LCDI2CLCDAddress, pConfig->LCDWidth, pConfig->LCDHeight, pConfig->LCDRotation);
-			break;
-
-		default:
-			break;
+		m_USBMIDIInputs[i].SetRoute(this, GetUSBMIDIRoute(i / USBMIDICables, i % USBMIDICables));
+		m_USBMIDIInputs[i].SetSysExBufferSize(pConfig->MIDISysExBufferSize);
 	}
 
+	pBootProfiler->BeginStage("LCD");
+	m_pLCD = CreateLCD();
 	if (m_pLCD)
-	{
-		if (m_pLCD->Initialize())
-			m_pLCD->Print("mt32-pi " MT32_PI_VERSION, 0, 0, false, true);
-		else
-		{
-			pLogger->Write(MT32PiName, LogWarning, "LCD init failed; invalid dimensions?");
-			delete m_pLCD;
-			m_pLCD = nullptr;
-		}
-	}
+		m_pLCD->Print("mt32-pi " MT32_PI_VERSION, 0, 0, false, true);
 
 #if !defined(__aarch64__) || !defined(LEAVE_QEMU_ON_HALT)
 	// The USB driver is not supported under 64-bit QEMU, so
 	// the initialization must be skipped in this case, or an
 	// exit happens here under 64-bit QEMU.
 	LCDLog(TLCDLogType::Startup, "Init USB");
+	pBootProfiler->BeginStage("USB");
 	if (pConfig->SystemUSB)
 	{
-		if (!m_pUSBHCI->Initialize())
+		// Devices are enumerated by Plug and Play updates from the main loop, so boot doesn't have to wait for them
+		if (!m_pUSBHCI->Initialize(false))
 			return false;
-
-		// Perform an initial Plug and Play update to initialize devices early
-		UpdateUSB(true);
 	}
 #endif
 
 	// Check for Blokas Pisound
+	pBootProfiler->BeginStage("Pisound");
 	m_pPisound = new CPisound(m_pSPIMaster, m_pGPIOManager, pConfig->AudioSampleRate);
 	if (m_pPisound->Initialize())
 	{
@@ -176,6 +253,7 @@ bool CMT32Pi::Initialize(bool bSerialMIDIAvailable)
 		m_pPisound = nullptr;
 	}
 
+	pBootProfiler->BeginStage("Audio");
 	if (pConfig->AudioOutputDevice == CConfig::TAudioOutputDevice::I2SDAC)
 	{
 		LCDLog(TLCDLogType::Startup, "Init audio (I2S)");
@@ -198,11 +276,23 @@ bool CMT32Pi::Initialize(bool bSerialMIDIAvailable)
 	if (!m_pSound->AllocateQueueFrames(pConfig->AudioChunkSize))
 		pLogger->Write(MT32PiName, LogPanic, "Failed to allocate sound queue");
 
+	// Render when the DMA completion interrupt refills the idle buffer from the queue, instead of polling the queue
+	if (pConfig->AudioLowLatency)
+		m_pSound->RegisterNeedDataCallback(SoundNeedDataHandler, this);
+
+	// Automatic polyphony and telemetry also need render statistics
+	if (pConfig->AudioProfiler || pConfig->FluidSynthAutoPolyphony || pConfig->SystemTelemetry)
+		m_pRenderProfiler = new CRenderProfiler(pConfig->AudioSampleRate);
+
+	if (pConfig->AudioProfiler && m_pLCD)
+		m_pLCD->SetRenderProfiler(m_pRenderProfiler);
+
 	LCDLog(TLCDLogType::Startup, "Init controls");
+	pBootProfiler->BeginStage("Controls");
 	if (pConfig->ControlScheme == CConfig::TControlScheme::SimpleButtons)
-		m_pControl = new CControlSimpleButtons(m_EventQueue);
+		m_pControl = new CControlSimpleButtons(m_EventQueue, m_pGPIOManager);
 	else if (pConfig->ControlScheme == CConfig::TControlScheme::SimpleEncoder)
-		m_pControl = new CControlSimpleEncoder(m_EventQueue, pConfig->ControlEncoderType);
+		m_pControl = new CControlSimpleEncoder(m_EventQueue, m_pGPIOManager, pConfig->ControlEncoderType);
 
 	if (m_pControl && !m_pControl->Initialize())
 	{
@@ -211,33 +301,48 @@ bool CMT32Pi::Initialize(bool bSerialMIDIAvailable)
 		m_pControl = nullptr;
 	}
 
-	LCDLog(TLCDLogType::Startup, "Init mt32emu");
-	InitMT32Synth();
+	// Only bring up the preferred synth now so that audio can start sooner; the other one is initialized on core 3
+	const TSynth PreferredSynth = pConfig->SystemDefaultSynth == CConfig::TSystemDefaultSynth::MT32 ? TSynth::MT32 : TSynth::SoundFont;
+	const TSynth OtherSynth     = PreferredSynth == TSynth::MT32 ? TSynth::SoundFont : TSynth::MT32;
+	bool bPreferredSynthReady   = InitSynth(PreferredSynth);
 
-	LCDLog(TLCDLogType::Startup, "Init FluidSynth");
-	InitSoundFontSynth();
+	// Its ROMs or SoundFonts may be on a USB disk; enumerate USB devices now instead of in the main loop and try again
+	if (!bPreferredSynthReady && pConfig->SystemUSB)
+	{
+		LCDLog(TLCDLogType::Startup, "Init USB devices");
+		pBootProfiler->BeginStage("USB devices");
+		UpdateUSB(true);
 
-	// Set initial synthesizer
-	if (pConfig->SystemDefaultSynth == CConfig::TSystemDefaultSynth::MT32)
-		m_pCurrentSynth = m_pMT32Synth;
-	else if (pConfig->SystemDefaultSynth == CConfig::TSystemDefaultSynth::SoundFont)
-		m_pCurrentSynth = m_pSoundFontSynth;
+		if (m_pUSBMassStorageDevice)
+			bPreferredSynthReady = InitSynth(PreferredSynth);
+	}
+
+	if (bPreferredSynthReady)
+	{
+		m_pCurrentSynth          = GetSynth(PreferredSynth);
+		m_BackgroundSynth        = OtherSynth;
+		m_bBackgroundInitPending = true;
 
-	if (!m_pCurrentSynth)
+		// Presets loaded on selection would read from disk while the other synth does
+		if (m_pSoundFontSynth)
+			m_pSoundFontSynth->SetSampleLoadingDeferred(true);
+	}
+	else
 	{
 		pLogger->Write(MT32PiName, LogError, "Preferred synth failed to initialize successfully");
 
 		// Activate any working synth
-		if (m_pMT32Synth)
-			m_pCurrentSynth = m_pMT32Synth;
-		else if (m_pSoundFontSynth)
-			m_pCurrentSynth = m_pSoundFontSynth;
-		else
+		if (!InitSynth(OtherSynth))
 		{
 			pLogger->Write(MT32PiName, LogError, "No synths available");
 			LCDLog(TLCDLogType::Startup, "Synth init failed!");
 			return false;
 		}
+
+		m_pCurrentSynth = GetSynth(OtherSynth);
+
+		if (pConfig->SystemLayering || pConfig->MIDIUSBRouting != CConfig::TMIDIUSBRouting::Merged)
+			pLogger->Write(MT32PiName, LogWarning, "Layering needs both synths; disabled");
 	}
 
 	if (m_pPisound)
@@ -248,7 +353,15 @@ bool CMT32Pi::Initialize(bool bSerialMIDIAvailable)
 	CCPUThrottle::Get()->DumpStatus();
 	SetPowerSaveTimeout(pConfig->SystemPowerSaveTimeout);
 
+	const unsigned int nSwitchFadeTime = Utility::Clamp(pConfig->SystemSwitchFadeTime, 0, 5000);
+	m_nSwitchFadeFrames = static_cast<u64>(nSwitchFadeTime) * pConfig->AudioSampleRate / 1000;
+
+	// Playback starts from the main task once background initialization is no longer using the file system
+	m_MIDIPlayer.ScanFiles();
+	m_bMIDIPlayerAutoplay = pConfig->MIDIPlayerAutoplay;
+
 	// Clear LCD
+	pBootProfiler->BeginStage("Start");
 	if (m_pLCD)
 		m_pLCD->Clear();
 
@@ -259,30 +372,76 @@ bool CMT32Pi::Initialize(bool bSerialMIDIAvailable)
 	if (!CMultiCoreSupport::Initialize())
 		return false;
 
+	pBootProfiler->Finish();
+
 	return true;
 }
 
+CSynthLCD* CMT32Pi::CreateLCD()
+{
+	CConfig* const pConfig = CConfig::Get();
+	CSynthLCD* pLCD        = nullptr;
+
+	switch (pConfig->LCDType)
+	{
+		case CConfig::TLCDType::HD44780FourBit:
+			pLCD = new CHD44780FourBit(pConfig->LCDWidth, pConfig->LCDHeight);
+			break;
+
+		case CConfig::TLCDType::HD44780I2C:
+			pLCD = new CHD44780I2C(m_pI2CMaster, pConfig->LCDI2CLCDAddress, pConfig->LCDWidth, pConfig->LCDHeight);
+			break;
+
+		case CConfig::TLCDType::SH1106I2C:
+			pLCD = new CSH1106(m_pI2CMaster, pConfig->LCDI2CLCDAddress, pConfig->LCDWidth, pConfig->LCDHeight, pConfig->LCDRotation);
+			break;
+
+		case CConfig::TLCDType::SSD1306I2C:
+			pLCD = new CSSD1306(m_pI2CMaster, pConfig->LCDI2CLCDAddress, pConfig->LCDWidth, pConfig->LCDHeight, pConfig->LCDRotation);
+			break;
+
+		default:
+			return nullptr;
+	}
+
+	if (!pLCD->Initialize())
+	{
+		CLogger::Get()->Write(MT32PiName, LogWarning, "LCD init failed; invalid dimensions?");
+		delete pLCD;
+		return nullptr;
+	}
+
+	return pLCD;
+}
+
 bool CMT32Pi::InitMT32Synth()
 {
 	assert(m_pMT32Synth == nullptr);
 
 	CConfig* const pConfig = CConfig::Get();
 
-	m_pMT32Synth = new CMT32Synth(pConfig->AudioSampleRate, pConfig->MT32EmuGain, pConfig->MT32EmuReverbGain, pConfig->MT32EmuResamplerQuality);
-	if (!m_pMT32Synth->Initialize())
+	// Other cores may be running, so only publish the synth once it's ready
+	// Float is only needed for 24-bit output, or for dithering down to 16 bits
+	const bool bIntegerRenderer = pConfig->AudioOutputDevice == CConfig::TAudioOutputDevice::PWM && !pConfig->AudioDither;
+	CMT32Synth* pMT32Synth = new CMT32Synth(pConfig->AudioSampleRate, pConfig->MT32EmuGain, pConfig->MT32EmuReverbGain, pConfig->MT32EmuResamplerQuality, bIntegerRenderer);
+	if (!pMT32Synth->Initialize())
 	{
 		CLogger::Get()->Write(MT32PiName, LogWarning, "mt32emu init failed; no ROMs present?");
-		delete m_pMT32Synth;
-		m_pMT32Synth = nullptr;
+		delete pMT32Synth;
+		return false;
 	}
 
 	// Set initial MT-32 channel assignment from config
 	if (pConfig->MT32EmuMIDIChannels == CMT32Synth::TMIDIChannels::Alternate)
-		m_pMT32Synth->SetMIDIChannels(pConfig->MT32EmuMIDIChannels);
+		pMT32Synth->SetMIDIChannels(pConfig->MT32EmuMIDIChannels);
 
-	m_pMT32Synth->SetLCD(m_pLCD);
+	pMT32Synth->SetLCD(m_pLCD);
+	pMT32Synth->SetMIDICommandQueueEnabled(pConfig->MIDICommandQueue);
 
-	return m_pMT32Synth != nullptr;
+	DataMemBarrier();
+	m_pMT32Synth = pMT32Synth;
+
+	return true;
 }
 
 bool CMT32Pi::InitSoundFontSynth()
@@ -291,17 +450,98 @@ bool CMT32Pi::InitSoundFontSynth()
 
 	CConfig* const pConfig = CConfig::Get();
 
-	m_pSoundFontSynth = new CSoundFontSynth(pConfig->AudioSampleRate, pConfig->FluidSynthGain, pConfig->FluidSynthPolyphony);
-	if (!m_pSoundFontSynth->Initialize())
+	// Other cores may be running, so only publish the synth once it's ready
+	CSoundFontSynth* pSoundFontSynth = new CSoundFontSynth(pConfig->AudioSampleRate, pConfig->FluidSynthGain, pConfig->FluidSynthPolyphony, pConfig->FluidSynthVoiceCullFloor, pConfig->FluidSynthSplitRender, pConfig->FluidSynthDynamicSamples);
+	if (!pSoundFontSynth->Initialize())
 	{
 		CLogger::Get()->Write(MT32PiName, LogWarning, "FluidSynth init failed; no SoundFonts present?");
-		delete m_pSoundFontSynth;
-		m_pSoundFontSynth = nullptr;
+		delete pSoundFontSynth;
+		return false;
 	}
 
-	m_pSoundFontSynth->SetLCD(m_pLCD);
+	pSoundFontSynth->SetLCD(m_pLCD);
+	pSoundFontSynth->SetMIDICommandQueueEnabled(pConfig->MIDICommandQueue);
+
+	// Samples are read on program changes, which can't share the file system with a background load
+	if (pConfig->FluidSynthPreload && pConfig->FluidSynthDynamicSamples)
+		CLogger::Get()->Write(MT32PiName, LogWarning, "SoundFont preloading is disabled when dynamic sample loading is enabled");
+	else
+		pSoundFontSynth->SetPreloadEnabled(pConfig->FluidSynthPreload);
+
+	if (pConfig->FluidSynthAutoPolyphony && !m_pPolyphonyGovernor)
+		m_pPolyphonyGovernor = new CPolyphonyGovernor(pConfig->FluidSynthPolyphony);
 
-	return m_pSoundFontSynth != nullptr;
+	DataMemBarrier();
+	m_pSoundFontSynth = pSoundFontSynth;
+
+	return true;
+}
+
+bool CMT32Pi::InitSynth(TSynth Synth, bool bBackground)
+{
+	const char* pName = Synth == TSynth::MT32 ? "mt32emu" : "FluidSynth";
+
+	// The LCD belongs to the UI task once the other cores are running
+	if (bBackground)
+		CLogger::Get()->Write(MT32PiName, LogNotice, "Initializing %s in the background", pName);
+	else
+	{
+		LCDLog(TLCDLogType::Startup, "Init %s", pName);
+		CBootProfiler::Get()->BeginStage(pName);
+	}
+
+	if (Synth == TSynth::MT32)
+		return InitMT32Synth();
+
+	if (!InitSoundFontSynth())
+		return false;
+
+	CZoneAllocator::Get()->LogStats();
+	return true;
+}
+
+CSynthBase* CMT32Pi::GetSynth(TSynth Synth) const
+{
+	if (Synth == TSynth::MT32)
+		return m_pMT32Synth;
+
+	return m_pSoundFontSynth;
+}
+
+void CMT32Pi::InitBackgroundSynth()
+{
+	CLogger* const pLogger = CLogger::Get();
+	const unsigned int nStartTime = CTimer::GetClockTicks();
+
+	InitSynth(m_BackgroundSynth, true);
+
+	pLogger->Write(MT32PiName, LogNotice, "Background initialization took %d ms", (CTimer::GetClockTicks() - nStartTime) / 1000);
+
+	// Routing USB MIDI inputs to each synth also needs both of them to play at once
+	CConfig* const pConfig = CConfig::Get();
+	if (pConfig->SystemLayering || pConfig->MIDIUSBRouting != CConfig::TMIDIUSBRouting::Merged)
+		InitLayering();
+
+	DataMemBarrier();
+	m_bBackgroundInitPending = false;
+	CPUSendEvent();
+}
+
+void CMT32Pi::InitLayering()
+{
+	CLogger* const pLogger = CLogger::Get();
+
+	if (!m_pMT32Synth || !m_pSoundFontSynth)
+	{
+		pLogger->Write(MT32PiName, LogWarning, "Layering needs both synths; disabled");
+		return;
+	}
+
+	// Channels 2-10, or 1-8 and 10 (zero-based here)
+	m_nMT32ChannelMask = CConfig::Get()->MT32EmuMIDIChannels == CConfig::TMT32EmuMIDIChannels::Standard ? 0x03FE : 0x02FF;
+	DataMemBarrier();
+	m_bLayering = true;
+	pLogger->Write(MT32PiName, LogNotice, "Layering mt32emu and FluidSynth");
 }
 
 void CMT32Pi::MainTask()
@@ -316,11 +556,7 @@ void CMT32Pi::MainTask()
 	while (m_bRunning)
 	{
 		// Process MIDI data
-		UpdateMIDI();
-
-		// Update controls
-		if (m_pControl)
-			m_pControl->Update();
+		const bool bMIDIReceived = UpdateMIDI();
 
 		// Process events
 		ProcessEventQueue();
@@ -337,19 +573,42 @@ void CMT32Pi::MainTask()
 		// Check for active sensing timeout
 		if (m_bActiveSenseFlag && (ticks > m_nActiveSenseTime) && (ticks - m_nActiveSenseTime) >= MSEC2HZ(ActiveSenseTimeoutMillis))
 		{
-			m_pCurrentSynth->AllSoundOff();
+			if (m_bLayering)
+			{
+				m_pMT32Synth->AllSoundOff();
+				m_pSoundFontSynth->AllSoundOff();
+			}
+			else
+				m_pCurrentSynth->AllSoundOff();
 			m_bActiveSenseFlag = false;
 			pLogger->Write(MT32PiName, LogNotice, "Active sense timeout - turning notes off");
 		}
 
 		// Update power management
-		if (m_pCurrentSynth->IsActive())
+		if (m_bLayering ? m_pMT32Synth->IsActive() || m_pSoundFontSynth->IsActive() : m_pCurrentSynth->IsActive())
 			Awaken();
 
 		CPower::Update();
 
-		// Check for deferred SoundFont switch
-		if (m_bDeferredSoundFontSwitchFlag && (ticks - m_nDeferredSoundFontSwitchTime) >= static_cast<unsigned int>(pConfig->ControlSwitchTimeout) * HZ)
+		// Keep scaling quality down if the firmware is still throttling after the last step
+		if (pConfig->SystemThrottleScaling && m_ThrottlePolicy.Update(IsThrottled()))
+			ApplyThrottleLevel();
+
+		// Check for deferred SoundFont switch; wait for background initialization to stop using the file system
+		const bool bSoundFontSwitchReady = m_bDeferredSoundFontSwitchFlag && !m_bBackgroundInitPending;
+		if (bSoundFontSwitchReady && (ticks - m_nDeferredSoundFontSwitchTime) < static_cast<unsigned int>(pConfig->ControlSwitchTimeout) * HZ)
+		{
+			// Use the switch timeout to load the SoundFont in the background, unless a MIDI file is being read or a recording written
+			if (!m_MIDIPlayer.IsPlaying() && !m_WAVRecorder.IsRecording())
+			{
+				m_pSoundFontSynth->PreloadSoundFont(m_nDeferredSoundFontSwitchIndex);
+
+				// Wake the render task to load it
+				if (m_pSoundFontSynth->IsPreloadRequested())
+					CPUSendEvent();
+			}
+		}
+		else if (bSoundFontSwitchReady)
 		{
 			SwitchSoundFont(m_nDeferredSoundFontSwitchIndex);
 			m_bDeferredSoundFontSwitchFlag = false;
@@ -358,11 +617,103 @@ void CMT32Pi::MainTask()
 			Awaken();
 		}
 
-		// Check for USB PnP events
-		if (CConfig::Get()->SystemUSB)
+		// Play MIDI files; with autoplay on, the next one starts when the last has finished
+		if (m_MIDIPlayer.IsPlaying())
+		{
+			if (!m_MIDIPlayer.Update() && m_bMIDIPlayerAutoplay)
+				SkipMIDIFile(true);
+		}
+		else if (m_bMIDIPlayerAutoplay && !m_bBackgroundInitPending)
+		{
+			if (m_MIDIPlayer.GetFileCount())
+				PlayMIDIFile(0);
+			else
+				m_bMIDIPlayerAutoplay = false;
+		}
+
+		// Write recorded audio to disk
+		m_WAVRecorder.Update();
+
+		// Run a benchmark requested by SysEx; MIDI and UI handling stop while it runs
+		if (m_nDeferredBenchmarkSeconds)
+		{
+			RunBenchmark(m_nDeferredBenchmarkSeconds);
+			m_nDeferredBenchmarkSeconds = 0;
+		}
+
+		// Play preset changes that had to wait for background initialization
+		if (m_pSoundFontSynth && m_pSoundFontSynth->IsSampleLoadingDeferred() && !m_bBackgroundInitPending)
+			m_pSoundFontSynth->SetSampleLoadingDeferred(false);
+
+		// Perform a synth switch that had to wait for background initialization
+		if (m_bDeferredSynthSwitchFlag && !m_bBackgroundInitPending)
+		{
+			m_bDeferredSynthSwitchFlag = false;
+			SwitchSynth(m_BackgroundSynth);
+		}
+
+		// Reload the config file once background initialization is no longer using the file system or the synths
+		if (m_bDeferredConfigReloadFlag && !m_bBackgroundInitPending)
+		{
+			m_bDeferredConfigReloadFlag = false;
+			ReloadConfig();
+		}
+
+		// Play a MIDI file that had to wait for a background SoundFont load
+		if (m_bDeferredMIDIFileFlag && !(m_pSoundFontSynth && m_pSoundFontSynth->IsPreloadBusy()))
+		{
+			m_bDeferredMIDIFileFlag = false;
+			PlayMIDIFile(m_nDeferredMIDIFileIndex);
+		}
+
+		// Check for USB PnP events; a newly attached disk would be rescanned, which can't happen during background initialization or loading
+		const bool bPreloadBusy = m_pSoundFontSynth && m_pSoundFontSynth->IsPreloadBusy();
+		if (pConfig->SystemUSB && !m_bBackgroundInitPending && !bPreloadBusy && (ticks - m_nUSBUpdateTime) >= MSEC2HZ(USBUpdatePeriodMillis))
+		{
 			UpdateUSB();
+			m_nUSBUpdateTime = ticks;
+		}
+
+		// Adjust FluidSynth polyphony
+		if (m_pPolyphonyGovernor && (m_bLayering || m_pCurrentSynth == m_pSoundFontSynth))
+			UpdatePolyphonyGovernor();
+
+		// Track the most voices played at once, for comparing the render cost of settings
+		if (m_pRenderProfiler && (ticks - m_nRenderProfilerVoiceTime) >= MSEC2HZ(RenderProfilerVoicePeriodMillis))
+		{
+			// Both synths are playing while layering
+			u32 nVoices = m_pCurrentSynth->GetActiveVoiceCount();
+			if (m_bLayering)
+				nVoices = m_pMT32Synth->GetActiveVoiceCount() + m_pSoundFontSynth->GetActiveVoiceCount();
+
+			m_pRenderProfiler->SampleVoices(nVoices);
+			m_nRenderProfilerVoiceTime = ticks;
+		}
+
+		// Dump render statistics
+		if (pConfig->AudioProfiler && (ticks - m_nRenderProfilerLogTime) >= MSEC2HZ(RenderProfilerLogPeriodMillis))
+		{
+			LogRenderStats();
+			m_nRenderProfilerLogTime = ticks;
+		}
+
+		// Send a telemetry record
+		if (pConfig->SystemTelemetry && (ticks - m_nTelemetryTime) >= MSEC2HZ(CTelemetry::PeriodMillis))
+		{
+			SendTelemetry();
+			m_nTelemetryTime = ticks;
+		}
+
+		// Nothing more to do until an interrupt arrives (serial, USB or Pisound MIDI, a control input, the system
+		// timer tick) or another core signals an event; keep going while MIDI is flowing in case there's more buffered, or
+		// while a MIDI file is playing, whose events would otherwise be held back until the next timer tick
+		if ((pConfig->SystemIdleWait || m_bDeepIdle) && !bMIDIReceived && !m_MIDIPlayer.IsPlaying())
+			CPUWaitForEvent();
 	}
 
+	// Finish any recording before the reboot
+	StopRecording();
+
 	// Stop audio
 	m_pSound->Cancel();
 
@@ -375,27 +726,61 @@ void CMT32Pi::UITask()
 {
 	CLogger::Get()->Write(MT32PiName, LogNotice, "UI task on Core 1 starting up");
 
-	// Display current MT-32 ROM version/SoundFont
-	m_pCurrentSynth->ReportStatus();
+	CConfig* const pConfig = CConfig::Get();
+
+	// Display how long it took to get here, or the current MT-32 ROM version/SoundFont
+	if (pConfig->LCDShowBootTime)
+	{
+		const unsigned int nBootTime = CBootProfiler::Get()->GetBootTime() / 100000;
+		LCDLog(TLCDLogType::Notice, "Ready in %d.%ds", nBootTime / 10, nBootTime % 10);
+	}
+	else
+		m_pCurrentSynth->ReportStatus();
+
+	const bool bMisterEnabled = pConfig->ControlMister;
 
-	const bool bMisterEnabled = CConfig::Get()->ControlMister;
+	// Wake from WFE every 32768 counter cycles; about 1.7 ms at 19.2 MHz (Pi 2/3) or 0.6 ms at 54 MHz (Pi 4)
+	EnableTimerEventStream(14);
 
 	while (m_bRunning)
 	{
+		// Leave the display and the I2C bus to the main task while it replaces the display
+		if (m_bUIPauseRequest)
+		{
+			m_bUIPaused = true;
+			while (m_bUIPauseRequest && m_bRunning)
+				CPUWaitForEvent();
+			m_bUIPaused = false;
+			continue;
+		}
+
+		// In deep power saving there's nothing to do once the display has gone dark, unless the MiSTer needs polling
+		if (m_bDeepIdle && !bMisterEnabled && (!m_pLCD || (m_pLCD->IsInPowerSavingMode() && m_pLCD->Flush())))
+		{
+			while (m_bDeepIdle && m_bRunning && !m_bUIPauseRequest)
+				CPUWaitForEvent();
+			continue;
+		}
+
 		unsigned ticks = m_pTimer->GetTicks();
 
-		// Update LCD
-		if (m_pLCD && (ticks - m_nLCDUpdateTime) >= MSEC2HZ(LCDUpdatePeriodMillis))
+		// Update LCD; frames are sent piecewise between the other UI work, and a new one is only drawn once the last is done
+		// Nothing is redrawn (or sent to the display) while the synth and UI are idle
+		if (m_pLCD && m_pLCD->Flush() && (ticks - m_nLCDUpdateTime) >= MSEC2HZ(LCDUpdatePeriodMillis))
 		{
 			if (m_pCurrentSynth == m_pMT32Synth)
-				m_pLCD->Update(*m_pMT32Synth);
-			else
+			{
+				if (m_pLCD->IsUpdateNeeded(*m_pMT32Synth))
+					m_pLCD->Update(*m_pMT32Synth);
+			}
+			else if (m_pLCD->IsUpdateNeeded(*m_pSoundFontSynth))
 				m_pLCD->Update(*m_pSoundFontSynth);
+
 			m_nLCDUpdateTime = ticks;
 		}
 
-		// Poll MiSTer interface
-		if (bMisterEnabled && (ticks - m_nMisterUpdateTime) >= MSEC2HZ(MisterUpdatePeriodMillis))
+		// Poll MiSTer interface, or push our changes to it
+		if (bMisterEnabled)
 		{
 			TMisterStatus Status{TMisterSynth::Unknown, 0xFF, 0xFF};
 
@@ -410,8 +795,22 @@ void CMT32Pi::UITask()
 			if (m_pSoundFontSynth)
 				Status.SoundFontIndex = m_pSoundFontSynth->GetSoundFontIndex();
 
-			m_MisterControl.Update(Status);
-			m_nMisterUpdateTime = ticks;
+			if ((ticks - m_nMisterUpdateTime) >= MSEC2HZ(m_MisterControl.GetUpdatePeriodMillis()) || m_MisterControl.IsSystemStatusChanged(Status))
+			{
+				m_MisterControl.Update(Status);
+				m_nMisterUpdateTime = ticks;
+
+				// The main task may be waiting for an event
+				CPUSendEvent();
+			}
+		}
+
+		// With the frame sent, there's nothing to do before the next timer tick; both the LCD update and MiSTer poll
+		// periods are counted in ticks, and status changes are pushed to the MiSTer at the next one
+		if (!m_pLCD || m_pLCD->Flush())
+		{
+			while (m_bRunning && !m_bUIPauseRequest && m_pTimer->GetTicks() == ticks)
+				CPUWaitForEvent();
 		}
 	}
 
@@ -428,42 +827,300 @@ void CMT32Pi::AudioTask()
 	pLogger->Write(MT32PiName, LogNotice, "Audio task on Core 2 starting up");
 
 	const bool bUse24Bit    = CConfig::Get()->AudioOutputDevice == CConfig::TAudioOutputDevice::I2SDAC;
+	const bool bLowLatency  = CConfig::Get()->AudioLowLatency;
+
+	// Without dither, 16-bit output can come straight from the synth's own 16-bit renderer; mixing still needs float
+	const bool bNativeS16 = !bUse24Bit && !CConfig::Get()->AudioDither;
 	const size_t nQueueSize = m_pSound->GetQueueSizeFrames();
-	float FloatBuffer[nQueueSize * 2];
-	s16 Int16Buffer[nQueueSize * 2];
-	s32 Int32Buffer[nQueueSize * 2];
+	float SecondaryFloatBuffer[nQueueSize * 2];
+
+	// Samples are converted in place, so there are no separate integer buffers to keep in cache; the storage is untyped
+	// and each view is only used between conversions, which access the samples as bytes (see CPCMConverter)
+	alignas(16) u8 SampleBuffer[nQueueSize * 2 * sizeof(float)];
+	float* const pFloatBuffer = reinterpret_cast<float*>(SampleBuffer);
+	s16* const pInt16Buffer = reinterpret_cast<s16*>(SampleBuffer);
+	s32* const pInt32Buffer = reinterpret_cast<s32*>(SampleBuffer);
+
+	m_pRenderWorkerBuffer = SecondaryFloatBuffer;
+
+	CPCMConverter Converter(CConfig::Get()->AudioDither);
+	bool bStarted = false;
+	bool bWaking = false;
+	size_t nFadePosition = 0;
+
+	// While silent, the buffer holds zeroes (which are the same in every sample format) and is sent as-is
+	const size_t nSilenceHoldFrames = CConfig::Get()->AudioSampleRate * SilenceHoldMillis / 1000;
+	size_t nQuietFrames = 0;
+	bool bSilent = false;
+	unsigned int nLastMIDIEventCount = m_nMIDIEventCount;
 
 	while (m_bRunning)
 	{
-		const size_t nFrames = nQueueSize - m_pSound->GetQueueFramesAvail();
-		m_pCurrentSynth->Render(FloatBuffer, nFrames);
+		// The sound device is stopped in deep power saving; sleep until the main task restarts it
+		if (m_bDeepIdle)
+		{
+			while (m_bDeepIdle && m_bRunning)
+				CPUWaitForEvent();
+			bWaking = true;
+		}
+
+		// Leave the synths to the benchmark until it's done; the sound device plays silence meanwhile
+		if (m_bAudioPauseRequest)
+		{
+			m_bAudioPaused = true;
+			while (m_bAudioPauseRequest && m_bRunning)
+				CPUWaitForEvent();
+			m_bAudioPaused = false;
+
+			// The synths may have been left with voices to finish
+			nQuietFrames = 0;
+			bSilent = false;
+		}
+
+		// Sleep until the sound device has moved the queue into the idle DMA buffer, then refill it in one go; this
+		// leaves a whole chunk period to render, rather than rendering a few frames at a time whenever they drain
+		if (bLowLatency)
+		{
+			while (!m_bSoundDataNeeded && m_bRunning)
+				CPUWaitForEvent();
+
+			m_bSoundDataNeeded = false;
+		}
+
+		const size_t nQueueFramesAvail = m_pSound->GetQueueFramesAvail();
+		const size_t nFrames = nQueueSize - nQueueFramesAvail;
+
+		// Take both synths for this chunk at once, so that a switch part way through can't have one rendered twice
+		m_FadeLock.Acquire();
+		CSynthBase* const pCurrentSynth = m_pCurrentSynth;
+		CSynthBase* const pFadingSynth  = m_pFadingSynth;
+		if (m_bFadeRestart)
+		{
+			nFadePosition  = 0;
+			m_bFadeRestart = false;
+		}
+		m_FadeLock.Release();
+
+		// Any MIDI, or a synth switch fading out the old synth, brings the synths back to life
+		const unsigned int nMIDIEventCount = m_nMIDIEventCount;
+		if (nMIDIEventCount != nLastMIDIEventCount || pFadingSynth)
+		{
+			nQuietFrames = 0;
+			bSilent = false;
+		}
+		nLastMIDIEventCount = nMIDIEventCount;
+
+		// The queue running dry after audio has started means the device ran out of data
+		if (m_pRenderProfiler)
+			m_pRenderProfiler->BeginChunk(nFrames, nQueueFramesAvail == 0 && bStarted);
+
+		// Split rendering or layering; hand the secondary synth (or mt32emu) to core 3 (unless it's busy loading) and mix its output once both are done
+		const bool bSplitRender = !m_bLayering && pCurrentSynth == m_pSoundFontSynth && m_pSoundFontSynth->IsSplitRenderEnabled();
+		const bool bRenderS16   = bNativeS16 && !m_bLayering && !bSplitRender && !pFadingSynth;
+		bool bRenderWorkerRequested = false;
+		if (!bSilent && (m_bLayering || bSplitRender))
+		{
+			// Queued MIDI must reach both synths before either starts rendering
+			if (bSplitRender)
+				m_pSoundFontSynth->ProcessMIDICommands();
+
+			m_RenderWorkerLock.Acquire();
+			if (m_bRenderWorkerReady)
+			{
+				m_nRenderWorkerFrames = nFrames;
+				m_pRenderWorkerSynth  = m_bLayering ? m_pMT32Synth : nullptr;
+				DataMemBarrier();
+				m_bRenderWorkerRequest = true;
+				bRenderWorkerRequested = true;
+			}
+			m_RenderWorkerLock.Release();
+
+			// Wake the render task
+			if (bRenderWorkerRequested)
+				CPUSendEvent();
+		}
+
+		if (bSilent)
+		{
+			// Nothing to render; keep the synths' MIDI timing anchored to now, as if they had been
+			const unsigned int nRenderStartTime = CTimer::GetClockTicks();
+			pCurrentSynth->SkipRender(nRenderStartTime);
+			if (m_bLayering)
+				m_pMT32Synth->SkipRender(nRenderStartTime);
+		}
+		else if (bRenderWorkerRequested)
+		{
+			if (m_bLayering)
+				m_pSoundFontSynth->Render(pFloatBuffer, nFrames);
+			else
+				m_pSoundFontSynth->RenderPrimary(pFloatBuffer, nFrames);
+
+			while (m_bRenderWorkerRequest && m_bRunning)
+				;
+			DataMemBarrier();
+
+			Mixer::Add(pFloatBuffer, SecondaryFloatBuffer, nFrames * 2);
+		}
+		else if (m_bLayering)
+		{
+			// Core 3 is busy; render both synths here
+			m_pSoundFontSynth->Render(pFloatBuffer, nFrames);
+			m_pMT32Synth->Render(SecondaryFloatBuffer, nFrames);
+
+			Mixer::Add(pFloatBuffer, SecondaryFloatBuffer, nFrames * 2);
+		}
+		else if (bRenderS16)
+			pCurrentSynth->Render(pInt16Buffer, nFrames);
+		else
+			pCurrentSynth->Render(pFloatBuffer, nFrames);
+
+		// Mix in the release tails of the synth we switched away from; the secondary buffer is free again by now
+		if (!bSilent && pFadingSynth)
+			RenderFade(pFadingSynth, SecondaryFloatBuffer, pFloatBuffer, nFrames, nFadePosition);
+
+		// Go silent once the synths have been idle for long enough that any reverb tails have decayed
+		if (!bSilent)
+		{
+			const bool bSynthsActive = m_bLayering ? m_pMT32Synth->IsActive() || m_pSoundFontSynth->IsActive() : pCurrentSynth->IsActive();
+			const float nPeak        = bRenderS16 ? Mixer::GetPeak(pInt16Buffer, nFrames * 2) : Mixer::GetPeak(pFloatBuffer, nFrames * 2);
+
+			if (bSynthsActive || nPeak >= SilenceThreshold || pFadingSynth)
+				nQuietFrames = 0;
+			else if ((nQuietFrames += nFrames) >= nSilenceHoldFrames)
+			{
+				memset(SampleBuffer, 0, sizeof(SampleBuffer));
+				bSilent = true;
+			}
+		}
+
+		if (m_pRenderProfiler)
+			m_pRenderProfiler->EndRender();
 
 		size_t nWriteBytes;
 		int nResult;
 
 		if (bUse24Bit)
 		{
-			nWriteBytes = nFrames * 2 * sizeof(*Int32Buffer);
+			nWriteBytes = nFrames * 2 * sizeof(*pInt32Buffer);
 
 			// Convert to signed 24-bit integers
-			for (size_t i = 0; i < nFrames * 2; ++i)
-				Int32Buffer[i] = Utility::Clamp(FloatBuffer[i], -1.0f, 1.0f) * Sample24BitMax;
+			if (!bSilent)
+				Converter.ConvertS24(pFloatBuffer, pInt32Buffer, nFrames * 2);
 
-			nResult = m_pSound->Write(Int32Buffer, nWriteBytes);
+			nResult = m_pSound->Write(pInt32Buffer, nWriteBytes);
 		}
 		else
 		{
-			nWriteBytes = nFrames * 2 * sizeof(*Int16Buffer);
+			nWriteBytes = nFrames * 2 * sizeof(*pInt16Buffer);
 
-			// Convert to signed 16-bit integers
-			for (size_t i = 0; i < nFrames * 2; ++i)
-				Int16Buffer[i] = Utility::Clamp(FloatBuffer[i], -1.0f, 1.0f) * Sample16BitMax;
+			// Convert to signed 16-bit integers, unless the synth rendered them directly
+			if (!bRenderS16 && !bSilent)
+				Converter.ConvertS16(pFloatBuffer, pInt16Buffer, nFrames * 2);
 
-			nResult = m_pSound->Write(Int16Buffer, nWriteBytes);
+			nResult = m_pSound->Write(pInt16Buffer, nWriteBytes);
 		}
 
-		if (nResult != static_cast<int>(nWriteBytes))
+		const bool bDropped = nResult != static_cast<int>(nWriteBytes);
+
+		// Capture exactly what the sound device was given, once it's on its way
+		m_WAVRecorder.WriteSamples(SampleBuffer, nWriteBytes);
+
+		if (m_pRenderProfiler)
+			m_pRenderProfiler->EndChunk(bDropped);
+
+		if (bDropped)
 			pLogger->Write(MT32PiName, LogError, "Sound data dropped");
+
+		// Check how long it took from leaving deep power saving until sound was on its way to the device again
+		if (bWaking)
+		{
+			const unsigned int nWakeLatency = CTimer::GetClockTicks() - m_nDeepIdleWakeTime;
+			if (nWakeLatency > DeepIdleWakeLatencyBudgetMicros)
+				pLogger->Write(MT32PiName, LogWarning, "Wake from deep idle to first sound took %dus (budget %dus)", nWakeLatency, DeepIdleWakeLatencyBudgetMicros);
+			else
+				pLogger->Write(MT32PiName, LogDebug, "Wake from deep idle to first sound took %dus", nWakeLatency);
+			bWaking = false;
+		}
+
+		bStarted = true;
+	}
+
+	// Release render worker
+	m_bRenderWorkerReady = false;
+}
+
+void CMT32Pi::RenderFade(CSynthBase* pFadingSynth, float* pFadeBuffer, float* pOutBuffer, size_t nFrames, size_t& nFadePosition)
+{
+	pFadingSynth->Render(pFadeBuffer, nFrames);
+
+	// Linear fade out; the incoming synth starts from silence, so it's left at full gain
+	const float nFadeFrames = m_nSwitchFadeFrames;
+	Mixer::AddRamp(pOutBuffer, pFadeBuffer, 1.0f - nFadePosition / nFadeFrames, -1.0f / nFadeFrames, nFrames);
+
+	nFadePosition += nFrames;
+	if (nFadePosition < m_nSwitchFadeFrames && pFadingSynth->IsActive())
+		return;
+
+	// Done, unless another switch started a new fade meanwhile
+	m_FadeLock.Acquire();
+	const bool bDone = m_pFadingSynth == pFadingSynth && !m_bFadeRestart;
+	if (bDone)
+		m_pFadingSynth = nullptr;
+	m_FadeLock.Release();
+
+	if (bDone)
+		pFadingSynth->AllSoundOff();
+}
+
+void CMT32Pi::RenderTask()
+{
+	// Bring up the synth that was skipped at boot while the other cores are already running
+	if (m_bBackgroundInitPending)
+		InitBackgroundSynth();
+
+	CConfig* const pConfig = CConfig::Get();
+	if (!pConfig->FluidSynthSplitRender && !pConfig->FluidSynthPreload && !m_bLayering)
+		return;
+
+	CLogger::Get()->Write(MT32PiName, LogNotice, "Render task on Core 3 starting up");
+
+	const bool bRenderWorker = pConfig->FluidSynthSplitRender || m_bLayering;
+	m_bRenderWorkerReady     = bRenderWorker;
+
+	while (m_bRunning)
+	{
+		if (m_bRenderWorkerRequest)
+		{
+			DataMemBarrier();
+			if (m_pRenderWorkerSynth)
+				m_pRenderWorkerSynth->Render(m_pRenderWorkerBuffer, m_nRenderWorkerFrames);
+			else
+				m_pSoundFontSynth->RenderSecondary(m_pRenderWorkerBuffer, m_nRenderWorkerFrames);
+			DataMemBarrier();
+
+			m_bRenderWorkerRequest = false;
+			continue;
+		}
+
+		// Sleep until the audio task posts a request, a preload is requested or we're shutting down
+		if (!m_pSoundFontSynth || !m_pSoundFontSynth->IsPreloadRequested())
+		{
+			CPUWaitForEvent();
+			continue;
+		}
+
+		// Stop accepting render requests while loading; the audio task renders both synths itself meanwhile
+		m_RenderWorkerLock.Acquire();
+		const bool bIdle = !m_bRenderWorkerRequest;
+		if (bIdle)
+			m_bRenderWorkerReady = false;
+		m_RenderWorkerLock.Release();
+
+		if (bIdle)
+		{
+			m_pSoundFontSynth->RunPreload();
+			m_bRenderWorkerReady = bRenderWorker && m_bRunning;
+		}
 	}
 }
 
@@ -481,6 +1138,9 @@ void CMT32Pi::Run(unsigned nCore)
 		case 2:
 			return AudioTask();
 
+		case 3:
+			return RenderTask();
+
 		default:
 			break;
 	}
@@ -489,6 +1149,11 @@ void CMT32Pi::Run(unsigned nCore)
 void CMT32Pi::OnEnterPowerSavingMode()
 {
 	CPower::OnEnterPowerSavingMode();
+
+	// Park the audio and UI tasks before stopping the sound device
+	if (CConfig::Get()->SystemPowerSaveDeepIdle)
+		m_bDeepIdle = true;
+
 	m_pSound->Cancel();
 
 	if (m_pLCD)
@@ -498,8 +1163,15 @@ void CMT32Pi::OnEnterPowerSavingMode()
 void CMT32Pi::OnExitPowerSavingMode()
 {
 	CPower::OnExitPowerSavingMode();
+	m_nDeepIdleWakeTime = CTimer::GetClockTicks();
 	m_pSound->Start();
 
+	if (m_bDeepIdle)
+	{
+		m_bDeepIdle = false;
+		CPUSendEvent();
+	}
+
 	if (m_pLCD)
 		m_pLCD->ExitPowerSavingMode();
 }
@@ -508,15 +1180,51 @@ void CMT32Pi::OnThrottleDetected()
 {
 	CPower::OnThrottleDetected();
 	LCDLog(TLCDLogType::Warning, "CPU throttl! Chk PSU");
+
+	if (CConfig::Get()->SystemThrottleScaling && m_ThrottlePolicy.OnThrottleDetected())
+		ApplyThrottleLevel();
+	else
+		ThrottlePolyphony();
 }
 
 void CMT32Pi::OnUnderVoltageDetected()
 {
 	CPower::OnUnderVoltageDetected();
 	LCDLog(TLCDLogType::Warning, "Low voltage! Chk PSU");
+
+	// The firmware will throttle an undervolted CPU, so get ahead of it
+	if (CConfig::Get()->SystemThrottleScaling && m_ThrottlePolicy.OnThrottleDetected())
+		ApplyThrottleLevel();
+}
+
+void CMT32Pi::OnThrottleCleared()
+{
+	CPower::OnThrottleCleared();
+
+	if (m_ThrottlePolicy.OnThrottleCleared())
+		ApplyThrottleLevel();
 }
 
-void CMT32Pi::OnShortMessage(u32 nMessage)
+void CMT32Pi::OnShortMessage(u32 nMessage, unsigned int nTimestamp)
+{
+	m_Telemetry.CountMIDIEvent(CTelemetry::TMIDISource::GPIO);
+	PlayShortMessage(nMessage, nTimestamp, TMIDIRoute::Default);
+}
+
+void CMT32Pi::OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	m_Telemetry.CountMIDIEvent(CTelemetry::TMIDISource::GPIO);
+	PlaySysExMessage(pData, nSize, nTimestamp, TMIDIRoute::Default);
+}
+
+bool CMT32Pi::OnSysExFragment(const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp)
+{
+	if (bComplete)
+		m_Telemetry.CountMIDIEvent(CTelemetry::TMIDISource::GPIO);
+	return PlaySysExFragment(this, pData, nSize, nOffset, bComplete, nTimestamp, TMIDIRoute::Default);
+}
+
+void CMT32Pi::PlayShortMessage(u32 nMessage, unsigned int nTimestamp, TMIDIRoute Route)
 {
 	// Active sensing
 	if (nMessage == 0xFE)
@@ -527,24 +1235,101 @@ void CMT32Pi::OnShortMessage(u32 nMessage)
 
 	// Flash LED
 	LEDOn();
+	++m_nMIDIEventCount;
 
-	m_pCurrentSynth->HandleMIDIShortMessage(nMessage);
+	if (m_bLayering)
+	{
+		// Inputs assigned to a synth play only that synth
+		if (Route == TMIDIRoute::MT32)
+			m_pMT32Synth->HandleMIDIShortMessage(nMessage, nTimestamp);
+		else if (Route == TMIDIRoute::SoundFont)
+			m_pSoundFontSynth->HandleMIDIShortMessage(nMessage, nTimestamp);
+
+		// System messages go to both synths; channel messages go to the synth that plays that channel
+		else if ((nMessage & 0xF0) == 0xF0)
+		{
+			m_pMT32Synth->HandleMIDIShortMessage(nMessage, nTimestamp);
+			m_pSoundFontSynth->HandleMIDIShortMessage(nMessage, nTimestamp);
+		}
+		else if (m_nMT32ChannelMask & (1 << (nMessage & 0x0F)))
+			m_pMT32Synth->HandleMIDIShortMessage(nMessage, nTimestamp);
+		else
+			m_pSoundFontSynth->HandleMIDIShortMessage(nMessage, nTimestamp);
+	}
+	else
+		m_pCurrentSynth->HandleMIDIShortMessage(nMessage, nTimestamp);
 
 	// Wake from power saving mode if necessary
 	Awaken();
 }
 
-void CMT32Pi::OnSysExMessage(const u8* pData, size_t nSize)
+void CMT32Pi::PlaySysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp, TMIDIRoute Route, bool bCustomSysEx)
 {
 	// Flash LED
 	LEDOn();
+	++m_nMIDIEventCount;
+
+	// If we don't consume the SysEx message, forward it to the synthesizer; each synth ignores SysEx meant for other devices
+	if (!bCustomSysEx || !ParseCustomSysEx(pData, nSize))
+	{
+		if (m_bLayering && Route == TMIDIRoute::MT32)
+			m_pMT32Synth->HandleMIDISysExMessage(pData, nSize, nTimestamp);
+		else if (m_bLayering && Route == TMIDIRoute::SoundFont)
+			m_pSoundFontSynth->HandleMIDISysExMessage(pData, nSize, nTimestamp);
+		else if (m_bLayering)
+		{
+			m_pMT32Synth->HandleMIDISysExMessage(pData, nSize, nTimestamp);
+			m_pSoundFontSynth->HandleMIDISysExMessage(pData, nSize, nTimestamp);
+		}
+		else
+			m_pCurrentSynth->HandleMIDISysExMessage(pData, nSize, nTimestamp);
+	}
+
+	// Wake from power saving mode if necessary
+	Awaken();
+}
+
+bool CMT32Pi::PlaySysExFragment(const void* pSource, const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp, TMIDIRoute Route)
+{
+	// Only mt32emu can take SysEx in pieces
+	const bool bMT32 = m_bLayering ? Route != TMIDIRoute::SoundFont : m_pCurrentSynth == m_pMT32Synth;
+	if (!bMT32 || !m_pMT32Synth->HandleMIDISysExFragment(pSource, pData, nSize, nOffset, bComplete, nTimestamp))
+		return false;
 
-	// If we don't consume the SysEx message, forward it to the synthesizer
-	if (!ParseCustomSysEx(pData, nSize))
-		m_pCurrentSynth->HandleMIDISysExMessage(pData, nSize);
+	// Flash LED
+	LEDOn();
+	++m_nMIDIEventCount;
 
 	// Wake from power saving mode if necessary
 	Awaken();
+
+	return true;
+}
+
+CMT32Pi::TMIDIRoute CMT32Pi::GetUSBMIDIRoute(size_t nDevice, size_t nCable) const
+{
+	size_t nIndex;
+	switch (CConfig::Get()->MIDIUSBRouting)
+	{
+		case CConfig::TMIDIUSBRouting::Device:
+			nIndex = nDevice;
+			break;
+
+		case CConfig::TMIDIUSBRouting::Cable:
+			nIndex = nCable;
+			break;
+
+		default:
+			return TMIDIRoute::Default;
+	}
+
+	if (nIndex == 0)
+		return TMIDIRoute::MT32;
+
+	if (nIndex == 1)
+		return TMIDIRoute::SoundFont;
+
+	return TMIDIRoute::Default;
 }
 
 void CMT32Pi::OnUnexpectedStatus()
@@ -559,6 +1344,68 @@ void CMT32Pi::OnSysExOverflow()
 	LCDLog(TLCDLogType::Error, "SysEx overflow!");
 }
 
+CMT32Pi::CMIDIInput::CMIDIInput()
+	: m_pMT32Pi(nullptr),
+	  m_Route(TMIDIRoute::Default)
+{
+}
+
+void CMT32Pi::CMIDIInput::SetRoute(CMT32Pi* pMT32Pi, TMIDIRoute Route)
+{
+	m_pMT32Pi = pMT32Pi;
+	m_Route   = Route;
+}
+
+void CMT32Pi::CMIDIInput::OnShortMessage(u32 nMessage, unsigned int nTimestamp)
+{
+	m_pMT32Pi->m_Telemetry.CountMIDIEvent(CTelemetry::TMIDISource::USB);
+	m_pMT32Pi->PlayShortMessage(nMessage, nTimestamp, m_Route);
+}
+
+void CMT32Pi::CMIDIInput::OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	m_pMT32Pi->m_Telemetry.CountMIDIEvent(CTelemetry::TMIDISource::USB);
+	m_pMT32Pi->PlaySysExMessage(pData, nSize, nTimestamp, m_Route);
+}
+
+bool CMT32Pi::CMIDIInput::OnSysExFragment(const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp)
+{
+	if (bComplete)
+		m_pMT32Pi->m_Telemetry.CountMIDIEvent(CTelemetry::TMIDISource::USB);
+	return m_pMT32Pi->PlaySysExFragment(this, pData, nSize, nOffset, bComplete, nTimestamp, m_Route);
+}
+
+void CMT32Pi::CMIDIInput::OnUnexpectedStatus()
+{
+	CMIDIParser::OnUnexpectedStatus();
+	m_pMT32Pi->LCDLog(TLCDLogType::Error, "Unexp. MIDI status!");
+}
+
+void CMT32Pi::CMIDIInput::OnSysExOverflow()
+{
+	CMIDIParser::OnSysExOverflow();
+	m_pMT32Pi->LCDLog(TLCDLogType::Error, "SysEx overflow!");
+}
+
+CMT32Pi::CMIDIFilePlayer::CMIDIFilePlayer(CMT32Pi* pMT32Pi)
+	: m_pMT32Pi(pMT32Pi)
+{
+}
+
+void CMT32Pi::CMIDIFilePlayer::OnShortMessage(u32 nMessage, unsigned int nTimestamp)
+{
+	m_pMT32Pi->m_Telemetry.CountMIDIEvent(CTelemetry::TMIDISource::Player);
+	m_pMT32Pi->PlayShortMessage(nMessage, nTimestamp, TMIDIRoute::Default);
+}
+
+void CMT32Pi::CMIDIFilePlayer::OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	m_pMT32Pi->m_Telemetry.CountMIDIEvent(CTelemetry::TMIDISource::Player);
+
+	// Custom commands could reboot, or stop/restart the player from within its own Update(); files only reach the synths
+	m_pMT32Pi->PlaySysExMessage(pData, nSize, nTimestamp, TMIDIRoute::Default, false);
+}
+
 bool CMT32Pi::ParseCustomSysEx(const u8* pData, size_t nSize)
 {
 	if (nSize < 4)
@@ -575,6 +1422,30 @@ bool CMT32Pi::ParseCustomSysEx(const u8* pData, size_t nSize)
 	{
 		CLogger::Get()->Write(MT32PiName, LogNotice, "Reboot command received");
 		m_bRunning = false;
+
+		// Wake the audio task if it's waiting for the sound device, and the idle render task
+		CPUSendEvent();
+		return true;
+	}
+
+	// Report memory statistics (F0 7D 04 F7)
+	if (nSize == 4 && Command == TCustomSysExCommand::MemoryStats)
+	{
+		SendMemoryStats();
+		return true;
+	}
+
+	// Stop MIDI file playback (F0 7D 07 F7)
+	if (nSize == 4 && Command == TCustomSysExCommand::StopMIDIFile)
+	{
+		StopMIDIFile();
+		return true;
+	}
+
+	// Reload the config file (F0 7D 0A F7)
+	if (nSize == 4 && Command == TCustomSysExCommand::ReloadConfig)
+	{
+		m_bDeferredConfigReloadFlag = true;
 		return true;
 	}
 
@@ -584,6 +1455,11 @@ bool CMT32Pi::ParseCustomSysEx(const u8* pData, size_t nSize)
 	const u8 nParameter = pData[3];
 	switch (Command)
 	{
+		// Run benchmark for xx seconds, or a default length if 0 (F0 7D 05 xx F7)
+		case TCustomSysExCommand::Benchmark:
+			m_nDeferredBenchmarkSeconds = nParameter ? Utility::Min(nParameter, BenchmarkMaxSeconds) : BenchmarkDefaultSeconds;
+			return true;
+
 		// Switch MT-32 ROM set (F0 7D 01 xx F7)
 		case TCustomSysExCommand::SwitchMT32ROMSet:
 		{
@@ -605,11 +1481,183 @@ bool CMT32Pi::ParseCustomSysEx(const u8* pData, size_t nSize)
 			return true;
 		}
 
+		// Play MIDI file (F0 7D 06 xx F7)
+		case TCustomSysExCommand::PlayMIDIFile:
+			PlayMIDIFile(nParameter);
+			return true;
+
+		// Skip to the previous (xx = 0) or next (xx = 1) MIDI file (F0 7D 08 xx F7)
+		case TCustomSysExCommand::SkipMIDIFile:
+			SkipMIDIFile(nParameter != 0);
+			return true;
+
+		// Stop recording (xx = 0), or start recording to SD card (xx = 1) or USB disk (xx = 2) (F0 7D 09 xx F7)
+		case TCustomSysExCommand::Record:
+			if (nParameter == 0)
+				StopRecording();
+			else if (nParameter <= 2)
+				StartRecording(nParameter == 1 ? "SD" : "USB");
+			return true;
+
 		default:
 			return false;
 	}
 }
 
+void CMT32Pi::SendMemoryStats()
+{
+	CZoneAllocator* const pAllocator = CZoneAllocator::Get();
+	const CZoneAllocator::TStats Stats = pAllocator->GetStats();
+	pAllocator->LogStats();
+
+	// Reply: F0 7D 04 <heap size> <used> <peak used> <FluidSynth used> <largest free block> <free blocks> <allocations> F7
+	// Sizes are in kilobytes
+	const u32 Values[] = {
+		static_cast<u32>(Stats.nHeapSize / 1024),
+		static_cast<u32>(Stats.nUsedBytes / 1024),
+		static_cast<u32>(Stats.nPeakUsedBytes / 1024),
+		static_cast<u32>(Stats.nTagUsedBytes[TZoneTag::FluidSynth] / 1024),
+		static_cast<u32>(Stats.nLargestFreeBlock / 1024),
+		static_cast<u32>(Stats.nFreeBlocks),
+		static_cast<u32>(Stats.nAllocCount),
+	};
+
+	SendSysExValues(static_cast<u8>(TCustomSysExCommand::MemoryStats), Values, Utility::ArraySize(Values));
+}
+
+void CMT32Pi::SendSysExValues(u8 nCommand, const u32* pValues, size_t nValues)
+{
+	// F0 7D <command> <values> F7; each value is sent as five 7-bit bytes, most significant first
+	u8 Reply[3 + nValues * 5 + 1];
+	Reply[0] = 0xF0;
+	Reply[1] = 0x7D;
+	Reply[2] = nCommand;
+	u8* pData = Reply + 3;
+
+	for (size_t i = 0; i < nValues; ++i)
+	{
+		for (int nShift = 28; nShift >= 0; nShift -= 7)
+			*pData++ = (pValues[i] >> nShift) & 0x7F;
+	}
+
+	*pData = 0xF7;
+
+	SendSysEx(Reply, sizeof(Reply));
+}
+
+void CMT32Pi::RunBenchmark(unsigned int nSeconds)
+{
+	CLogger* const pLogger     = CLogger::Get();
+	CSynthBase* const pSynth   = m_pCurrentSynth;
+	const unsigned nSampleRate = CConfig::Get()->AudioSampleRate;
+	const size_t nChunkFrames  = m_pSound->GetQueueSizeFrames();
+	const u32 nChunkMicros     = static_cast<u64>(nChunkFrames) * 1000000 / nSampleRate;
+	const size_t nTotalFrames  = nSeconds * nSampleRate;
+	const size_t nNoteFrames   = nSampleRate * BenchmarkNoteIntervalMillis / 1000;
+
+	pLogger->Write(MT32PiName, LogNotice, "Running %d second benchmark", nSeconds);
+	LCDLog(TLCDLogType::Spinner, "Benchmarking...");
+
+	// Take over rendering from the audio task
+	m_bAudioPauseRequest = true;
+	while (!m_bAudioPaused && m_bRunning)
+		;
+	DataMemBarrier();
+
+	// Everything is timestamped before rendering starts, so it plays at the start of the next chunk
+	const unsigned int nTimestamp = CTimer::GetClockTicks();
+	pSynth->AllSoundOff();
+	for (u8 nChannel = 0; nChannel < 16; ++nChannel)
+		pSynth->HandleMIDIShortMessage(0xB0 | nChannel | 64 << 8 | 127 << 16, nTimestamp);
+
+	float Buffer[nChunkFrames * 2];
+	u64 nBusyTime = 0;
+	u32 nPeakVoices = 0, nMaxVoicesBeforeLate = 0, nLateChunks = 0;
+	size_t nNextNoteFrame = 0, nChord = 0;
+
+	for (size_t nFrame = 0; nFrame < nTotalFrames; nFrame += nChunkFrames)
+	{
+		// Dense chords on all 16 channels in turn, held by the sustain pedal so voices pile up
+		while (nNextNoteFrame <= nFrame)
+		{
+			const u8 nChannel = nChord % 16;
+			const u8 nRoot    = 36 + (nChord * 7) % 48;
+			for (u8 nInterval : BenchmarkChord)
+				pSynth->HandleMIDIShortMessage(0x90 | nChannel | (nRoot + nInterval) << 8 | 100 << 16, nTimestamp);
+
+			nNextNoteFrame += nNoteFrames;
+			++nChord;
+		}
+
+		const unsigned int nRenderStart = CTimer::GetClockTicks();
+		pSynth->Render(Buffer, nChunkFrames);
+		const unsigned int nRenderTime = CTimer::GetClockTicks() - nRenderStart;
+		nBusyTime += nRenderTime;
+
+		const u32 nVoices = pSynth->GetActiveVoiceCount();
+		nPeakVoices = Utility::Max(nPeakVoices, nVoices);
+
+		if (nRenderTime > nChunkMicros)
+			++nLateChunks;
+		else if (!nLateChunks)
+			nMaxVoicesBeforeLate = nPeakVoices;
+	}
+
+	for (u8 nChannel = 0; nChannel < 16; ++nChannel)
+		pSynth->HandleMIDIShortMessage(0xB0 | nChannel | 64 << 8, nTimestamp);
+	pSynth->AllSoundOff();
+
+	DataMemBarrier();
+	m_bAudioPauseRequest = false;
+	CPUSendEvent();
+
+	// Real-time factor times 100
+	const u32 nRealTimeFactor = static_cast<u64>(nTotalFrames) * 100000000 / nSampleRate / Utility::Max(nBusyTime, static_cast<u64>(1));
+	const u32 nPeakHeapKB     = CZoneAllocator::Get()->GetStats().nPeakUsedBytes / 1024;
+
+	pLogger->Write(MT32PiName, LogNotice, "Benchmark: real-time factor %u.%02ux, %u voices before late chunks, %u peak voices, %u late chunks, heap peak %u KB",
+				   nRealTimeFactor / 100, nRealTimeFactor % 100, nMaxVoicesBeforeLate, nPeakVoices, nLateChunks, nPeakHeapKB);
+	LCDLog(TLCDLogType::Notice, "%u.%02ux %uv %u late", nRealTimeFactor / 100, nRealTimeFactor % 100, nMaxVoicesBeforeLate, nLateChunks);
+
+	// Reply: F0 7D 05 <real-time factor x100> <voices before late chunks> <peak voices> <late chunks> <heap peak KB> F7
+	const u32 Values[] = { nRealTimeFactor, nMaxVoicesBeforeLate, nPeakVoices, nLateChunks, nPeakHeapKB };
+	SendSysExValues(static_cast<u8>(TCustomSysExCommand::Benchmark), Values, Utility::ArraySize(Values));
+}
+
+void CMT32Pi::SendSysEx(const u8* pData, size_t nSize)
+{
+	// GPIO MIDI
+	if (m_bSerialMIDIEnabled)
+		m_pSerial->Write(pData, nSize);
+
+	// USB MIDI; split into event packets for cable 0
+	u8 Packets[(nSize + 2) / 3 * 4];
+	size_t nPacketsSize = 0;
+
+	for (size_t nOffset = 0; nOffset < nSize; nOffset += 3)
+	{
+		const size_t nRemaining = nSize - nOffset;
+		const size_t nBytes     = Utility::Min(nRemaining, static_cast<size_t>(3));
+		u8* pPacket             = Packets + nPacketsSize;
+
+		// CIN 0x4: SysEx starts or continues; 0x5-0x7: SysEx ends with 1-3 bytes
+		pPacket[0] = nRemaining > 3 ? 0x04 : 0x04 + nBytes;
+		pPacket[1] = pData[nOffset];
+		pPacket[2] = nBytes > 1 ? pData[nOffset + 1] : 0;
+		pPacket[3] = nBytes > 2 ? pData[nOffset + 2] : 0;
+
+		nPacketsSize += 4;
+	}
+
+	// Send to every connected device, as we don't know which one the request came from
+	for (size_t i = 0; i < MaxUSBMIDIDevices; ++i)
+	{
+		CUSBMIDIDevice* const pUSBMIDIDevice = m_pUSBMIDIDevices[i];
+		if (pUSBMIDIDevice)
+			pUSBMIDIDevice->SendEventPackets(Packets, nPacketsSize);
+	}
+}
+
 void CMT32Pi::UpdateUSB(bool bStartup)
 {
 	if (!m_pUSBHCI->UpdatePlugAndPlay())
@@ -629,6 +1677,10 @@ void CMT32Pi::UpdateUSB(bool bStartup)
 		{
 			if (!bStartup)
 			{
+				// Nothing is loading in the background (see MainTask), so any pending request is simply dropped
+				if (m_pSoundFontSynth)
+					m_pSoundFontSynth->CancelPreload();
+
 				LCDLog(TLCDLogType::Spinner, "MT-32 ROM rescan");
 				if (m_pMT32Synth)
 					m_pMT32Synth->GetROMManager().ScanROMs();
@@ -643,6 +1695,9 @@ void CMT32Pi::UpdateUSB(bool bStartup)
 
 				if (m_pSoundFontSynth)
 					LCDLog(TLCDLogType::Notice, "%d SoundFonts avail", m_pSoundFontSynth->GetSoundFontManager().GetSoundFontCount());
+
+				StopMIDIFile();
+				m_MIDIPlayer.ScanFiles();
 			}
 		}
 	}
@@ -657,40 +1712,90 @@ void CMT32Pi::UpdateUSB(bool bStartup)
 		if (m_pSoundFontSynth)
 		{
 			LCDLog(TLCDLogType::Spinner, "SoundFont rescan");
+			m_pSoundFontSynth->CancelPreload();
 			m_pSoundFontSynth->GetSoundFontManager().ScanSoundFonts();
 			LCDLog(TLCDLogType::Notice, "%d SoundFonts avail", m_pSoundFontSynth->GetSoundFontManager().GetSoundFontCount());
 		}
+
+		// The file being played or recorded may have been on the disk
+		StopMIDIFile();
+		StopRecording();
+		m_MIDIPlayer.ScanFiles();
 	}
 	m_pUSBMassStorageDevice = pUSBMassStorageDevice;
 
-	if (!m_pUSBMIDIDevice && (m_pUSBMIDIDevice = static_cast<CUSBMIDIDevice*>(CDeviceNameService::Get()->GetDevice("umidi1", FALSE))))
+	// Bind any newly attached USB MIDI devices
+	for (size_t i = 0; i < MaxUSBMIDIDevices; ++i)
 	{
-		m_pUSBMIDIDevice->RegisterRemovedHandler(USBMIDIDeviceRemovedHandler);
-		m_pUSBMIDIDevice->RegisterPacketHandler(USBMIDIPacketHandler);
-		pLogger->Write(MT32PiName, LogNotice, "Using USB MIDI interface");
+		if (m_pUSBMIDIDevices[i])
+			continue;
+
+		CString DeviceName;
+		DeviceName.Format("umidi%d", i + 1);
+
+		CUSBMIDIDevice* pUSBMIDIDevice = static_cast<CUSBMIDIDevice*>(CDeviceNameService::Get()->GetDevice(DeviceName, FALSE));
+		if (!pUSBMIDIDevice)
+			continue;
+
+		m_pUSBMIDIDevices[i] = pUSBMIDIDevice;
+		pUSBMIDIDevice->RegisterRemovedHandler(USBMIDIDeviceRemovedHandler, const_cast<CUSBMIDIDevice**>(&m_pUSBMIDIDevices[i]));
+		pUSBMIDIDevice->RegisterPacketHandler(USBMIDIPacketHandlers[i]);
+		pLogger->Write(MT32PiName, LogNotice, "Using USB MIDI interface %d", i + 1);
 		m_bSerialMIDIEnabled = false;
 	}
 }
 
-void CMT32Pi::UpdateMIDI()
+bool CMT32Pi::UpdateMIDI()
 {
-	size_t nBytes;
-	u8 Buffer[MIDIRxBufferSize];
-
-	// Read MIDI messages from serial device or ring buffer
 	if (m_bSerialMIDIEnabled)
-		nBytes = ReceiveSerialMIDI(Buffer, sizeof(Buffer));
+	{
+		// Send any software thru data left over from last time
+		UpdateSerialThru();
+
+		// Read MIDI messages from serial device
+		u8 Buffer[MIDIRxBufferSize];
+		const unsigned int nTimestamp = CTimer::GetClockTicks();
+		const size_t nBytes = ReceiveSerialMIDI(Buffer, sizeof(Buffer));
+		if (nBytes == 0)
+			return false;
+
+		m_Telemetry.CountMIDIBytes(CTelemetry::TMIDISource::GPIO, nBytes);
+
+		ParseMIDIBytes(Buffer, nBytes, nTimestamp);
+	}
 	else
-		nBytes = m_MIDIRxBuffer.Dequeue(Buffer, sizeof(Buffer));
+	{
+		// Logging and the LCD can't be used from interrupt context, so overruns are reported here
+		if (m_bMIDIRxOverrun)
+		{
+			m_bMIDIRxOverrun = false;
 
-	if (nBytes == 0)
-		return;
+			static const char* pErrorString = "MIDI overrun error!";
+			CLogger::Get()->Write(MT32PiName, LogWarning, pErrorString);
+			LCDLog(TLCDLogType::Error, pErrorString);
+		}
+
+		// Read MIDI packets from ring buffer
+		TMIDIRxPacket Packets[MIDIRxBufferSize / 8];
+		const size_t nPackets = m_MIDIRxBuffer.Dequeue(Packets, Utility::ArraySize(Packets));
+		if (nPackets == 0)
+			return false;
 
-	// Process MIDI messages
-	ParseMIDIBytes(Buffer, nBytes);
+		// Each input has its own parser, so interleaved running status or SysEx from different sources can't corrupt each other
+		for (size_t i = 0; i < nPackets; ++i)
+		{
+			const TMIDIRxPacket& Packet = Packets[i];
+			if (Packet.nInput == GPIOMIDIInput)
+				ParseMIDIBytes(Packet.Data, Packet.nSize, Packet.nTimestamp);
+			else
+				m_USBMIDIInputs[Packet.nInput - 1].ParseMIDIEventPacket(Packet.Data, Packet.nSize, Packet.nTimestamp);
+		}
+	}
 
 	// Reset the Active Sense timer
 	s_pThis->m_nActiveSenseTime = s_pThis->m_pTimer->GetTicks();
+
+	return true;
 }
 
 size_t CMT32Pi::ReceiveSerialMIDI(u8* pOutData, size_t nSize)
@@ -730,24 +1835,46 @@ size_t CMT32Pi::ReceiveSerialMIDI(u8* pOutData, size_t nSize)
 		return 0;
 	}
 
-	// Replay received MIDI data out via the serial port ('software thru')
+	// Replay received MIDI data out via the serial port ('software thru'); it's queued so that receiving never has to
+	// wait for the transmit buffer to drain
 	if (CConfig::Get()->MIDIGPIOThru)
 	{
-		int nSendResult = m_pSerial->Write(pOutData, nResult);
-		if (nSendResult != nResult)
+		const size_t nQueued = m_SerialThruBuffer.Enqueue(pOutData, nResult);
+		if (nQueued != static_cast<size_t>(nResult))
 		{
-			CLogger::Get()->Write(MT32PiName, LogWarning, "received %d bytes, but only sent %d bytes", nResult, nSendResult);
+			CLogger::Get()->Write(MT32PiName, LogWarning, "received %d bytes, but only queued %d bytes for thru", nResult, nQueued);
 			LCDLog(TLCDLogType::Error, "UART TX error!");
 		}
+
+		UpdateSerialThru();
 	}
 
 	return static_cast<size_t>(nResult);
 }
 
+void CMT32Pi::UpdateSerialThru()
+{
+	u8 Buffer[SerialThruBufferSize / 4];
+	const size_t nBytes = m_SerialThruBuffer.Peek(Buffer, sizeof(Buffer));
+	if (nBytes == 0)
+		return;
+
+	// The serial device takes as much as fits in its transmit buffer; the rest is sent next time
+	const int nSent = m_pSerial->Write(Buffer, nBytes);
+	if (nSent > 0)
+		m_SerialThruBuffer.Skip(nSent);
+}
+
 void CMT32Pi::ProcessEventQueue()
+{
+	ProcessEventQueue(m_EventQueue);
+	ProcessEventQueue(m_MisterEventQueue);
+}
+
+void CMT32Pi::ProcessEventQueue(TEventQueue& Queue)
 {
 	TEvent Buffer[EventQueueSize];
-	const size_t nEvents = m_EventQueue.Dequeue(Buffer, sizeof(Buffer));
+	const size_t nEvents = Queue.Dequeue(Buffer, Utility::ArraySize(Buffer));
 
 	// We got some events, wake up
 	if (nEvents > 0)
@@ -790,8 +1917,337 @@ void CMT32Pi::ProcessEventQueue()
 			case TEventType::Encoder:
 				SetMasterVolume(m_nMasterVolume + Event.Encoder.nDelta);
 				break;
+
+			case TEventType::MIDIPlayer:
+				ProcessMIDIPlayerEvent(Event.MIDIPlayer);
+				break;
+		}
+	}
+}
+
+void CMT32Pi::UpdatePolyphonyGovernor()
+{
+	const CRenderProfiler::TStats Stats = m_pRenderProfiler->GetStats();
+	const u32 nPreviousPolyphony = m_pPolyphonyGovernor->GetPolyphony();
+
+	if (!m_pPolyphonyGovernor->Update(Stats, m_pSoundFontSynth->GetActiveVoiceCount()))
+		return;
+
+	const u32 nPolyphony = m_pPolyphonyGovernor->GetPolyphony();
+	m_pSoundFontSynth->SetPolyphony(nPolyphony);
+	CLogger::Get()->Write(MT32PiName, LogNotice, "FluidSynth polyphony %s to %u (max load %u%%)", nPolyphony > nPreviousPolyphony ? "raised" : "lowered", nPolyphony, Stats.nMaxLoad);
+}
+
+void CMT32Pi::ThrottlePolyphony()
+{
+	if (!m_pPolyphonyGovernor)
+		return;
+
+	m_pPolyphonyGovernor->OnThrottleDetected();
+	m_pSoundFontSynth->SetPolyphony(m_pPolyphonyGovernor->GetPolyphony());
+	CLogger::Get()->Write(MT32PiName, LogWarning, "CPU throttled; FluidSynth polyphony lowered to %u", m_pPolyphonyGovernor->GetPolyphony());
+}
+
+void CMT32Pi::ApplyThrottleLevel()
+{
+	using TLevel = CThrottlePolicy::TLevel;
+
+	const TLevel Level = m_ThrottlePolicy.GetLevel();
+	ApplyQualitySettings();
+
+	static const char* const LevelNames[] = { "full", "reduced resampler", "no effects" };
+	CLogger::Get()->Write(MT32PiName, LogWarning, "Throttle quality level: %s", LevelNames[static_cast<size_t>(Level)]);
+	LCDLog(TLCDLogType::Notice, Level == TLevel::Full ? "Quality restored" : "Quality reduced");
+}
+
+void CMT32Pi::ApplyQualitySettings()
+{
+	using TLevel = CThrottlePolicy::TLevel;
+
+	CConfig* const pConfig = CConfig::Get();
+	const TLevel Level     = m_ThrottlePolicy.GetLevel();
+
+	// Drop to the next cheapest resampler; none is left alone as it only sounds right at the native rate
+	if (m_pMT32Synth)
+	{
+		CMT32Synth::TResamplerQuality Quality = pConfig->MT32EmuResamplerQuality;
+		if (Level != TLevel::Full)
+		{
+			switch (Quality)
+			{
+				case CMT32Synth::TResamplerQuality::Best:
+					Quality = CMT32Synth::TResamplerQuality::Good;
+					break;
+
+				case CMT32Synth::TResamplerQuality::Good:
+					Quality = CMT32Synth::TResamplerQuality::Fast;
+					break;
+
+				case CMT32Synth::TResamplerQuality::Fast:
+				case CMT32Synth::TResamplerQuality::Polyphase:
+					Quality = CMT32Synth::TResamplerQuality::Fastest;
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		m_pMT32Synth->SetResamplerQuality(Quality);
+	}
+
+	if (m_pSoundFontSynth)
+	{
+		m_pSoundFontSynth->SetEffectsEnabled(Level != TLevel::NoEffects);
+
+		// The governor raises polyphony again by itself once rendering has headroom
+		if (m_pPolyphonyGovernor)
+		{
+			if (Level != TLevel::Full)
+				ThrottlePolyphony();
+		}
+		else
+		{
+			const u32 nPolyphony = pConfig->FluidSynthPolyphony;
+			m_pSoundFontSynth->SetPolyphony(Level == TLevel::Full ? nPolyphony : Level == TLevel::ReducedResampler ? nPolyphony * 3 / 4 : nPolyphony / 2);
+		}
+	}
+}
+
+void CMT32Pi::ReloadConfig()
+{
+	CConfig* const pConfig = CConfig::Get();
+	CLogger* const pLogger = CLogger::Get();
+
+	// Nothing else should use the file system while the file is being read; try again once a background load has finished
+	if (m_pSoundFontSynth && !m_pSoundFontSynth->CancelPreload())
+	{
+		m_bDeferredConfigReloadFlag = true;
+		return;
+	}
+
+	// Options missing from the file fall back to their defaults, as they would after a reboot
+	CConfig NewConfig;
+	if (!NewConfig.Initialize(CConfig::FileName))
+	{
+		pLogger->Write(MT32PiName, LogError, "Couldn't reload config file");
+		LCDLog(TLCDLogType::Error, "Config reload failed!");
+		return;
+	}
+
+	pLogger->Write(MT32PiName, LogNotice, "Reloading config file");
+
+	// Read whenever they're needed
+	pConfig->SystemIdleWait       = NewConfig.SystemIdleWait;
+	pConfig->ControlSwitchTimeout = NewConfig.ControlSwitchTimeout;
+	pConfig->LCDShowBootTime      = NewConfig.LCDShowBootTime;
+
+	// Render statistics are only gathered if something needed them at boot
+	if (m_pRenderProfiler)
+	{
+		pConfig->AudioProfiler   = NewConfig.AudioProfiler;
+		pConfig->SystemTelemetry = NewConfig.SystemTelemetry;
+		if (m_pLCD)
+			m_pLCD->SetRenderProfiler(pConfig->AudioProfiler ? m_pRenderProfiler : nullptr);
+	}
+
+	if (NewConfig.SystemPowerSaveTimeout != pConfig->SystemPowerSaveTimeout)
+	{
+		pConfig->SystemPowerSaveTimeout = NewConfig.SystemPowerSaveTimeout;
+		SetPowerSaveTimeout(pConfig->SystemPowerSaveTimeout);
+	}
+
+	if (NewConfig.SystemSwitchFadeTime != pConfig->SystemSwitchFadeTime)
+	{
+		pConfig->SystemSwitchFadeTime      = NewConfig.SystemSwitchFadeTime;
+		const unsigned int nSwitchFadeTime = Utility::Clamp(pConfig->SystemSwitchFadeTime, 0, 5000);
+		m_nSwitchFadeFrames                = static_cast<u64>(nSwitchFadeTime) * pConfig->AudioSampleRate / 1000;
+	}
+
+	if (NewConfig.MIDIPlayerAutoplay != pConfig->MIDIPlayerAutoplay)
+	{
+		pConfig->MIDIPlayerAutoplay = NewConfig.MIDIPlayerAutoplay;
+		m_bMIDIPlayerAutoplay       = pConfig->MIDIPlayerAutoplay;
+	}
+
+	if (NewConfig.MT32EmuGain != pConfig->MT32EmuGain || NewConfig.MT32EmuReverbGain != pConfig->MT32EmuReverbGain)
+	{
+		pConfig->MT32EmuGain       = NewConfig.MT32EmuGain;
+		pConfig->MT32EmuReverbGain = NewConfig.MT32EmuReverbGain;
+		if (m_pMT32Synth)
+			m_pMT32Synth->SetGain(pConfig->MT32EmuGain, pConfig->MT32EmuReverbGain);
+	}
+
+	if (NewConfig.MT32EmuMIDIChannels != pConfig->MT32EmuMIDIChannels)
+	{
+		pConfig->MT32EmuMIDIChannels = NewConfig.MT32EmuMIDIChannels;
+		if (m_pMT32Synth)
+			m_pMT32Synth->SetMIDIChannels(pConfig->MT32EmuMIDIChannels);
+		if (m_bLayering)
+			m_nMT32ChannelMask = pConfig->MT32EmuMIDIChannels == CConfig::TMT32EmuMIDIChannels::Standard ? 0x03FE : 0x02FF;
+	}
+
+	if (NewConfig.FluidSynthGain != pConfig->FluidSynthGain)
+	{
+		pConfig->FluidSynthGain = NewConfig.FluidSynthGain;
+		if (m_pSoundFontSynth)
+			m_pSoundFontSynth->SetGain(pConfig->FluidSynthGain);
+	}
+
+	// Turning culling on or off also changes FluidSynth's voice stealing priorities, which are only read from the settings
+	// by a newly created synth; a settings change wouldn't reach every instance
+	const bool bVoiceCullingToggled = !NewConfig.FluidSynthVoiceCullFloor != !pConfig->FluidSynthVoiceCullFloor;
+	if (NewConfig.FluidSynthVoiceCullFloor != pConfig->FluidSynthVoiceCullFloor && !bVoiceCullingToggled)
+	{
+		pConfig->FluidSynthVoiceCullFloor = NewConfig.FluidSynthVoiceCullFloor;
+		if (m_pSoundFontSynth)
+			m_pSoundFontSynth->SetVoiceCullFloor(pConfig->FluidSynthVoiceCullFloor);
+	}
+
+	// Applied on top of any reduction for throttling; automatic polyphony has its own limit
+	const bool bPolyphonyChanged = !m_pPolyphonyGovernor && NewConfig.FluidSynthPolyphony != pConfig->FluidSynthPolyphony;
+	if (NewConfig.MT32EmuResamplerQuality != pConfig->MT32EmuResamplerQuality || bPolyphonyChanged)
+	{
+		pConfig->MT32EmuResamplerQuality = NewConfig.MT32EmuResamplerQuality;
+		if (bPolyphonyChanged)
+			pConfig->FluidSynthPolyphony = NewConfig.FluidSynthPolyphony;
+		ApplyQualitySettings();
+	}
+
+	// New startup selections are switched to, just as they'd be selected by a reboot
+	if (NewConfig.MT32EmuROMSet != pConfig->MT32EmuROMSet)
+	{
+		pConfig->MT32EmuROMSet = NewConfig.MT32EmuROMSet;
+		if (pConfig->MT32EmuROMSet < TMT32ROMSet::Any)
+			SwitchMT32ROMSet(pConfig->MT32EmuROMSet);
+	}
+
+	if (NewConfig.FluidSynthSoundFont != pConfig->FluidSynthSoundFont)
+	{
+		pConfig->FluidSynthSoundFont = NewConfig.FluidSynthSoundFont;
+		SwitchSoundFont(pConfig->FluidSynthSoundFont);
+	}
+
+	if (NewConfig.SystemDefaultSynth != pConfig->SystemDefaultSynth)
+	{
+		pConfig->SystemDefaultSynth = NewConfig.SystemDefaultSynth;
+		SwitchSynth(pConfig->SystemDefaultSynth == CConfig::TSystemDefaultSynth::MT32 ? TSynth::MT32 : TSynth::SoundFont);
+	}
+
+	if (NewConfig.LCDType != pConfig->LCDType || NewConfig.LCDWidth != pConfig->LCDWidth || NewConfig.LCDHeight != pConfig->LCDHeight ||
+		NewConfig.LCDI2CLCDAddress != pConfig->LCDI2CLCDAddress || NewConfig.LCDRotation != pConfig->LCDRotation)
+	{
+		pConfig->LCDType          = NewConfig.LCDType;
+		pConfig->LCDWidth         = NewConfig.LCDWidth;
+		pConfig->LCDHeight        = NewConfig.LCDHeight;
+		pConfig->LCDI2CLCDAddress = NewConfig.LCDI2CLCDAddress;
+		pConfig->LCDRotation      = NewConfig.LCDRotation;
+		ReinitLCD();
+	}
+
+	// Everything else stays as it was set up at boot until the next reboot
+	size_t nRebootOptions = 0;
+	const char* pSection  = nullptr;
+
+	#define BEGIN_SECTION(SECTION) pSection = #SECTION;
+
+	#define CFG(INI_NAME, _1, MEMBER_NAME, ...)                                                                         \
+		if (NewConfig.MEMBER_NAME != pConfig->MEMBER_NAME)                                                              \
+		{                                                                                                               \
+			pLogger->Write(MT32PiName, LogWarning, "Change to '%s' option '%s' needs a reboot", pSection, #INI_NAME); \
+			++nRebootOptions;                                                                                           \
 		}
+
+	#include "config.def"
+
+	if (nRebootOptions)
+		LCDLog(TLCDLogType::Warning, "Reboot to apply all");
+	else
+		LCDLog(TLCDLogType::Notice, "Config reloaded");
+}
+
+void CMT32Pi::ReinitLCD()
+{
+	// Take over the display and the I2C bus from the UI task
+	m_bUIPauseRequest = true;
+	CPUSendEvent();
+	while (!m_bUIPaused && m_bRunning)
+		;
+	DataMemBarrier();
+
+	// The synths have to let go of the old display before it's deleted
+	if (m_pMT32Synth)
+		m_pMT32Synth->SetLCD(nullptr);
+	if (m_pSoundFontSynth)
+		m_pSoundFontSynth->SetLCD(nullptr);
+
+	if (m_pLCD)
+	{
+		m_pLCD->Clear();
+		delete m_pLCD;
 	}
+
+	m_pLCD = CreateLCD();
+	if (m_pLCD && CConfig::Get()->AudioProfiler)
+		m_pLCD->SetRenderProfiler(m_pRenderProfiler);
+
+	if (m_pMT32Synth)
+		m_pMT32Synth->SetLCD(m_pLCD);
+	if (m_pSoundFontSynth)
+		m_pSoundFontSynth->SetLCD(m_pLCD);
+
+	DataMemBarrier();
+	m_bUIPauseRequest = false;
+	CPUSendEvent();
+}
+
+void CMT32Pi::LogRenderStats()
+{
+	const CRenderProfiler::TStats Stats = m_pRenderProfiler->GetStats();
+	const u32* pLate = Stats.nLateChunks;
+	const u32* pThresholds = CRenderProfiler::LateChunkThresholds;
+
+	CLogger* const pLogger = CLogger::Get();
+	pLogger->Write(MT32PiName, LogNotice, "DSP load: min %u%%, avg %u%% (PCM conversion %u%%), max %u%%; %u voices",
+				   Stats.nMinLoad, Stats.nAvgLoad, Stats.nAvgConversionLoad, Stats.nMaxLoad, m_pCurrentSynth->GetActiveVoiceCount());
+	pLogger->Write(MT32PiName, LogNotice, "Late chunks: %u%%+: %u, %u%%+: %u, %u%%+: %u, %u%%+: %u, %u%%+: %u (of %u); %u underruns, %u dropped",
+				   pThresholds[0], pLate[0], pThresholds[1], pLate[1], pThresholds[2], pLate[2], pThresholds[3], pLate[3], pThresholds[4], pLate[4],
+				   Stats.nChunks, Stats.nUnderruns, Stats.nDroppedChunks);
+	pLogger->Write(MT32PiName, LogNotice, "Real-time factor: %u.%02ux (%u.%02ux since startup); peak %u voices",
+				   Stats.nRealTimeFactor / 100, Stats.nRealTimeFactor % 100, Stats.nTotalRealTimeFactor / 100, Stats.nTotalRealTimeFactor % 100, Stats.nPeakVoices);
+	CZoneAllocator::Get()->LogStats();
+}
+
+void CMT32Pi::SendTelemetry()
+{
+	const CRenderProfiler::TStats RenderStats = m_pRenderProfiler->GetStats();
+	const CZoneAllocator::TStats HeapStats    = CZoneAllocator::Get()->GetStats();
+
+	CTelemetry::TRecord Record;
+
+	Record.nAvgLoad       = Utility::Min(RenderStats.nAvgLoad, 0xFFFFu);
+	Record.nMaxLoad       = Utility::Min(RenderStats.nMaxLoad, 0xFFFFu);
+	Record.nChunks        = RenderStats.nChunks;
+	Record.nLateChunks    = 0;
+	Record.nUnderruns     = RenderStats.nUnderruns;
+	Record.nDroppedChunks = RenderStats.nDroppedChunks;
+	for (size_t i = 0; i < CRenderProfiler::LateChunkBuckets; ++i)
+		Record.nLateChunks += RenderStats.nLateChunks[i];
+
+	Record.nMIDIRxHighWaterMark           = m_MIDIRxBuffer.TakeHighWaterMark();
+	Record.nEventQueueHighWaterMark       = m_EventQueue.TakeHighWaterMark();
+	Record.nMisterEventQueueHighWaterMark = m_MisterEventQueue.TakeHighWaterMark();
+
+	Record.nMT32Partials       = m_pMT32Synth ? m_pMT32Synth->GetActiveVoiceCount() : 0;
+	Record.nSoundFontVoices    = m_pSoundFontSynth ? m_pSoundFontSynth->GetActiveVoiceCount() : 0;
+	Record.nSoundFontPolyphony = m_pSoundFontSynth ? m_pSoundFontSynth->GetPolyphony() : 0;
+
+	Record.nHeapUsed             = HeapStats.nUsedBytes / 1024;
+	Record.nHeapPeakUsed         = HeapStats.nPeakUsedBytes / 1024;
+	Record.nHeapFluidSynthUsed   = HeapStats.nTagUsedBytes[TZoneTag::FluidSynth] / 1024;
+	Record.nHeapLargestFreeBlock = HeapStats.nLargestFreeBlock / 1024;
+
+	m_Telemetry.Send(Record);
 }
 
 void CMT32Pi::ProcessButtonEvent(const TButtonEvent& Event)
@@ -853,6 +2309,28 @@ void CMT32Pi::ProcessButtonEvent(const TButtonEvent& Event)
 	}
 }
 
+void CMT32Pi::ProcessMIDIPlayerEvent(const TMIDIPlayerEvent& Event)
+{
+	switch (Event.Action)
+	{
+		case TMIDIPlayerAction::Play:
+			PlayMIDIFile(Event.Index);
+			break;
+
+		case TMIDIPlayerAction::Stop:
+			StopMIDIFile();
+			break;
+
+		case TMIDIPlayerAction::Next:
+			SkipMIDIFile(true);
+			break;
+
+		case TMIDIPlayerAction::Previous:
+			SkipMIDIFile(false);
+			break;
+	}
+}
+
 void CMT32Pi::SwitchSynth(TSynth NewSynth)
 {
 	CSynthBase* pNewSynth = nullptr;
@@ -864,6 +2342,14 @@ void CMT32Pi::SwitchSynth(TSynth NewSynth)
 
 	if (pNewSynth == nullptr)
 	{
+		// Switch once it has finished initializing
+		if (m_bBackgroundInitPending && NewSynth == m_BackgroundSynth)
+		{
+			m_bDeferredSynthSwitchFlag = true;
+			LCDLog(TLCDLogType::Notice, "Synth starting...");
+			return;
+		}
+
 		LCDLog(TLCDLogType::Warning, "Synth unavailable!");
 		return;
 	}
@@ -874,8 +2360,42 @@ void CMT32Pi::SwitchSynth(TSynth NewSynth)
 		return;
 	}
 
-	m_pCurrentSynth->AllSoundOff();
-	m_pCurrentSynth = pNewSynth;
+	// Both synths keep playing when layered; only the display and controls switch over
+	if (m_bLayering)
+	{
+		m_FadeLock.Acquire();
+		m_pCurrentSynth = pNewSynth;
+		m_FadeLock.Release();
+	}
+	else if (m_nSwitchFadeFrames)
+	{
+		// Release held notes and let the audio task fade out what's left
+		for (u8 nChannel = 0; nChannel < 16; ++nChannel)
+		{
+			m_pCurrentSynth->HandleMIDIShortMessage(0x40B0 | nChannel, 0);
+			m_pCurrentSynth->HandleMIDIShortMessage(0x7BB0 | nChannel, 0);
+		}
+
+		m_FadeLock.Acquire();
+		CSynthBase* const pDroppedSynth = m_pFadingSynth;
+		m_pFadingSynth  = m_pCurrentSynth;
+		m_bFadeRestart  = true;
+		m_pCurrentSynth = pNewSynth;
+		m_FadeLock.Release();
+
+		// A fade still in progress is cut short rather than having its tails jump back to full gain
+		if (pDroppedSynth)
+			pDroppedSynth->AllSoundOff();
+	}
+	else
+	{
+		m_pCurrentSynth->AllSoundOff();
+
+		m_FadeLock.Acquire();
+		m_pCurrentSynth = pNewSynth;
+		m_FadeLock.Release();
+	}
+
 	const char* pMode = NewSynth == TSynth::MT32 ? "MT-32 mode" : "SoundFont mode";
 	CLogger::Get()->Write(MT32PiName, LogNotice, "Switching to %s", pMode);
 	LCDLog(TLCDLogType::Notice, pMode);
@@ -907,9 +2427,18 @@ void CMT32Pi::SwitchSoundFont(size_t nIndex)
 	if (m_pSoundFontSynth == nullptr)
 		return;
 
+	// The other synth may still be reading its ROMs; switch once it has finished
+	if (m_bBackgroundInitPending)
+	{
+		DeferSwitchSoundFont(nIndex);
+		return;
+	}
+
 	CLogger::Get()->Write(MT32PiName, LogNotice, "Switching to SoundFont %d", nIndex);
 	if (m_pSoundFontSynth->SwitchSoundFont(nIndex) && m_pCurrentSynth == m_pSoundFontSynth)
 		m_pSoundFontSynth->ReportStatus();
+
+	CZoneAllocator::Get()->LogStats();
 }
 
 void CMT32Pi::DeferSwitchSoundFont(size_t nIndex)
@@ -937,6 +2466,98 @@ void CMT32Pi::SetMasterVolume(s32 nVolume)
 		LCDLog(TLCDLogType::Notice, "Volume: %d", m_nMasterVolume);
 }
 
+void CMT32Pi::PlayMIDIFile(size_t nIndex)
+{
+	// The other synth may still be reading its ROMs or SoundFonts
+	if (m_bBackgroundInitPending)
+	{
+		CLogger::Get()->Write(MT32PiName, LogWarning, "Can't play MIDI files until initialization has finished");
+		return;
+	}
+
+	// Nothing else should use the file system while the file is being read; play it once a background load has finished
+	if (m_pSoundFontSynth && !m_pSoundFontSynth->CancelPreload())
+	{
+		m_nDeferredMIDIFileIndex = nIndex;
+		m_bDeferredMIDIFileFlag  = true;
+		return;
+	}
+
+	if (m_pSoundFontSynth)
+		m_pSoundFontSynth->AllSoundOff();
+	if (m_pMT32Synth)
+		m_pMT32Synth->AllSoundOff();
+
+	if (!m_MIDIPlayer.Play(nIndex))
+	{
+		// Don't keep retrying a bad file
+		m_bMIDIPlayerAutoplay = false;
+		LCDLog(TLCDLogType::Error, "MIDI file error!");
+		return;
+	}
+
+	LCDLog(TLCDLogType::Notice, "%s", m_MIDIPlayer.GetFileName(nIndex));
+}
+
+void CMT32Pi::StopMIDIFile()
+{
+	m_bMIDIPlayerAutoplay   = false;
+	m_bDeferredMIDIFileFlag = false;
+
+	if (!m_MIDIPlayer.IsPlaying())
+		return;
+
+	m_MIDIPlayer.Stop();
+
+	if (m_pMT32Synth)
+		m_pMT32Synth->AllSoundOff();
+	if (m_pSoundFontSynth)
+		m_pSoundFontSynth->AllSoundOff();
+
+	LCDLog(TLCDLogType::Notice, "MIDI file stopped");
+}
+
+void CMT32Pi::SkipMIDIFile(bool bForward)
+{
+	const size_t nFiles = m_MIDIPlayer.GetFileCount();
+	if (!nFiles)
+		return;
+
+	const size_t nIndex = m_MIDIPlayer.GetFileIndex();
+	PlayMIDIFile(bForward ? (nIndex + 1) % nFiles : (nIndex + nFiles - 1) % nFiles);
+}
+
+void CMT32Pi::StartRecording(const char* pDisk)
+{
+	// Nothing else should use the file system while the recording is being written
+	if (m_bBackgroundInitPending)
+	{
+		CLogger::Get()->Write(MT32PiName, LogWarning, "Can't record until initialization has finished");
+		return;
+	}
+
+	if (m_pSoundFontSynth && !m_pSoundFontSynth->CancelPreload())
+	{
+		CLogger::Get()->Write(MT32PiName, LogWarning, "Can't record while a SoundFont is loading");
+		return;
+	}
+
+	const bool b24Bit = CConfig::Get()->AudioOutputDevice == CConfig::TAudioOutputDevice::I2SDAC;
+	if (m_WAVRecorder.Start(pDisk, CConfig::Get()->AudioSampleRate, b24Bit))
+		LCDLog(TLCDLogType::Notice, "Recording...");
+	else
+		LCDLog(TLCDLogType::Error, "Recording failed!");
+}
+
+void CMT32Pi::StopRecording()
+{
+	if (!m_WAVRecorder.IsRecording())
+		return;
+
+	m_WAVRecorder.Stop();
+	LCDLog(TLCDLogType::Notice, "Recording stopped");
+}
+
 void CMT32Pi::LEDOn()
 {
 	m_pActLED->On();
@@ -1004,11 +2625,33 @@ void CMT32Pi::EventHandler(const TEvent& Event)
 	s_pThis->m_EventQueue.Enqueue(Event);
 }
 
+// The following handlers are called from interrupt context, enqueue into ring buffer for main thread
+// Each USB MIDI device gets its own instance of the packet handler
+template <size_t N>
+void CMT32Pi::USBMIDIPacketHandler(unsigned nCable, u8* pPacket, unsigned nLength)
+{
+	EnqueueMIDIData(1 + N * USBMIDICables + (nCable % USBMIDICables), pPacket, nLength);
+}
+
+TMIDIPacketHandler* const CMT32Pi::USBMIDIPacketHandlers[MaxUSBMIDIDevices] =
+{
+	USBMIDIPacketHandler<0>,
+	USBMIDIPacketHandler<1>,
+	USBMIDIPacketHandler<2>,
+	USBMIDIPacketHandler<3>,
+};
+
 void CMT32Pi::USBMIDIDeviceRemovedHandler(CDevice* pDevice, void* pContext)
 {
 	assert(s_pThis != nullptr);
 
-	s_pThis->m_pUSBMIDIDevice = nullptr;
+	*static_cast<CUSBMIDIDevice**>(pContext) = nullptr;
+
+	for (size_t i = 0; i < MaxUSBMIDIDevices; ++i)
+	{
+		if (s_pThis->m_pUSBMIDIDevices[i])
+			return;
+	}
 
 	// Re-enable serial MIDI if not in-use by logger and not using Pisound
 	if (s_pThis->m_bSerialMIDIAvailable && !s_pThis->m_pPisound)
@@ -1018,21 +2661,43 @@ void CMT32Pi::USBMIDIDeviceRemovedHandler(CDevice* pDevice, void* pContext)
 	}
 }
 
-// The following handlers are called from interrupt context, enqueue into ring buffer for main thread
-void CMT32Pi::USBMIDIPacketHandler(unsigned nCable, u8* pPacket, unsigned nLength)
+void CMT32Pi::MIDIReceiveHandler(const u8* pData, size_t nSize)
 {
-	MIDIReceiveHandler(pPacket, nLength);
+	EnqueueMIDIData(GPIOMIDIInput, pData, nSize);
 }
 
-void CMT32Pi::MIDIReceiveHandler(const u8* pData, size_t nSize)
+void CMT32Pi::SoundNeedDataHandler(void* pParam)
+{
+	CMT32Pi* const pThis = static_cast<CMT32Pi*>(pParam);
+
+	// Wake the audio task on core 2
+	pThis->m_bSoundDataNeeded = true;
+	CPUSendEvent();
+}
+
+void CMT32Pi::EnqueueMIDIData(u8 nInput, const u8* pData, size_t nSize)
 {
 	assert(s_pThis != nullptr);
 
-	// Enqueue data into ring buffer
-	if (s_pThis->m_MIDIRxBuffer.Enqueue(pData, nSize) != nSize)
+	TMIDIRxPacket Packet;
+	Packet.nTimestamp = CTimer::GetClockTicks();
+	Packet.nInput     = nInput;
+
+	s_pThis->m_Telemetry.CountMIDIBytes(nInput == GPIOMIDIInput ? CTelemetry::TMIDISource::GPIO : CTelemetry::TMIDISource::USB, nSize);
+
+	// Split data into packets and enqueue into ring buffer
+	while (nSize)
 	{
-		static const char* pErrorString = "MIDI overrun error!";
-		CLogger::Get()->Write(MT32PiName, LogWarning, pErrorString);
-		s_pThis->LCDLog(TLCDLogType::Error, pErrorString);
+		Packet.nSize = Utility::Min(nSize, sizeof(Packet.Data));
+		memcpy(Packet.Data, pData, Packet.nSize);
+
+		if (!s_pThis->m_MIDIRxBuffer.Enqueue(Packet))
+		{
+			s_pThis->m_Telemetry.CountMIDIOverrun();
+			s_pThis->m_bMIDIRxOverrun = true;
+		}
+
+		pData += Packet.nSize;
+		nSize -= Packet.nSize;
 	}
 }
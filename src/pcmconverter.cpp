@@ -0,0 +1,182 @@
+//
+// pcmconverter.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PCM_CONVERTER_NEON
+#endif
+
+#include <circle/util.h>
+
+#include "pcmconverter.h"
+#include "utility.h"
+
+constexpr float Sample16BitMax = (1 << 16 - 1) - 1;
+constexpr float Sample24BitMax = (1 << 24 - 1) - 1;
+
+// Scales the top 24 bits of a random number into [0.0, 1.0)
+constexpr float RandomScale = 1.0f / (1 << 24);
+
+// Arbitrary non-zero seeds, one per lane
+const u32 DitherSeeds[] = { 0x6B8B4567, 0x327B23C6, 0x643C9869, 0x66334873 };
+
+namespace
+{
+	// Byte-wise accesses, which may alias samples of any type
+	template <class T>
+	inline T LoadSample(const T* pBuffer, size_t nIndex)
+	{
+		T Sample;
+		memcpy(&Sample, pBuffer + nIndex, sizeof(T));
+		return Sample;
+	}
+
+	template <class T>
+	inline void StoreSample(T* pBuffer, size_t nIndex, T Sample)
+	{
+		memcpy(pBuffer + nIndex, &Sample, sizeof(T));
+	}
+
+	// xorshift32 pseudo-random number generator
+	inline u32 NextRandom(u32& nState)
+	{
+		nState ^= nState << 13;
+		nState ^= nState >> 17;
+		nState ^= nState << 5;
+		return nState;
+	}
+
+	inline float TPDFDither(u32& nState)
+	{
+		const float nA = (NextRandom(nState) >> 8) * RandomScale;
+		const float nB = (NextRandom(nState) >> 8) * RandomScale;
+		return nA - nB;
+	}
+
+#ifdef PCM_CONVERTER_NEON
+	inline uint32x4_t NextRandom(uint32x4_t State)
+	{
+		State = veorq_u32(State, vshlq_n_u32(State, 13));
+		State = veorq_u32(State, vshrq_n_u32(State, 17));
+		State = veorq_u32(State, vshlq_n_u32(State, 5));
+		return State;
+	}
+
+	inline float32x4_t ToUnitFloat(uint32x4_t Random)
+	{
+		return vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(Random, 8)), RandomScale);
+	}
+
+	// Byte vector loads and stores, for the same reason as above
+	inline float32x4_t LoadSamples(const float* pBuffer)
+	{
+		return vreinterpretq_f32_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(pBuffer)));
+	}
+
+	inline void StoreSamples(s32* pBuffer, int32x4_t Samples)
+	{
+		vst1q_u8(reinterpret_cast<uint8_t*>(pBuffer), vreinterpretq_u8_s32(Samples));
+	}
+
+	inline void StoreSamples(s16* pBuffer, int16x8_t Samples)
+	{
+		vst1q_u8(reinterpret_cast<uint8_t*>(pBuffer), vreinterpretq_u8_s16(Samples));
+	}
+#endif
+}
+
+CPCMConverter::CPCMConverter(bool bDither)
+	: m_bDither(bDither)
+{
+	for (size_t i = 0; i < DitherLanes; ++i)
+		m_DitherState[i] = DitherSeeds[i];
+}
+
+void CPCMConverter::ConvertS24(const float* pInBuffer, s32* pOutBuffer, size_t nSamples) const
+{
+	size_t i = 0;
+
+#ifdef PCM_CONVERTER_NEON
+	const float32x4_t Min = vdupq_n_f32(-1.0f);
+	const float32x4_t Max = vdupq_n_f32(1.0f);
+
+	for (; i + 4 <= nSamples; i += 4)
+	{
+		float32x4_t Samples = LoadSamples(pInBuffer + i);
+		Samples = vminq_f32(vmaxq_f32(Samples, Min), Max);
+		StoreSamples(pOutBuffer + i, vcvtq_s32_f32(vmulq_n_f32(Samples, Sample24BitMax)));
+	}
+#endif
+
+	for (; i < nSamples; ++i)
+		StoreSample<s32>(pOutBuffer, i, Utility::Clamp(LoadSample(pInBuffer, i), -1.0f, 1.0f) * Sample24BitMax);
+}
+
+void CPCMConverter::ConvertS16(const float* pInBuffer, s16* pOutBuffer, size_t nSamples)
+{
+	size_t i = 0;
+
+#ifdef PCM_CONVERTER_NEON
+	const float32x4_t Min = vdupq_n_f32(-1.0f);
+	const float32x4_t Max = vdupq_n_f32(1.0f);
+	uint32x4_t DitherState = vld1q_u32(reinterpret_cast<const uint32_t*>(m_DitherState));
+
+	for (; i + 8 <= nSamples; i += 8)
+	{
+		float32x4_t SamplesLow  = LoadSamples(pInBuffer + i);
+		float32x4_t SamplesHigh = LoadSamples(pInBuffer + i + 4);
+
+		SamplesLow  = vmulq_n_f32(vminq_f32(vmaxq_f32(SamplesLow, Min), Max), Sample16BitMax);
+		SamplesHigh = vmulq_n_f32(vminq_f32(vmaxq_f32(SamplesHigh, Min), Max), Sample16BitMax);
+
+		if (m_bDither)
+		{
+			uint32x4_t RandomA = NextRandom(DitherState);
+			uint32x4_t RandomB = NextRandom(RandomA);
+			SamplesLow = vaddq_f32(SamplesLow, vsubq_f32(ToUnitFloat(RandomA), ToUnitFloat(RandomB)));
+
+			RandomA = NextRandom(RandomB);
+			RandomB = NextRandom(RandomA);
+			SamplesHigh = vaddq_f32(SamplesHigh, vsubq_f32(ToUnitFloat(RandomA), ToUnitFloat(RandomB)));
+
+			DitherState = RandomB;
+		}
+
+		// Saturating narrow catches any dithered samples that went out of range
+		const int16x4_t OutLow  = vqmovn_s32(vcvtq_s32_f32(SamplesLow));
+		const int16x4_t OutHigh = vqmovn_s32(vcvtq_s32_f32(SamplesHigh));
+		StoreSamples(pOutBuffer + i, vcombine_s16(OutLow, OutHigh));
+	}
+
+	vst1q_u32(reinterpret_cast<uint32_t*>(m_DitherState), DitherState);
+#endif
+
+	for (; i < nSamples; ++i)
+	{
+		float nSample = Utility::Clamp(LoadSample(pInBuffer, i), -1.0f, 1.0f) * Sample16BitMax;
+
+		if (m_bDither)
+			nSample = Utility::Clamp(nSample + TPDFDither(m_DitherState[i % DitherLanes]), -Sample16BitMax - 1, Sample16BitMax);
+
+		StoreSample<s16>(pOutBuffer, i, nSample);
+	}
+}
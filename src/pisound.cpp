@@ -33,6 +33,9 @@ constexpr u8 SPIDelayMicroseconds = 10;
 constexpr u32 SPIClockSpeed       = 150000;
 constexpr u8 SPITransferSize      = 4;
 
+// MIDI bytes collected from consecutive SPI transfers before being passed on
+constexpr size_t MIDIBlockSize = 32;
+
 constexpr u8 GPIOButton = 17;
 
 constexpr u8 GPIOADCReset           = 12;
@@ -230,11 +233,11 @@ void CPisound::DataAvailableInterruptHandler(void* pUserData)
 	CPisound* pThis = static_cast<CPisound*>(pUserData);
 	assert(pThis && pThis->m_pReceiveHandler);
 
+	size_t nMIDIBytes = 0;
+	u8 MIDIBuffer[MIDIBlockSize];
+
 	do
 	{
-		size_t nMIDIBytes = 0;
-		u8 MIDIBuffer[SPITransferSize / 2];
-
 		u8 RxBuffer[SPITransferSize];
 		memset(RxBuffer, 0, sizeof(RxBuffer));
 
@@ -246,8 +249,15 @@ void CPisound::DataAvailableInterruptHandler(void* pUserData)
 				MIDIBuffer[nMIDIBytes++] = RxBuffer[i + 1];
 		}
 
-		// Pass MIDI bytes on to handler
-		if (nMIDIBytes)
+		// Pass MIDI bytes on to handler once there's no room for another packet's worth
+		if (nMIDIBytes > sizeof(MIDIBuffer) - SPITransferSize / 2)
+		{
 			pThis->m_pReceiveHandler(MIDIBuffer, nMIDIBytes);
+			nMIDIBytes = 0;
+		}
 	} while (pThis->m_DataAvailable.Read() == HIGH);
+
+	// Pass on whatever is left once the Pisound has nothing more to send
+	if (nMIDIBytes)
+		pThis->m_pReceiveHandler(MIDIBuffer, nMIDIBytes);
 }
@@ -0,0 +1,99 @@
+//
+// polyphonygovernor.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <circle/timer.h>
+
+#include "polyphonygovernor.h"
+#include "utility.h"
+
+CPolyphonyGovernor::CPolyphonyGovernor(u32 nMaxPolyphony)
+	: m_nMaxPolyphony(Utility::Max(nMaxPolyphony, MinPolyphony)),
+	  m_nPolyphony(m_nMaxPolyphony),
+
+	  m_nLastChunks(0),
+	  m_nLastLateChunks(0),
+	  m_nQuietWindows(0),
+
+	  m_bThrottled(false),
+	  m_nThrottleTime(0)
+{
+}
+
+bool CPolyphonyGovernor::Update(const CRenderProfiler::TStats& Stats, u32 nActiveVoices)
+{
+	// Only act once per measurement window
+	if (Stats.nChunks == m_nLastChunks)
+		return false;
+
+	u32 nLateChunks = 0;
+	for (size_t i = 0; i < CRenderProfiler::LateChunkBuckets; ++i)
+		nLateChunks += Stats.nLateChunks[i];
+
+	const bool bMissedDeadline = nLateChunks != m_nLastLateChunks;
+	const u32 nPreviousPolyphony = m_nPolyphony;
+
+	m_nLastChunks     = Stats.nChunks;
+	m_nLastLateChunks = nLateChunks;
+
+	if (m_bThrottled && (CTimer::Get()->GetTicks() - m_nThrottleTime) >= MSEC2HZ(ThrottleHoldMillis))
+		m_bThrottled = false;
+
+	// Back off hard if we're already too late, and gently if we're getting close
+	if (bMissedDeadline)
+	{
+		Lower(4);
+		m_nQuietWindows = 0;
+	}
+	else if (Stats.nMaxLoad >= HighLoadThreshold)
+	{
+		Lower(8);
+		m_nQuietWindows = 0;
+	}
+
+	// Only raise the limit if it's actually being reached
+	else if (Stats.nMaxLoad < LowLoadThreshold && nActiveVoices >= m_nPolyphony * 3 / 4 && !m_bThrottled)
+	{
+		if (++m_nQuietWindows >= RaiseWindows)
+		{
+			m_nPolyphony    = Utility::Min(m_nPolyphony + Utility::Max(m_nPolyphony / 16, 4u), m_nMaxPolyphony);
+			m_nQuietWindows = 0;
+		}
+	}
+	else
+		m_nQuietWindows = 0;
+
+	return m_nPolyphony != nPreviousPolyphony;
+}
+
+void CPolyphonyGovernor::OnThrottleDetected()
+{
+	// A throttled CPU will take longer to render the same voices, so don't wait for deadlines to be missed
+	Lower(4);
+	m_nQuietWindows = 0;
+	m_bThrottled    = true;
+	m_nThrottleTime = CTimer::Get()->GetTicks();
+}
+
+void CPolyphonyGovernor::Lower(u32 nDivisor)
+{
+	m_nPolyphony = Utility::Max(m_nPolyphony - m_nPolyphony / nDivisor, MinPolyphony);
+}
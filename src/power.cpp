@@ -33,11 +33,16 @@ const char PowerName[] = "power";
 constexpr u32 UnderVoltageOccurredBit = 1 << 16;
 constexpr u32 ThrottlingOccurredBit   = 1 << 18;
 
+// Any problem now (low 4 bits) or since the last status read (high 4 bits)
+constexpr u32 ThrottledStatusMask     = 0x000F000F;
+
 CPower::CPower()
 	: m_nPowerSaveTimeout(300),
 	  m_nLastActivityTime(0),
 	  m_State(TState::Normal),
-	  m_LastThrottledStatus(0)
+	  m_LastThrottledStatus(0),
+	  m_bThrottled(false),
+	  m_nLastThrottledTime(0)
 {
 }
 
@@ -90,6 +95,11 @@ void CPower::OnUnderVoltageDetected()
 	CLogger::Get()->Write(PowerName, LogWarning, "Undervoltage detected; check power supply");
 }
 
+void CPower::OnThrottleCleared()
+{
+	CLogger::Get()->Write(PowerName, LogNotice, "CPU throttling/undervoltage no longer reported");
+}
+
 void CPower::UpdateThrottledStatus()
 {
 	// Get throttled status from the firmware and clear status bits
@@ -110,4 +120,17 @@ void CPower::UpdateThrottledStatus()
 		OnUnderVoltageDetected();
 
 	m_LastThrottledStatus = ThrottledStatus.nValue;
+
+	// Only report the all-clear after a spell of normal status, so that a marginal supply doesn't cause flapping
+	const unsigned int nTicks = CTimer::Get()->GetTicks();
+	if (ThrottledStatus.nValue & ThrottledStatusMask)
+	{
+		m_bThrottled         = true;
+		m_nLastThrottledTime = nTicks;
+	}
+	else if (m_bThrottled && (nTicks - m_nLastThrottledTime) >= MSEC2HZ(ThrottleClearHoldMillis))
+	{
+		m_bThrottled = false;
+		OnThrottleCleared();
+	}
 }
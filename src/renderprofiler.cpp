@@ -0,0 +1,147 @@
+//
+// renderprofiler.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <circle/timer.h>
+#include <circle/util.h>
+
+#include "renderprofiler.h"
+#include "utility.h"
+
+constexpr u32 CRenderProfiler::LateChunkThresholds[];
+
+// Start value for the minimum load of a new window
+constexpr u32 NoMinLoad = 0xFFFFFFFF;
+
+CRenderProfiler::CRenderProfiler(unsigned int nSampleRate)
+	: m_nSampleRate(nSampleRate),
+
+	  m_nChunkStartTime(0),
+	  m_nRenderEndTime(0),
+	  m_nChunkPeriod(0),
+
+	  m_nWindowPeriod(0),
+	  m_nWindowBusyTime(0),
+	  m_nWindowConversionTime(0),
+	  m_nWindowMinLoad(NoMinLoad),
+	  m_nWindowMaxLoad(0),
+
+	  m_Totals{},
+	  m_nTotalPeriod(0),
+	  m_nTotalBusyTime(0),
+	  m_nPeakVoices(0),
+
+	  m_Lock(TASK_LEVEL),
+	  m_PublishedStats{}
+{
+}
+
+void CRenderProfiler::BeginChunk(size_t nFrames, bool bUnderrun)
+{
+	m_nChunkStartTime = CTimer::GetClockTicks();
+	m_nChunkPeriod    = static_cast<u64>(nFrames) * 1000000 / m_nSampleRate;
+
+	if (bUnderrun)
+		++m_Totals.nUnderruns;
+}
+
+void CRenderProfiler::EndRender()
+{
+	m_nRenderEndTime = CTimer::GetClockTicks();
+}
+
+void CRenderProfiler::EndChunk(bool bDropped)
+{
+	const unsigned int nChunkEndTime = CTimer::GetClockTicks();
+
+	// Nothing was rendered
+	if (m_nChunkPeriod == 0)
+		return;
+
+	const unsigned int nBusyTime = nChunkEndTime - m_nChunkStartTime;
+	const u32 nLoad = static_cast<u64>(nBusyTime) * 100 / m_nChunkPeriod;
+
+	++m_Totals.nChunks;
+	if (bDropped)
+		++m_Totals.nDroppedChunks;
+
+	// Find the highest bucket this chunk reached
+	for (size_t i = LateChunkBuckets; i > 0; --i)
+	{
+		if (nLoad >= LateChunkThresholds[i - 1])
+		{
+			++m_Totals.nLateChunks[i - 1];
+			break;
+		}
+	}
+
+	m_nTotalPeriod   += m_nChunkPeriod;
+	m_nTotalBusyTime += nBusyTime;
+
+	m_nWindowPeriod         += m_nChunkPeriod;
+	m_nWindowBusyTime       += nBusyTime;
+	m_nWindowConversionTime += nChunkEndTime - m_nRenderEndTime;
+	m_nWindowMinLoad         = Utility::Min(m_nWindowMinLoad, nLoad);
+	m_nWindowMaxLoad         = Utility::Max(m_nWindowMaxLoad, nLoad);
+
+	if (m_nWindowPeriod >= WindowMicros)
+		PublishWindow();
+}
+
+void CRenderProfiler::SampleVoices(u32 nVoices)
+{
+	if (nVoices > m_nPeakVoices)
+		m_nPeakVoices = nVoices;
+}
+
+CRenderProfiler::TStats CRenderProfiler::GetStats() const
+{
+	m_Lock.Acquire();
+	TStats Stats = m_PublishedStats;
+	m_Lock.Release();
+
+	Stats.nPeakVoices = m_nPeakVoices;
+
+	return Stats;
+}
+
+void CRenderProfiler::PublishWindow()
+{
+	TStats Stats = m_Totals;
+	Stats.nMinLoad           = m_nWindowMinLoad;
+	Stats.nAvgLoad           = static_cast<u64>(m_nWindowBusyTime) * 100 / m_nWindowPeriod;
+	Stats.nMaxLoad           = m_nWindowMaxLoad;
+	Stats.nAvgConversionLoad = static_cast<u64>(m_nWindowConversionTime) * 100 / m_nWindowPeriod;
+
+	// Audio time per unit of busy time; guard against a clock too coarse to have measured anything
+	Stats.nRealTimeFactor      = static_cast<u64>(m_nWindowPeriod) * 100 / Utility::Max(m_nWindowBusyTime, 1u);
+	Stats.nTotalRealTimeFactor = m_nTotalPeriod * 100 / Utility::Max(m_nTotalBusyTime, static_cast<u64>(1));
+
+	m_Lock.Acquire();
+	m_PublishedStats = Stats;
+	m_Lock.Release();
+
+	m_nWindowPeriod         = 0;
+	m_nWindowBusyTime       = 0;
+	m_nWindowConversionTime = 0;
+	m_nWindowMinLoad        = NoMinLoad;
+	m_nWindowMaxLoad        = 0;
+}
@@ -21,13 +21,47 @@
 //
 
 #include <circle/logger.h>
+#include <circle/util.h>
 #include <fatfs/ff.h>
 
 #include "rommanager.h"
+#include "utility.h"
 
 const char ROMManagerName[] = "rommanager";
 const char* const Disks[] = { "SD", "USB" };
 const char ROMDirectory[] = "roms";
+const char IndexFileName[] = ".romindex";
+
+// Index file identifier; bump the version whenever the format changes
+constexpr u32 IndexMagic   = 'R' | 'O' << 8 | 'I' << 16 | 'X' << 24;
+constexpr u32 IndexVersion = 1;
+
+// File names are stored with an 8-bit length
+constexpr size_t MaxIndexStringLength = 255;
+
+// The only sizes a complete ROM dump can have
+constexpr size_t ControlROMSize  = 64 * 1024;
+constexpr size_t MT32PCMROMSize  = 512 * 1024;
+constexpr size_t CM32LPCMROMSize = 1024 * 1024;
+
+struct TIndexFileHeader
+{
+	u32 nMagic;
+	u32 nVersion;
+	u32 nEntries;
+}
+PACKED;
+
+// Followed by the file name, without null terminator
+struct TIndexFileEntry
+{
+	u32 nSize;
+	u16 nDate;
+	u16 nTime;
+	u8 nSlot;
+	u8 nFileNameLength;
+}
+PACKED;
 
 // Custom File class for mt32emu
 class CROMFile : public MT32Emu::AbstractFile
@@ -108,40 +142,110 @@ bool CROMManager::ScanROMs()
 	FILINFO FileInfo;
 	FRESULT Result;
 	CString DirectoryPath;
+	CString IndexPath;
 
 	// Already have all ROMs
 	if (HaveROMSet(TMT32ROMSet::All))
 		return true;
 
+	CLogger* const pLogger = CLogger::Get();
+
+	TIndexEntry* const pCachedEntries = new TIndexEntry[MaxIndexEntries];
+	TIndexEntry* const pNewEntries    = new TIndexEntry[MaxIndexEntries];
+
 	// Loop over each disk
 	for (auto pDisk : Disks)
 	{
 		DirectoryPath.Format("%s:/%s", pDisk, ROMDirectory);
+		IndexPath.Format("%s/%s", static_cast<const char*>(DirectoryPath), IndexFileName);
+
+		const size_t nCachedEntries = LoadIndex(IndexPath, pCachedEntries);
+		size_t nNewEntries = 0;
+		size_t nReadFiles = 0;
+		size_t nUnindexedFiles = 0;
+		bool bIndexChanged = false;
+		TIndexEntry UnindexedEntry;
+
 		Result = f_findfirst(&Dir, &FileInfo, DirectoryPath, "*");
 
-		// Loop over each file in the directory
+		// Loop over each file in the directory; once all ROMs are found, the rest are only indexed
 		while (Result == FR_OK && *FileInfo.fname)
 		{
-			// Ensure not directory, hidden, or system file
-			if (!(FileInfo.fattrib & (AM_DIR | AM_HID | AM_SYS)))
+			// Ensure not directory, hidden, or system file, or our own index
+			if (!(FileInfo.fattrib & (AM_DIR | AM_HID | AM_SYS)) && strcmp(FileInfo.fname, IndexFileName) != 0)
 			{
-				// Assemble path
-				CString ROMPath(static_cast<const char*>(DirectoryPath));
-				ROMPath.Append("/");
-				ROMPath.Append(FileInfo.fname);
-
-				// Try to open file
-				CheckROM(ROMPath);
-
-				// Stop if we have all ROMs
-				if (HaveROMSet(TMT32ROMSet::All))
-					return true;
+				// Files beyond the index's capacity are still scanned, but identified from scratch every time
+				const bool bIndexed = nNewEntries < MaxIndexEntries;
+				TIndexEntry& Entry = bIndexed ? pNewEntries[nNewEntries++] : UnindexedEntry;
+				if (!bIndexed)
+					++nUnindexedFiles;
+
+				Entry.FileName = FileInfo.fname;
+				Entry.nSize    = FileInfo.fsize;
+				Entry.nDate    = FileInfo.fdate;
+				Entry.nTime    = FileInfo.ftime;
+				Entry.nSlot    = UnidentifiedSlot;
+
+				// Reuse the cached identification if the file hasn't changed since it was indexed
+				for (size_t i = 0; i < nCachedEntries; ++i)
+				{
+					const TIndexEntry& CachedEntry = pCachedEntries[i];
+					if (CachedEntry.nSize == Entry.nSize && CachedEntry.nDate == Entry.nDate && CachedEntry.nTime == Entry.nTime && CachedEntry.FileName.Compare(Entry.FileName) == 0)
+					{
+						Entry.nSlot = CachedEntry.nSlot;
+						break;
+					}
+				}
+
+				const u8 nCachedSlot = Entry.nSlot;
+
+				// Only read files that could be a ROM we still need
+				if (Entry.nSize != ControlROMSize && Entry.nSize != MT32PCMROMSize && Entry.nSize != CM32LPCMROMSize)
+					Entry.nSlot = NotROMSlot;
+				else if (Entry.nSlot == UnidentifiedSlot ? IsNeeded(Entry.nSize) : Entry.nSlot < SlotCount && !*GetSlot(Entry.nSlot))
+				{
+					// Assemble path
+					CString ROMPath(static_cast<const char*>(DirectoryPath));
+					ROMPath.Append("/");
+					ROMPath.Append(FileInfo.fname);
+
+					// Try to open file
+					CheckROM(ROMPath, Entry.nSlot);
+					++nReadFiles;
+				}
+
+				if (bIndexed && Entry.nSlot != nCachedSlot)
+					bIndexChanged = true;
 			}
 
 			Result = f_findnext(&Dir, &FileInfo);
 		}
+
+		f_closedir(&Dir);
+
+		if (nUnindexedFiles)
+			pLogger->Write(ROMManagerName, LogWarning, "%s: %d files didn't fit in the index", pDisk, nUnindexedFiles);
+
+		// Files were added, changed or removed
+		if (bIndexChanged || nNewEntries != nCachedEntries)
+		{
+			pLogger->Write(ROMManagerName, LogNotice, "%s: %d of %d files read; updating index", pDisk, nReadFiles, nNewEntries);
+
+			if (!SaveIndex(IndexPath, pNewEntries, nNewEntries))
+				pLogger->Write(ROMManagerName, LogWarning, "Couldn't write %s", static_cast<const char*>(IndexPath));
+		}
+
+		// Release strings before the next disk
+		for (size_t i = 0; i < MaxIndexEntries; ++i)
+		{
+			pCachedEntries[i] = TIndexEntry();
+			pNewEntries[i]    = TIndexEntry();
+		}
 	}
 
+	delete[] pCachedEntries;
+	delete[] pNewEntries;
+
 	return HaveROMSet(TMT32ROMSet::Any);
 }
 
@@ -224,7 +328,31 @@ bool CROMManager::GetROMSet(TMT32ROMSet ROMSet, TMT32ROMSet& pOutROMSet, const M
 	return true;
 }
 
-bool CROMManager::CheckROM(const char* pPath)
+bool CROMManager::IsNeeded(size_t nSize) const
+{
+	switch (nSize)
+	{
+		case ControlROMSize:
+			return !m_pMT32OldControl || !m_pMT32NewControl || !m_pCM32LControl;
+
+		case MT32PCMROMSize:
+			return !m_pMT32PCM;
+
+		case CM32LPCMROMSize:
+			return !m_pCM32LPCM;
+
+		default:
+			return false;
+	}
+}
+
+const MT32Emu::ROMImage** CROMManager::GetSlot(u8 nSlot)
+{
+	const MT32Emu::ROMImage** const Slots[SlotCount] = { &m_pMT32OldControl, &m_pMT32NewControl, &m_pCM32LControl, &m_pMT32PCM, &m_pCM32LPCM };
+	return nSlot < SlotCount ? Slots[nSlot] : nullptr;
+}
+
+bool CROMManager::CheckROM(const char* pPath, u8& nOutSlot)
 {
 	CROMFile* pFile = new CROMFile();
 	if (!pFile->open(pPath))
@@ -236,7 +364,7 @@ bool CROMManager::CheckROM(const char* pPath)
 
 	// Check ROM and store if valid
 	const MT32Emu::ROMImage* pROM = MT32Emu::ROMImage::makeROMImage(pFile);
-	if (!StoreROM(*pROM))
+	if (!StoreROM(*pROM, nOutSlot))
 	{
 		MT32Emu::ROMImage::freeROMImage(pROM);
 		delete pFile;
@@ -246,10 +374,10 @@ bool CROMManager::CheckROM(const char* pPath)
 	return true;
 }
 
-bool CROMManager::StoreROM(const MT32Emu::ROMImage& ROMImage)
+bool CROMManager::StoreROM(const MT32Emu::ROMImage& ROMImage, u8& nOutSlot)
 {
 	const MT32Emu::ROMInfo* pROMInfo = ROMImage.getROMInfo();
-	const MT32Emu::ROMImage** pROMImagePtr = nullptr;
+	nOutSlot = NotROMSlot;
 
 	// Not a valid ROM file
 	if (!pROMInfo)
@@ -259,31 +387,109 @@ bool CROMManager::StoreROM(const MT32Emu::ROMImage& ROMImage)
 	{
 		// Is an 'old' MT-32 control ROM
 		if (pROMInfo->shortName[10] == '1' || pROMInfo->shortName[10] == 'b')
-			pROMImagePtr = &m_pMT32OldControl;
+			nOutSlot = 0;
 
 		// Is a 'new' MT-32 control ROM
 		else if (pROMInfo->shortName[10] == '2')
-			pROMImagePtr = &m_pMT32NewControl;
+			nOutSlot = 1;
 
 		// Is a CM-32L control ROM
 		else
-			pROMImagePtr = &m_pCM32LControl;
+			nOutSlot = 2;
 	}
 	else if (pROMInfo->type == MT32Emu::ROMInfo::Type::PCM)
 	{
 		// Is an MT-32 PCM ROM
 		if (pROMInfo->shortName[4] == 'm')
-			pROMImagePtr = &m_pMT32PCM;
+			nOutSlot = 3;
 
 		// Is a CM-32L PCM ROM
 		else
-			pROMImagePtr = &m_pCM32LPCM;
+			nOutSlot = 4;
 	}
 
 	// Ensure we don't already have this ROM
+	const MT32Emu::ROMImage** pROMImagePtr = GetSlot(nOutSlot);
 	if (!pROMImagePtr || *pROMImagePtr)
 		return false;
 
 	*pROMImagePtr = &ROMImage;
 	return true;
 }
+
+size_t CROMManager::LoadIndex(const char* pIndexPath, TIndexEntry* pEntries)
+{
+	FIL File;
+	UINT nBytesRead;
+	TIndexFileHeader Header;
+
+	if (f_open(&File, pIndexPath, FA_READ) != FR_OK)
+		return 0;
+
+	if (f_read(&File, &Header, sizeof(Header), &nBytesRead) != FR_OK || nBytesRead != sizeof(Header) ||
+		Header.nMagic != IndexMagic || Header.nVersion != IndexVersion || Header.nEntries > MaxIndexEntries)
+	{
+		f_close(&File);
+		return 0;
+	}
+
+	char StringBuffer[MaxIndexStringLength + 1];
+	size_t nEntries = 0;
+
+	while (nEntries < Header.nEntries)
+	{
+		TIndexFileEntry FileEntry;
+		TIndexEntry& Entry = pEntries[nEntries];
+
+		if (f_read(&File, &FileEntry, sizeof(FileEntry), &nBytesRead) != FR_OK || nBytesRead != sizeof(FileEntry))
+			break;
+
+		if (f_read(&File, StringBuffer, FileEntry.nFileNameLength, &nBytesRead) != FR_OK || nBytesRead != FileEntry.nFileNameLength)
+			break;
+		StringBuffer[FileEntry.nFileNameLength] = '\0';
+		Entry.FileName = StringBuffer;
+
+		Entry.nSize = FileEntry.nSize;
+		Entry.nDate = FileEntry.nDate;
+		Entry.nTime = FileEntry.nTime;
+		Entry.nSlot = FileEntry.nSlot;
+
+		++nEntries;
+	}
+
+	f_close(&File);
+
+	// Truncated or corrupt; don't trust any of it
+	return nEntries == Header.nEntries ? nEntries : 0;
+}
+
+bool CROMManager::SaveIndex(const char* pIndexPath, const TIndexEntry* pEntries, size_t nEntries)
+{
+	FIL File;
+	UINT nBytesWritten;
+
+	if (f_open(&File, pIndexPath, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+		return false;
+
+	const TIndexFileHeader Header{IndexMagic, IndexVersion, static_cast<u32>(nEntries)};
+	bool bSuccess = f_write(&File, &Header, sizeof(Header), &nBytesWritten) == FR_OK && nBytesWritten == sizeof(Header);
+
+	for (size_t i = 0; bSuccess && i < nEntries; ++i)
+	{
+		const TIndexEntry& Entry = pEntries[i];
+		const u8 nFileNameLength = Utility::Min(Entry.FileName.GetLength(), MaxIndexStringLength);
+
+		const TIndexFileEntry FileEntry{Entry.nSize, Entry.nDate, Entry.nTime, Entry.nSlot, nFileNameLength};
+
+		bSuccess = f_write(&File, &FileEntry, sizeof(FileEntry), &nBytesWritten) == FR_OK && nBytesWritten == sizeof(FileEntry) &&
+				   f_write(&File, static_cast<const char*>(Entry.FileName), nFileNameLength, &nBytesWritten) == FR_OK && nBytesWritten == nFileNameLength;
+	}
+
+	f_close(&File);
+
+	// Don't leave a partial index behind
+	if (!bSuccess)
+		f_unlink(pIndexPath);
+
+	return bSuccess;
+}
@@ -30,6 +30,7 @@
 const char SoundFontManagerName[] = "soundfontmanager";
 const char* const Disks[] = { "SD", "USB" };
 const char SoundFontDirectory[] = "soundfonts";
+const char IndexFileName[] = ".sfindex";
 
 // Four-character codes used throughout SoundFont RIFF structure
 constexpr u32 FourCC(const char pFourCC[4])
@@ -37,11 +38,36 @@ constexpr u32 FourCC(const char pFourCC[4])
 	return pFourCC[3] << 24 | pFourCC[2] << 16 | pFourCC[1] << 8 | pFourCC[0];
 }
 
+constexpr u32 FourCCIBAG = FourCC("ibag");
 constexpr u32 FourCCINAM = FourCC("INAM");
 constexpr u32 FourCCINFO = FourCC("INFO");
 constexpr u32 FourCCLIST = FourCC("LIST");
+constexpr u32 FourCCPBAG = FourCC("pbag");
+constexpr u32 FourCCPDTA = FourCC("pdta");
+constexpr u32 FourCCPHDR = FourCC("phdr");
 constexpr u32 FourCCRIFF = FourCC("RIFF");
 constexpr u32 FourCCSFBK = FourCC("sfbk");
+constexpr u32 FourCCSDTA = FourCC("sdta");
+constexpr u32 FourCCSHDR = FourCC("shdr");
+constexpr u32 FourCCSM24 = FourCC("sm24");
+constexpr u32 FourCCSMPL = FourCC("smpl");
+
+// Index file identifier; bump the version whenever the format changes
+constexpr u32 IndexMagic   = FourCC("SFIX");
+constexpr u32 IndexVersion = 3;
+
+// Names are stored with an 8-bit length
+constexpr size_t MaxIndexStringLength = 255;
+
+// Sizes of preset and sample header records (see SoundFont 2.04 spec sections 7.2 and 7.10)
+constexpr size_t PresetHeaderSize = 38;
+constexpr size_t SampleHeaderSize = 46;
+constexpr size_t BagSize          = 4;
+
+// Rough FluidSynth memory cost of each preset/instrument zone (a full generator array), and of the parsed preset data
+// which is held in memory alongside the final structures while loading
+constexpr size_t ZoneMemorySize         = 2048;
+constexpr size_t PresetDataMemoryFactor = 2;
 
 struct TSoundFontChunk
 {
@@ -50,6 +76,64 @@ struct TSoundFontChunk
 }
 PACKED;
 
+struct TIndexFileHeader
+{
+	u32 nMagic;
+	u32 nVersion;
+	u32 nEntries;
+}
+PACKED;
+
+// Followed by the file name and SoundFont name, without null terminators
+struct TIndexFileEntry
+{
+	u32 nSize;
+	u16 nDate;
+	u16 nTime;
+	u16 nPresets;
+	u16 nSamples;
+	u32 nSampleDataSize;
+	u32 nSample16DataSize;
+	u32 nSample24DataSize;
+	u32 nPresetDataSize;
+	u32 nZones;
+	u8 nValid;
+	u8 nFileNameLength;
+	u8 nNameLength;
+}
+PACKED;
+
+namespace
+{
+	// Sizes of the 16-bit sample data and its optional 24-bit extension, from the sample data list ending at nListEnd;
+	// leaves the file positioned at the end of the list
+	bool ReadSampleDataSizes(FIL* pFile, FSIZE_t nListEnd, u32& nSample16DataSize, u32& nSample24DataSize)
+	{
+		UINT nBytesRead;
+		TSoundFontChunk Chunk;
+		u32 nFourCC;
+
+		nSample16DataSize = 0;
+		nSample24DataSize = 0;
+
+		if (f_read(pFile, &nFourCC, sizeof(nFourCC), &nBytesRead) == FR_OK && nFourCC == FourCCSDTA)
+		{
+			while (f_tell(pFile) < nListEnd && f_read(pFile, &Chunk, sizeof(Chunk), &nBytesRead) == FR_OK && nBytesRead == sizeof(Chunk))
+			{
+				if (Chunk.FourCC == FourCCSMPL)
+					nSample16DataSize = Chunk.Size;
+				else if (Chunk.FourCC == FourCCSM24)
+					nSample24DataSize = Chunk.Size;
+
+				// Chunks are padded to an even size
+				f_lseek(pFile, f_tell(pFile) + Chunk.Size + (Chunk.Size & 1));
+			}
+		}
+
+		return f_lseek(pFile, nListEnd) == FR_OK;
+	}
+}
+
 CSoundFontManager::CSoundFontManager()
 	: m_nSoundFonts(0)
 {
@@ -67,41 +151,130 @@ bool CSoundFontManager::ScanSoundFonts()
 	FILINFO FileInfo;
 	FRESULT Result;
 	CString DirectoryPath;
+	CString IndexPath;
+
+	CLogger* const pLogger = CLogger::Get();
+
+	TIndexEntry* const pCachedEntries = new TIndexEntry[MaxSoundFonts];
+	TIndexEntry* const pNewEntries    = new TIndexEntry[MaxSoundFonts];
 
 	// Loop over each disk
 	for (auto pDisk : Disks)
 	{
 		DirectoryPath.Format("%s:/%s", pDisk, SoundFontDirectory);
+		IndexPath.Format("%s/%s", static_cast<const char*>(DirectoryPath), IndexFileName);
+
+		const size_t nCachedEntries = LoadIndex(IndexPath, pCachedEntries);
+		size_t nNewEntries = 0;
+		size_t nParsedFiles = 0;
+
 		Result = f_findfirst(&Dir, &FileInfo, DirectoryPath, "*");
 
 		// Loop over each file in the directory
-		while (Result == FR_OK && *FileInfo.fname && m_nSoundFonts < MaxSoundFonts)
+		while (Result == FR_OK && *FileInfo.fname && m_nSoundFonts < MaxSoundFonts && nNewEntries < MaxSoundFonts)
 		{
-			// Ensure not directory, hidden, or system file
-			if (!(FileInfo.fattrib & (AM_DIR | AM_HID | AM_SYS)))
+			// Ensure not directory, hidden, or system file, or our own index
+			if (!(FileInfo.fattrib & (AM_DIR | AM_HID | AM_SYS)) && strcmp(FileInfo.fname, IndexFileName) != 0)
 			{
+				TIndexEntry& Entry = pNewEntries[nNewEntries++];
+				Entry.FileName = FileInfo.fname;
+				Entry.nSize    = FileInfo.fsize;
+				Entry.nDate    = FileInfo.fdate;
+				Entry.nTime    = FileInfo.ftime;
+
 				// Assemble path
 				CString SoundFontPath(static_cast<const char*>(DirectoryPath));
 				SoundFontPath.Append("/");
 				SoundFontPath.Append(FileInfo.fname);
 
-				CheckSoundFont(SoundFontPath, FileInfo.fname);
+				// Reuse the cached result if the file hasn't changed since it was indexed
+				const TIndexEntry* pCachedEntry = nullptr;
+				for (size_t i = 0; i < nCachedEntries; ++i)
+				{
+					const TIndexEntry& CachedEntry = pCachedEntries[i];
+					if (CachedEntry.nSize == Entry.nSize && CachedEntry.nDate == Entry.nDate && CachedEntry.nTime == Entry.nTime && CachedEntry.FileName.Compare(Entry.FileName) == 0)
+					{
+						pCachedEntry = &CachedEntry;
+						break;
+					}
+				}
+
+				if (pCachedEntry)
+				{
+					Entry.Name     = pCachedEntry->Name;
+					Entry.bValid   = pCachedEntry->bValid;
+					Entry.nPresets          = pCachedEntry->nPresets;
+					Entry.nSamples          = pCachedEntry->nSamples;
+					Entry.nSampleDataSize   = pCachedEntry->nSampleDataSize;
+					Entry.nSample16DataSize = pCachedEntry->nSample16DataSize;
+					Entry.nSample24DataSize = pCachedEntry->nSample24DataSize;
+					Entry.nPresetDataSize   = pCachedEntry->nPresetDataSize;
+					Entry.nZones            = pCachedEntry->nZones;
+				}
+				else
+				{
+					Entry.bValid = CheckSoundFont(SoundFontPath, Entry);
+					++nParsedFiles;
+				}
+
+				if (Entry.bValid)
+				{
+					TSoundFontListEntry& ListEntry = m_SoundFontList[m_nSoundFonts++];
+					ListEntry.Path     = SoundFontPath;
+					ListEntry.nPresets = Entry.nPresets;
+					ListEntry.nSamples = Entry.nSamples;
+
+					// Preset data is expanded into zones
+					ListEntry.nSampleDataSize   = Entry.nSampleDataSize;
+					ListEntry.nSample16DataSize = Entry.nSample16DataSize;
+					ListEntry.nSample24DataSize = Entry.nSample24DataSize;
+					ListEntry.nPresetMemorySize = Entry.nPresetDataSize * PresetDataMemoryFactor + Entry.nZones * ZoneMemorySize;
+
+					// If we got a name, use it, otherwise fall back on filename
+					if (Entry.Name.GetLength() > 0)
+						ListEntry.Name = Entry.Name;
+					else
+						ListEntry.Name = FileInfo.fname;
+				}
 			}
 
 			Result = f_findnext(&Dir, &FileInfo);
 		}
+
+		f_closedir(&Dir);
+
+		// Files were added, changed or removed
+		if (nParsedFiles > 0 || nNewEntries != nCachedEntries)
+		{
+			pLogger->Write(SoundFontManagerName, LogNotice, "%s: %d of %d files parsed; updating index", pDisk, nParsedFiles, nNewEntries);
+
+			if (!SaveIndex(IndexPath, pNewEntries, nNewEntries))
+				pLogger->Write(SoundFontManagerName, LogWarning, "Couldn't write %s", static_cast<const char*>(IndexPath));
+		}
+
+		// Release strings before the next disk
+		for (size_t i = 0; i < MaxSoundFonts; ++i)
+		{
+			pCachedEntries[i] = TIndexEntry();
+			pNewEntries[i]    = TIndexEntry();
+		}
 	}
 
+	delete[] pCachedEntries;
+	delete[] pNewEntries;
+
 	// Sort into alphabetical order
 	if (m_nSoundFonts > 0)
 	{
 		// Sort into lexicographical order
 		Utility::QSort(m_SoundFontList, SoundFontListComparator, 0, m_nSoundFonts - 1);
 
-		CLogger* const pLogger = CLogger::Get();
 		pLogger->Write(SoundFontManagerName, LogNotice, "%d SoundFonts found:", m_nSoundFonts);
 		for (size_t i = 0; i < m_nSoundFonts; ++i)
-			pLogger->Write(SoundFontManagerName, LogNotice, "%d: %s (%s)", i, static_cast<const char*>(m_SoundFontList[i].Path), static_cast<const char*>(m_SoundFontList[i].Name));
+		{
+			const TSoundFontListEntry& Entry = m_SoundFontList[i];
+			pLogger->Write(SoundFontManagerName, LogNotice, "%d: %s (%s, %d presets, %d samples, ~%d KB)", i, static_cast<const char*>(Entry.Path), static_cast<const char*>(Entry.Name), Entry.nPresets, Entry.nSamples, (Entry.nSampleDataSize + Entry.nPresetMemorySize) / 1024);
+		}
 
 		return true;
 	}
@@ -128,12 +301,28 @@ const char* CSoundFontManager::GetSoundFontName(size_t nIndex) const
 	return static_cast<const char*>(m_SoundFontList[nIndex].Name);
 }
 
+size_t CSoundFontManager::GetSoundFontMemorySize(size_t nIndex, bool bIncludeSampleData) const
+{
+	// Out of range
+	if (nIndex >= m_nSoundFonts)
+		return 0;
+
+	const TSoundFontListEntry& Entry = m_SoundFontList[nIndex];
+	return bIncludeSampleData ? Entry.nSampleDataSize + Entry.nPresetMemorySize : Entry.nPresetMemorySize;
+}
+
+void CSoundFontManager::GetSampleDataSizes(size_t nIndex, size_t& nSample16DataSize, size_t& nSample24DataSize) const
+{
+	nSample16DataSize = nIndex < m_nSoundFonts ? m_SoundFontList[nIndex].nSample16DataSize : 0;
+	nSample24DataSize = nIndex < m_nSoundFonts ? m_SoundFontList[nIndex].nSample24DataSize : 0;
+}
+
 const char* CSoundFontManager::GetFirstValidSoundFontPath() const
 {
 	return m_nSoundFonts > 0 ? static_cast<const char*>(m_SoundFontList[0].Path) : nullptr;
 }
 
-void CSoundFontManager::CheckSoundFont(const char* pFullPath, const char* pFileName)
+bool CSoundFontManager::CheckSoundFont(const char* pFullPath, TIndexEntry& Entry)
 {
 	FIL File;
 	UINT nBytesRead;
@@ -145,22 +334,31 @@ void CSoundFontManager::CheckSoundFont(const char* pFullPath, const char* pFileN
 	// Init with null terminator
 	Name[0] = '\0';
 
+	Entry.Name              = "";
+	Entry.nPresets          = 0;
+	Entry.nSamples          = 0;
+	Entry.nSampleDataSize   = 0;
+	Entry.nSample16DataSize = 0;
+	Entry.nSample24DataSize = 0;
+	Entry.nPresetDataSize   = 0;
+	Entry.nZones            = 0;
+
 	// Try to open file
 	if (f_open(&File, pFullPath, FA_READ) != FR_OK)
-		return;
+		return false;
 
 #define CHECK_CHUNK_ID(EXPECTED_CHUNK_ID)                                                                \
 	if (f_read(&File, &Chunk, sizeof(Chunk), &nBytesRead) != FR_OK || Chunk.FourCC != EXPECTED_CHUNK_ID) \
 	{                                                                                                    \
 		f_close(&File);                                                                                  \
-		return;                                                                                          \
+		return false;                                                                                    \
 	}
 
 #define CHECK_FORM_ID(EXPECTED_FORM_ID)                                                                \
 	if (f_read(&File, &nFourCC, sizeof(nFourCC), &nBytesRead) != FR_OK || nFourCC != EXPECTED_FORM_ID) \
 	{                                                                                                  \
 		f_close(&File);                                                                                \
-		return;                                                                                        \
+		return false;                                                                                  \
 	}
 
 	CHECK_CHUNK_ID(FourCCRIFF);
@@ -173,6 +371,7 @@ void CSoundFontManager::CheckSoundFont(const char* pFullPath, const char* pFileN
 
 	// Loop over info list chunks and look for name chunk
 	nInfoListChunkSize = Chunk.Size;
+	const FSIZE_t nInfoListEnd = f_tell(&File) - sizeof(nFourCC) + nInfoListChunkSize;
 	size_t nTotalBytesRead = 4;
 
 	while (nTotalBytesRead < nInfoListChunkSize && f_read(&File, &Chunk, sizeof(Chunk), &nBytesRead) == FR_OK)
@@ -195,17 +394,128 @@ void CSoundFontManager::CheckSoundFont(const char* pFullPath, const char* pFileN
 		nTotalBytesRead += Chunk.Size;
 	}
 
+	// Make sure the name is terminated even if the INAM chunk wasn't
+	Name[sizeof(Name) - 1] = '\0';
+	Entry.Name = Name;
+
+	// Skip the sample data list (noting its size and what kind of samples it holds), then count preset and sample headers and zones in the preset data list
+	if (f_lseek(&File, nInfoListEnd) == FR_OK && f_read(&File, &Chunk, sizeof(Chunk), &nBytesRead) == FR_OK && Chunk.FourCC == FourCCLIST &&
+		(Entry.nSampleDataSize = Chunk.Size, ReadSampleDataSizes(&File, f_tell(&File) + Chunk.Size, Entry.nSample16DataSize, Entry.nSample24DataSize)) &&
+		f_read(&File, &Chunk, sizeof(Chunk), &nBytesRead) == FR_OK && Chunk.FourCC == FourCCLIST &&
+		f_read(&File, &nFourCC, sizeof(nFourCC), &nBytesRead) == FR_OK && nFourCC == FourCCPDTA)
+	{
+		const FSIZE_t nPresetDataListEnd = f_tell(&File) - sizeof(nFourCC) + Chunk.Size;
+		Entry.nPresetDataSize = Chunk.Size;
+
+		while (f_tell(&File) < nPresetDataListEnd && f_read(&File, &Chunk, sizeof(Chunk), &nBytesRead) == FR_OK && nBytesRead == sizeof(Chunk))
+		{
+			// Each list ends with a terminal record
+			if (Chunk.FourCC == FourCCPHDR && Chunk.Size >= PresetHeaderSize)
+				Entry.nPresets = Chunk.Size / PresetHeaderSize - 1;
+			else if (Chunk.FourCC == FourCCSHDR && Chunk.Size >= SampleHeaderSize)
+				Entry.nSamples = Chunk.Size / SampleHeaderSize - 1;
+			else if ((Chunk.FourCC == FourCCPBAG || Chunk.FourCC == FourCCIBAG) && Chunk.Size >= BagSize)
+				Entry.nZones += Chunk.Size / BagSize - 1;
+
+			f_lseek(&File, f_tell(&File) + Chunk.Size);
+		}
+	}
+
 	// Clean up
 	f_close(&File);
 
-	TSoundFontListEntry& entry = m_SoundFontList[m_nSoundFonts++];
-	entry.Path  = pFullPath;
+	return true;
+}
+
+size_t CSoundFontManager::LoadIndex(const char* pIndexPath, TIndexEntry* pEntries)
+{
+	FIL File;
+	UINT nBytesRead;
+	TIndexFileHeader Header;
+
+	if (f_open(&File, pIndexPath, FA_READ) != FR_OK)
+		return 0;
+
+	if (f_read(&File, &Header, sizeof(Header), &nBytesRead) != FR_OK || nBytesRead != sizeof(Header) ||
+		Header.nMagic != IndexMagic || Header.nVersion != IndexVersion || Header.nEntries > MaxSoundFonts)
+	{
+		f_close(&File);
+		return 0;
+	}
+
+	char StringBuffer[MaxIndexStringLength + 1];
+	size_t nEntries = 0;
+
+	while (nEntries < Header.nEntries)
+	{
+		TIndexFileEntry FileEntry;
+		TIndexEntry& Entry = pEntries[nEntries];
+
+		if (f_read(&File, &FileEntry, sizeof(FileEntry), &nBytesRead) != FR_OK || nBytesRead != sizeof(FileEntry))
+			break;
+
+		if (f_read(&File, StringBuffer, FileEntry.nFileNameLength, &nBytesRead) != FR_OK || nBytesRead != FileEntry.nFileNameLength)
+			break;
+		StringBuffer[FileEntry.nFileNameLength] = '\0';
+		Entry.FileName = StringBuffer;
+
+		if (f_read(&File, StringBuffer, FileEntry.nNameLength, &nBytesRead) != FR_OK || nBytesRead != FileEntry.nNameLength)
+			break;
+		StringBuffer[FileEntry.nNameLength] = '\0';
+		Entry.Name = StringBuffer;
+
+		Entry.nSize    = FileEntry.nSize;
+		Entry.nDate    = FileEntry.nDate;
+		Entry.nTime    = FileEntry.nTime;
+		Entry.bValid   = FileEntry.nValid;
+		Entry.nPresets          = FileEntry.nPresets;
+		Entry.nSamples          = FileEntry.nSamples;
+		Entry.nSampleDataSize   = FileEntry.nSampleDataSize;
+		Entry.nSample16DataSize = FileEntry.nSample16DataSize;
+		Entry.nSample24DataSize = FileEntry.nSample24DataSize;
+		Entry.nPresetDataSize   = FileEntry.nPresetDataSize;
+		Entry.nZones            = FileEntry.nZones;
+
+		++nEntries;
+	}
+
+	f_close(&File);
+
+	// Truncated or corrupt; don't trust any of it
+	return nEntries == Header.nEntries ? nEntries : 0;
+}
+
+bool CSoundFontManager::SaveIndex(const char* pIndexPath, const TIndexEntry* pEntries, size_t nEntries)
+{
+	FIL File;
+	UINT nBytesWritten;
+
+	if (f_open(&File, pIndexPath, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+		return false;
+
+	const TIndexFileHeader Header{IndexMagic, IndexVersion, static_cast<u32>(nEntries)};
+	bool bSuccess = f_write(&File, &Header, sizeof(Header), &nBytesWritten) == FR_OK && nBytesWritten == sizeof(Header);
+
+	for (size_t i = 0; bSuccess && i < nEntries; ++i)
+	{
+		const TIndexEntry& Entry = pEntries[i];
+		const u8 nFileNameLength = Utility::Min(Entry.FileName.GetLength(), MaxIndexStringLength);
+		const u8 nNameLength     = Utility::Min(Entry.Name.GetLength(), MaxIndexStringLength);
+
+		const TIndexFileEntry FileEntry{Entry.nSize, Entry.nDate, Entry.nTime, Entry.nPresets, Entry.nSamples, Entry.nSampleDataSize, Entry.nSample16DataSize, Entry.nSample24DataSize, Entry.nPresetDataSize, Entry.nZones, Entry.bValid, nFileNameLength, nNameLength};
+
+		bSuccess = f_write(&File, &FileEntry, sizeof(FileEntry), &nBytesWritten) == FR_OK && nBytesWritten == sizeof(FileEntry) &&
+				   f_write(&File, static_cast<const char*>(Entry.FileName), nFileNameLength, &nBytesWritten) == FR_OK && nBytesWritten == nFileNameLength &&
+				   f_write(&File, static_cast<const char*>(Entry.Name), nNameLength, &nBytesWritten) == FR_OK && nBytesWritten == nNameLength;
+	}
+
+	f_close(&File);
+
+	// Don't leave a partial index behind
+	if (!bSuccess)
+		f_unlink(pIndexPath);
 
-	// If we got a name, use it, otherwise fall back on filename
-	if (Name[0] != '\0')
-		entry.Name = Name;
-	else
-		entry.Name = pFileName;
+	return bSuccess;
 }
 
 inline bool CSoundFontManager::SoundFontListComparator(const TSoundFontListEntry& lhs, const TSoundFontListEntry& rhs)
@@ -21,6 +21,8 @@
 //
 
 #include <circle/logger.h>
+#include <circle/spinlock.h>
+#include <circle/timer.h>
 
 #include "config.h"
 #include "synth/mt32synth.h"
@@ -28,6 +30,11 @@
 
 const char MT32SynthName[] = "mt32synth";
 
+// Synths with the same PCM ROM share its decoded data through a table in mt32emu that isn't thread-safe (see
+// patches/munt-mt32emu-shared-pcm-rom.patch); synths may be opened by the main and render cores, so opening and closing is
+// serialized here
+static CSpinLock SynthOpenLock(TASK_LEVEL);
+
 constexpr size_t ROMOffsetVersionStringOld  = 0x4015;
 constexpr size_t ROMOffsetVersionString1_07 = 0x4011;
 constexpr size_t ROMOffsetVersionStringNew  = 0x2206;
@@ -37,16 +44,36 @@ constexpr u32 MemoryAddressMasterVolume     = 0x40016;
 const u8 CMT32Synth::StandardMIDIChannelsSysEx[] = { 0x10, 0x00, 0x0D, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09 };
 const u8 CMT32Synth::AlternateMIDIChannelsSysEx[] = { 0x10, 0x00, 0x0D, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x09 };
 
-CMT32Synth::CMT32Synth(unsigned nSampleRate, float nGain, float nReverbGain, TResamplerQuality ResamplerQuality)
+// SysEx command for resetting the synth to its power-on state (3-byte address and 1-byte value)
+const u8 CMT32Synth::ResetSysEx[] = { 0x7F, 0x00, 0x00, 0x00 };
+
+CMT32Synth::CMT32Synth(unsigned nSampleRate, float nGain, float nReverbGain, TResamplerQuality ResamplerQuality, bool bIntegerRenderer)
 	: CSynthBase(nSampleRate),
 
 	  m_pSynth(nullptr),
+	  m_nRenderedSampleCount(0),
 
 	  m_nGain(nGain),
 	  m_nReverbGain(nReverbGain),
 
 	  m_ResamplerQuality(ResamplerQuality),
 	  m_pSampleRateConverter(nullptr),
+	  m_pPolyphaseResampler(nullptr),
+	  m_bIntegerRenderer(bIntegerRenderer),
+
+	  m_pCachedSynths{nullptr},
+	  m_pCachedSampleRateConverters{nullptr},
+	  m_pCachedPolyphaseResamplers{nullptr},
+	  m_bROMSetsCached(false),
+
+	  m_bSysExStreaming(false),
+	  m_pSysExStreamSource(nullptr),
+	  m_nSysExStreamTime(0),
+	  m_nSysExStreamDeviceID(0),
+	  m_nSysExStreamAddress(0),
+	  m_nSysExStreamChecksum(0),
+	  m_SysExStreamData{0},
+	  m_nSysExStreamLength(0),
 
 	  m_CurrentROMSet(TMT32ROMSet::Any),
 	  m_pControlROMImage(nullptr),
@@ -56,11 +83,30 @@ CMT32Synth::CMT32Synth(unsigned nSampleRate, float nGain, float nReverbGain, TRe
 
 CMT32Synth::~CMT32Synth()
 {
+	SynthOpenLock.Acquire();
+
+	for (size_t i = 0; i < ROMSetCount; ++i)
+	{
+		if (m_pCachedSampleRateConverters[i] && m_pCachedSampleRateConverters[i] != m_pSampleRateConverter)
+			delete m_pCachedSampleRateConverters[i];
+
+		if (m_pCachedPolyphaseResamplers[i] && m_pCachedPolyphaseResamplers[i] != m_pPolyphaseResampler)
+			delete m_pCachedPolyphaseResamplers[i];
+
+		if (m_pCachedSynths[i] && m_pCachedSynths[i] != m_pSynth)
+			delete m_pCachedSynths[i];
+	}
+
 	if (m_pSynth)
 		delete m_pSynth;
 
+	SynthOpenLock.Release();
+
 	if (m_pSampleRateConverter)
 		delete m_pSampleRateConverter;
+
+	if (m_pPolyphaseResampler)
+		delete m_pPolyphaseResampler;
 }
 
 bool CMT32Synth::Initialize()
@@ -76,59 +122,251 @@ bool CMT32Synth::Initialize()
 	if (!m_ROMManager.GetROMSet(InitialROMSet, m_CurrentROMSet, m_pControlROMImage, m_pPCMROMImage))
 		return false;
 
-	m_pSynth = new MT32Emu::Synth(this);
-
-	if (!m_pSynth->open(*m_pControlROMImage, *m_pPCMROMImage))
+	m_pSynth = OpenSynth(*m_pControlROMImage, *m_pPCMROMImage);
+	if (!m_pSynth)
 		return false;
 
-	m_pSynth->setOutputGain(m_nGain);
-	m_pSynth->setReverbOutputGain(m_nReverbGain);
+	m_pPolyphaseResampler  = CreatePolyphaseResampler(*m_pSynth);
+	m_pSampleRateConverter = m_pPolyphaseResampler ? nullptr : CreateSampleRateConverter(*m_pSynth);
+
+	if (CConfig::Get()->MT32EmuCacheROMSets)
+		m_bROMSetsCached = CacheROMSets();
+
+	return true;
+}
+
+MT32Emu::Synth* CMT32Synth::OpenSynth(const MT32Emu::ROMImage& ControlROMImage, const MT32Emu::ROMImage& PCMROMImage)
+{
+	MT32Emu::Synth* pSynth = new MT32Emu::Synth(this);
+	pSynth->selectRendererType(m_bIntegerRenderer ? MT32Emu::RendererType_BIT16S : MT32Emu::RendererType_FLOAT);
+
+	SynthOpenLock.Acquire();
+	const bool bOpened = pSynth->open(ControlROMImage, PCMROMImage);
+	if (!bOpened)
+		delete pSynth;
+	SynthOpenLock.Release();
 
-	if (m_ResamplerQuality != TResamplerQuality::None)
+	if (!bOpened)
+		return nullptr;
+
+	pSynth->setOutputGain(m_nGain);
+	pSynth->setReverbOutputGain(m_nReverbGain);
+
+	return pSynth;
+}
+
+MT32Emu::SampleRateConverter* CMT32Synth::CreateSampleRateConverter(MT32Emu::Synth& Synth) const
+{
+	if (m_ResamplerQuality == TResamplerQuality::None)
+		return nullptr;
+
+	auto quality = MT32Emu::SamplerateConversionQuality_GOOD;
+	switch (m_ResamplerQuality)
+	{
+		case TResamplerQuality::Fastest:
+			quality = MT32Emu::SamplerateConversionQuality_FASTEST;
+			break;
+
+		case TResamplerQuality::Fast:
+			quality = MT32Emu::SamplerateConversionQuality_FAST;
+			break;
+
+		case TResamplerQuality::Good:
+			quality = MT32Emu::SamplerateConversionQuality_GOOD;
+			break;
+
+		case TResamplerQuality::Best:
+			quality = MT32Emu::SamplerateConversionQuality_BEST;
+			break;
+
+		default:
+			break;
+	}
+
+	return new MT32Emu::SampleRateConverter(Synth, m_nSampleRate, quality);
+}
+
+CPolyphaseResampler* CMT32Synth::CreatePolyphaseResampler(MT32Emu::Synth& Synth) const
+{
+	if (m_ResamplerQuality != TResamplerQuality::Polyphase)
+		return nullptr;
+
+	const unsigned int nSynthSampleRate = Synth.getStereoOutputSampleRate();
+	if (!CPolyphaseResampler::IsSupported(nSynthSampleRate, m_nSampleRate))
 	{
-		auto quality = MT32Emu::SamplerateConversionQuality_GOOD;
-		switch (m_ResamplerQuality)
+		// Falls back on mt32emu's converter at "good" quality
+		CLogger::Get()->Write(MT32SynthName, LogWarning, "Polyphase resampler can't convert %dHz to %dHz", nSynthSampleRate, m_nSampleRate);
+		return nullptr;
+	}
+
+	return new CPolyphaseResampler(Synth, nSynthSampleRate, m_nSampleRate);
+}
+
+bool CMT32Synth::CacheROMSets()
+{
+	CLogger* const pLogger = CLogger::Get();
+	const size_t nCurrentROMSetIndex = static_cast<size_t>(m_CurrentROMSet);
+
+	m_pCachedSynths[nCurrentROMSetIndex]               = m_pSynth;
+	m_pCachedSampleRateConverters[nCurrentROMSetIndex] = m_pSampleRateConverter;
+	m_pCachedPolyphaseResamplers[nCurrentROMSetIndex]  = m_pPolyphaseResampler;
+
+	// Open a synth for every other available ROM set up front; ROM sets with the same PCM ROM share its decoded data (see
+	// patches/munt-mt32emu-shared-pcm-rom.patch)
+	size_t nCachedSets = 1;
+	for (size_t i = 0; i < ROMSetCount; ++i)
+	{
+		const TMT32ROMSet ROMSet = static_cast<TMT32ROMSet>(i);
+		if (i == nCurrentROMSetIndex || !m_ROMManager.HaveROMSet(ROMSet))
+			continue;
+
+		TMT32ROMSet ActualROMSet;
+		const MT32Emu::ROMImage* pControlROMImage;
+		const MT32Emu::ROMImage* pPCMROMImage;
+		if (!m_ROMManager.GetROMSet(ROMSet, ActualROMSet, pControlROMImage, pPCMROMImage))
+			continue;
+
+		MT32Emu::Synth* pSynth = OpenSynth(*pControlROMImage, *pPCMROMImage);
+		if (!pSynth)
 		{
-			case TResamplerQuality::Fastest:
-				quality = MT32Emu::SamplerateConversionQuality_FASTEST;
-				break;
+			pLogger->Write(MT32SynthName, LogWarning, "Couldn't open ROM set %d for caching", i);
+			continue;
+		}
+
+		m_pCachedSynths[i]               = pSynth;
+		m_pCachedPolyphaseResamplers[i]  = CreatePolyphaseResampler(*pSynth);
+		m_pCachedSampleRateConverters[i] = m_pCachedPolyphaseResamplers[i] ? nullptr : CreateSampleRateConverter(*pSynth);
+		++nCachedSets;
+	}
+
+	pLogger->Write(MT32SynthName, LogNotice, "%d ROM set(s) ready", nCachedSets);
+	return true;
+}
 
-			case TResamplerQuality::Fast:
-				quality = MT32Emu::SamplerateConversionQuality_FAST;
-				break;
+void CMT32Synth::HandleMIDIShortMessage(u32 nMessage, unsigned int nTimestamp)
+{
+	if (!QueueMIDIShortMessage(nMessage, nTimestamp))
+		PlayMIDIShortMessage(nMessage, nTimestamp);
+}
 
-			case TResamplerQuality::Good:
-				quality = MT32Emu::SamplerateConversionQuality_GOOD;
-				break;
+void CMT32Synth::HandleMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	if (!QueueMIDISysExMessage(pData, nSize, nTimestamp))
+		PlayMIDISysExMessage(pData, nSize, nTimestamp);
+}
 
-			case TResamplerQuality::Best:
-				quality = MT32Emu::SamplerateConversionQuality_BEST;
-				break;
+bool CMT32Synth::HandleMIDISysExFragment(const void* pSource, const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp)
+{
+	// Only one stream can be open at a time; streams from other inputs are rejected until it ends or goes quiet
+	if (m_bSysExStreaming && pSource != m_pSysExStreamSource)
+	{
+		if (nOffset != 0 || nTimestamp - m_nSysExStreamTime < SysExStreamTimeoutMicros)
+			return false;
+
+		CLogger::Get()->Write(MT32SynthName, LogWarning, "Abandoned streamed SysEx message");
+		m_bSysExStreaming = false;
+	}
+
+	if (nOffset == 0)
+	{
+		// Roland header for the MT-32 model ID and the DT1 command, followed by a 3-byte address
+		m_bSysExStreaming = nSize >= 8 && pData[1] == 0x41 && pData[3] == 0x16 && pData[4] == 0x12;
+		if (!m_bSysExStreaming)
+			return false;
+
+		m_pSysExStreamSource   = pSource;
+		m_nSysExStreamDeviceID = pData[2];
+		m_nSysExStreamAddress  = pData[5] << 14 | pData[6] << 7 | pData[7];
+		m_nSysExStreamChecksum = pData[5] + pData[6] + pData[7];
+		m_nSysExStreamLength   = 0;
+
+		pData += 8;
+		nSize -= 8;
+	}
+	else if (!m_bSysExStreaming)
+		return false;
+
+	m_nSysExStreamTime = nTimestamp;
+
+	// Drop EOX
+	if (bComplete)
+		--nSize;
+
+	for (size_t i = 0; i < nSize; ++i)
+	{
+		// Keep the last byte back for the next chunk
+		if (m_nSysExStreamLength == sizeof(m_SysExStreamData))
+		{
+			PlaySysExStreamData(SysExStreamChunkSize, nTimestamp);
+			m_SysExStreamData[0] = m_SysExStreamData[SysExStreamChunkSize];
+			m_nSysExStreamLength = 1;
+		}
+
+		m_SysExStreamData[m_nSysExStreamLength++] = pData[i];
+	}
+
+	if (bComplete)
+	{
+		// The held back byte is the message's checksum; the data has already been played, so just report a mismatch
+		if (m_nSysExStreamLength)
+		{
+			const u8 nChecksum = m_SysExStreamData[--m_nSysExStreamLength];
+			PlaySysExStreamData(m_nSysExStreamLength, nTimestamp);
 
-			default:
-				break;
+			if ((m_nSysExStreamChecksum + nChecksum) & 0x7F)
+				CLogger::Get()->Write(MT32SynthName, LogWarning, "Checksum error in streamed SysEx message");
 		}
 
-		m_pSampleRateConverter = new MT32Emu::SampleRateConverter(*m_pSynth, m_nSampleRate, quality);
+		m_bSysExStreaming = false;
 	}
 
 	return true;
 }
 
-void CMT32Synth::HandleMIDIShortMessage(u32 nMessage)
+void CMT32Synth::PlaySysExStreamData(size_t nSize, unsigned int nTimestamp)
 {
-	// TODO: timestamping
-	m_pSynth->playMsg(nMessage);
+	if (!nSize)
+		return;
+
+	u8 Message[SysExStreamChunkSize + 10] = {
+		0xF0, 0x41, m_nSysExStreamDeviceID, 0x16, 0x12,
+		static_cast<u8>(m_nSysExStreamAddress >> 14 & 0x7F),
+		static_cast<u8>(m_nSysExStreamAddress >> 7 & 0x7F),
+		static_cast<u8>(m_nSysExStreamAddress & 0x7F),
+	};
+
+	u8 nDataSum = 0;
+	for (size_t i = 0; i < nSize; ++i)
+	{
+		Message[8 + i] = m_SysExStreamData[i];
+		nDataSum += m_SysExStreamData[i];
+	}
+
+	const u8 nSum = Message[5] + Message[6] + Message[7] + nDataSum;
+	Message[8 + nSize] = (128 - (nSum & 0x7F)) & 0x7F;
+	Message[9 + nSize] = 0xF7;
+
+	HandleMIDISysExMessage(Message, nSize + 10, nTimestamp);
+
+	m_nSysExStreamChecksum += nDataSum;
+	m_nSysExStreamAddress += nSize;
 }
 
-void CMT32Synth::HandleMIDISysExMessage(const u8* pData, size_t nSize)
+void CMT32Synth::PlayMIDIShortMessage(u32 nMessage, unsigned int nTimestamp)
 {
-	// TODO: timestamping
-	m_pSynth->playSysex(pData, nSize);
+	m_pSynth->playMsg(nMessage, GetMIDITimestamp(nTimestamp));
+}
+
+void CMT32Synth::PlayMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	m_pSynth->playSysex(pData, nSize, GetMIDITimestamp(nTimestamp));
 }
 
 void CMT32Synth::AllSoundOff()
 {
+	// Don't let queued notes play after this
+	ProcessMIDICommands();
+
 	// Stop all sound immediately; mt32emu treats CC 0x7C like "All Sound Off", ignoring pedal
 	for (uint8_t i = 0; i < 8; ++i)
 		m_pSynth->playMsgOnPart(i, 0x0B, 0x7C, 0);
@@ -142,11 +380,17 @@ void CMT32Synth::SetMasterVolume(u8 nVolume)
 
 size_t CMT32Synth::Render(s16* pOutBuffer, size_t nFrames)
 {
+	const unsigned int nRenderStartTime = CTimer::GetClockTicks();
+
 	m_Lock.Acquire();
-	if (m_pSampleRateConverter)
+	DrainMIDICommands();
+	if (m_pPolyphaseResampler)
+		m_pPolyphaseResampler->GetOutputSamples(pOutBuffer, nFrames);
+	else if (m_pSampleRateConverter)
 		m_pSampleRateConverter->getOutputSamples(pOutBuffer, nFrames);
 	else
 		m_pSynth->render(pOutBuffer, nFrames);
+	UpdateRenderTiming(nRenderStartTime);
 	m_Lock.Release();
 
 	return nFrames;
@@ -154,16 +398,36 @@ size_t CMT32Synth::Render(s16* pOutBuffer, size_t nFrames)
 
 size_t CMT32Synth::Render(float* pOutBuffer, size_t nFrames)
 {
+	const unsigned int nRenderStartTime = CTimer::GetClockTicks();
+
 	m_Lock.Acquire();
-	if (m_pSampleRateConverter)
+	DrainMIDICommands();
+	if (m_pPolyphaseResampler)
+		m_pPolyphaseResampler->GetOutputSamples(pOutBuffer, nFrames);
+	else if (m_pSampleRateConverter)
 		m_pSampleRateConverter->getOutputSamples(pOutBuffer, nFrames);
 	else
 		m_pSynth->render(pOutBuffer, nFrames);
+	UpdateRenderTiming(nRenderStartTime);
 	m_Lock.Release();
 
 	return nFrames;
 }
 
+void CMT32Synth::UpdateRenderTiming(unsigned int nRenderStartTime)
+{
+	// mt32emu timestamps are measured in samples at its internal sample rate
+	const MT32Emu::Bit32u nRenderedSampleCount = m_pSynth->getInternalRenderedSampleCount();
+	CSynthBase::UpdateRenderTiming(nRenderStartTime, nRenderedSampleCount, nRenderedSampleCount - m_nRenderedSampleCount);
+	m_nRenderedSampleCount = nRenderedSampleCount;
+}
+
+MT32Emu::Bit32u CMT32Synth::GetMIDITimestamp(unsigned int nTimestamp) const
+{
+	// The timeline counts samples at mt32emu's internal rate, whatever the output rate is
+	return GetTimelinePosition(nTimestamp, MT32Emu::SAMPLE_RATE);
+}
+
 u8 CMT32Synth::GetChannelVelocities(u8* pOutVelocities, size_t nMaxChannels)
 {
 	u8 Keys[MT32Emu::DEFAULT_MAX_PARTIALS];
@@ -189,12 +453,50 @@ u8 CMT32Synth::GetChannelVelocities(u8* pOutVelocities, size_t nMaxChannels)
 	return nMaxChannels;
 }
 
+u32 CMT32Synth::GetActiveVoiceCount()
+{
+	// The MT-32's polyphony is measured in partials
+	const size_t nPartials = m_pSynth->getPartialCount();
+	MT32Emu::PartialState PartialStates[nPartials];
+	m_pSynth->getPartialStates(PartialStates);
+
+	u32 nActivePartials = 0;
+	for (size_t i = 0; i < nPartials; ++i)
+	{
+		if (PartialStates[i] != MT32Emu::PartialState_INACTIVE)
+			++nActivePartials;
+	}
+
+	return nActivePartials;
+}
+
 void CMT32Synth::ReportStatus() const
 {
 	if (m_pLCD)
 		m_pLCD->OnSystemMessage(GetControlROMName());
 }
 
+void CMT32Synth::SetGain(float nGain, float nReverbGain)
+{
+	m_Lock.Acquire();
+	m_nGain       = nGain;
+	m_nReverbGain = nReverbGain;
+
+	// Cached synths keep their gain when they're swapped in
+	for (size_t i = 0; i < ROMSetCount; ++i)
+	{
+		if (m_pCachedSynths[i] && m_pCachedSynths[i] != m_pSynth)
+		{
+			m_pCachedSynths[i]->setOutputGain(m_nGain);
+			m_pCachedSynths[i]->setReverbOutputGain(m_nReverbGain);
+		}
+	}
+
+	m_pSynth->setOutputGain(m_nGain);
+	m_pSynth->setReverbOutputGain(m_nReverbGain);
+	m_Lock.Release();
+}
+
 void CMT32Synth::SetMIDIChannels(TMIDIChannels Channels)
 {
 	if (Channels == TMIDIChannels::Standard)
@@ -203,8 +505,65 @@ void CMT32Synth::SetMIDIChannels(TMIDIChannels Channels)
 		m_pSynth->writeSysex(0x10, AlternateMIDIChannelsSysEx, sizeof(AlternateMIDIChannelsSysEx));
 }
 
+void CMT32Synth::SetResamplerQuality(TResamplerQuality ResamplerQuality)
+{
+	if (ResamplerQuality == m_ResamplerQuality)
+		return;
+
+	m_ResamplerQuality = ResamplerQuality;
+	if (!m_pSynth)
+		return;
+
+	// Build the new converters outside of the lock so rendering isn't held up, then swap them in
+	CPolyphaseResampler* pPolyphaseResampler           = CreatePolyphaseResampler(*m_pSynth);
+	MT32Emu::SampleRateConverter* pSampleRateConverter = pPolyphaseResampler ? nullptr : CreateSampleRateConverter(*m_pSynth);
+
+	CPolyphaseResampler* CachedPolyphaseResamplers[ROMSetCount]           = {nullptr};
+	MT32Emu::SampleRateConverter* CachedSampleRateConverters[ROMSetCount] = {nullptr};
+	for (size_t i = 0; i < ROMSetCount; ++i)
+	{
+		if (m_pCachedSynths[i] == m_pSynth)
+		{
+			CachedPolyphaseResamplers[i]  = pPolyphaseResampler;
+			CachedSampleRateConverters[i] = pSampleRateConverter;
+		}
+		else if (m_pCachedSynths[i])
+		{
+			CachedPolyphaseResamplers[i]  = CreatePolyphaseResampler(*m_pCachedSynths[i]);
+			CachedSampleRateConverters[i] = CachedPolyphaseResamplers[i] ? nullptr : CreateSampleRateConverter(*m_pCachedSynths[i]);
+		}
+	}
+
+	m_Lock.Acquire();
+	Utility::Swap(m_pPolyphaseResampler, pPolyphaseResampler);
+	Utility::Swap(m_pSampleRateConverter, pSampleRateConverter);
+	for (size_t i = 0; i < ROMSetCount; ++i)
+	{
+		Utility::Swap(m_pCachedPolyphaseResamplers[i], CachedPolyphaseResamplers[i]);
+		Utility::Swap(m_pCachedSampleRateConverters[i], CachedSampleRateConverters[i]);
+	}
+	m_Lock.Release();
+
+	// Free the old ones; the current synth's may also be in the cache
+	for (size_t i = 0; i < ROMSetCount; ++i)
+	{
+		if (CachedPolyphaseResamplers[i] && CachedPolyphaseResamplers[i] != pPolyphaseResampler)
+			delete CachedPolyphaseResamplers[i];
+
+		if (CachedSampleRateConverters[i] && CachedSampleRateConverters[i] != pSampleRateConverter)
+			delete CachedSampleRateConverters[i];
+	}
+
+	if (pPolyphaseResampler)
+		delete pPolyphaseResampler;
+
+	if (pSampleRateConverter)
+		delete pSampleRateConverter;
+}
+
 bool CMT32Synth::SwitchROMSet(TMT32ROMSet ROMSet)
 {
+	TMT32ROMSet NewROMSet;
 	const MT32Emu::ROMImage* pControlROMImage;
 	const MT32Emu::ROMImage* pPCMROMImage;
 
@@ -217,19 +576,65 @@ bool CMT32Synth::SwitchROMSet(TMT32ROMSet ROMSet)
 	}
 
 	// Get ROM set if available
-	if (!m_ROMManager.GetROMSet(ROMSet, m_CurrentROMSet, pControlROMImage, pPCMROMImage))
+	if (!m_ROMManager.GetROMSet(ROMSet, NewROMSet, pControlROMImage, pPCMROMImage))
 	{
 		if (m_pLCD)
 			m_pLCD->OnSystemMessage("ROM set not avail!");
 		return false;
 	}
 
-	// Reopen synth with new ROMs
+	const size_t nNewROMSetIndex = static_cast<size_t>(NewROMSet);
+
+	// A set that appeared after caching (e.g. from a USB disk) gets a synth of its own, opened before taking the lock;
+	// a cached synth belongs to the set it was opened with, so it's never reopened with other ROMs
+	if (m_bROMSetsCached && !m_pCachedSynths[nNewROMSetIndex])
+	{
+		MT32Emu::Synth* const pSynth = OpenSynth(*pControlROMImage, *pPCMROMImage);
+		if (!pSynth)
+		{
+			CLogger::Get()->Write(MT32SynthName, LogWarning, "Couldn't open ROM set %d for caching", static_cast<int>(NewROMSet));
+			if (m_pLCD)
+				m_pLCD->OnSystemMessage("ROM set not avail!");
+			return false;
+		}
+
+		m_pCachedPolyphaseResamplers[nNewROMSetIndex]  = CreatePolyphaseResampler(*pSynth);
+		m_pCachedSampleRateConverters[nNewROMSetIndex] = m_pCachedPolyphaseResamplers[nNewROMSetIndex] ? nullptr : CreateSampleRateConverter(*pSynth);
+		m_pCachedSynths[nNewROMSetIndex]               = pSynth;
+	}
+
 	m_Lock.Acquire();
-	m_pSynth->close();
-	assert(m_pSynth->open(*pControlROMImage, *pPCMROMImage));
-	m_pSynth->setOutputGain(m_nGain);
-	m_pSynth->setReverbOutputGain(m_nReverbGain);
+	DiscardMIDICommands();
+
+	if (m_bROMSetsCached)
+	{
+		// Silence the outgoing synth so nothing resumes when it's selected again
+		for (uint8_t i = 0; i < 8; ++i)
+			m_pSynth->playMsgOnPart(i, 0x0B, 0x7C, 0);
+
+		// Swap in the already opened synth, resetting it to the same state a reopen would leave it in
+		m_pSynth               = m_pCachedSynths[nNewROMSetIndex];
+		m_pSampleRateConverter = m_pCachedSampleRateConverters[nNewROMSetIndex];
+		m_pPolyphaseResampler  = m_pCachedPolyphaseResamplers[nNewROMSetIndex];
+		for (uint8_t i = 0; i < 8; ++i)
+			m_pSynth->playMsgOnPart(i, 0x0B, 0x7C, 0);
+		m_pSynth->writeSysex(0x10, ResetSysEx, sizeof(ResetSysEx));
+	}
+	else
+	{
+		// Reopen synth with new ROMs
+		SynthOpenLock.Acquire();
+		m_pSynth->close();
+		assert(m_pSynth->open(*pControlROMImage, *pPCMROMImage));
+		SynthOpenLock.Release();
+		m_pSynth->setOutputGain(m_nGain);
+		m_pSynth->setReverbOutputGain(m_nReverbGain);
+	}
+
+	// Reopening may restart the sample counter
+	m_nRenderedSampleCount = m_pSynth->getInternalRenderedSampleCount();
+	CSynthBase::UpdateRenderTiming(CTimer::GetClockTicks(), m_nRenderedSampleCount, 0);
+	m_CurrentROMSet = NewROMSet;
 	m_Lock.Release();
 
 	m_pControlROMImage = pControlROMImage;
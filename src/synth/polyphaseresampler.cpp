@@ -0,0 +1,206 @@
+//
+// polyphaseresampler.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define POLYPHASE_RESAMPLER_NEON
+#endif
+
+#include <assert.h>
+#include <circle/util.h>
+
+#include <cmath>
+
+#include "synth/polyphaseresampler.h"
+#include "utility.h"
+
+constexpr float Pi = 3.14159265358979f;
+
+// Passband edge as a fraction of the input Nyquist frequency
+constexpr float CutoffRatio = 0.9f;
+
+constexpr float Sample16BitMax = (1 << (16 - 1)) - 1;
+
+namespace
+{
+	size_t GreatestCommonDivisor(size_t nA, size_t nB)
+	{
+		while (nB)
+		{
+			const size_t nRemainder = nA % nB;
+			nA = nB;
+			nB = nRemainder;
+		}
+
+		return nA;
+	}
+
+	inline float DotProduct(const float* pCoefficients, const float* pInput, size_t nTaps)
+	{
+		size_t i = 0;
+		float nSum = 0.0f;
+
+#ifdef POLYPHASE_RESAMPLER_NEON
+		float32x4_t Sum = vdupq_n_f32(0.0f);
+		for (; i + 4 <= nTaps; i += 4)
+			Sum = vmlaq_f32(Sum, vld1q_f32(pCoefficients + i), vld1q_f32(pInput + i));
+
+#ifdef __aarch64__
+		nSum = vaddvq_f32(Sum);
+#else
+		const float32x2_t Pair = vadd_f32(vget_low_f32(Sum), vget_high_f32(Sum));
+		nSum = vget_lane_f32(vpadd_f32(Pair, Pair), 0);
+#endif
+#endif
+
+		for (; i < nTaps; ++i)
+			nSum += pCoefficients[i] * pInput[i];
+
+		return nSum;
+	}
+
+	inline void StoreFrame(float* pOutBuffer, float nLeft, float nRight)
+	{
+		pOutBuffer[0] = nLeft;
+		pOutBuffer[1] = nRight;
+	}
+
+	inline void StoreFrame(s16* pOutBuffer, float nLeft, float nRight)
+	{
+		pOutBuffer[0] = Utility::Clamp(nLeft, -1.0f, 1.0f) * Sample16BitMax;
+		pOutBuffer[1] = Utility::Clamp(nRight, -1.0f, 1.0f) * Sample16BitMax;
+	}
+}
+
+CPolyphaseResampler::CPolyphaseResampler(MT32Emu::Synth& Synth, unsigned int nInputRate, unsigned int nOutputRate)
+	: m_Synth(Synth),
+
+	  m_nInterpolation(0),
+	  m_nDecimation(0),
+
+	  m_Coefficients{{0}},
+
+	  m_InputLeft{0},
+	  m_InputRight{0},
+	  m_nInputFrames(HistoryFrames),
+
+	  m_nPosition(HistoryFrames),
+	  m_nPhase(0)
+{
+	assert(IsSupported(nInputRate, nOutputRate));
+
+	const size_t nDivisor = GreatestCommonDivisor(nOutputRate, nInputRate);
+	m_nInterpolation      = nOutputRate / nDivisor;
+	m_nDecimation         = nInputRate / nDivisor;
+
+	// Blackman-windowed sinc low-pass at the upsampled rate, cutting off just below the input's Nyquist frequency
+	const size_t nTaps    = m_nInterpolation * TapsPerPhase;
+	const float nCutoff   = CutoffRatio * 0.5f / m_nInterpolation;
+	const float nCentre   = (nTaps - 1) * 0.5f;
+	float PhaseSums[MaxPhases] = {0};
+
+	for (size_t i = 0; i < nTaps; ++i)
+	{
+		const float nX      = i - nCentre;
+		const float nSinc   = nX == 0.0f ? 2.0f * nCutoff : std::sin(2.0f * Pi * nCutoff * nX) / (Pi * nX);
+		const float nWindow = 0.42f - 0.5f * std::cos(2.0f * Pi * i / (nTaps - 1)) + 0.08f * std::cos(4.0f * Pi * i / (nTaps - 1));
+
+		// Tap i belongs to phase i % L, and applies to the input i / L frames before the newest
+		const size_t nPhase = i % m_nInterpolation;
+		m_Coefficients[nPhase][TapsPerPhase - 1 - i / m_nInterpolation] = nSinc * nWindow;
+		PhaseSums[nPhase] += nSinc * nWindow;
+	}
+
+	// Unity gain at DC for every phase
+	for (size_t i = 0; i < m_nInterpolation; ++i)
+	{
+		for (size_t j = 0; j < TapsPerPhase; ++j)
+			m_Coefficients[i][j] /= PhaseSums[i];
+	}
+}
+
+bool CPolyphaseResampler::IsSupported(unsigned int nInputRate, unsigned int nOutputRate)
+{
+	if (!nInputRate || nOutputRate <= nInputRate)
+		return false;
+
+	return nOutputRate / GreatestCommonDivisor(nOutputRate, nInputRate) <= MaxPhases;
+}
+
+void CPolyphaseResampler::GetOutputSamples(float* pOutBuffer, size_t nFrames)
+{
+	Resample(pOutBuffer, nFrames);
+}
+
+void CPolyphaseResampler::GetOutputSamples(s16* pOutBuffer, size_t nFrames)
+{
+	Resample(pOutBuffer, nFrames);
+}
+
+template <class T>
+void CPolyphaseResampler::Resample(T* pOutBuffer, size_t nFrames)
+{
+	for (size_t i = 0; i < nFrames; ++i)
+	{
+		// Render just enough input for the rest of the output once the next frame needs more
+		if (m_nPosition == m_nInputFrames)
+		{
+			const size_t nNeeded = (m_nPhase + (nFrames - i - 1) * m_nDecimation) / m_nInterpolation + 1;
+			RenderInput(Utility::Min(nNeeded, MaxInputFrames));
+		}
+
+		const float* pCoefficients = m_Coefficients[m_nPhase];
+		const size_t nStart        = m_nPosition + 1 - TapsPerPhase;
+		StoreFrame(pOutBuffer + i * 2,
+				   DotProduct(pCoefficients, m_InputLeft + nStart, TapsPerPhase),
+				   DotProduct(pCoefficients, m_InputRight + nStart, TapsPerPhase));
+
+		// Output rate is higher than input rate, so this advances by at most one input frame
+		m_nPhase += m_nDecimation;
+		if (m_nPhase >= m_nInterpolation)
+		{
+			m_nPhase -= m_nInterpolation;
+			++m_nPosition;
+		}
+	}
+}
+
+void CPolyphaseResampler::RenderInput(size_t nFrames)
+{
+	// Move the history the filter still needs to the front
+	const size_t nDiscard = m_nInputFrames - HistoryFrames;
+	memmove(m_InputLeft, m_InputLeft + nDiscard, HistoryFrames * sizeof(*m_InputLeft));
+	memmove(m_InputRight, m_InputRight + nDiscard, HistoryFrames * sizeof(*m_InputRight));
+	m_nInputFrames = HistoryFrames;
+	m_nPosition -= nDiscard;
+
+	float Buffer[MaxInputFrames * 2];
+	m_Synth.render(Buffer, nFrames);
+
+	for (size_t i = 0; i < nFrames; ++i)
+	{
+		m_InputLeft[m_nInputFrames + i]  = Buffer[i * 2];
+		m_InputRight[m_nInputFrames + i] = Buffer[i * 2 + 1];
+	}
+
+	m_nInputFrames += nFrames;
+}
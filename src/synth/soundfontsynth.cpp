@@ -22,9 +22,14 @@
 
 #include <fatfs/ff.h>
 #include <circle/logger.h>
+#include <circle/synchronize.h>
 #include <circle/timer.h>
+#include <circle/util.h>
+
+#include <cmath>
 
 #include "config.h"
+#include "mixer.h"
 #include "synth/gmsysex.h"
 #include "synth/rolandsysex.h"
 #include "synth/soundfontsynth.h"
@@ -34,6 +39,12 @@
 const char SoundFontSynthName[] = "soundfontsynth";
 const char SoundFontPath[] = "soundfonts";
 
+// Heap used by FluidSynth, for reporting the memory taken by a SoundFont
+static size_t GetFluidSynthHeapUsed()
+{
+	return CZoneAllocator::Get()->GetStats().nTagUsedBytes[TZoneTag::FluidSynth];
+}
+
 extern "C"
 {
 	// Replacements for fluid_sys.c functions
@@ -127,24 +138,60 @@ extern "C"
 	}
 }
 
-CSoundFontSynth::CSoundFontSynth(unsigned nSampleRate, float nGain, u32 nPolyphony)
+CSoundFontSynth::CSoundFontSynth(unsigned nSampleRate, float nGain, u32 nPolyphony, int nVoiceCullFloor, bool bSplitRender, bool bDynamicSampleLoading)
 	: CSynthBase(nSampleRate),
 
 	  m_pSettings(nullptr),
 	  m_pSynth(nullptr),
 
+	  m_bSplitRender(bSplitRender),
+	  m_SecondaryLock(TASK_LEVEL),
+	  m_pSecondarySynth(nullptr),
+
+	  m_bDynamicSampleLoading(bDynamicSampleLoading),
+	  m_pLoaderSettings(nullptr),
+	  m_pLoaderSynth(nullptr),
+
+	  m_bSampleLoadingDeferred(false),
+	  m_DeferredMIDIBuffer{0},
+	  m_nDeferredMIDIBytes(0),
+
+	  m_nPrimaryPosition(0),
+	  m_nSecondaryPosition(0),
+	  m_nLastEventPosition(0),
+
+	  m_PrimaryVelocities{0, {0}},
+	  m_SecondaryVelocities{0, {0}},
+
+	  m_nVoiceCullFloor(Utility::Clamp(nVoiceCullFloor, 0, 96)),
+	  m_PrimaryCullState{{0}, {0}},
+	  m_SecondaryCullState{{0}, {0}},
+
 	  m_nInitialGain(nGain),
 	  m_nCurrentGain(nGain),
 
 	  m_nPolyphony(nPolyphony),
-	  m_nCurrentSoundFontIndex(0)
+	  m_nCurrentSoundFontIndex(0),
+
+	  m_bPreloadEnabled(false),
+	  m_PreloadLock(TASK_LEVEL),
+	  m_PreloadState(TPreloadState::Idle),
+	  m_nPreloadIndex(0),
+	  m_pPreloadSynth(nullptr)
 {
 }
 
 CSoundFontSynth::~CSoundFontSynth()
 {
-	if (m_pSynth)
-		delete_fluid_synth(m_pSynth);
+	// The other cores have stopped by now, so a load that never started can simply be dropped
+	if (m_PreloadState != TPreloadState::Loading)
+		DiscardPreload();
+	DestroySynths();
+
+	if (m_pLoaderSynth)
+		delete_fluid_synth(m_pLoaderSynth);
+	if (m_pLoaderSettings)
+		delete_fluid_settings(m_pLoaderSettings);
 
 	if (m_pSettings)
 		delete_fluid_settings(m_pSettings);
@@ -188,11 +235,216 @@ bool CSoundFontSynth::Initialize()
 
 	fluid_settings_setnum(m_pSettings, "synth.sample-rate", static_cast<double>(m_nSampleRate));
 	fluid_settings_setint(m_pSettings, "synth.threadsafe-api", false);
+	fluid_settings_setint(m_pSettings, "synth.dynamic-sample-loading", m_bDynamicSampleLoading);
+
+	// When out of voices, take released notes before held ones regardless of age (FluidSynth's default is -2000)
+	if (m_nVoiceCullFloor)
+		fluid_settings_setnum(m_pSettings, "synth.overflow.released", -4000.0);
+
+	if (m_bDynamicSampleLoading)
+		CreateLoaderSynth();
 
 	return Reinitialize(pSoundFontPath);
 }
 
-void CSoundFontSynth::HandleMIDIShortMessage(u32 nMessage)
+void CSoundFontSynth::CreateLoaderSynth()
+{
+	// It's never rendered, so it only needs a single voice
+	m_pLoaderSettings = new_fluid_settings();
+	if (!m_pLoaderSettings)
+		return;
+
+	fluid_settings_setnum(m_pLoaderSettings, "synth.sample-rate", static_cast<double>(m_nSampleRate));
+	fluid_settings_setint(m_pLoaderSettings, "synth.threadsafe-api", false);
+	fluid_settings_setint(m_pLoaderSettings, "synth.dynamic-sample-loading", true);
+	fluid_settings_setint(m_pLoaderSettings, "synth.polyphony", 1);
+	fluid_settings_setint(m_pLoaderSettings, "synth.reverb.active", false);
+	fluid_settings_setint(m_pLoaderSettings, "synth.chorus.active", false);
+
+	m_pLoaderSynth = new_fluid_synth(m_pLoaderSettings);
+	if (!m_pLoaderSynth)
+		CLogger::Get()->Write(SoundFontSynthName, LogWarning, "Failed to create loader synth; presets will load while rendering is held up");
+}
+
+void CSoundFontSynth::ShareSoundFontWithLoader(fluid_sfont_t* pSoundFont)
+{
+	if (!m_pLoaderSynth)
+		return;
+
+	if (fluid_synth_add_sfont(m_pLoaderSynth, pSoundFont) == FLUID_FAILED)
+	{
+		CLogger::Get()->Write(SoundFontSynthName, LogWarning, "Failed to share SoundFont with loader synth");
+		return;
+	}
+
+	// Adding a SoundFont selects the default presets on every channel; let go of them until they're needed
+	const int nChannels = fluid_synth_count_midi_channels(m_pLoaderSynth);
+	for (int nChannel = 0; nChannel < nChannels; ++nChannel)
+		fluid_synth_unset_program(m_pLoaderSynth, nChannel);
+}
+
+void CSoundFontSynth::UnshareSoundFontWithLoader(fluid_sfont_t* pSoundFont)
+{
+	if (m_pLoaderSynth && pSoundFont)
+		fluid_synth_remove_sfont(m_pLoaderSynth, pSoundFont);
+}
+
+bool CSoundFontSynth::LoadPresetSamples(u32 nMessage)
+{
+	if (!m_pLoaderSynth)
+		return false;
+
+	const u8 nStatus = nMessage & 0xFF;
+	if (nStatus == 0xFF)
+		return LoadDefaultPresetSamples();
+
+	if ((nStatus & 0xF0) != 0xC0)
+		return false;
+
+	// The preset comes from the channel's current bank; bring it up to date first
+	const u8 nChannel = nStatus & 0x0F;
+	int nSoundFontID, nBank, nProgram;
+
+	AcquireAll();
+	DrainMIDICommands();
+	FlushAllEvents();
+	const bool bValid = fluid_synth_get_program(GetChannelSynth(nChannel), nChannel, &nSoundFontID, &nBank, &nProgram) == FLUID_OK;
+	ReleaseAll();
+
+	if (!bValid)
+		return false;
+
+	fluid_synth_bank_select(m_pLoaderSynth, 0, nBank);
+	fluid_synth_program_change(m_pLoaderSynth, 0, (nMessage >> 8) & 0x7F);
+	return true;
+}
+
+bool CSoundFontSynth::LoadDefaultPresetSamples()
+{
+	if (!m_pLoaderSynth)
+		return false;
+
+	// Resets select the first melodic preset, and the first drum kit on drum channels
+	fluid_synth_bank_select(m_pLoaderSynth, 0, 0);
+	fluid_synth_program_change(m_pLoaderSynth, 0, 0);
+	fluid_synth_bank_select(m_pLoaderSynth, 1, 128);
+	fluid_synth_program_change(m_pLoaderSynth, 1, 0);
+	return true;
+}
+
+void CSoundFontSynth::ReleasePresetSamples()
+{
+	// The live synths hold on to the samples they selected; anything else is freed
+	fluid_synth_unset_program(m_pLoaderSynth, 0);
+	fluid_synth_unset_program(m_pLoaderSynth, 1);
+}
+
+bool CSoundFontSynth::SelectsDefaultPresets(const u8* pData, size_t nSize)
+{
+	if (nSize == sizeof(TGMModeOnSysExMessage))
+		return reinterpret_cast<const TGMModeOnSysExMessage&>(*pData).IsValid();
+
+	if (nSize == RolandSingleDataByteMessageSize)
+		return reinterpret_cast<const TRolandGSResetSysExMessage&>(*pData).IsValid() ||
+		       reinterpret_cast<const TRolandSystemModeSetSysExMessage&>(*pData).IsValid() ||
+		       reinterpret_cast<const TRolandUseForRhythmPartSysExMessage&>(*pData).IsValid();
+
+	return false;
+}
+
+void CSoundFontSynth::HandleMIDIShortMessage(u32 nMessage, unsigned int nTimestamp)
+{
+	// Bank selects are held back too, so that each preset is selected from the same bank when played later
+	if (m_bSampleLoadingDeferred && (SelectsPreset(nMessage) || SelectsBank(nMessage)))
+	{
+		const u8 Data[] = {static_cast<u8>(nMessage), static_cast<u8>(nMessage >> 8), static_cast<u8>(nMessage >> 16)};
+		const u8 nStatus = Data[0];
+		DeferMIDIMessage(Data, nStatus == 0xFF ? 1 : (nStatus & 0xF0) == 0xC0 ? 2 : 3);
+		return;
+	}
+
+	// Selecting a preset may read its samples from disk; keep this off the render thread
+	if (m_bDynamicSampleLoading && SelectsPreset(nMessage))
+	{
+		PlayShortMessageNow(nMessage);
+		return;
+	}
+
+	if (QueueMIDIShortMessage(nMessage, nTimestamp))
+		return;
+
+	// The render thread also fills the event queues while draining commands, so take its locks to stay the only producer
+	AcquireAll();
+	DrainMIDICommands();
+	PlayMIDIShortMessage(nMessage, nTimestamp);
+	ReleaseAll();
+}
+
+void CSoundFontSynth::PlayMIDIShortMessage(u32 nMessage, unsigned int nTimestamp)
+{
+	const u8 nStatus  = nMessage & 0xFF;
+	const u8 nChannel = nMessage & 0x0F;
+
+	// Keep events in arrival order, even if the render timing moved underneath us
+	u32 nPosition = GetTimelinePosition(nTimestamp, m_nSampleRate);
+	if (static_cast<s32>(nPosition - m_nLastEventPosition) < 0)
+		nPosition = m_nLastEventPosition;
+	m_nLastEventPosition = nPosition;
+
+	const TTimedMIDIMessage Message{nPosition, nMessage};
+
+	// System reset goes to all synth instances
+	if (nStatus == 0xFF)
+	{
+		QueueShortMessage(m_PrimaryEventQueue, m_pSynth, Message);
+		if (m_pSecondarySynth)
+			QueueShortMessage(m_SecondaryEventQueue, m_pSecondarySynth, Message);
+		return;
+	}
+
+	// Channel messages only need to reach the synth instance that owns the channel
+	QueueShortMessage(GetChannelEventQueue(nChannel), GetChannelSynth(nChannel), Message);
+}
+
+void CSoundFontSynth::PlayShortMessageNow(u32 nMessage)
+{
+	const u8 nStatus  = nMessage & 0xFF;
+	const u8 nChannel = nMessage & 0x0F;
+
+	// Read the samples from disk before taking the render locks
+	const bool bLoaded = LoadPresetSamples(nMessage);
+
+	// Play everything that arrived earlier first to keep messages in order
+	AcquireAll();
+	DrainMIDICommands();
+	FlushAllEvents();
+
+	if (nStatus == 0xFF)
+	{
+		PlayShortMessage(m_pSynth, nMessage);
+		if (m_pSecondarySynth)
+			PlayShortMessage(m_pSecondarySynth, nMessage);
+	}
+	else
+		PlayShortMessage(GetChannelSynth(nChannel), nMessage);
+
+	ReleaseAll();
+
+	if (bLoaded)
+		ReleasePresetSamples();
+}
+
+void CSoundFontSynth::QueueShortMessage(TMIDIEventQueue& Queue, fluid_synth_t* pSynth, const TTimedMIDIMessage& Message)
+{
+	if (Queue.Enqueue(Message))
+		return;
+
+	// Queue is full; play everything now
+	FlushEvents(pSynth, Queue);
+	PlayShortMessage(pSynth, Message.nMessage);
+}
+
+void CSoundFontSynth::PlayShortMessage(fluid_synth_t* pSynth, u32 nMessage)
 {
 	const u8 nStatus  = nMessage & 0xFF;
 	const u8 nChannel = nMessage & 0x0F;
@@ -202,67 +454,191 @@ void CSoundFontSynth::HandleMIDIShortMessage(u32 nMessage)
 	// Handle system real-time messages
 	if (nStatus == 0xFF)
 	{
-		m_Lock.Acquire();
-		fluid_synth_system_reset(m_pSynth);
-		m_Lock.Release();
+		fluid_synth_system_reset(pSynth);
 		return;
 	}
 
-	m_Lock.Acquire();
-
 	// Handle channel messages
 	switch (nStatus & 0xF0)
 	{
 		// Note off
 		case 0x80:
-			fluid_synth_noteoff(m_pSynth, nChannel, nData1);
+			fluid_synth_noteoff(pSynth, nChannel, nData1);
 			break;
 
 		// Note on
 		case 0x90:
-			fluid_synth_noteon(m_pSynth, nChannel, nData1, nData2);
+			fluid_synth_noteon(pSynth, nChannel, nData1, nData2);
 			break;
 
 		// Polyphonic key pressure/aftertouch
 		case 0xA0:
-			fluid_synth_key_pressure(m_pSynth, nChannel, nData1, nData2);
+			fluid_synth_key_pressure(pSynth, nChannel, nData1, nData2);
 			break;
 
 		// Control change
 		case 0xB0:
-			fluid_synth_cc(m_pSynth, nChannel, nData1, nData2);
+			fluid_synth_cc(pSynth, nChannel, nData1, nData2);
 			break;
 
 		// Program change
 		case 0xC0:
-			fluid_synth_program_change(m_pSynth, nChannel, nData1);
+			fluid_synth_program_change(pSynth, nChannel, nData1);
 			break;
 
 		// Channel pressure/aftertouch
 		case 0xD0:
-			fluid_synth_channel_pressure(m_pSynth, nChannel, nData1);
+			fluid_synth_channel_pressure(pSynth, nChannel, nData1);
 			break;
 
 		// Pitch bend
 		case 0xE0:
-			fluid_synth_pitch_bend(m_pSynth, nChannel, (nData2 << 7) | nData1);
+			fluid_synth_pitch_bend(pSynth, nChannel, (nData2 << 7) | nData1);
 			break;
 	}
+}
 
-	m_Lock.Release();
+void CSoundFontSynth::FlushEvents(fluid_synth_t* pSynth, TMIDIEventQueue& Queue)
+{
+	TTimedMIDIMessage Message;
+	while (Queue.Dequeue(Message))
+		PlayShortMessage(pSynth, Message.nMessage);
+}
+
+void CSoundFontSynth::FlushAllEvents()
+{
+	FlushEvents(m_pSynth, m_PrimaryEventQueue);
+	if (m_pSecondarySynth)
+		FlushEvents(m_pSecondarySynth, m_SecondaryEventQueue);
 }
 
-void CSoundFontSynth::HandleMIDISysExMessage(const u8* pData, size_t nSize)
+void CSoundFontSynth::DiscardEvents(TMIDIEventQueue& Queue)
 {
+	TTimedMIDIMessage Message;
+	while (Queue.Dequeue(Message))
+		;
+}
+
+void CSoundFontSynth::RenderWithEvents(fluid_synth_t* pSynth, TMIDIEventQueue& Queue, u32& nPosition, void* pOutBuffer, size_t nFrames, TWriteFunction pWriteFunction)
+{
+	size_t nRendered = 0;
+	TTimedMIDIMessage Message;
+
+	// Split the chunk at each event that falls inside it
+	while (Queue.Peek(Message))
+	{
+		const s32 nOffset = static_cast<s32>(Message.nPosition - nPosition);
+
+		// Belongs to a later chunk
+		if (nOffset >= static_cast<s32>(nFrames))
+			break;
+
+		if (nOffset > static_cast<s32>(nRendered))
+		{
+			assert(pWriteFunction(pSynth, nOffset - nRendered, pOutBuffer, nRendered * 2, 2, pOutBuffer, nRendered * 2 + 1, 2) == FLUID_OK);
+			nRendered = nOffset;
+		}
+
+		PlayShortMessage(pSynth, Message.nMessage);
+		Queue.Dequeue(Message);
+	}
+
+	if (nRendered < nFrames)
+		assert(pWriteFunction(pSynth, nFrames - nRendered, pOutBuffer, nRendered * 2, 2, pOutBuffer, nRendered * 2 + 1, 2) == FLUID_OK);
+
+	nPosition += nFrames;
+}
+
+void CSoundFontSynth::HandleMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	// Resets reselect every channel's preset, which may read samples from disk; keep this off the render thread
+	if (!m_bDynamicSampleLoading && QueueMIDISysExMessage(pData, nSize, nTimestamp))
+		return;
+
+	if (m_bSampleLoadingDeferred)
+		DeferMIDIMessage(pData, nSize);
+	else
+		PlaySysExNow(pData, nSize, nTimestamp);
+}
+
+void CSoundFontSynth::PlaySysExNow(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	// Read the samples from disk before taking the render locks
+	const bool bLoaded = SelectsDefaultPresets(pData, nSize) && LoadDefaultPresetSamples();
+
+	AcquireAll();
+	DrainMIDICommands();
+	PlayMIDISysExMessage(pData, nSize, nTimestamp);
+	ReleaseAll();
+
+	if (bLoaded)
+		ReleasePresetSamples();
+}
+
+void CSoundFontSynth::SetSampleLoadingDeferred(bool bDeferred)
+{
+	// Only presets loaded on selection read from disk
+	m_bSampleLoadingDeferred = bDeferred && m_bDynamicSampleLoading;
+	if (m_bSampleLoadingDeferred)
+		return;
+
+	// Play everything that was held back, in arrival order
+	const unsigned int nTimestamp = CTimer::GetClockTicks();
+	size_t nOffset = 0;
+	while (nOffset < m_nDeferredMIDIBytes)
+	{
+		const u8* pData = m_DeferredMIDIBuffer + nOffset;
+		const u8 nStatus = pData[0];
+
+		if (nStatus == 0xF0)
+		{
+			size_t nSize = 1;
+			while (nOffset + nSize < m_nDeferredMIDIBytes && pData[nSize - 1] != 0xF7)
+				++nSize;
+
+			PlaySysExNow(pData, nSize, nTimestamp);
+			nOffset += nSize;
+			continue;
+		}
+
+		const size_t nSize = nStatus == 0xFF ? 1 : (nStatus & 0xF0) == 0xC0 ? 2 : 3;
+		u32 nMessage = 0;
+		for (size_t i = 0; i < nSize; ++i)
+			nMessage |= pData[i] << (i * 8);
+
+		PlayShortMessageNow(nMessage);
+		nOffset += nSize;
+	}
+
+	m_nDeferredMIDIBytes = 0;
+}
+
+void CSoundFontSynth::DeferMIDIMessage(const u8* pData, size_t nSize)
+{
+	if (m_nDeferredMIDIBytes + nSize > sizeof(m_DeferredMIDIBuffer))
+	{
+		CLogger::Get()->Write(SoundFontSynthName, LogWarning, "Deferred MIDI buffer full; dropping message");
+		return;
+	}
+
+	memcpy(m_DeferredMIDIBuffer + m_nDeferredMIDIBytes, pData, nSize);
+	m_nDeferredMIDIBytes += nSize;
+}
+
+void CSoundFontSynth::PlayMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	// SysEx messages are played immediately; play any queued events first to keep them in order
+	FlushAllEvents();
+
 	// GM Mode On
 	if (nSize == sizeof(TGMModeOnSysExMessage))
 	{
 		const auto& GMModeOnMessage = reinterpret_cast<const TGMModeOnSysExMessage&>(*pData);
 		if (GMModeOnMessage.IsValid())
 		{
-			m_Lock.Acquire();
 			fluid_synth_system_reset(m_pSynth);
-			m_Lock.Release();
+			if (m_pSecondarySynth)
+				fluid_synth_system_reset(m_pSecondarySynth);
 			return;
 		}
 	}
@@ -275,9 +651,9 @@ void CSoundFontSynth::HandleMIDISysExMessage(const u8* pData, size_t nSize)
 		const auto& SystemModeSetMessage = reinterpret_cast<const TRolandSystemModeSetSysExMessage&>(*pData);
 		if (GSResetMessage.IsValid() || SystemModeSetMessage.IsValid())
 		{
-			m_Lock.Acquire();
 			fluid_synth_system_reset(m_pSynth);
-			m_Lock.Release();
+			if (m_pSecondarySynth)
+				fluid_synth_system_reset(m_pSecondarySynth);
 			return;
 		}
 
@@ -291,10 +667,9 @@ void CSoundFontSynth::HandleMIDISysExMessage(const u8* pData, size_t nSize)
 			if (nMode > 0x02)
 				return;
 
-			m_Lock.Acquire();
-			fluid_synth_set_channel_type(m_pSynth, nChannel, nMode == 0 ? CHANNEL_TYPE_MELODIC : CHANNEL_TYPE_DRUM);
-			fluid_synth_program_change(m_pSynth, nChannel, 0);
-			m_Lock.Release();
+			fluid_synth_t* const pSynth = GetChannelSynth(nChannel);
+			fluid_synth_set_channel_type(pSynth, nChannel, nMode == 0 ? CHANNEL_TYPE_MELODIC : CHANNEL_TYPE_DRUM);
+			fluid_synth_program_change(pSynth, nChannel, 0);
 			return;
 		}
 	}
@@ -323,81 +698,312 @@ void CSoundFontSynth::HandleMIDISysExMessage(const u8* pData, size_t nSize)
 	}
 
 	// No special handling; forward to FluidSynth SysEx parser, excluding leading 0xF0 and trailing 0xF7
-	m_Lock.Acquire();
 	fluid_synth_sysex(m_pSynth, reinterpret_cast<const char*>(pData + 1), nSize - 1, nullptr, nullptr, nullptr, false);
-	m_Lock.Release();
+	if (m_pSecondarySynth)
+		fluid_synth_sysex(m_pSecondarySynth, reinterpret_cast<const char*>(pData + 1), nSize - 1, nullptr, nullptr, nullptr, false);
 }
 
 bool CSoundFontSynth::IsActive()
 {
-	m_Lock.Acquire();
-	int nVoices = fluid_synth_get_active_voice_count(m_pSynth);
-	m_Lock.Release();
-
-	return nVoices > 0;
+	return GetActiveVoiceCount() > 0;
 }
 
 void CSoundFontSynth::AllSoundOff()
 {
-	m_Lock.Acquire();
+	AcquireAll();
+	DrainMIDICommands();
+	FlushAllEvents();
 	fluid_synth_all_sounds_off(m_pSynth, -1);
-	m_Lock.Release();
+	if (m_pSecondarySynth)
+		fluid_synth_all_sounds_off(m_pSecondarySynth, -1);
+	ReleaseAll();
 }
 
 void CSoundFontSynth::SetMasterVolume(u8 nVolume)
 {
 	m_nCurrentGain = nVolume / 100.0f * m_nInitialGain;
-	m_Lock.Acquire();
+	AcquireAll();
 	fluid_synth_set_gain(m_pSynth, m_nCurrentGain);
-	m_Lock.Release();
+	if (m_pSecondarySynth)
+		fluid_synth_set_gain(m_pSecondarySynth, m_nCurrentGain);
+	ReleaseAll();
+}
+
+void CSoundFontSynth::ProcessMIDICommands()
+{
+	if (!IsMIDICommandQueueEnabled())
+		return;
+
+	// Queued events may be routed to either synth instance, and SysEx needs both
+	AcquireAll();
+	DrainMIDICommands();
+	ReleaseAll();
+}
+
+void CSoundFontSynth::SetGain(float nGain)
+{
+	// Keep the master volume that's been applied on top of the configured gain
+	const float nVolumeScale = m_nInitialGain > 0.0f ? m_nCurrentGain / m_nInitialGain : 1.0f;
+
+	AcquireAll();
+	m_nInitialGain = nGain;
+	m_nCurrentGain = nVolumeScale * nGain;
+	fluid_synth_set_gain(m_pSynth, m_nCurrentGain);
+	if (m_pSecondarySynth)
+		fluid_synth_set_gain(m_pSecondarySynth, m_nCurrentGain);
+	ReleaseAll();
+}
+
+void CSoundFontSynth::SetPolyphony(u32 nPolyphony)
+{
+	AcquireAll();
+	m_nPolyphony = nPolyphony;
+	if (m_pSynth)
+		fluid_synth_set_polyphony(m_pSynth, m_nPolyphony);
+	if (m_pSecondarySynth)
+		fluid_synth_set_polyphony(m_pSecondarySynth, m_nPolyphony);
+	ReleaseAll();
+}
+
+void CSoundFontSynth::SetVoiceCullFloor(int nVoiceCullFloor)
+{
+	AcquireAll();
+	m_nVoiceCullFloor = Utility::Clamp(nVoiceCullFloor, 0, 96);
+	memset(&m_PrimaryCullState, 0, sizeof(m_PrimaryCullState));
+	memset(&m_SecondaryCullState, 0, sizeof(m_SecondaryCullState));
+	ReleaseAll();
+}
+
+void CSoundFontSynth::SetEffectsEnabled(bool bEnabled)
+{
+	AcquireAll();
+	fluid_settings_setint(m_pSettings, "synth.reverb.active", bEnabled);
+	fluid_settings_setint(m_pSettings, "synth.chorus.active", bEnabled);
+	if (m_pSynth)
+	{
+		fluid_synth_set_reverb_on(m_pSynth, bEnabled);
+		fluid_synth_set_chorus_on(m_pSynth, bEnabled);
+	}
+	if (m_pSecondarySynth)
+	{
+		fluid_synth_set_reverb_on(m_pSecondarySynth, bEnabled);
+		fluid_synth_set_chorus_on(m_pSecondarySynth, bEnabled);
+	}
+	ReleaseAll();
 }
 
 size_t CSoundFontSynth::Render(float* pOutBuffer, size_t nFrames)
 {
+	ProcessMIDICommands();
+	RenderPrimary(pOutBuffer, nFrames);
+
+	// Nobody else is rendering the secondary synth; do it here and mix
+	if (m_pSecondarySynth)
+	{
+		float SecondaryBuffer[nFrames * 2];
+		RenderSecondary(SecondaryBuffer, nFrames);
+
+		Mixer::Add(pOutBuffer, SecondaryBuffer, nFrames * 2);
+	}
+
+	return nFrames;
+}
+
+size_t CSoundFontSynth::Render(s16* pOutBuffer, size_t nFrames)
+{
+	const unsigned int nRenderStartTime = CTimer::GetClockTicks();
+
+	ProcessMIDICommands();
+
 	m_Lock.Acquire();
-	assert(fluid_synth_write_float(m_pSynth, nFrames, pOutBuffer, 0, 2, pOutBuffer, 1, 2) == FLUID_OK);
+	RenderWithEvents(m_pSynth, m_PrimaryEventQueue, m_nPrimaryPosition, pOutBuffer, nFrames, fluid_synth_write_s16);
+	UpdateRenderTiming(nRenderStartTime, m_nPrimaryPosition, nFrames);
+	PublishVelocities(m_pSynth, m_PrimaryVelocities);
+	CullVoices(m_pSynth, m_PrimaryCullState, m_nPrimaryPosition);
 	m_Lock.Release();
+
+	if (m_pSecondarySynth)
+	{
+		s16 SecondaryBuffer[nFrames * 2];
+
+		m_SecondaryLock.Acquire();
+		RenderWithEvents(m_pSecondarySynth, m_SecondaryEventQueue, m_nSecondaryPosition, SecondaryBuffer, nFrames, fluid_synth_write_s16);
+		PublishVelocities(m_pSecondarySynth, m_SecondaryVelocities);
+		CullVoices(m_pSecondarySynth, m_SecondaryCullState, m_nSecondaryPosition);
+		m_SecondaryLock.Release();
+
+		Mixer::Add(pOutBuffer, SecondaryBuffer, nFrames * 2);
+	}
+
 	return nFrames;
 }
 
-size_t CSoundFontSynth::Render(s16* pOutBuffer, size_t nFrames)
+size_t CSoundFontSynth::RenderPrimary(float* pOutBuffer, size_t nFrames)
 {
+	const unsigned int nRenderStartTime = CTimer::GetClockTicks();
+
 	m_Lock.Acquire();
-	assert(fluid_synth_write_s16(m_pSynth, nFrames, pOutBuffer, 0, 2, pOutBuffer, 1, 2) == FLUID_OK);
+	RenderWithEvents(m_pSynth, m_PrimaryEventQueue, m_nPrimaryPosition, pOutBuffer, nFrames, fluid_synth_write_float);
+	UpdateRenderTiming(nRenderStartTime, m_nPrimaryPosition, nFrames);
+	PublishVelocities(m_pSynth, m_PrimaryVelocities);
+	CullVoices(m_pSynth, m_PrimaryCullState, m_nPrimaryPosition);
 	m_Lock.Release();
 	return nFrames;
 }
 
+size_t CSoundFontSynth::RenderSecondary(float* pOutBuffer, size_t nFrames)
+{
+	m_SecondaryLock.Acquire();
+
+	if (m_pSecondarySynth)
+	{
+		RenderWithEvents(m_pSecondarySynth, m_SecondaryEventQueue, m_nSecondaryPosition, pOutBuffer, nFrames, fluid_synth_write_float);
+		PublishVelocities(m_pSecondarySynth, m_SecondaryVelocities);
+		CullVoices(m_pSecondarySynth, m_SecondaryCullState, m_nSecondaryPosition);
+	}
+	else
+		memset(pOutBuffer, 0, nFrames * 2 * sizeof(*pOutBuffer));
+
+	m_SecondaryLock.Release();
+	return nFrames;
+}
+
 u8 CSoundFontSynth::GetChannelVelocities(u8* pOutVelocities, size_t nMaxChannels)
 {
-	nMaxChannels = Utility::Min(nMaxChannels, static_cast<size_t>(16));
+	nMaxChannels = Utility::Min(nMaxChannels, MIDIChannelCount);
 
-	m_Lock.Acquire();
+	// Initialize output array
+	memset(pOutVelocities, 0, nMaxChannels);
+
+	// Read the render thread's latest snapshots rather than locking the synths
+	ReadVelocities(m_PrimaryVelocities, pOutVelocities, nMaxChannels);
+	if (m_pSecondarySynth)
+		ReadVelocities(m_SecondaryVelocities, pOutVelocities, nMaxChannels);
 
-	const size_t nVoices = fluid_synth_get_polyphony(m_pSynth);
+	return nMaxChannels;
+}
+
+u32 CSoundFontSynth::GetActiveVoiceCount()
+{
+	AcquireAll();
+	u32 nVoices = fluid_synth_get_active_voice_count(m_pSynth);
+	if (m_pSecondarySynth)
+		nVoices += fluid_synth_get_active_voice_count(m_pSecondarySynth);
+	ReleaseAll();
+
+	return nVoices;
+}
+
+void CSoundFontSynth::GetVoiceVelocities(fluid_synth_t* pSynth, u8* pOutVelocities, size_t nMaxChannels)
+{
+	const size_t nVoices = fluid_synth_get_polyphony(pSynth);
 
 	// Null-terminated
 	fluid_voice_t* Voices[nVoices + 1];
 	fluid_voice_t** pCurrentVoice = Voices;
 
-	// Initialize output array
 	memset(Voices, 0, (nVoices + 1) * sizeof(*Voices));
-	memset(pOutVelocities, 0, nMaxChannels);
 
-	fluid_synth_get_voicelist(m_pSynth, Voices, nVoices, -1);
+	fluid_synth_get_voicelist(pSynth, Voices, nVoices, -1);
 
 	while (*pCurrentVoice)
 	{
 		const u8 nChannel = fluid_voice_get_channel(*pCurrentVoice);
 		const u8 nVelocity = fluid_voice_is_on(*pCurrentVoice) ? fluid_voice_get_actual_velocity(*pCurrentVoice) : 0;
 
-		pOutVelocities[nChannel] = Utility::Max(pOutVelocities[nChannel], nVelocity);
+		if (nChannel < nMaxChannels)
+			pOutVelocities[nChannel] = Utility::Max(pOutVelocities[nChannel], nVelocity);
 		++pCurrentVoice;
 	}
+}
 
-	m_Lock.Release();
+void CSoundFontSynth::PublishVelocities(fluid_synth_t* pSynth, TVelocitySnapshot& Snapshot)
+{
+	u8 Velocities[MIDIChannelCount] = {0};
+	GetVoiceVelocities(pSynth, Velocities, MIDIChannelCount);
+
+	// Odd sequence number while the snapshot is being written
+	++Snapshot.nSequence;
+	DataMemBarrier();
+	for (size_t i = 0; i < MIDIChannelCount; ++i)
+		Snapshot.Velocities[i] = Velocities[i];
+	DataMemBarrier();
+	++Snapshot.nSequence;
+}
 
-	return nMaxChannels;
+void CSoundFontSynth::CullVoices(fluid_synth_t* pSynth, TVoiceCullState& State, u32 nPosition) const
+{
+	if (!m_nVoiceCullFloor)
+		return;
+
+	const size_t nVoices = fluid_synth_get_polyphony(pSynth);
+
+	// Null-terminated
+	fluid_voice_t* Voices[nVoices + 1];
+	fluid_voice_t** pCurrentVoice = Voices;
+
+	memset(Voices, 0, (nVoices + 1) * sizeof(*Voices));
+
+	fluid_synth_get_voicelist(pSynth, Voices, nVoices, -1);
+
+	for (; *pCurrentVoice; ++pCurrentVoice)
+	{
+		fluid_voice_t* const pVoice = *pCurrentVoice;
+
+		// Only notes that are fading out; held notes stay however quiet they are
+		if (fluid_voice_is_on(pVoice) || fluid_voice_is_sustained(pVoice) || fluid_voice_is_sostenuto(pVoice))
+			continue;
+
+		// First seen released; work out when it should have faded below the floor
+		const unsigned int nTag = fluid_voice_get_id(pVoice) + 1;
+		const size_t nSlot      = nTag % TVoiceCullState::Slots;
+		if (State.VoiceTags[nSlot] != nTag)
+		{
+			State.VoiceTags[nSlot]     = nTag;
+			State.CullPositions[nSlot] = nPosition + GetCullDelayFrames(pVoice);
+			continue;
+		}
+
+		// Cut the release short; FluidSynth clamps it to its shortest click-free release, so the voice ends within a
+		// few blocks (its noise floor check can't be used, as the floor is only worked out when the voice starts)
+		if (static_cast<s32>(nPosition - State.CullPositions[nSlot]) >= 0)
+		{
+			fluid_voice_gen_set(pVoice, GEN_VOLENVRELEASE, -12000.0f);
+			fluid_voice_update_param(pVoice, GEN_VOLENVRELEASE);
+		}
+	}
+}
+
+u32 CSoundFontSynth::GetCullDelayFrames(fluid_voice_t* pVoice) const
+{
+	// Estimate the level the release starts from using the instrument's attenuation and the standard velocity curve;
+	// sustain level and modulators (e.g. volume and expression) can only make it quieter, so this errs on the loud side
+	const float nVelocity = Utility::Max(fluid_voice_get_actual_velocity(pVoice), 1);
+	const float nLevel    = -fluid_voice_gen_get(pVoice, GEN_ATTENUATION) / 10.0f + 40.0f * std::log10(nVelocity / 127.0f);
+
+	// The volume envelope's release falls linearly in dB, by 96dB over the release time (in timecents)
+	const float nReleaseSeconds = std::pow(2.0f, fluid_voice_gen_get(pVoice, GEN_VOLENVRELEASE) / 1200.0f);
+	const float nFall           = Utility::Max(nLevel + m_nVoiceCullFloor, 0.0f);
+
+	return nFall / 96.0f * nReleaseSeconds * m_nSampleRate;
+}
+
+void CSoundFontSynth::ReadVelocities(const TVelocitySnapshot& Snapshot, u8* pOutVelocities, size_t nMaxChannels)
+{
+	u8 Velocities[MIDIChannelCount];
+	unsigned int nSequence;
+
+	do
+	{
+		nSequence = Snapshot.nSequence;
+		DataMemBarrier();
+		for (size_t i = 0; i < MIDIChannelCount; ++i)
+			Velocities[i] = Snapshot.Velocities[i];
+		DataMemBarrier();
+	} while ((nSequence & 1) || nSequence != Snapshot.nSequence);
+
+	for (size_t i = 0; i < nMaxChannels; ++i)
+		pOutVelocities[i] = Utility::Max(pOutVelocities[i], Velocities[i]);
 }
 
 void CSoundFontSynth::ReportStatus() const
@@ -428,8 +1034,27 @@ bool CSoundFontSynth::SwitchSoundFont(size_t nIndex)
 	if (m_pLCD)
 		m_pLCD->OnSystemMessage("Loading SoundFont", true);
 
-	// We can't use fluid_synth_sfunload() as we don't support the lazy SoundFont unload timer, so trash the entire synth and create a new one
-	if (!Reinitialize(pSoundFontPath))
+	// Finish any background load; if it's the SoundFont we want, switch to it without a gap
+	WaitForPreload();
+	bool bSuccess = m_PreloadState == TPreloadState::Ready && m_nPreloadIndex == nIndex && SwapPreloadedSynth();
+	DiscardPreload();
+
+	if (!bSuccess)
+	{
+		// Don't give up the current SoundFont if the new one won't fit in its place
+		if (!HasMemoryFor(nIndex, true))
+		{
+			if (m_pLCD)
+				m_pLCD->OnSystemMessage("Not enough memory!");
+
+			return false;
+		}
+
+		// Free the old SoundFont first and carry channel and effects state over; only rebuild the synth if it can't be unloaded
+		bSuccess = UnloadSoundFont() ? LoadSoundFont(pSoundFontPath) : Reinitialize(pSoundFontPath);
+	}
+
+	if (!bSuccess)
 	{
 		if (m_pLCD)
 			m_pLCD->OnSystemMessage("SF switch failed!");
@@ -439,7 +1064,11 @@ bool CSoundFontSynth::SwitchSoundFont(size_t nIndex)
 
 	m_nCurrentSoundFontIndex = nIndex;
 
-	CLogger::Get()->Write(SoundFontSynthName, LogNotice, "Loaded \"%s\"", m_SoundFontManager.GetSoundFontName(nIndex));
+	// FluidSynth keeps samples as they're stored in the file and converts them as voices play them; the 24-bit
+	// extension is only loaded (and interpolated) when the SoundFont has one
+	size_t nSample16DataSize, nSample24DataSize;
+	m_SoundFontManager.GetSampleDataSizes(nIndex, nSample16DataSize, nSample24DataSize);
+	CLogger::Get()->Write(SoundFontSynthName, LogNotice, "Loaded \"%s\" (samples: %d KB 16-bit, %d KB 24-bit extension)", m_SoundFontManager.GetSoundFontName(nIndex), nSample16DataSize / 1024, nSample24DataSize / 1024);
 	if (m_pLCD)
 		m_pLCD->ClearSpinnerMessage();
 
@@ -448,16 +1077,18 @@ bool CSoundFontSynth::SwitchSoundFont(size_t nIndex)
 
 bool CSoundFontSynth::Reinitialize(const char* pSoundFontPath)
 {
-	m_Lock.Acquire();
-
-	if (m_pSynth)
-		delete_fluid_synth(m_pSynth);
+	AcquireAll();
+	DestroySynths();
+	DiscardMIDICommands();
+	DiscardEvents(m_PrimaryEventQueue);
+	DiscardEvents(m_SecondaryEventQueue);
 
 	m_pSynth = new_fluid_synth(m_pSettings);
+	memset(&m_PrimaryCullState, 0, sizeof(m_PrimaryCullState));
 
 	if (!m_pSynth)
 	{
-		m_Lock.Release();
+		ReleaseAll();
 		CLogger::Get()->Write(SoundFontSynthName, LogError, "Failed to create synth");
 		return false;
 	}
@@ -465,18 +1096,407 @@ bool CSoundFontSynth::Reinitialize(const char* pSoundFontPath)
 	fluid_synth_set_gain(m_pSynth, m_nCurrentGain);
 	fluid_synth_set_polyphony(m_pSynth, m_nPolyphony);
 
-	m_Lock.Release();
+	ReleaseAll();
 
-	const unsigned int nLoadStart = CTimer::GetClockTicks();
+	if (!LoadSoundFont(pSoundFontPath))
+		return false;
+
+	if (!m_bSplitRender)
+		return true;
+
+	// Create a secondary synth which shares the primary synth's SoundFont
+	fluid_synth_t* pSecondarySynth = new_fluid_synth(m_pSettings);
+	if (!pSecondarySynth)
+	{
+		CLogger::Get()->Write(SoundFontSynthName, LogWarning, "Failed to create secondary synth; split rendering disabled");
+		return true;
+	}
+
+	fluid_synth_set_gain(pSecondarySynth, m_nCurrentGain);
+	fluid_synth_set_polyphony(pSecondarySynth, m_nPolyphony);
 
-	if (fluid_synth_sfload(m_pSynth, pSoundFontPath, true) == FLUID_FAILED)
+	if (fluid_synth_add_sfont(pSecondarySynth, fluid_synth_get_sfont(m_pSynth, 0)) == FLUID_FAILED)
 	{
-		CLogger::Get()->Write(SoundFontSynthName, LogError, "Failed to load SoundFont");
+		CLogger::Get()->Write(SoundFontSynthName, LogWarning, "Failed to share SoundFont with secondary synth; split rendering disabled");
+		delete_fluid_synth(pSecondarySynth);
+		return true;
+	}
+
+	// Both synths share one sample timeline
+	AcquireAll();
+	m_pSecondarySynth    = pSecondarySynth;
+	m_nSecondaryPosition = m_nPrimaryPosition;
+	memset(&m_SecondaryCullState, 0, sizeof(m_SecondaryCullState));
+	ReleaseAll();
+
+	return true;
+}
+
+bool CSoundFontSynth::LoadSoundFont(const char* pSoundFontPath)
+{
+	// Load into a new synth; the render task carries on with the current one meanwhile
+	fluid_synth_t* const pNewSynth = LoadSynth(pSoundFontPath, false);
+	if (!pNewSynth)
+		return false;
+
+	fluid_sfont_t* const pNewSoundFont = fluid_synth_get_sfont(pNewSynth, 0);
+
+	AcquireAll();
+
+	// Queued MIDI is routed to the event queues, which carry over to the new synth
+	DrainMIDICommands();
+
+	// Hand the new SoundFont to an existing secondary synth
+	if (m_pSecondarySynth && fluid_synth_add_sfont(m_pSecondarySynth, pNewSoundFont) == FLUID_FAILED)
+	{
+		ReleaseAll();
+		CLogger::Get()->Write(SoundFontSynthName, LogError, "Failed to share SoundFont with secondary synth");
+		delete_fluid_synth(pNewSynth);
 		return false;
 	}
 
+	CopySynthState(m_pSynth, pNewSynth);
+
+	fluid_synth_t* const pOldSynth = m_pSynth;
+	m_pSynth                       = pNewSynth;
+
+	// Voice IDs start again in the new synth
+	memset(&m_PrimaryCullState, 0, sizeof(m_PrimaryCullState));
+
+	ReleaseAll();
+
+	ShareSoundFontWithLoader(pNewSoundFont);
+
+	// The old synth has no SoundFont left and nothing renders it any more
+	delete_fluid_synth(pOldSynth);
+
+	return true;
+}
+
+fluid_synth_t* CSoundFontSynth::LoadSynth(const char* pSoundFontPath, bool bPreload)
+{
+	fluid_synth_t* const pSynth = new_fluid_synth(m_pSettings);
+	if (!pSynth)
+	{
+		CLogger::Get()->Write(SoundFontSynthName, LogError, "Failed to create synth");
+		return nullptr;
+	}
+
+	fluid_synth_set_gain(pSynth, m_nCurrentGain);
+	fluid_synth_set_polyphony(pSynth, m_nPolyphony);
+
+	const unsigned int nLoadStart = CTimer::GetClockTicks();
+	const size_t nHeapUsedBefore  = GetFluidSynthHeapUsed();
+
+	if (fluid_synth_sfload(pSynth, pSoundFontPath, true) == FLUID_FAILED)
+	{
+		CLogger::Get()->Write(SoundFontSynthName, LogError, bPreload ? "Failed to preload SoundFont" : "Failed to load SoundFont");
+		delete_fluid_synth(pSynth);
+		return nullptr;
+	}
+
 	const float nLoadTime = (CTimer::GetClockTicks() - nLoadStart) / 1000000.0f;
-	CLogger::Get()->Write(SoundFontSynthName, TLogSeverity::LogNotice, "\"%s\" loaded in %0.2f seconds", pSoundFontPath, nLoadTime);
+	const size_t nHeapUsed = GetFluidSynthHeapUsed() - nHeapUsedBefore;
+	CLogger::Get()->Write(SoundFontSynthName, LogNotice, "\"%s\" %s in %0.2f seconds, using %d KB", pSoundFontPath, bPreload ? "preloaded" : "loaded", nLoadTime, nHeapUsed / 1024);
+
+	return pSynth;
+}
+
+bool CSoundFontSynth::UnloadSoundFont()
+{
+	if (!m_pSynth)
+		return false;
+
+	fluid_sfont_t* pSoundFont = fluid_synth_get_sfont(m_pSynth, 0);
+	if (!pSoundFont)
+		return true;
+
+	AcquireAll();
+
+	// Bring channel state up to date, then stop every voice so that nothing references the SoundFont's samples
+	DrainMIDICommands();
+	FlushAllEvents();
+
+	bool bReleased = ReleaseVoices(m_pSynth);
+	if (m_pSecondarySynth)
+		bReleased &= ReleaseVoices(m_pSecondarySynth);
+
+	// Without the lazy unload timer, FluidSynth would leak a SoundFont that is still in use
+	if (!bReleased)
+	{
+		ReleaseAll();
+		CLogger::Get()->Write(SoundFontSynthName, LogWarning, "Voices still active; can't unload SoundFont");
+		return false;
+	}
+
+	// The secondary and loader synths only borrow the SoundFont; the primary synth frees it
+	if (m_pSecondarySynth)
+		fluid_synth_remove_sfont(m_pSecondarySynth, pSoundFont);
+	UnshareSoundFontWithLoader(pSoundFont);
+	fluid_synth_sfunload(m_pSynth, fluid_sfont_get_id(pSoundFont), false);
+
+	ReleaseAll();
 
 	return true;
 }
+
+bool CSoundFontSynth::ReleaseVoices(fluid_synth_t* pSynth)
+{
+	fluid_synth_all_sounds_off(pSynth, -1);
+
+	// Render (and discard) one block so that the mixer processes the voice off events
+	float ScratchBuffer[VoiceReleaseFrames * 2];
+	fluid_synth_write_float(pSynth, VoiceReleaseFrames, ScratchBuffer, 0, 2, ScratchBuffer, 1, 2);
+
+	return fluid_synth_get_active_voice_count(pSynth) == 0;
+}
+
+void CSoundFontSynth::PreloadSoundFont(size_t nIndex)
+{
+	if (!m_bPreloadEnabled || !m_pSynth || nIndex == m_nCurrentSoundFontIndex)
+		return;
+
+	// The loader core owns the standby synth until it's done; try again later
+	const TPreloadState State = m_PreloadState;
+	if (State == TPreloadState::Requested || State == TPreloadState::Loading)
+		return;
+
+	// Already loaded (or already failed)
+	if (State != TPreloadState::Idle && m_nPreloadIndex == nIndex)
+		return;
+
+	if (!m_SoundFontManager.GetSoundFontPath(nIndex))
+		return;
+
+	DiscardPreload();
+
+	// Both SoundFonts must fit at once; mark it as failed so that it's loaded normally when selected
+	if (!HasMemoryFor(nIndex, false))
+	{
+		m_nPreloadIndex = nIndex;
+		m_PreloadState  = TPreloadState::Failed;
+		return;
+	}
+
+	m_nPreloadIndex = nIndex;
+	DataMemBarrier();
+	m_PreloadState = TPreloadState::Requested;
+}
+
+bool CSoundFontSynth::CancelPreload()
+{
+	// A load that hasn't started yet is dropped; one that has can't be interrupted, so the caller must try again later
+	m_PreloadLock.Acquire();
+	const bool bLoading = m_PreloadState == TPreloadState::Loading;
+	if (m_PreloadState == TPreloadState::Requested)
+		m_PreloadState = TPreloadState::Idle;
+	m_PreloadLock.Release();
+
+	if (bLoading)
+		return false;
+
+	DataMemBarrier();
+	DiscardPreload();
+	return true;
+}
+
+void CSoundFontSynth::RunPreload()
+{
+	// Claim the request, unless the MIDI thread has just cancelled it
+	m_PreloadLock.Acquire();
+	const bool bRequested = m_PreloadState == TPreloadState::Requested;
+	if (bRequested)
+		m_PreloadState = TPreloadState::Loading;
+	m_PreloadLock.Release();
+
+	if (!bRequested)
+		return;
+
+	DataMemBarrier();
+
+	const char* pSoundFontPath  = m_SoundFontManager.GetSoundFontPath(m_nPreloadIndex);
+	fluid_synth_t* const pSynth = pSoundFontPath ? LoadSynth(pSoundFontPath, true) : nullptr;
+
+	m_pPreloadSynth = pSynth;
+	DataMemBarrier();
+	m_PreloadState = pSynth ? TPreloadState::Ready : TPreloadState::Failed;
+}
+
+bool CSoundFontSynth::SwapPreloadedSynth()
+{
+	fluid_synth_t* const pNewSynth = m_pPreloadSynth;
+	fluid_sfont_t* const pNewSoundFont = fluid_synth_get_sfont(pNewSynth, 0);
+
+	AcquireAll();
+
+	// Queued MIDI is routed to the event queues, which carry over to the new synth
+	DrainMIDICommands();
+
+	// The secondary synth borrows the old SoundFont; it must let go before the old synth is deleted
+	if (m_pSecondarySynth)
+	{
+		if (!ReleaseVoices(m_pSecondarySynth))
+		{
+			ReleaseAll();
+			CLogger::Get()->Write(SoundFontSynthName, LogWarning, "Voices still active; can't swap to preloaded SoundFont");
+			return false;
+		}
+
+		fluid_synth_remove_sfont(m_pSecondarySynth, fluid_synth_get_sfont(m_pSynth, 0));
+		fluid_synth_add_sfont(m_pSecondarySynth, pNewSoundFont);
+	}
+
+	CopySynthState(m_pSynth, pNewSynth);
+	fluid_synth_set_gain(pNewSynth, m_nCurrentGain);
+	fluid_synth_set_polyphony(pNewSynth, m_nPolyphony);
+
+	fluid_synth_t* const pOldSynth = m_pSynth;
+	m_pSynth                       = pNewSynth;
+	m_pPreloadSynth                = nullptr;
+	m_PreloadState                 = TPreloadState::Idle;
+
+	// Voice IDs start again in the new synth
+	memset(&m_PrimaryCullState, 0, sizeof(m_PrimaryCullState));
+
+	ReleaseAll();
+
+	UnshareSoundFontWithLoader(fluid_synth_get_sfont(pOldSynth, 0));
+	ShareSoundFontWithLoader(pNewSoundFont);
+
+	// Nothing renders the old synth any more; free it and its SoundFont outside the locks
+	delete_fluid_synth(pOldSynth);
+
+	return true;
+}
+
+bool CSoundFontSynth::HasMemoryFor(size_t nIndex, bool bReplaceCurrent) const
+{
+	const size_t nRequired = m_SoundFontManager.GetSoundFontMemorySize(nIndex, !m_bDynamicSampleLoading);
+
+	// Unknown; let FluidSynth try
+	if (!nRequired)
+		return true;
+
+	const CZoneAllocator::TStats Stats = CZoneAllocator::Get()->GetStats();
+	size_t nAvailable = Stats.nHeapSize - Stats.nUsedBytes;
+
+	// The current SoundFont's memory will be freed first
+	if (bReplaceCurrent)
+		nAvailable += m_SoundFontManager.GetSoundFontMemorySize(m_nCurrentSoundFontIndex, !m_bDynamicSampleLoading);
+
+	if (nRequired > nAvailable)
+	{
+		CLogger::Get()->Write(SoundFontSynthName, LogWarning, "\"%s\" needs ~%d KB but only %d KB is available", m_SoundFontManager.GetSoundFontName(nIndex), nRequired / 1024, nAvailable / 1024);
+		return false;
+	}
+
+	// Samples loaded on demand are allocated individually
+	if (m_bDynamicSampleLoading)
+		return true;
+
+	// Otherwise FluidSynth allocates the 16-bit sample data as a single block, so it must fit in one free block
+	size_t nSample16DataSize, nSample24DataSize;
+	m_SoundFontManager.GetSampleDataSizes(nIndex, nSample16DataSize, nSample24DataSize);
+
+	size_t nLargestFreeBlock = Stats.nLargestFreeBlock;
+
+	// The current SoundFont's sample data will leave a free block at least as large as itself
+	if (bReplaceCurrent)
+	{
+		size_t nCurrentSample16DataSize, nCurrentSample24DataSize;
+		m_SoundFontManager.GetSampleDataSizes(m_nCurrentSoundFontIndex, nCurrentSample16DataSize, nCurrentSample24DataSize);
+		nLargestFreeBlock = Utility::Max(nLargestFreeBlock, nCurrentSample16DataSize);
+	}
+
+	if (nSample16DataSize <= nLargestFreeBlock)
+		return true;
+
+	CLogger::Get()->Write(SoundFontSynthName, LogWarning, "\"%s\" needs a ~%d KB block but the largest free block is %d KB", m_SoundFontManager.GetSoundFontName(nIndex), nSample16DataSize / 1024, nLargestFreeBlock / 1024);
+	return false;
+}
+
+void CSoundFontSynth::WaitForPreload() const
+{
+	while (m_PreloadState == TPreloadState::Requested || m_PreloadState == TPreloadState::Loading)
+		;
+	DataMemBarrier();
+}
+
+void CSoundFontSynth::DiscardPreload()
+{
+	assert(m_PreloadState != TPreloadState::Loading);
+
+	if (m_pPreloadSynth)
+	{
+		delete_fluid_synth(m_pPreloadSynth);
+		m_pPreloadSynth = nullptr;
+	}
+
+	m_PreloadState = TPreloadState::Idle;
+}
+
+void CSoundFontSynth::CopySynthState(fluid_synth_t* pFromSynth, fluid_synth_t* pToSynth)
+{
+	const int nChannels = fluid_synth_count_midi_channels(pFromSynth);
+
+	for (int nChannel = 0; nChannel < nChannels; ++nChannel)
+	{
+		int nSoundFontID, nBank, nProgram, nValue;
+
+		if (fluid_synth_get_program(pFromSynth, nChannel, &nSoundFontID, &nBank, &nProgram) == FLUID_OK)
+		{
+			fluid_synth_bank_select(pToSynth, nChannel, nBank);
+			fluid_synth_program_change(pToSynth, nChannel, nProgram);
+		}
+
+		// Skip bank select, data entry, (N)RPN and channel mode messages; they have side effects when replayed
+		for (int nController = 1; nController < 120; ++nController)
+		{
+			if (nController == 6 || nController == 32 || nController == 38 || (nController >= 96 && nController <= 101))
+				continue;
+
+			if (fluid_synth_get_cc(pFromSynth, nChannel, nController, &nValue) == FLUID_OK)
+				fluid_synth_cc(pToSynth, nChannel, nController, nValue);
+		}
+
+		if (fluid_synth_get_pitch_wheel_sens(pFromSynth, nChannel, &nValue) == FLUID_OK)
+			fluid_synth_pitch_wheel_sens(pToSynth, nChannel, nValue);
+
+		if (fluid_synth_get_pitch_bend(pFromSynth, nChannel, &nValue) == FLUID_OK)
+			fluid_synth_pitch_bend(pToSynth, nChannel, nValue);
+	}
+
+	fluid_synth_set_reverb(pToSynth, fluid_synth_get_reverb_roomsize(pFromSynth), fluid_synth_get_reverb_damp(pFromSynth), fluid_synth_get_reverb_width(pFromSynth), fluid_synth_get_reverb_level(pFromSynth));
+	fluid_synth_set_chorus(pToSynth, fluid_synth_get_chorus_nr(pFromSynth), fluid_synth_get_chorus_level(pFromSynth), fluid_synth_get_chorus_speed(pFromSynth), fluid_synth_get_chorus_depth(pFromSynth), fluid_synth_get_chorus_type(pFromSynth));
+}
+
+void CSoundFontSynth::DestroySynths()
+{
+	// The secondary and loader synths must give up the shared SoundFont before the primary synth frees it
+	if (m_pSecondarySynth)
+	{
+		fluid_synth_remove_sfont(m_pSecondarySynth, fluid_synth_get_sfont(m_pSynth, 0));
+		delete_fluid_synth(m_pSecondarySynth);
+		m_pSecondarySynth = nullptr;
+	}
+
+	if (m_pSynth)
+	{
+		UnshareSoundFontWithLoader(fluid_synth_get_sfont(m_pSynth, 0));
+		delete_fluid_synth(m_pSynth);
+		m_pSynth = nullptr;
+	}
+}
+
+void CSoundFontSynth::AcquireAll()
+{
+	// Always acquire in the same order to avoid deadlocks
+	m_Lock.Acquire();
+	m_SecondaryLock.Acquire();
+}
+
+void CSoundFontSynth::ReleaseAll()
+{
+	m_SecondaryLock.Release();
+	m_Lock.Release();
+}
@@ -0,0 +1,100 @@
+//
+// synthbase.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <circle/util.h>
+
+#include "synth/synthbase.h"
+
+void CSynthBase::ProcessMIDICommands()
+{
+	if (!m_bMIDICommandQueueEnabled)
+		return;
+
+	m_Lock.Acquire();
+	DrainMIDICommands();
+	m_Lock.Release();
+}
+
+bool CSynthBase::QueueMIDIShortMessage(u32 nMessage, unsigned int nTimestamp)
+{
+	if (!m_bMIDICommandQueueEnabled)
+		return false;
+
+	const TMIDICommandHeader Header{nTimestamp, nMessage, 0};
+	return QueueMIDICommand(Header, nullptr);
+}
+
+bool CSynthBase::QueueMIDISysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp)
+{
+	if (!m_bMIDICommandQueueEnabled)
+		return false;
+
+	const TMIDICommandHeader Header{nTimestamp, 0, static_cast<u32>(nSize)};
+	return QueueMIDICommand(Header, pData);
+}
+
+bool CSynthBase::QueueMIDICommand(const TMIDICommandHeader& Header, const u8* pSysExData)
+{
+	const size_t nRecordSize = sizeof(Header) + Header.nSysExSize;
+
+	// Too big to ever fit
+	if (nRecordSize >= MIDICommandQueueSize)
+		return false;
+
+	// The whole record must be published at once
+	u8 Record[nRecordSize];
+	memcpy(Record, &Header, sizeof(Header));
+	if (Header.nSysExSize)
+		memcpy(Record + sizeof(Header), pSysExData, Header.nSysExSize);
+
+	if (m_MIDICommandQueue.EnqueueAll(Record, nRecordSize))
+		return true;
+
+	// Queue is full; play the backlog on this thread and try again
+	ProcessMIDICommands();
+	return m_MIDICommandQueue.EnqueueAll(Record, nRecordSize);
+}
+
+void CSynthBase::DrainMIDICommands()
+{
+	TMIDICommandHeader Header;
+
+	while (m_MIDICommandQueue.Dequeue(reinterpret_cast<u8*>(&Header), sizeof(Header)) == sizeof(Header))
+	{
+		if (Header.nSysExSize == 0)
+		{
+			PlayMIDIShortMessage(Header.nMessage, Header.nTimestamp);
+			continue;
+		}
+
+		u8 SysExData[Header.nSysExSize];
+		m_MIDICommandQueue.Dequeue(SysExData, Header.nSysExSize);
+		PlayMIDISysExMessage(SysExData, Header.nSysExSize, Header.nTimestamp);
+	}
+}
+
+void CSynthBase::DiscardMIDICommands()
+{
+	u8 Buffer[256];
+	while (m_MIDICommandQueue.Dequeue(Buffer, sizeof(Buffer)))
+		;
+}
@@ -0,0 +1,84 @@
+//
+// telemetry.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+
+#include "telemetry.h"
+
+const char TelemetryName[] = "telemetry";
+
+CTelemetry::CTelemetry()
+	: m_nSequence(0),
+
+	  m_nMIDIBytes{0},
+	  m_nMIDIEvents{0},
+	  m_nMIDIOverruns(0)
+{
+}
+
+void CTelemetry::Send(TRecord& Record)
+{
+	static const char HexDigits[] = "0123456789abcdef";
+
+	Record.Magic[0]  = 'M';
+	Record.Magic[1]  = 'T';
+	Record.nVersion  = RecordVersion;
+	Record.nSize     = sizeof(TRecord);
+	Record.nSequence = m_nSequence++;
+	Record.nUptime   = CTimer::Get()->GetUptime();
+
+	for (size_t i = 0; i < MIDISourceCount; ++i)
+	{
+		Record.nMIDIBytes[i]  = m_nMIDIBytes[i];
+		Record.nMIDIEvents[i] = m_nMIDIEvents[i];
+	}
+	Record.nMIDIOverruns = m_nMIDIOverruns;
+
+	const u8* pData  = reinterpret_cast<const u8*>(&Record);
+	Record.nChecksum = GetChecksum(pData, sizeof(TRecord) - sizeof(Record.nChecksum));
+
+	char Line[sizeof(TRecord) * 2 + 1];
+	for (size_t i = 0; i < sizeof(TRecord); ++i)
+	{
+		Line[i * 2]     = HexDigits[pData[i] >> 4];
+		Line[i * 2 + 1] = HexDigits[pData[i] & 0xF];
+	}
+	Line[sizeof(TRecord) * 2] = '\0';
+
+	CLogger::Get()->Write(TelemetryName, LogNotice, "%s", Line);
+}
+
+u16 CTelemetry::GetChecksum(const u8* pData, size_t nSize)
+{
+	u16 nSum1 = 0;
+	u16 nSum2 = 0;
+
+	for (size_t i = 0; i < nSize; ++i)
+	{
+		nSum1 = (nSum1 + pData[i]) % 255;
+		nSum2 = (nSum2 + nSum1) % 255;
+	}
+
+	return nSum2 << 8 | nSum1;
+}
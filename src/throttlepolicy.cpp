@@ -0,0 +1,68 @@
+//
+// throttlepolicy.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <circle/timer.h>
+
+#include "throttlepolicy.h"
+
+CThrottlePolicy::CThrottlePolicy()
+	: m_Level(TLevel::Full),
+	  m_nStepTime(0)
+{
+}
+
+bool CThrottlePolicy::OnThrottleDetected()
+{
+	// Don't step down again if a step was only just taken
+	if (m_Level != TLevel::Full && (CTimer::Get()->GetTicks() - m_nStepTime) < MSEC2HZ(StepHoldMillis))
+		return false;
+
+	return StepDown();
+}
+
+bool CThrottlePolicy::Update(bool bThrottled)
+{
+	// Keep stepping down while the firmware still reports a problem
+	if (!bThrottled || m_Level == TLevel::Full || (CTimer::Get()->GetTicks() - m_nStepTime) < MSEC2HZ(StepHoldMillis))
+		return false;
+
+	return StepDown();
+}
+
+bool CThrottlePolicy::OnThrottleCleared()
+{
+	if (m_Level == TLevel::Full)
+		return false;
+
+	m_Level = TLevel::Full;
+	return true;
+}
+
+bool CThrottlePolicy::StepDown()
+{
+	if (m_Level == TLevel::NoEffects)
+		return false;
+
+	m_Level     = m_Level == TLevel::Full ? TLevel::ReducedResampler : TLevel::NoEffects;
+	m_nStepTime = CTimer::Get()->GetTicks();
+	return true;
+}
@@ -0,0 +1,250 @@
+//
+// wavrecorder.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <circle/logger.h>
+#include <circle/synchronize.h>
+#include <circle/util.h>
+
+#include "utility.h"
+#include "wavrecorder.h"
+
+const char WAVRecorderName[] = "wavrecorder";
+const char RecordingDirectory[] = "recordings";
+constexpr unsigned int MaxFileNumber = 9999;
+
+namespace
+{
+	inline void WriteLittleEndian16(u8* pData, u16 nValue)
+	{
+		pData[0] = nValue;
+		pData[1] = nValue >> 8;
+	}
+
+	inline void WriteLittleEndian32(u8* pData, u32 nValue)
+	{
+		pData[0] = nValue;
+		pData[1] = nValue >> 8;
+		pData[2] = nValue >> 16;
+		pData[3] = nValue >> 24;
+	}
+}
+
+CWAVRecorder::CWAVRecorder()
+	: m_pBuffer(nullptr),
+	  m_bRecording(false),
+
+	  m_File{},
+	  m_nSampleRate(0),
+	  m_b24Bit(false),
+	  m_nDataSize(0),
+	  m_bWriteError(false),
+
+	  m_nDroppedBytes(0),
+
+	  m_WriteBuffer{0}
+{
+}
+
+CWAVRecorder::~CWAVRecorder()
+{
+	Stop();
+	delete m_pBuffer;
+}
+
+bool CWAVRecorder::Start(const char* pDisk, unsigned int nSampleRate, bool b24Bit)
+{
+	CLogger* const pLogger = CLogger::Get();
+
+	if (m_bRecording)
+		return false;
+
+	// Discard anything the audio task added after the last recording was stopped
+	if (m_pBuffer)
+		m_pBuffer->Skip(m_pBuffer->GetCount());
+	else
+		m_pBuffer = new TSampleBuffer();
+
+	CString DirectoryPath;
+	DirectoryPath.Format("%s:/%s", pDisk, RecordingDirectory);
+
+	const FRESULT Result = f_mkdir(DirectoryPath);
+	if (Result != FR_OK && Result != FR_EXIST)
+	{
+		pLogger->Write(WAVRecorderName, LogError, "Couldn't create '%s' (error %d)", static_cast<const char*>(DirectoryPath), Result);
+		return false;
+	}
+
+	// Find the first unused file name
+	FILINFO FileInfo;
+	unsigned int nFileNumber;
+	for (nFileNumber = 1; nFileNumber <= MaxFileNumber; ++nFileNumber)
+	{
+		m_FileName.Format("%s/rec%04u.wav", static_cast<const char*>(DirectoryPath), nFileNumber);
+		if (f_stat(m_FileName, &FileInfo) == FR_NO_FILE)
+			break;
+	}
+
+	if (nFileNumber > MaxFileNumber || f_open(&m_File, m_FileName, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+	{
+		pLogger->Write(WAVRecorderName, LogError, "Couldn't create a recording in '%s'", static_cast<const char*>(DirectoryPath));
+		return false;
+	}
+
+#if FF_USE_EXPAND
+	// Not fatal; without contiguous free space, the file is extended as it's written instead
+	if (f_expand(&m_File, PreallocateSize, 1) != FR_OK)
+		pLogger->Write(WAVRecorderName, LogWarning, "Couldn't reserve space for recording");
+#endif
+
+	m_nSampleRate   = nSampleRate;
+	m_b24Bit        = b24Bit;
+	m_nDataSize     = 0;
+	m_bWriteError   = false;
+	m_nDroppedBytes = 0;
+
+	if (!WriteHeader())
+	{
+		pLogger->Write(WAVRecorderName, LogError, "Couldn't write to '%s'", static_cast<const char*>(m_FileName));
+		f_close(&m_File);
+		f_unlink(m_FileName);
+		return false;
+	}
+
+	DataMemBarrier();
+	m_bRecording = true;
+
+	pLogger->Write(WAVRecorderName, LogNotice, "Recording %d-bit audio to '%s'", b24Bit ? 24 : 16, static_cast<const char*>(m_FileName));
+	return true;
+}
+
+void CWAVRecorder::Stop()
+{
+	CLogger* const pLogger = CLogger::Get();
+
+	if (!m_bRecording)
+		return;
+
+	m_bRecording = false;
+	DataMemBarrier();
+
+	// Write whatever is left; the last block can be short
+	size_t nBufferedBytes;
+	while (!m_bWriteError && (nBufferedBytes = m_pBuffer->GetCount()) > 0)
+		WriteBlock(Utility::Min(nBufferedBytes, GetReadBlockSize()));
+
+	// Fill in the sizes, and give back any space reserved beyond the data
+	const bool bSuccess = !m_bWriteError && WriteHeader() && f_lseek(&m_File, HeaderSize + m_nDataSize) == FR_OK && f_truncate(&m_File) == FR_OK;
+	f_close(&m_File);
+
+	const unsigned int nBytesPerSecond = m_nSampleRate * 2 * (m_b24Bit ? 3 : 2);
+	if (bSuccess)
+		pLogger->Write(WAVRecorderName, LogNotice, "Recorded %u seconds to '%s'", m_nDataSize / nBytesPerSecond, static_cast<const char*>(m_FileName));
+	else
+		pLogger->Write(WAVRecorderName, LogError, "Recording to '%s' is incomplete", static_cast<const char*>(m_FileName));
+
+	if (m_nDroppedBytes)
+	{
+		const unsigned int nDroppedMillis = static_cast<u64>(m_nDroppedBytes) * 1000 / (m_nSampleRate * 2 * (m_b24Bit ? 4 : 2));
+		pLogger->Write(WAVRecorderName, LogWarning, "%u ms of audio was dropped because the disk couldn't keep up", nDroppedMillis);
+	}
+}
+
+void CWAVRecorder::WriteSamples(const void* pData, size_t nSize)
+{
+	if (!m_bRecording)
+		return;
+
+	// Whole chunks only, so that a gap never splits a frame
+	if (!m_pBuffer->EnqueueAll(static_cast<const u8*>(pData), nSize))
+		m_nDroppedBytes += nSize;
+}
+
+void CWAVRecorder::Update()
+{
+	if (!m_bRecording)
+		return;
+
+	if (m_pBuffer->GetCount() >= GetReadBlockSize() && !WriteBlock(GetReadBlockSize()))
+		Stop();
+}
+
+bool CWAVRecorder::WriteBlock(size_t nBufferedBytes)
+{
+	const size_t nRead = m_pBuffer->Dequeue(m_WriteBuffer, nBufferedBytes);
+	size_t nWriteSize  = nRead;
+
+	// Keep the low 3 bytes of each 32-bit sample, packing them in place
+	if (m_b24Bit)
+	{
+		nWriteSize = nRead / 4 * 3;
+		for (size_t i = 0; i < nRead / 4; ++i)
+		{
+			m_WriteBuffer[i * 3]     = m_WriteBuffer[i * 4];
+			m_WriteBuffer[i * 3 + 1] = m_WriteBuffer[i * 4 + 1];
+			m_WriteBuffer[i * 3 + 2] = m_WriteBuffer[i * 4 + 2];
+		}
+	}
+
+	UINT nWritten;
+	if (f_write(&m_File, m_WriteBuffer, nWriteSize, &nWritten) != FR_OK || nWritten != nWriteSize)
+	{
+		CLogger::Get()->Write(WAVRecorderName, LogError, "Writing to '%s' failed", static_cast<const char*>(m_FileName));
+		m_bWriteError = true;
+		return false;
+	}
+
+	m_nDataSize += nWriteSize;
+	return true;
+}
+
+bool CWAVRecorder::WriteHeader()
+{
+	const u16 nBlockAlign = m_b24Bit ? 6 : 4;
+	u8 Header[HeaderSize] = {0};
+
+	memcpy(Header, "RIFF", 4);
+	WriteLittleEndian32(Header + 4, HeaderSize - 8 + m_nDataSize);
+	memcpy(Header + 8, "WAVE", 4);
+
+	// PCM, stereo
+	memcpy(Header + 12, "fmt ", 4);
+	WriteLittleEndian32(Header + 16, 16);
+	WriteLittleEndian16(Header + 20, 1);
+	WriteLittleEndian16(Header + 22, 2);
+	WriteLittleEndian32(Header + 24, m_nSampleRate);
+	WriteLittleEndian32(Header + 28, m_nSampleRate * nBlockAlign);
+	WriteLittleEndian16(Header + 32, nBlockAlign);
+	WriteLittleEndian16(Header + 34, m_b24Bit ? 24 : 16);
+
+	// Padding up to the data chunk
+	memcpy(Header + 36, "JUNK", 4);
+	WriteLittleEndian32(Header + 40, HeaderSize - 52);
+
+	memcpy(Header + HeaderSize - 8, "data", 4);
+	WriteLittleEndian32(Header + HeaderSize - 4, m_nDataSize);
+
+	UINT nWritten;
+	if (f_lseek(&m_File, 0) != FR_OK || f_write(&m_File, Header, sizeof(Header), &nWritten) != FR_OK || nWritten != sizeof(Header))
+		return false;
+
+	return f_lseek(&m_File, HeaderSize + m_nDataSize) == FR_OK;
+}
@@ -23,6 +23,7 @@
 #include <circle/alloc.h>
 #include <circle/logger.h>
 #include <circle/memory.h>
+#include <circle/timer.h>
 
 #include "utility.h"
 #include "zoneallocator.h"
@@ -37,8 +38,22 @@ CZoneAllocator* CZoneAllocator::s_pThis = nullptr;
 CZoneAllocator::CZoneAllocator()
 	: m_pHeap(nullptr),
 	  m_nHeapSize(0),
-	  m_pCurrentBlock(nullptr),
-	  m_nAllocCount(0)
+	  m_pFreeBins{nullptr},
+	  m_BinMap{0},
+	  m_nAllocCount(0),
+	  m_nFreeBlocks(0),
+
+	  m_nUsedBytes(0),
+	  m_nPeakUsedBytes(0),
+	  m_nTagUsedBytes{0},
+	  m_nAllocCalls(0),
+	  m_nReallocCalls(0),
+	  m_nFreeCalls(0),
+	  m_nAllocTime(0),
+	  m_nReallocTime(0),
+	  m_nFreeTime(0),
+
+	  m_Lock(TASK_LEVEL)
 {
 	assert(s_pThis == nullptr);
 	s_pThis = this;
@@ -95,6 +110,17 @@ bool CZoneAllocator::Initialize()
 }
 
 void* CZoneAllocator::Alloc(size_t nSize, TZoneTag Tag)
+{
+	m_Lock.Acquire();
+	const unsigned int nStartTime = CTimer::GetClockTicks();
+	void* pPtr = AllocUnlocked(nSize, Tag);
+	m_nAllocTime += CTimer::GetClockTicks() - nStartTime;
+	++m_nAllocCalls;
+	m_Lock.Release();
+	return pPtr;
+}
+
+void* CZoneAllocator::AllocUnlocked(size_t nSize, TZoneTag Tag)
 {
 	if (!nSize)
 		return nullptr;
@@ -105,58 +131,28 @@ void* CZoneAllocator::Alloc(size_t nSize, TZoneTag Tag)
 		return nullptr;
 	}
 
-	// Account for size of block header and magic number at end of zone (for corruption detection), padded to 16 bytes
-	nSize = (nSize + sizeof(TBlock) + sizeof(BlockMagic) + 0xF) & ~0xF;
-
-	TBlock* pNextBlock      = m_pCurrentBlock;
-	TBlock* pCandidateBlock = m_pCurrentBlock;
-	TBlock* pStartBlock     = m_pCurrentBlock->pPrevious;
+	nSize = GetBlockSize(nSize);
 
-	do
+	TBlock* pBlock = FindFreeBlock(nSize);
+	if (!pBlock)
 	{
-		// We've been through the whole linked list and couldn't find a free block
-		if (pNextBlock == pStartBlock)
-		{
-			CLogger::Get()->Write(ZoneAllocatorName, LogError, "Zone allocation failed: couldn't allocate %d bytes", nSize);
-			return nullptr;
-		}
-
-		// This block is in use; look at the next one
-		if (pNextBlock->Tag != TZoneTag::Free)
-			pCandidateBlock = pNextBlock->pNext;
-
-		pNextBlock = pNextBlock->pNext;
-	} while (pCandidateBlock->Tag || pCandidateBlock->nSize < nSize);
+		CLogger::Get()->Write(ZoneAllocatorName, LogError, "Zone allocation failed: couldn't allocate %d bytes", nSize);
+		return nullptr;
+	}
 
-	// Create a new block for any remaining free space
-	const size_t nRemaining = pCandidateBlock->nSize - nSize;
-	if (nRemaining > MinFragmentSize)
-	{
-		TBlock* pNewBlock    = reinterpret_cast<TBlock*>(reinterpret_cast<u8*>(pCandidateBlock) + nSize);
-		pNewBlock->nSize     = nRemaining;
-		pNewBlock->pNext     = pCandidateBlock->pNext;
-		pNewBlock->pPrevious = pCandidateBlock;
-		pNewBlock->Tag       = TZoneTag::Free;
-		pNewBlock->nMagic    = BlockMagic;
-#if AARCH == 32
-		memset(pNewBlock->Padding, 0xEB, Utility::ArraySize(pNewBlock->Padding));
-#endif
-		// Set the next block's previous to look at the new block
-		pNewBlock->pNext->pPrevious = pNewBlock;
+	RemoveFreeBlock(pBlock);
 
-		pCandidateBlock->nSize = nSize;
-		pCandidateBlock->pNext = pNewBlock;
-	}
+	// Return any remaining space to the free lists
+	SplitBlock(pBlock, nSize);
 
 	// Mark block used
-	pCandidateBlock->Tag    = Tag;
-	pCandidateBlock->nMagic = BlockMagic;
+	pBlock->Tag    = Tag;
+	pBlock->nMagic = BlockMagic;
 
 	// Mark end of memory with magic number
-	GetEndMagic(pCandidateBlock) = BlockMagic;
+	GetEndMagic(pBlock) = BlockMagic;
 
-	// Next allocation will start looking at this block
-	m_pCurrentBlock = pCandidateBlock->pNext;
+	AddUsage(pBlock);
 
 #ifdef ZONE_ALLOCATOR_TRACE
 	CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Allocated %d bytes for tag %x", nSize, Tag);
@@ -165,20 +161,30 @@ void* CZoneAllocator::Alloc(size_t nSize, TZoneTag Tag)
 	// Increment alloc counter
 	++m_nAllocCount;
 
-	return pCandidateBlock + 1;
+	return pBlock + 1;
 }
 
 void* CZoneAllocator::Realloc(void* pPtr, size_t nSize, TZoneTag Tag)
+{
+	m_Lock.Acquire();
+	const unsigned int nStartTime = CTimer::GetClockTicks();
+	pPtr = ReallocUnlocked(pPtr, nSize, Tag);
+	m_nReallocTime += CTimer::GetClockTicks() - nStartTime;
+	++m_nReallocCalls;
+	m_Lock.Release();
+	return pPtr;
+}
+
+void* CZoneAllocator::ReallocUnlocked(void* pPtr, size_t nSize, TZoneTag Tag)
 {
 	// If passed a null pointer, perform a new allocation
 	if (!pPtr)
-		return Alloc(nSize, Tag);
+		return AllocUnlocked(nSize, Tag);
 
 	if (!nSize)
 		return nullptr;
 
-	// Account for size of block header and magic number at end of zone (for corruption detection), padded to 16 bytes
-	const size_t nNewSize = (nSize + sizeof(TBlock) + sizeof(BlockMagic) + 0xF) & ~0xF;
+	const size_t nNewSize = GetBlockSize(nSize);
 	TBlock* pBlock        = reinterpret_cast<TBlock*>(pPtr) - 1;
 
 	if (Tag == TZoneTag::Free)
@@ -196,32 +202,19 @@ void* CZoneAllocator::Realloc(void* pPtr, size_t nSize, TZoneTag Tag)
 	// Expand block
 	if (nNewSize > pBlock->nSize)
 	{
-		const size_t nSizeDiff = nNewSize - pBlock->nSize;
+		TBlock* pNextBlock = pBlock->pNext;
 
 		// Expand in-place if next block is free and large enough
-		if (pBlock->pNext->Tag == TZoneTag::Free && pBlock->pNext->nSize >= nSizeDiff)
+		if (pNextBlock->Tag == TZoneTag::Free && pBlock->nSize + pNextBlock->nSize >= nNewSize)
 		{
-			TBlock* pNewBlock = reinterpret_cast<TBlock*>(reinterpret_cast<u8*>(pBlock) + nNewSize);
-
-			pNewBlock->nSize            = pBlock->pNext->nSize - nSizeDiff;
-			pNewBlock->pNext            = pBlock->pNext->pNext;
-			pNewBlock->pNext->pPrevious = pNewBlock;
-			pNewBlock->pPrevious        = pBlock;
-			pNewBlock->Tag              = TZoneTag::Free;
-			pNewBlock->nMagic           = BlockMagic;
-#if AARCH == 32
-			memset(pNewBlock->Padding, 0xEB, Utility::ArraySize(pNewBlock->Padding));
-#endif
-			GetEndMagic(pNewBlock) = BlockMagic;
+			RemoveUsage(pBlock);
+			RemoveFreeBlock(pNextBlock);
+			JoinNextBlock(pBlock);
+			SplitBlock(pBlock, nNewSize);
 
-			// Next allocations search from this new merged free block
-			if (pBlock->pNext == m_pCurrentBlock)
-				m_pCurrentBlock = pNewBlock;
-
-			pBlock->nSize       = nNewSize;
-			pBlock->pNext       = pNewBlock;
 			pBlock->Tag         = Tag;
 			GetEndMagic(pBlock) = BlockMagic;
+			AddUsage(pBlock);
 
 #ifdef ZONE_ALLOCATOR_TRACE
 			CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Expanded block at %p in-place", pPtr);
@@ -230,11 +223,44 @@ void* CZoneAllocator::Realloc(void* pPtr, size_t nSize, TZoneTag Tag)
 			return pBlock + 1;
 		}
 
+		// Otherwise, expand backwards if the previous block (together with any free space after us) is large enough
+		TBlock* pPreviousBlock = pBlock->pPrevious;
+		const size_t nNextFree = pNextBlock->Tag == TZoneTag::Free ? pNextBlock->nSize : 0;
+		if (pPreviousBlock->Tag == TZoneTag::Free && pPreviousBlock->nSize + pBlock->nSize + nNextFree >= nNewSize)
+		{
+			const size_t nSrcSize = pBlock->nSize - sizeof(TBlock) - sizeof(BlockMagic);
+
+			RemoveUsage(pBlock);
+			RemoveFreeBlock(pPreviousBlock);
+			if (nNextFree)
+			{
+				RemoveFreeBlock(pNextBlock);
+				JoinNextBlock(pBlock);
+			}
+			JoinNextBlock(pPreviousBlock);
+
+			// Source and destination may overlap
+			memmove(pPreviousBlock + 1, pPtr, nSrcSize);
+
+			pPreviousBlock->Tag    = Tag;
+			pPreviousBlock->nMagic = BlockMagic;
+			SplitBlock(pPreviousBlock, nNewSize);
+
+			GetEndMagic(pPreviousBlock) = BlockMagic;
+			AddUsage(pPreviousBlock);
+
+#ifdef ZONE_ALLOCATOR_TRACE
+			CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Expanded block at %p into previous block at %p", pPtr, pPreviousBlock);
+#endif
+
+			return pPreviousBlock + 1;
+		}
+
 		// Allocate a new block and move contents
 		else
 		{
 			const size_t nSrcSize = pBlock->nSize - sizeof(TBlock) - sizeof(BlockMagic);
-			void* pDest           = Alloc(nSize, Tag);
+			void* pDest           = AllocUnlocked(nSize, Tag);
 
 			if (!pDest)
 			{
@@ -243,7 +269,7 @@ void* CZoneAllocator::Realloc(void* pPtr, size_t nSize, TZoneTag Tag)
 			}
 
 			memcpy(pDest, pPtr, nSrcSize);
-			Free(pPtr);
+			FreeUnlocked(pPtr);
 
 #ifdef ZONE_ALLOCATOR_TRACE
 			CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Expanded block at %p by allocating new block", pPtr);
@@ -253,118 +279,95 @@ void* CZoneAllocator::Realloc(void* pPtr, size_t nSize, TZoneTag Tag)
 		}
 	}
 
-	// Shrink in-place
+	// Shrink in-place; the tail is returned to the free lists if it's big enough to hold a block
 	if (nNewSize < pBlock->nSize)
 	{
-		const size_t nRemain = pBlock->nSize - nNewSize;
-		if (nRemain > MinFragmentSize)
-		{
-			TBlock* pNewBlock = reinterpret_cast<TBlock*>(reinterpret_cast<u8*>(pBlock) + nNewSize);
+		RemoveUsage(pBlock);
+		SplitBlock(pBlock, nNewSize);
 
-			if (pBlock->pNext->Tag == TZoneTag::Free)
-			{
-				// Merge free space with next block if it is also free
-				*pNewBlock = *pBlock->pNext;
-				pNewBlock->nSize += nRemain;
-#ifdef ZONE_ALLOCATOR_TRACE
-				CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Shrunk block at %p in-place; adjacent free space expanded", pPtr);
-#endif
-			}
-			else
-			{
-				// Create a new block for any remaining free space
-				pNewBlock->nSize     = nRemain;
-				pNewBlock->pNext     = pBlock->pNext;
-				pNewBlock->pPrevious = pBlock;
-				pNewBlock->Tag       = TZoneTag::Free;
-				pNewBlock->nMagic    = BlockMagic;
-#if AARCH == 32
-				memset(pNewBlock->Padding, 0xEB, Utility::ArraySize(pNewBlock->Padding));
-#endif
-				GetEndMagic(pNewBlock) = BlockMagic;
 #ifdef ZONE_ALLOCATOR_TRACE
-				CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Shrunk block at %p in-place; new free block inserted after", pPtr);
+		CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Shrunk block at %p in-place", pPtr);
 #endif
-			}
 
-			// Next allocations search from this new merged free block
-			if (pBlock->pNext == m_pCurrentBlock)
-				m_pCurrentBlock = pNewBlock;
-
-			// Set the next block's previous to look at the new block
-			pNewBlock->pNext->pPrevious = pNewBlock;
-
-			pBlock->pNext = pNewBlock;
-		}
-
-		pBlock->nSize = nNewSize;
-		pBlock->Tag   = Tag;
+		pBlock->Tag = Tag;
 
 		// Mark end of memory with magic number
 		GetEndMagic(pBlock) = BlockMagic;
+		AddUsage(pBlock);
 
 		return pBlock + 1;
 	}
 
 	// Size is the same, just update tag
+	RemoveUsage(pBlock);
 	pBlock->Tag = Tag;
+	AddUsage(pBlock);
 	return pPtr;
 }
 
 void CZoneAllocator::Free(void* pPtr)
+{
+	m_Lock.Acquire();
+	const unsigned int nStartTime = CTimer::GetClockTicks();
+	FreeUnlocked(pPtr);
+	m_nFreeTime += CTimer::GetClockTicks() - nStartTime;
+	++m_nFreeCalls;
+	m_Lock.Release();
+}
+
+CZoneAllocator::TBlock* CZoneAllocator::FreeUnlocked(void* pPtr)
 {
 	if (!pPtr)
-		return;
+		return nullptr;
 
 	TBlock* pBlock = reinterpret_cast<TBlock*>(pPtr) - 1;
 
 	if (pBlock->Tag == TZoneTag::Free)
 	{
 		CLogger::Get()->Write(ZoneAllocatorName, LogError, "Attempted to free an already-freed block");
-		return;
+		return nullptr;
 	}
 
 	if (pBlock->nMagic != BlockMagic)
 	{
 		CLogger::Get()->Write(ZoneAllocatorName, LogError, "Attempted to free a block with a bad magic number (heap corruption?)");
-		return;
+		return nullptr;
 	}
 
+	RemoveUsage(pBlock);
+
 	// Mark this block as free
 	pBlock->Tag = TZoneTag::Free;
 
-	// Join with previous block if previous block is also free
-	TBlock* pAdjacentBlock = pBlock->pPrevious;
+	// Join with next block if next block is also free
+	TBlock* pAdjacentBlock = pBlock->pNext;
 	if (pAdjacentBlock->Tag == TZoneTag::Free)
 	{
-		pAdjacentBlock->nSize += pBlock->nSize;
-		pAdjacentBlock->pNext            = pBlock->pNext;
-		pAdjacentBlock->pNext->pPrevious = pAdjacentBlock;
-		// Next allocations search from this new merged free block
-		if (pBlock == m_pCurrentBlock)
-			m_pCurrentBlock = pAdjacentBlock;
+		RemoveFreeBlock(pAdjacentBlock);
+		JoinNextBlock(pBlock);
 #ifdef ZONE_ALLOCATOR_TRACE
-		CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Merged freed block at %p with previous block at %p", pPtr, pAdjacentBlock);
+		CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Merged freed block at %p with next block at %p", pPtr, pAdjacentBlock);
 #endif
-		pBlock = pAdjacentBlock;
 	}
 
-	// Join with next block if next block is also free
-	pAdjacentBlock = pBlock->pNext;
+	// Join with previous block if previous block is also free
+	pAdjacentBlock = pBlock->pPrevious;
 	if (pAdjacentBlock->Tag == TZoneTag::Free)
 	{
-		pBlock->nSize += pAdjacentBlock->nSize;
-		pBlock->pNext            = pAdjacentBlock->pNext;
-		pBlock->pNext->pPrevious = pBlock;
-		if (pAdjacentBlock == m_pCurrentBlock)
-			m_pCurrentBlock = pBlock;
+		RemoveFreeBlock(pAdjacentBlock);
+		JoinNextBlock(pAdjacentBlock);
 #ifdef ZONE_ALLOCATOR_TRACE
-		CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Merged freed block at %p with next block at %p", pPtr, pAdjacentBlock);
+		CLogger::Get()->Write(ZoneAllocatorName, LogDebug, "Merged freed block at %p with previous block at %p", pPtr, pAdjacentBlock);
 #endif
+		pBlock = pAdjacentBlock;
 	}
 
+	InsertFreeBlock(pBlock);
+
 	// Decrement allocation counter
 	--m_nAllocCount;
+
+	return pBlock;
 }
 
 void CZoneAllocator::Clear()
@@ -391,7 +394,14 @@ void CZoneAllocator::Clear()
 	memset(pFirstBlock->Padding, 0xEB, Utility::ArraySize(pFirstBlock->Padding));
 #endif
 
-	m_pCurrentBlock = pFirstBlock;
+	memset(m_pFreeBins, 0, sizeof(m_pFreeBins));
+	memset(m_BinMap, 0, sizeof(m_BinMap));
+	m_nFreeBlocks = 0;
+	InsertFreeBlock(pFirstBlock);
+
+	m_nAllocCount = 0;
+	m_nUsedBytes  = 0;
+	memset(m_nTagUsedBytes, 0, sizeof(m_nTagUsedBytes));
 }
 
 void CZoneAllocator::FreeTag(u32 Tag)
@@ -402,17 +412,213 @@ void CZoneAllocator::FreeTag(u32 Tag)
 		return;
 	}
 
+	m_Lock.Acquire();
+
 	TBlock* pBlock = m_MainBlock.pNext;
-	TBlock* pNextBlock;
 
 	do
 	{
-		// Grab the next block before freeing this one
-		pNextBlock = pBlock->pNext;
-		if (pBlock->Tag == Tag)
-			Free(reinterpret_cast<u8*>(pBlock) + sizeof(TBlock));
-		pBlock = pNextBlock;
+		// Freeing may merge this block with its neighbours; carry on from the merged block
+		if (pBlock->Tag == Tag && !(pBlock = FreeUnlocked(pBlock + 1)))
+			break;
+		pBlock = pBlock->pNext;
 	} while (pBlock != &m_MainBlock);
+
+	m_Lock.Release();
+}
+
+size_t CZoneAllocator::GetBinIndex(size_t nSize)
+{
+	// Small blocks have one bin per size
+	if (nSize <= SmallBlockLimit)
+		return (nSize - MinBlockSize) / BlockAlignment;
+
+	// Large blocks share a bin with all blocks of the same power of two
+	const size_t nLog2 = sizeof(unsigned long) * 8 - 1 - __builtin_clzl(nSize);
+	return Utility::Min(SmallBinCount + nLog2 - SmallBlockLimitLog2, BinCount - 1);
+}
+
+CZoneAllocator::TBlock* CZoneAllocator::FindFreeBlock(size_t nSize) const
+{
+	size_t nBin = GetBinIndex(nSize);
+
+	// Blocks in a large bin may be smaller than requested; take the first one that fits
+	if (nBin >= SmallBinCount)
+	{
+		for (TBlock* pBlock = m_pFreeBins[nBin]; pBlock; pBlock = GetFreeLinks(pBlock).pNextFree)
+		{
+			if (pBlock->nSize >= nSize)
+				return pBlock;
+		}
+
+		++nBin;
+	}
+
+	// Any block in this bin or a larger one will fit
+	for (size_t nWord = nBin / 32; nWord < BinMapWords; ++nWord)
+	{
+		u32 nMap = m_BinMap[nWord];
+		if (nWord == nBin / 32)
+			nMap &= ~0u << (nBin % 32);
+
+		if (nMap)
+			return m_pFreeBins[nWord * 32 + __builtin_ctz(nMap)];
+	}
+
+	return nullptr;
+}
+
+void CZoneAllocator::InsertFreeBlock(TBlock* pBlock)
+{
+	const size_t nBin  = GetBinIndex(pBlock->nSize);
+	TFreeLinks& Links = GetFreeLinks(pBlock);
+
+	Links.pNextFree     = m_pFreeBins[nBin];
+	Links.pPreviousFree = nullptr;
+
+	if (Links.pNextFree)
+		GetFreeLinks(Links.pNextFree).pPreviousFree = pBlock;
+
+	m_pFreeBins[nBin] = pBlock;
+	m_BinMap[nBin / 32] |= 1u << (nBin % 32);
+	++m_nFreeBlocks;
+}
+
+void CZoneAllocator::RemoveFreeBlock(TBlock* pBlock)
+{
+	const size_t nBin  = GetBinIndex(pBlock->nSize);
+	TFreeLinks& Links = GetFreeLinks(pBlock);
+
+	if (Links.pPreviousFree)
+		GetFreeLinks(Links.pPreviousFree).pNextFree = Links.pNextFree;
+	else
+		m_pFreeBins[nBin] = Links.pNextFree;
+
+	if (Links.pNextFree)
+		GetFreeLinks(Links.pNextFree).pPreviousFree = Links.pPreviousFree;
+
+	if (!m_pFreeBins[nBin])
+		m_BinMap[nBin / 32] &= ~(1u << (nBin % 32));
+	--m_nFreeBlocks;
+}
+
+void CZoneAllocator::SplitBlock(TBlock* pBlock, size_t nSize)
+{
+	const size_t nRemaining = pBlock->nSize - nSize;
+	TBlock* pNextBlock      = pBlock->pNext;
+	const bool bNextFree    = pNextBlock->Tag == TZoneTag::Free;
+
+	// Space too small to hold a block of its own can still be given to a free neighbour
+	if (!nRemaining || (nRemaining < MinBlockSize && !bNextFree))
+		return;
+
+	// Merge free space with next block if it is also free; unlink it before its header gets overwritten
+	size_t nNewSize = nRemaining;
+	if (bNextFree)
+	{
+		RemoveFreeBlock(pNextBlock);
+		nNewSize += pNextBlock->nSize;
+		pNextBlock = pNextBlock->pNext;
+	}
+
+	// Create a new free block for the remaining space
+	TBlock* pNewBlock    = reinterpret_cast<TBlock*>(reinterpret_cast<u8*>(pBlock) + nSize);
+	pNewBlock->nSize     = nNewSize;
+	pNewBlock->pNext     = pNextBlock;
+	pNewBlock->pPrevious = pBlock;
+	pNewBlock->Tag       = TZoneTag::Free;
+	pNewBlock->nMagic    = BlockMagic;
+#if AARCH == 32
+	memset(pNewBlock->Padding, 0xEB, Utility::ArraySize(pNewBlock->Padding));
+#endif
+	// Set the next block's previous to look at the new block
+	pNextBlock->pPrevious = pNewBlock;
+
+	pBlock->nSize = nSize;
+	pBlock->pNext = pNewBlock;
+
+	InsertFreeBlock(pNewBlock);
+}
+
+void CZoneAllocator::AddUsage(const TBlock* pBlock)
+{
+	m_nUsedBytes += pBlock->nSize;
+	m_nPeakUsedBytes = Utility::Max(m_nPeakUsedBytes, m_nUsedBytes);
+
+	if (pBlock->Tag < TagCount)
+		m_nTagUsedBytes[pBlock->Tag] += pBlock->nSize;
+}
+
+void CZoneAllocator::RemoveUsage(const TBlock* pBlock)
+{
+	m_nUsedBytes -= pBlock->nSize;
+
+	if (pBlock->Tag < TagCount)
+		m_nTagUsedBytes[pBlock->Tag] -= pBlock->nSize;
+}
+
+size_t CZoneAllocator::GetLargestFreeBlock() const
+{
+	// Find the highest non-empty bin
+	for (size_t nWord = BinMapWords; nWord-- > 0;)
+	{
+		const u32 nMap = m_BinMap[nWord];
+		if (!nMap)
+			continue;
+
+		size_t nLargest = 0;
+		for (TBlock* pBlock = m_pFreeBins[nWord * 32 + 31 - __builtin_clz(nMap)]; pBlock; pBlock = GetFreeLinks(pBlock).pNextFree)
+			nLargest = Utility::Max(nLargest, pBlock->nSize);
+
+		return nLargest;
+	}
+
+	return 0;
+}
+
+CZoneAllocator::TStats CZoneAllocator::GetStats()
+{
+	TStats Stats;
+
+	m_Lock.Acquire();
+
+	Stats.nHeapSize         = m_nHeapSize;
+	Stats.nUsedBytes        = m_nUsedBytes;
+	Stats.nPeakUsedBytes    = m_nPeakUsedBytes;
+	Stats.nLargestFreeBlock = GetLargestFreeBlock();
+	Stats.nFreeBlocks       = m_nFreeBlocks;
+	Stats.nAllocCount       = m_nAllocCount;
+	memcpy(Stats.nTagUsedBytes, m_nTagUsedBytes, sizeof(m_nTagUsedBytes));
+
+	Stats.nAllocCalls   = m_nAllocCalls;
+	Stats.nReallocCalls = m_nReallocCalls;
+	Stats.nFreeCalls    = m_nFreeCalls;
+	Stats.nAllocTime    = m_nAllocTime;
+	Stats.nReallocTime  = m_nReallocTime;
+	Stats.nFreeTime     = m_nFreeTime;
+
+	m_Lock.Release();
+
+	return Stats;
+}
+
+void CZoneAllocator::LogStats()
+{
+	CLogger* const pLogger = CLogger::Get();
+	const TStats Stats     = GetStats();
+
+	pLogger->Write(ZoneAllocatorName, LogNotice, "Heap: %d/%d KB used (peak %d KB), FluidSynth: %d KB", Stats.nUsedBytes / 1024, Stats.nHeapSize / 1024, Stats.nPeakUsedBytes / 1024, Stats.nTagUsedBytes[TZoneTag::FluidSynth] / 1024);
+	pLogger->Write(ZoneAllocatorName, LogNotice, "%d allocations, %d free blocks, largest free block: %d KB", Stats.nAllocCount, Stats.nFreeBlocks, Stats.nLargestFreeBlock / 1024);
+	pLogger->Write(ZoneAllocatorName, LogNotice, "Calls: %u alloc (%u ms), %u realloc (%u ms), %u free (%u ms)", Stats.nAllocCalls, static_cast<u32>(Stats.nAllocTime / 1000), Stats.nReallocCalls, static_cast<u32>(Stats.nReallocTime / 1000), Stats.nFreeCalls, static_cast<u32>(Stats.nFreeTime / 1000));
+}
+
+void CZoneAllocator::JoinNextBlock(TBlock* pBlock)
+{
+	TBlock* pNextBlock = pBlock->pNext;
+
+	pBlock->nSize += pNextBlock->nSize;
+	pBlock->pNext            = pNextBlock->pNext;
+	pBlock->pNext->pPrevious = pBlock;
 }
 
 void CZoneAllocator::Dump() const
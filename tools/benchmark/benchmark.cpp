@@ -0,0 +1,600 @@
+//
+// benchmark.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <circle/logger.h>
+#include <circle/memory.h>
+#include <circle/timer.h>
+#include <fatfs/ff.h>
+
+#include "config.h"
+#include "midiparser.h"
+#include "midiplayer.h"
+#include "mixer.h"
+#include "synth/mt32synth.h"
+#include "synth/soundfontsynth.h"
+#include "zoneallocator.h"
+
+// Plays Standard MIDI Files from a directory laid out like mt32-pi's SD card through the firmware's own synth classes,
+// configured from its mt32-pi.cfg, as fast as possible; rendering is done in chunks like the firmware's audio task,
+// and the time taken is reported against the length of the audio produced
+
+namespace
+{
+	using TClock = std::chrono::steady_clock;
+
+	// Feeds the synth the way a sequencer on the MIDI input would: as a byte stream, through the firmware's parser
+	class CMIDIInput : public CMIDIParser
+	{
+	public:
+		CMIDIInput(CSynthBase& Synth) : m_Synth(Synth) {}
+
+	protected:
+		virtual void OnShortMessage(u32 nMessage, unsigned int nTimestamp) override { m_Synth.HandleMIDIShortMessage(nMessage, nTimestamp); }
+		virtual void OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override { m_Synth.HandleMIDISysExMessage(pData, nSize, nTimestamp); }
+
+		virtual bool OnSysExFragment(const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp) override
+		{
+			// Only mt32emu can take a SysEx message in pieces, as on the firmware
+			CMT32Synth* const pMT32Synth = dynamic_cast<CMT32Synth*>(&m_Synth);
+			return pMT32Synth && pMT32Synth->HandleMIDISysExFragment(this, pData, nSize, nOffset, bComplete, nTimestamp);
+		}
+
+	private:
+		CSynthBase& m_Synth;
+	};
+
+	class CBenchmarkPlayer : public CMIDIPlayer
+	{
+	public:
+		// Without an input, the player can only be used to list files
+		CBenchmarkPlayer(CMIDIInput* pInput = nullptr) : m_pInput(pInput) {}
+
+	protected:
+		virtual void OnShortMessage(u32 nMessage, unsigned int nTimestamp) override
+		{
+			const u8 Message[] = { static_cast<u8>(nMessage), static_cast<u8>(nMessage >> 8), static_cast<u8>(nMessage >> 16) };
+			OnMIDIBytes(Message, GetShortMessageLength(Message[0]), nTimestamp);
+		}
+
+		virtual void OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override { OnMIDIBytes(pData, nSize, nTimestamp); }
+
+		virtual void OnMIDIBytes(const u8* pData, size_t nSize, unsigned int nTimestamp) { m_pInput->ParseMIDIBytes(pData, nSize, nTimestamp); }
+
+	private:
+		static size_t GetShortMessageLength(u8 nStatus)
+		{
+			switch (nStatus & 0xF0)
+			{
+				case 0xC0:
+				case 0xD0:
+					return 2;
+
+				case 0xF0:
+					return nStatus == 0xF1 || nStatus == 0xF3 ? 2 : nStatus == 0xF2 ? 3 : 1;
+
+				default:
+					return 3;
+			}
+		}
+
+		CMIDIInput* m_pInput;
+	};
+
+	// Collects the byte stream a file produces, for timing the parser by itself
+	class CCapturePlayer : public CBenchmarkPlayer
+	{
+	public:
+		CCapturePlayer(std::vector<u8>& Stream) : m_Stream(Stream) {}
+
+	protected:
+		virtual void OnMIDIBytes(const u8* pData, size_t nSize, unsigned int nTimestamp) override { m_Stream.insert(m_Stream.end(), pData, pData + nSize); }
+
+	private:
+		std::vector<u8>& m_Stream;
+	};
+
+	// Counts what the parser delivers, so that there's something for it to do
+	class CCountingParser : public CMIDIParser
+	{
+	public:
+		size_t nMessages   = 0;
+		size_t nSysExBytes = 0;
+
+	protected:
+		virtual void OnShortMessage(u32 nMessage, unsigned int nTimestamp) override { ++nMessages; }
+		virtual void OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override { ++nMessages; nSysExBytes += nSize; }
+
+		// Taken in pieces, as CMT32Synth does
+		virtual bool OnSysExFragment(const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp) override
+		{
+			nMessages += bComplete;
+			nSysExBytes += nSize;
+			return true;
+		}
+	};
+
+	struct TOptions
+	{
+		std::string SDCardPath    = ".";
+		std::string USBPath;
+		std::string Synth;
+		unsigned int nChunkSize   = 0;
+		unsigned int nHeapSizeMB  = 512;
+		double nTailSeconds       = 2.0;
+		unsigned int nRepeats     = 1;
+		bool bParse               = false;
+		bool bCSV                 = false;
+		bool bVerbose             = false;
+	};
+
+	struct TResult
+	{
+		double nAudioSeconds;
+		double nRenderSeconds;
+		double nMIDISeconds;
+		size_t nChunks;
+		size_t nLateChunks;
+		double nMeanChunkMicros;
+		double nP99ChunkMicros;
+		double nMaxChunkMicros;
+		unsigned int nPeakVoices;
+
+		// Zone heap in use once the synth was ready, and the calls made into it during playback
+		size_t nHeapUsedBytes;
+		size_t nHeapPeakBytes;
+		u32 nHeapAllocCalls;
+		u32 nHeapFreeCalls;
+	};
+
+	struct TParseResult
+	{
+		size_t nBytes;
+		size_t nMessages;
+		size_t nSysExBytes;
+
+		// Best of the passes over the stream
+		double nWholeSeconds;
+		double nByteAtATimeSeconds;
+	};
+
+	// Set up as by CMT32Pi::InitMT32Synth() and CMT32Pi::InitSoundFontSynth()
+	std::unique_ptr<CSynthBase> CreateSynth(bool bSoundFont)
+	{
+		CConfig* const pConfig = CConfig::Get();
+
+		if (bSoundFont)
+		{
+			std::unique_ptr<CSoundFontSynth> pSynth(new CSoundFontSynth(pConfig->AudioSampleRate, pConfig->FluidSynthGain, pConfig->FluidSynthPolyphony, pConfig->FluidSynthVoiceCullFloor, pConfig->FluidSynthSplitRender, pConfig->FluidSynthDynamicSamples));
+			if (!pSynth->Initialize())
+			{
+				fprintf(stderr, "FluidSynth init failed; no SoundFonts present?\n");
+				return nullptr;
+			}
+
+			pSynth->SetMIDICommandQueueEnabled(pConfig->MIDICommandQueue);
+			return pSynth;
+		}
+
+		const bool bIntegerRenderer = pConfig->AudioOutputDevice == CConfig::TAudioOutputDevice::PWM && !pConfig->AudioDither;
+		std::unique_ptr<CMT32Synth> pSynth(new CMT32Synth(pConfig->AudioSampleRate, pConfig->MT32EmuGain, pConfig->MT32EmuReverbGain, pConfig->MT32EmuResamplerQuality, bIntegerRenderer));
+		if (!pSynth->Initialize())
+		{
+			fprintf(stderr, "mt32emu init failed; no ROMs present?\n");
+			return nullptr;
+		}
+
+		if (pConfig->MT32EmuMIDIChannels == CMT32Synth::TMIDIChannels::Alternate)
+			pSynth->SetMIDIChannels(pConfig->MT32EmuMIDIChannels);
+
+		pSynth->SetMIDICommandQueueEnabled(pConfig->MIDICommandQueue);
+		return pSynth;
+	}
+
+	bool Run(const TOptions& Options, bool bSoundFont, size_t nFileIndex, TResult& Result)
+	{
+		CConfig* const pConfig = CConfig::Get();
+		CZoneAllocator* const pAllocator = CZoneAllocator::Get();
+
+		// A fresh synth for each run, so that every run starts from the same state
+		std::unique_ptr<CSynthBase> pSynth = CreateSynth(bSoundFont);
+		if (!pSynth)
+			return false;
+
+		CSoundFontSynth* const pSoundFontSynth = bSoundFont ? static_cast<CSoundFontSynth*>(pSynth.get()) : nullptr;
+		const bool bSplitRender = pSoundFontSynth && pSoundFontSynth->IsSplitRenderEnabled();
+
+		// As in CMT32Pi::AudioTask()
+		const bool bRenderS16 = pConfig->AudioOutputDevice == CConfig::TAudioOutputDevice::PWM && !pConfig->AudioDither && !bSplitRender;
+
+		CMIDIInput Input(*pSynth);
+		Input.SetSysExBufferSize(pConfig->MIDISysExBufferSize);
+
+		CBenchmarkPlayer Player(&Input);
+		if (!Player.ScanFiles() || !Player.Play(nFileIndex))
+			return false;
+
+		const unsigned int nSampleRate = pConfig->AudioSampleRate;
+		const size_t nChunkSize        = Options.nChunkSize ? Options.nChunkSize : pConfig->AudioChunkSize;
+		const size_t nTailFrames       = static_cast<size_t>(Options.nTailSeconds * nSampleRate);
+		const double nChunkMicros      = 1000000.0 * nChunkSize / nSampleRate;
+
+		std::vector<float> FloatBuffer(nChunkSize * 2);
+		std::vector<float> SecondaryFloatBuffer(nChunkSize * 2);
+		std::vector<s16> Int16Buffer(nChunkSize * 2);
+		std::vector<double> ChunkMicros;
+
+		CTimer* const pTimer = CTimer::Get();
+		u64 nRenderedFrames = 0;
+		size_t nRemainingTailFrames = nTailFrames;
+		bool bPlaying = true;
+		unsigned int nPeakVoices = 0;
+		TClock::duration MIDITime{};
+		TClock::duration RenderTime{};
+
+		// Sampling voices is expensive for mt32emu; do it about every 10ms, outside of the timed section
+		const size_t nVoiceSamplePeriod = std::max<size_t>(1, nSampleRate / 100 / nChunkSize);
+
+		const CZoneAllocator::TStats StartStats = pAllocator->GetStats();
+
+		while (bPlaying || nRemainingTailFrames)
+		{
+			// Events that became due while the previous chunk was playing; the synth places them within the next one
+			if (bPlaying)
+			{
+				const TClock::time_point StartTime = TClock::now();
+				bPlaying = Player.Update();
+				MIDITime += TClock::now() - StartTime;
+			}
+			else
+				nRemainingTailFrames -= std::min(nRemainingTailFrames, nChunkSize);
+
+			const TClock::time_point StartTime = TClock::now();
+			TClock::duration ChunkTime;
+
+			if (bSplitRender)
+			{
+				// The firmware renders the odd channels on core 3 at the same time, so a chunk takes as long as the
+				// slower half, plus the mix
+				pSoundFontSynth->ProcessMIDICommands();
+				pSoundFontSynth->RenderPrimary(FloatBuffer.data(), nChunkSize);
+				const TClock::time_point PrimaryEndTime = TClock::now();
+				pSoundFontSynth->RenderSecondary(SecondaryFloatBuffer.data(), nChunkSize);
+				const TClock::time_point SecondaryEndTime = TClock::now();
+				Mixer::Add(FloatBuffer.data(), SecondaryFloatBuffer.data(), nChunkSize * 2);
+
+				ChunkTime = std::max(PrimaryEndTime - StartTime, SecondaryEndTime - PrimaryEndTime) + (TClock::now() - SecondaryEndTime);
+			}
+			else
+			{
+				if (bRenderS16)
+					pSynth->Render(Int16Buffer.data(), nChunkSize);
+				else
+					pSynth->Render(FloatBuffer.data(), nChunkSize);
+
+				ChunkTime = TClock::now() - StartTime;
+			}
+
+			RenderTime += ChunkTime;
+			ChunkMicros.push_back(std::chrono::duration<double, std::micro>(ChunkTime).count());
+
+			// Move the clock on by the chunk's playback time, without accumulating rounding errors
+			const u64 nPreviousMicros = nRenderedFrames * 1000000 / nSampleRate;
+			nRenderedFrames += nChunkSize;
+			pTimer->Advance(nRenderedFrames * 1000000 / nSampleRate - nPreviousMicros);
+
+			if (ChunkMicros.size() % nVoiceSamplePeriod == 0)
+				nPeakVoices = std::max(nPeakVoices, pSynth->GetActiveVoiceCount());
+		}
+
+		const CZoneAllocator::TStats EndStats = pAllocator->GetStats();
+
+		if (ChunkMicros.empty())
+			return false;
+
+		Result.nChunks          = ChunkMicros.size();
+		Result.nAudioSeconds    = static_cast<double>(nRenderedFrames) / nSampleRate;
+		Result.nRenderSeconds   = std::chrono::duration<double>(RenderTime).count();
+		Result.nMIDISeconds     = std::chrono::duration<double>(MIDITime).count();
+		Result.nLateChunks      = std::count_if(ChunkMicros.begin(), ChunkMicros.end(), [nChunkMicros](double nMicros) { return nMicros > nChunkMicros; });
+		Result.nMeanChunkMicros = Result.nRenderSeconds * 1000000.0 / Result.nChunks;
+		Result.nMaxChunkMicros  = *std::max_element(ChunkMicros.begin(), ChunkMicros.end());
+		Result.nPeakVoices      = nPeakVoices;
+		Result.nHeapUsedBytes   = StartStats.nUsedBytes;
+		Result.nHeapPeakBytes   = EndStats.nPeakUsedBytes;
+		Result.nHeapAllocCalls  = (EndStats.nAllocCalls - StartStats.nAllocCalls) + (EndStats.nReallocCalls - StartStats.nReallocCalls);
+		Result.nHeapFreeCalls   = EndStats.nFreeCalls - StartStats.nFreeCalls;
+
+		const size_t nP99Index = Result.nChunks * 99 / 100;
+		std::nth_element(ChunkMicros.begin(), ChunkMicros.begin() + nP99Index, ChunkMicros.end());
+		Result.nP99ChunkMicros = ChunkMicros[nP99Index];
+
+		return true;
+	}
+
+	// Times one pass of the parser over the stream in pieces of nPieceSize bytes
+	double TimeParse(const std::vector<u8>& Stream, size_t nPieceSize, size_t nSysExBufferSize, TParseResult& Result)
+	{
+		CCountingParser Parser;
+		Parser.SetSysExBufferSize(nSysExBufferSize);
+
+		const TClock::time_point StartTime = TClock::now();
+		for (size_t nOffset = 0; nOffset < Stream.size(); nOffset += nPieceSize)
+			Parser.ParseMIDIBytes(Stream.data() + nOffset, std::min(nPieceSize, Stream.size() - nOffset), 0);
+		const double nSeconds = std::chrono::duration<double>(TClock::now() - StartTime).count();
+
+		Result.nMessages   = Parser.nMessages;
+		Result.nSysExBytes = Parser.nSysExBytes;
+		return nSeconds;
+	}
+
+	// Times CMIDIParser over the bytes the file would send to the synth, handed over all at once (where runs of data
+	// bytes take its bulk paths) and one byte at a time (as from a serial port read byte by byte)
+	bool RunParse(const TOptions& Options, size_t nFileIndex, TParseResult& Result)
+	{
+		std::vector<u8> Stream;
+		CCapturePlayer Player(Stream);
+		if (!Player.ScanFiles() || !Player.Play(nFileIndex))
+			return false;
+
+		CTimer* const pTimer = CTimer::Get();
+		while (Player.Update())
+			pTimer->Advance(1000);
+
+		if (Stream.empty())
+			return false;
+
+		const size_t nSysExBufferSize = CConfig::Get()->MIDISysExBufferSize;
+		Result.nBytes              = Stream.size();
+		Result.nWholeSeconds       = 0.0;
+		Result.nByteAtATimeSeconds = 0.0;
+
+		// Enough passes for a stable result, however short the file
+		double nTotalSeconds = 0.0;
+		for (unsigned int nPass = 0; nPass < Options.nRepeats || nTotalSeconds < 0.5; ++nPass)
+		{
+			const double nWholeSeconds       = TimeParse(Stream, Stream.size(), nSysExBufferSize, Result);
+			const double nByteAtATimeSeconds = TimeParse(Stream, 1, nSysExBufferSize, Result);
+
+			if (!nPass || nWholeSeconds < Result.nWholeSeconds)
+				Result.nWholeSeconds = nWholeSeconds;
+			if (!nPass || nByteAtATimeSeconds < Result.nByteAtATimeSeconds)
+				Result.nByteAtATimeSeconds = nByteAtATimeSeconds;
+
+			nTotalSeconds += nWholeSeconds + nByteAtATimeSeconds;
+		}
+
+		return true;
+	}
+
+	void PrintUsage(const char* pProgram)
+	{
+		fprintf(stderr,
+			"Usage: %s [options] [file.mid...]\n"
+			"\n"
+			"Plays the given files from the SD card's midi directory, or all of them.\n"
+			"\n"
+			"  -d, --sd-card DIR              directory laid out like mt32-pi's SD card (default .)\n"
+			"  -u, --usb DIR                  directory laid out like a USB disk for mt32-pi\n"
+			"  -s, --synth mt32|soundfont     synth to benchmark (default from mt32-pi.cfg)\n"
+			"  -k, --chunk-size FRAMES        frames rendered at a time (default from mt32-pi.cfg)\n"
+			"  -m, --heap MEGABYTES           size of the zone heap (default 512)\n"
+			"  -t, --tail SECONDS             time rendered after the last event (default 2)\n"
+			"  -n, --repeats COUNT            runs per file; the fastest is reported (default 1)\n"
+			"  -p, --parse                    time the MIDI parser on each file's byte stream instead\n"
+			"  -V, --verbose                  show the firmware's log messages\n"
+			"      --csv                      print results as CSV\n",
+			pProgram);
+	}
+
+	bool ParseOptions(int argc, char** argv, TOptions& Options)
+	{
+		static const option LongOptions[] = {
+			{ "sd-card", required_argument, nullptr, 'd' },
+			{ "usb", required_argument, nullptr, 'u' },
+			{ "synth", required_argument, nullptr, 's' },
+			{ "chunk-size", required_argument, nullptr, 'k' },
+			{ "heap", required_argument, nullptr, 'm' },
+			{ "tail", required_argument, nullptr, 't' },
+			{ "repeats", required_argument, nullptr, 'n' },
+			{ "parse", no_argument, nullptr, 'p' },
+			{ "verbose", no_argument, nullptr, 'V' },
+			{ "csv", no_argument, nullptr, 'C' },
+			{ "help", no_argument, nullptr, 'h' },
+			{ nullptr, 0, nullptr, 0 },
+		};
+
+		int nOption;
+		while ((nOption = getopt_long(argc, argv, "d:u:s:k:m:t:n:pVh", LongOptions, nullptr)) != -1)
+		{
+			switch (nOption)
+			{
+				case 'd': Options.SDCardPath   = optarg; break;
+				case 'u': Options.USBPath      = optarg; break;
+				case 's': Options.Synth        = optarg; break;
+				case 'k': Options.nChunkSize   = strtoul(optarg, nullptr, 10); break;
+				case 'm': Options.nHeapSizeMB  = strtoul(optarg, nullptr, 10); break;
+				case 't': Options.nTailSeconds = atof(optarg); break;
+				case 'n': Options.nRepeats     = strtoul(optarg, nullptr, 10); break;
+				case 'p': Options.bParse       = true; break;
+				case 'V': Options.bVerbose     = true; break;
+				case 'C': Options.bCSV         = true; break;
+				default: return false;
+			}
+		}
+
+		if (!Options.nHeapSizeMB || !Options.nRepeats || Options.nTailSeconds < 0.0)
+			return false;
+
+		if (!Options.Synth.empty() && Options.Synth != "mt32" && Options.Synth != "soundfont")
+		{
+			fprintf(stderr, "Unknown synth \"%s\"\n", Options.Synth.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	// The player's file list, in the order it plays them, narrowed down to the named files if any
+	bool GetFileIndices(CMIDIPlayer& Player, int nNames, char** ppNames, std::vector<size_t>& Indices)
+	{
+		if (!Player.ScanFiles())
+		{
+			fprintf(stderr, "No MIDI files found in the midi directory\n");
+			return false;
+		}
+
+		if (!nNames)
+		{
+			for (size_t i = 0; i < Player.GetFileCount(); ++i)
+				Indices.push_back(i);
+			return true;
+		}
+
+		for (int i = 0; i < nNames; ++i)
+		{
+			size_t nIndex = 0;
+			while (nIndex < Player.GetFileCount() && strcasecmp(Player.GetFileName(nIndex), ppNames[i]) != 0)
+				++nIndex;
+
+			if (nIndex == Player.GetFileCount())
+			{
+				fprintf(stderr, "'%s' isn't in the midi directory\n", ppNames[i]);
+				return false;
+			}
+
+			Indices.push_back(nIndex);
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	TOptions Options;
+	if (!ParseOptions(argc, argv, Options))
+	{
+		PrintUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Stand-ins for what CKernel sets up on the Raspberry Pi
+	CLogger Logger(Options.bVerbose ? LogDebug : LogError);
+	CTimer Timer;
+	CMemorySystem Memory(static_cast<size_t>(Options.nHeapSizeMB) * MEGABYTE);
+
+	f_mapdrive("SD", Options.SDCardPath.c_str());
+	if (!Options.USBPath.empty())
+		f_mapdrive("USB", Options.USBPath.c_str());
+
+	CConfig Config;
+	if (!Config.Initialize(CConfig::FileName))
+		fprintf(stderr, "Unable to find or parse mt32-pi.cfg; using defaults\n");
+
+	CZoneAllocator Allocator;
+	if (!Allocator.Initialize())
+		return EXIT_FAILURE;
+
+	CBenchmarkPlayer Files;
+	std::vector<size_t> FileIndices;
+	if (!GetFileIndices(Files, argc - optind, argv + optind, FileIndices))
+		return EXIT_FAILURE;
+
+	if (Options.bParse)
+	{
+		if (Options.bCSV)
+			printf("file,bytes,messages,sysex_bytes,whole_mb_s,byte_at_a_time_mb_s\n");
+		else
+			printf("CMIDIParser, %d byte SysEx buffer\n", Config.MIDISysExBufferSize);
+
+		for (size_t nFileIndex : FileIndices)
+		{
+			TParseResult Result;
+			if (!RunParse(Options, nFileIndex, Result))
+				return EXIT_FAILURE;
+
+			const double nWholeMBPerSecond       = Result.nBytes / Result.nWholeSeconds / 1000000.0;
+			const double nByteAtATimeMBPerSecond = Result.nBytes / Result.nByteAtATimeSeconds / 1000000.0;
+
+			if (Options.bCSV)
+				printf("\"%s\",%zu,%zu,%zu,%.1f,%.1f\n", Files.GetFileName(nFileIndex), Result.nBytes, Result.nMessages, Result.nSysExBytes, nWholeMBPerSecond, nByteAtATimeMBPerSecond);
+			else
+				printf("%s: %zu bytes (%zu messages, %zu bytes of SysEx); %.1fMB/s whole, %.1fMB/s a byte at a time (%.1fx)\n", Files.GetFileName(nFileIndex), Result.nBytes, Result.nMessages, Result.nSysExBytes, nWholeMBPerSecond, nByteAtATimeMBPerSecond, nWholeMBPerSecond / nByteAtATimeMBPerSecond);
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	const bool bSoundFont = Options.Synth.empty() ? Config.SystemDefaultSynth == CConfig::TSystemDefaultSynth::SoundFont : Options.Synth == "soundfont";
+	const unsigned int nChunkSize = Options.nChunkSize ? Options.nChunkSize : Config.AudioChunkSize;
+
+	if (Options.bCSV)
+		printf("file,audio_s,render_s,rtf,chunks,late_chunks,mean_chunk_us,p99_chunk_us,max_chunk_us,peak_voices,midi_s,heap_used_kb,heap_peak_kb,heap_allocs,heap_frees\n");
+	else
+		printf("%s, %dHz, %u frame chunks (%.0fus each)\n", bSoundFont ? "FluidSynth" : "mt32emu", Config.AudioSampleRate, nChunkSize, 1000000.0 * nChunkSize / Config.AudioSampleRate);
+
+	double nTotalAudioSeconds  = 0.0;
+	double nTotalRenderSeconds = 0.0;
+	for (size_t nFileIndex : FileIndices)
+	{
+		const char* pFileName = Files.GetFileName(nFileIndex);
+		TResult Best{};
+		bool bHaveResult = false;
+
+		for (unsigned int nRun = 0; nRun < Options.nRepeats; ++nRun)
+		{
+			TResult Result;
+			if (!Run(Options, bSoundFont, nFileIndex, Result))
+				return EXIT_FAILURE;
+
+			if (!bHaveResult || Result.nRenderSeconds < Best.nRenderSeconds)
+				Best = Result;
+			bHaveResult = true;
+		}
+
+		nTotalAudioSeconds += Best.nAudioSeconds;
+		nTotalRenderSeconds += Best.nRenderSeconds;
+
+		const double nRTF = Best.nRenderSeconds / Best.nAudioSeconds;
+
+		if (Options.bCSV)
+			printf("\"%s\",%.3f,%.3f,%.4f,%zu,%zu,%.1f,%.1f,%.1f,%u,%.3f,%zu,%zu,%u,%u\n", pFileName, Best.nAudioSeconds, Best.nRenderSeconds, nRTF, Best.nChunks, Best.nLateChunks, Best.nMeanChunkMicros, Best.nP99ChunkMicros, Best.nMaxChunkMicros, Best.nPeakVoices, Best.nMIDISeconds, Best.nHeapUsedBytes / 1024, Best.nHeapPeakBytes / 1024, Best.nHeapAllocCalls, Best.nHeapFreeCalls);
+		else
+			printf("%s: %.1fs of audio in %.2fs (RTF %.3f, %.1fx real time); chunks mean %.0fus, p99 %.0fus, max %.0fus, %zu late; peak voices %u; MIDI %.3fs; heap %zuKB (peak %zuKB), %u allocs/%u frees while playing\n", pFileName, Best.nAudioSeconds, Best.nRenderSeconds, nRTF, 1.0 / nRTF, Best.nMeanChunkMicros, Best.nP99ChunkMicros, Best.nMaxChunkMicros, Best.nLateChunks, Best.nPeakVoices, Best.nMIDISeconds, Best.nHeapUsedBytes / 1024, Best.nHeapPeakBytes / 1024, Best.nHeapAllocCalls, Best.nHeapFreeCalls);
+	}
+
+	if (!Options.bCSV && nTotalAudioSeconds > 0.0 && FileIndices.size() > 1)
+		printf("Total: %.1fs of audio in %.2fs (RTF %.3f)\n", nTotalAudioSeconds, nTotalRenderSeconds, nTotalRenderSeconds / nTotalAudioSeconds);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,333 @@
+//
+// midiparsertest.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <circle/logger.h>
+#include <circle/memory.h>
+#include <circle/timer.h>
+
+#include "midiparser.h"
+#include "zoneallocator.h"
+
+// Checks that CMIDIParser produces the same callbacks whether a stream is handed to it whole, where runs of data bytes
+// take the bulk paths, or one byte at a time, where every byte goes through the state machine. The corpus is a set of
+// generated streams covering running status, interleaved real-time bytes, SysEx of all sizes and malformed input, plus
+// any files named on the command line, which are parsed as raw MIDI byte streams (e.g. .syx dumps).
+
+namespace
+{
+	using TStream = std::vector<u8>;
+
+	constexpr unsigned int Timestamp = 12345;
+
+	// Records every callback as a line of text
+	class CRecordingParser : public CMIDIParser
+	{
+	public:
+		CRecordingParser(bool bAcceptFragments) : m_bAcceptFragments(bAcceptFragments) {}
+
+		const std::vector<std::string>& GetEvents() const { return m_Events; }
+
+	protected:
+		virtual void OnShortMessage(u32 nMessage, unsigned int nTimestamp) override
+		{
+			Record("short %06x @%u", nMessage, nTimestamp);
+		}
+
+		virtual void OnSysExMessage(const u8* pData, size_t nSize, unsigned int nTimestamp) override
+		{
+			Record("sysex %zu @%u", nSize, nTimestamp);
+			RecordData(pData, nSize);
+		}
+
+		virtual bool OnSysExFragment(const u8* pData, size_t nSize, size_t nOffset, bool bComplete, unsigned int nTimestamp) override
+		{
+			if (!m_bAcceptFragments)
+				return false;
+
+			Record("fragment %zu+%zu%s @%u", nOffset, nSize, bComplete ? " complete" : "", nTimestamp);
+			RecordData(pData, nSize);
+			return true;
+		}
+
+		virtual void OnUnexpectedStatus() override { Record("unexpected status"); }
+		virtual void OnSysExOverflow() override { Record("overflow"); }
+
+	private:
+		template <class... TArgs>
+		void Record(const char* pFormat, TArgs... Args)
+		{
+			char Buffer[128];
+			snprintf(Buffer, sizeof(Buffer), pFormat, Args...);
+			m_Events.emplace_back(Buffer);
+		}
+
+		void RecordData(const u8* pData, size_t nSize)
+		{
+			std::string Data;
+			Data.reserve(nSize * 2);
+			for (size_t i = 0; i < nSize; ++i)
+			{
+				static const char Digits[] = "0123456789abcdef";
+				Data += Digits[pData[i] >> 4];
+				Data += Digits[pData[i] & 0xF];
+			}
+			m_Events.push_back(std::move(Data));
+		}
+
+		bool m_bAcceptFragments;
+		std::vector<std::string> m_Events;
+	};
+
+	struct TParserSetup
+	{
+		const char* pName;
+		size_t nSysExBufferSize;
+		bool bAcceptFragments;
+	};
+
+	// The default buffer, one allocated from the zone heap, and both with and without fragmented delivery
+	constexpr TParserSetup ParserSetups[] = {
+		{ "default buffer",              CMIDIParser::DefaultSysExBufferSize, false },
+		{ "default buffer, fragments",   CMIDIParser::DefaultSysExBufferSize, true  },
+		{ "4096 byte buffer",            4096,                                false },
+		{ "4096 byte buffer, fragments", 4096,                                true  },
+	};
+
+	// Hands the stream to a fresh parser in pieces of nPieceSize bytes, or of random sizes if zero
+	std::vector<std::string> Parse(const TParserSetup& Setup, const TStream& Stream, size_t nPieceSize, std::mt19937& Random)
+	{
+		CRecordingParser Parser(Setup.bAcceptFragments);
+		Parser.SetSysExBufferSize(Setup.nSysExBufferSize);
+
+		std::uniform_int_distribution<size_t> RandomPieceSize(1, 64);
+		size_t nOffset = 0;
+		while (nOffset < Stream.size())
+		{
+			const size_t nSize = std::min(nPieceSize ? nPieceSize : RandomPieceSize(Random), Stream.size() - nOffset);
+			Parser.ParseMIDIBytes(Stream.data() + nOffset, nSize, Timestamp);
+			nOffset += nSize;
+		}
+
+		return Parser.GetEvents();
+	}
+
+	TStream GenerateStream(std::mt19937& Random, size_t nLength)
+	{
+		TStream Stream;
+		auto Next = [&](unsigned int nMax) { return std::uniform_int_distribution<unsigned int>(0, nMax)(Random); };
+		auto Data = [&]() { return static_cast<u8>(Next(0x7F)); };
+
+		while (Stream.size() < nLength)
+		{
+			switch (Next(9))
+			{
+				// Channel message
+				case 0:
+				case 1:
+				{
+					const u8 nStatus = 0x80 + Next(0x6F);
+					Stream.push_back(nStatus);
+					Stream.push_back(Data());
+					if (nStatus < 0xC0 || nStatus >= 0xE0)
+						Stream.push_back(Data());
+					break;
+				}
+
+				// A burst under running status, sometimes ending in a partial message
+				case 2:
+				case 3:
+				{
+					const size_t nBytes = Next(64);
+					for (size_t i = 0; i < nBytes; ++i)
+						Stream.push_back(Data());
+					break;
+				}
+
+				// System Common, with the right number of data bytes or not
+				case 4:
+				{
+					static const u8 Statuses[] = { 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7 };
+					Stream.push_back(Statuses[Next(sizeof(Statuses) - 1)]);
+					const size_t nBytes = Next(3);
+					for (size_t i = 0; i < nBytes; ++i)
+						Stream.push_back(Data());
+					break;
+				}
+
+				// SysEx, mostly short, sometimes around or well past the buffer sizes, and sometimes cut short by a status
+				case 5:
+				case 6:
+				{
+					static const size_t MaxLengths[] = { 16, 256, 1100, 5000, 70000 };
+					const size_t nMaxLength = MaxLengths[std::min<unsigned int>(Next(15), 4)];
+					const size_t nBytes = Next(nMaxLength);
+
+					Stream.push_back(0xF0);
+					for (size_t i = 0; i < nBytes; ++i)
+						Stream.push_back(Data());
+
+					if (Next(7))
+						Stream.push_back(0xF7);
+					else
+						Stream.push_back(0x80 + Next(0x77));
+					break;
+				}
+
+				// SysEx exactly filling the default buffer, with and without room for EOX
+				case 7:
+				{
+					const size_t nBytes = CMIDIParser::DefaultSysExBufferSize - 2 + Next(2);
+					Stream.push_back(0xF0);
+					for (size_t i = 0; i < nBytes; ++i)
+						Stream.push_back(Data());
+					Stream.push_back(0xF7);
+					break;
+				}
+
+				// Random bytes
+				case 8:
+				{
+					const size_t nBytes = Next(16);
+					for (size_t i = 0; i < nBytes; ++i)
+						Stream.push_back(Next(0xFF));
+					break;
+				}
+
+				// System Real-Time, defined or not
+				case 9:
+					Stream.push_back(0xF8 + Next(7));
+					break;
+			}
+		}
+
+		// Real-Time bytes can also appear between any other two bytes
+		TStream Interleaved;
+		Interleaved.reserve(Stream.size() + Stream.size() / 32);
+		for (u8 nByte : Stream)
+		{
+			if (Next(63) == 0)
+				Interleaved.push_back(0xF8 + Next(7));
+			Interleaved.push_back(nByte);
+		}
+
+		return Interleaved;
+	}
+
+	bool ReadFile(const char* pFileName, TStream& Stream)
+	{
+		FILE* pFile = fopen(pFileName, "rb");
+		if (!pFile)
+			return false;
+
+		u8 Buffer[4096];
+		size_t nRead;
+		while ((nRead = fread(Buffer, 1, sizeof(Buffer), pFile)) > 0)
+			Stream.insert(Stream.end(), Buffer, Buffer + nRead);
+
+		fclose(pFile);
+		return true;
+	}
+
+	bool Compare(const char* pStreamName, const TParserSetup& Setup, const char* pHowName, const std::vector<std::string>& Expected, const std::vector<std::string>& Actual)
+	{
+		size_t nIndex = 0;
+		while (nIndex < Expected.size() && nIndex < Actual.size() && Expected[nIndex] == Actual[nIndex])
+			++nIndex;
+
+		if (nIndex == Expected.size() && nIndex == Actual.size())
+			return true;
+
+		fprintf(stderr, "FAIL: %s, %s: %s differs from byte at a time at callback %zu of %zu/%zu\n", pStreamName, Setup.pName, pHowName, nIndex, Actual.size(), Expected.size());
+		// Show the callbacks from just before where they first differ, as SysEx data can be long
+		const std::string ExpectedEvent = nIndex < Expected.size() ? Expected[nIndex] : "(end)";
+		const std::string ActualEvent   = nIndex < Actual.size() ? Actual[nIndex] : "(end)";
+		const size_t nDifference = std::mismatch(ExpectedEvent.begin(), ExpectedEvent.end(), ActualEvent.begin(), ActualEvent.end()).first - ExpectedEvent.begin();
+		const size_t nStart = nDifference < 16 ? 0 : nDifference - 16;
+
+		fprintf(stderr, "  expected: %.64s\n", ExpectedEvent.c_str() + std::min(nStart, ExpectedEvent.size()));
+		fprintf(stderr, "  actual:   %.64s\n", ActualEvent.c_str() + std::min(nStart, ActualEvent.size()));
+		return false;
+	}
+
+	bool Test(const char* pStreamName, const TStream& Stream, std::mt19937& Random)
+	{
+		bool bPassed = true;
+
+		for (const TParserSetup& Setup : ParserSetups)
+		{
+			const std::vector<std::string> ByteAtATime = Parse(Setup, Stream, 1, Random);
+
+			bPassed &= Compare(pStreamName, Setup, "whole stream", ByteAtATime, Parse(Setup, Stream, Stream.size(), Random));
+			bPassed &= Compare(pStreamName, Setup, "random pieces", ByteAtATime, Parse(Setup, Stream, 0, Random));
+		}
+
+		return bPassed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	CLogger Logger(LogError);
+	CTimer Timer;
+	CMemorySystem Memory(64 * MEGABYTE);
+
+	CZoneAllocator Allocator;
+	if (!Allocator.Initialize())
+		return EXIT_FAILURE;
+
+	std::mt19937 Random(0x6D743332);
+	size_t nStreams = 0;
+	size_t nFailures = 0;
+
+	for (unsigned int i = 0; i < 200; ++i)
+	{
+		char StreamName[32];
+		snprintf(StreamName, sizeof(StreamName), "generated stream %u", i);
+
+		const TStream Stream = GenerateStream(Random, 20000);
+		nFailures += !Test(StreamName, Stream, Random);
+		++nStreams;
+	}
+
+	for (int i = 1; i < argc; ++i)
+	{
+		TStream Stream;
+		if (!ReadFile(argv[i], Stream))
+		{
+			fprintf(stderr, "Couldn't read '%s'\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+
+		nFailures += !Test(argv[i], Stream, Random);
+		++nStreams;
+	}
+
+	printf("%zu of %zu streams parsed identically\n", nStreams - nFailures, nStreams);
+	return nFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+//
+// logger.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <cstdarg>
+#include <cstdio>
+
+#include <circle/logger.h>
+#include <circle/timer.h>
+
+CLogger* CLogger::s_pThis = nullptr;
+
+CLogger::CLogger(unsigned nLogLevel)
+	: m_nLogLevel(nLogLevel)
+{
+	s_pThis = this;
+}
+
+CLogger::~CLogger()
+{
+	s_pThis = nullptr;
+}
+
+void CLogger::Write(const char* pSource, TLogSeverity Severity, const char* pMessage, ...)
+{
+	if (Severity > m_nLogLevel)
+		return;
+
+	static const char* const SeverityNames[] = { "!", "E", "W", "N", "D" };
+
+	// Stamped with the benchmark's audio clock, like the firmware's log is with its uptime
+	const unsigned int nTicks = CTimer::GetClockTicks();
+	fprintf(stderr, "%u.%06u %s %s: ", nTicks / 1000000, nTicks % 1000000, SeverityNames[Severity], pSource);
+
+	va_list Args;
+	va_start(Args, pMessage);
+	vfprintf(stderr, pMessage, Args);
+	va_end(Args);
+
+	fputc('\n', stderr);
+}
@@ -0,0 +1,57 @@
+//
+// logger.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef _circle_logger_h
+#define _circle_logger_h
+
+// Host stand-in for Circle's logger; messages go to stderr
+
+#include <circle/types.h>
+
+enum TLogSeverity
+{
+	LogPanic,
+	LogError,
+	LogWarning,
+	LogNotice,
+	LogDebug
+};
+
+class CLogger
+{
+public:
+	// Messages less severe than nLogLevel are dropped
+	CLogger(unsigned nLogLevel);
+	~CLogger();
+
+	void Write(const char* pSource, TLogSeverity Severity, const char* pMessage, ...) __attribute__((format(printf, 4, 5)));
+
+	static CLogger* Get() { return s_pThis; }
+
+private:
+	unsigned m_nLogLevel;
+
+	static CLogger* s_pThis;
+};
+
+#endif
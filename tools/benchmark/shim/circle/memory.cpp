@@ -0,0 +1,53 @@
+//
+// memory.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <cstdlib>
+
+#include <circle/memory.h>
+
+CMemorySystem* CMemorySystem::s_pThis = nullptr;
+
+CMemorySystem::CMemorySystem(size_t nHeapSize)
+	: m_nHeapSize(nHeapSize)
+{
+	s_pThis = this;
+}
+
+CMemorySystem::~CMemorySystem()
+{
+	s_pThis = nullptr;
+}
+
+void* CMemorySystem::HeapAllocate(size_t nSize, int nType)
+{
+	if (nSize > m_nHeapSize)
+		return nullptr;
+
+	// Pages are only committed by the host when they're touched, so an unused heap costs nothing
+	return aligned_alloc(16, (nSize + 15) & ~static_cast<size_t>(15));
+}
+
+void CMemorySystem::HeapFree(void* pBlock)
+{
+	free(pBlock);
+}
@@ -0,0 +1,52 @@
+//
+// memory.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef _circle_memory_h
+#define _circle_memory_h
+
+// Host stand-in for Circle's memory system; a single heap region of a chosen size, backed by the host's heap
+
+#include <circle/alloc.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+class CMemorySystem
+{
+public:
+	// nHeapSize is the free space reported for every region, as on a Raspberry Pi with that much memory left
+	CMemorySystem(size_t nHeapSize);
+	~CMemorySystem();
+
+	size_t GetHeapFreeSpace(int nType) const { return m_nHeapSize; }
+	void* HeapAllocate(size_t nSize, int nType);
+	void HeapFree(void* pBlock);
+
+	static CMemorySystem* Get() { return s_pThis; }
+
+private:
+	size_t m_nHeapSize;
+
+	static CMemorySystem* s_pThis;
+};
+
+#endif
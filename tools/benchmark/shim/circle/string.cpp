@@ -0,0 +1,118 @@
+//
+// string.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <circle/string.h>
+
+CString::CString()
+	: m_pBuffer(nullptr),
+	  m_nLength(0)
+{
+}
+
+CString::CString(const char* pString)
+	: CString()
+{
+	*this = pString;
+}
+
+CString::CString(const CString& String)
+	: CString()
+{
+	*this = static_cast<const char*>(String);
+}
+
+CString::~CString()
+{
+	free(m_pBuffer);
+}
+
+CString::operator const char*() const
+{
+	return m_pBuffer ? m_pBuffer : "";
+}
+
+const char* CString::operator=(const char* pString)
+{
+	// The source may be part of this string
+	const size_t nLength = strlen(pString);
+	char* pBuffer = static_cast<char*>(malloc(nLength + 1));
+	memcpy(pBuffer, pString, nLength + 1);
+
+	free(m_pBuffer);
+	m_pBuffer = pBuffer;
+	m_nLength = nLength;
+
+	return m_pBuffer;
+}
+
+const CString& CString::operator=(const CString& String)
+{
+	*this = static_cast<const char*>(String);
+	return *this;
+}
+
+int CString::Compare(const char* pString) const
+{
+	return strcmp(*this, pString);
+}
+
+void CString::Append(const char* pString)
+{
+	const size_t nLength = strlen(pString);
+	m_pBuffer = static_cast<char*>(realloc(m_pBuffer, m_nLength + nLength + 1));
+	memcpy(m_pBuffer + m_nLength, pString, nLength + 1);
+	m_nLength += nLength;
+}
+
+void CString::Format(const char* pFormat, ...)
+{
+	va_list Args;
+	va_start(Args, pFormat);
+	FormatV(pFormat, Args);
+	va_end(Args);
+}
+
+void CString::FormatV(const char* pFormat, va_list Args)
+{
+	va_list SizeArgs;
+	va_copy(SizeArgs, Args);
+	const int nLength = vsnprintf(nullptr, 0, pFormat, SizeArgs);
+	va_end(SizeArgs);
+
+	if (nLength < 0)
+	{
+		*this = "";
+		return;
+	}
+
+	char* pBuffer = static_cast<char*>(malloc(nLength + 1));
+	vsnprintf(pBuffer, nLength + 1, pFormat, Args);
+
+	free(m_pBuffer);
+	m_pBuffer = pBuffer;
+	m_nLength = nLength;
+}
@@ -0,0 +1,57 @@
+//
+// string.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _circle_string_h
+#define _circle_string_h
+
+// Host stand-in for Circle's string class
+// Like Circle's, it only holds a pointer to its buffer, so that Utility::Swap() can move it with memcpy()
+
+#include <cstdarg>
+
+#include <circle/types.h>
+
+class CString
+{
+public:
+	CString();
+	CString(const char* pString);
+	CString(const CString& String);
+	~CString();
+
+	operator const char*() const;
+	const char* operator=(const char* pString);
+	const CString& operator=(const CString& String);
+
+	size_t GetLength() const { return m_nLength; }
+	int Compare(const char* pString) const;
+
+	void Append(const char* pString);
+	void Format(const char* pFormat, ...) __attribute__((format(printf, 2, 3)));
+	void FormatV(const char* pFormat, va_list Args);
+
+private:
+	char* m_pBuffer;
+	size_t m_nLength;
+};
+
+#endif
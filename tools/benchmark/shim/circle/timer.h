@@ -0,0 +1,62 @@
+//
+// timer.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef _circle_timer_h
+#define _circle_timer_h
+
+// Host stand-in for Circle's timer
+// Time doesn't pass on its own: the benchmark advances the clock by each chunk's playback time, so that MIDI events are
+// timed against the audio being rendered, however long rendering takes
+
+#include <circle/types.h>
+
+#define HZ 100
+#define MSEC2HZ(msec) ((msec) * HZ / 1000)
+
+class CTimer
+{
+public:
+	CTimer();
+	~CTimer();
+
+	// Hundredths of a second
+	unsigned GetTicks() const { return s_nClockTicks / (1000000 / HZ); }
+
+	// Not part of Circle's timer
+	void Advance(unsigned nMicros) { s_nClockTicks += nMicros; }
+
+	static CTimer* Get() { return s_pThis; }
+
+	// Microseconds
+	static unsigned GetClockTicks() { return s_nClockTicks; }
+
+	// Delays pass instantly on the benchmark's clock
+	static void SimpleMsDelay(unsigned nMilliSeconds) { s_nClockTicks += nMilliSeconds * 1000; }
+	static void SimpleusDelay(unsigned nMicroSeconds) { s_nClockTicks += nMicroSeconds; }
+
+private:
+	static CTimer* s_pThis;
+	static unsigned s_nClockTicks;
+};
+
+#endif
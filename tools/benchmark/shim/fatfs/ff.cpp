@@ -0,0 +1,247 @@
+//
+// ff.cpp
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <string>
+
+#include <fnmatch.h>
+#include <sys/stat.h>
+
+#include <fatfs/ff.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	std::map<std::string, std::string> Drives;
+
+	// Returns false if the path is on a drive that isn't mapped
+	bool GetHostPath(const TCHAR* pPath, std::string& HostPath)
+	{
+		std::string Drive = "SD";
+		const char* pSeparator = strchr(pPath, ':');
+		if (pSeparator)
+		{
+			Drive.assign(pPath, pSeparator - pPath);
+			pPath = pSeparator + 1;
+		}
+
+		const auto Iterator = Drives.find(Drive);
+		if (Iterator == Drives.end())
+			return false;
+
+		while (*pPath == '/')
+			++pPath;
+
+		HostPath = Iterator->second + "/" + pPath;
+		return true;
+	}
+
+	FRESULT GetErrorResult()
+	{
+		switch (errno)
+		{
+			case ENOENT:
+				return FR_NO_FILE;
+
+			case ENOTDIR:
+				return FR_NO_PATH;
+
+			case EACCES:
+			case EPERM:
+			case EISDIR:
+				return FR_DENIED;
+
+			default:
+				return FR_DISK_ERR;
+		}
+	}
+
+	FRESULT ReadDirectory(DIR* dp, FILINFO* fno)
+	{
+		auto& Iterator = *static_cast<fs::directory_iterator*>(dp->pIterator);
+		std::error_code Error;
+
+		for (; Iterator != fs::directory_iterator(); Iterator.increment(Error))
+		{
+			if (Error)
+				return FR_DISK_ERR;
+
+			const std::string FileName = Iterator->path().filename().string();
+			if (FileName.size() >= sizeof(fno->fname) || fnmatch(dp->Pattern, FileName.c_str(), FNM_CASEFOLD) != 0)
+				continue;
+
+			struct stat Stat;
+			if (stat(Iterator->path().c_str(), &Stat) != 0)
+				continue;
+
+			// FAT timestamps are in local time, with 2 second resolution
+			struct tm Time;
+			localtime_r(&Stat.st_mtime, &Time);
+
+			fno->fsize   = S_ISDIR(Stat.st_mode) ? 0 : Stat.st_size;
+			fno->fdate   = (Time.tm_year - 80) << 9 | (Time.tm_mon + 1) << 5 | Time.tm_mday;
+			fno->ftime   = Time.tm_hour << 11 | Time.tm_min << 5 | Time.tm_sec / 2;
+			fno->fattrib = S_ISDIR(Stat.st_mode) ? AM_DIR : AM_ARC;
+			strcpy(fno->fname, FileName.c_str());
+
+			Iterator.increment(Error);
+			return FR_OK;
+		}
+
+		// End of directory
+		fno->fname[0] = '\0';
+		return FR_OK;
+	}
+}
+
+void f_mapdrive(const TCHAR* drive, const char* pHostPath)
+{
+	Drives[drive] = pHostPath;
+}
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode)
+{
+	fp->pFile = nullptr;
+
+	std::string HostPath;
+	if (!GetHostPath(path, HostPath))
+		return FR_NOT_READY;
+
+	const char* pMode;
+	if (mode & FA_CREATE_ALWAYS)
+		pMode = mode & FA_READ ? "w+b" : "wb";
+	else if (mode & FA_WRITE)
+		pMode = "r+b";
+	else
+		pMode = "rb";
+
+	fp->pFile = fopen(HostPath.c_str(), pMode);
+	if (!fp->pFile && (mode & (FA_OPEN_ALWAYS | FA_CREATE_NEW)) && errno == ENOENT)
+		fp->pFile = fopen(HostPath.c_str(), "w+b");
+
+	if (!fp->pFile)
+		return GetErrorResult();
+
+	fseek(fp->pFile, 0, SEEK_END);
+	fp->objsize = ftell(fp->pFile);
+	fp->fptr    = 0;
+	rewind(fp->pFile);
+
+	return FR_OK;
+}
+
+FRESULT f_close(FIL* fp)
+{
+	if (!fp->pFile)
+		return FR_INVALID_OBJECT;
+
+	const int nResult = fclose(fp->pFile);
+	fp->pFile = nullptr;
+
+	return nResult == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br)
+{
+	if (!fp->pFile)
+		return FR_INVALID_OBJECT;
+
+	*br = fread(buff, 1, btr, fp->pFile);
+	fp->fptr += *br;
+
+	return ferror(fp->pFile) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw)
+{
+	if (!fp->pFile)
+		return FR_INVALID_OBJECT;
+
+	*bw = fwrite(buff, 1, btw, fp->pFile);
+	fp->fptr += *bw;
+	if (fp->fptr > fp->objsize)
+		fp->objsize = fp->fptr;
+
+	return ferror(fp->pFile) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs)
+{
+	if (!fp->pFile)
+		return FR_INVALID_OBJECT;
+
+	if (fseek(fp->pFile, ofs, SEEK_SET) != 0)
+		return FR_DISK_ERR;
+
+	fp->fptr = ofs;
+	return FR_OK;
+}
+
+FRESULT f_unlink(const TCHAR* path)
+{
+	std::string HostPath;
+	if (!GetHostPath(path, HostPath))
+		return FR_NOT_READY;
+
+	return remove(HostPath.c_str()) == 0 ? FR_OK : GetErrorResult();
+}
+
+FRESULT f_findfirst(DIR* dp, FILINFO* fno, const TCHAR* path, const TCHAR* pattern)
+{
+	dp->pIterator = nullptr;
+
+	std::string HostPath;
+	if (!GetHostPath(path, HostPath))
+		return FR_NOT_READY;
+
+	std::error_code Error;
+	fs::directory_iterator Iterator(HostPath, Error);
+	if (Error)
+		return FR_NO_PATH;
+
+	dp->pIterator = new fs::directory_iterator(std::move(Iterator));
+	snprintf(dp->Pattern, sizeof(dp->Pattern), "%s", pattern);
+
+	return ReadDirectory(dp, fno);
+}
+
+FRESULT f_findnext(DIR* dp, FILINFO* fno)
+{
+	if (!dp->pIterator)
+		return FR_INVALID_OBJECT;
+
+	return ReadDirectory(dp, fno);
+}
+
+FRESULT f_closedir(DIR* dp)
+{
+	delete static_cast<fs::directory_iterator*>(dp->pIterator);
+	dp->pIterator = nullptr;
+
+	return FR_OK;
+}
@@ -0,0 +1,109 @@
+//
+// ff.h
+//
+// mt32-pi - A baremetal MIDI synthesizer for Raspberry Pi
+// Copyright (C) 2020-2021 Dale Whinham <daleyo@gmail.com>
+//
+// This file is part of mt32-pi.
+//
+// mt32-pi is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// mt32-pi is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// mt32-pi. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef _fatfs_ff_h
+#define _fatfs_ff_h
+
+// Host stand-in for the subset of FatFs used by the firmware sources built into the benchmark
+// Each drive ("SD:", "USB:") is mapped onto a host directory; paths without a drive are on the SD card
+
+#include <cstdio>
+
+#include <circle/types.h>
+
+typedef u8 BYTE;
+typedef u16 WORD;
+typedef u32 DWORD;
+typedef unsigned int UINT;
+typedef char TCHAR;
+typedef DWORD FSIZE_t;
+
+typedef enum
+{
+	FR_OK = 0,
+	FR_DISK_ERR,
+	FR_INT_ERR,
+	FR_NOT_READY,
+	FR_NO_FILE,
+	FR_NO_PATH,
+	FR_INVALID_NAME,
+	FR_DENIED,
+	FR_EXIST,
+	FR_INVALID_OBJECT,
+	FR_WRITE_PROTECTED,
+	FR_INVALID_DRIVE,
+	FR_NOT_ENABLED,
+} FRESULT;
+
+#define FA_READ				0x01
+#define FA_WRITE			0x02
+#define FA_OPEN_EXISTING	0x00
+#define FA_CREATE_NEW		0x04
+#define FA_CREATE_ALWAYS	0x08
+#define FA_OPEN_ALWAYS		0x10
+
+#define AM_RDO	0x01
+#define AM_HID	0x02
+#define AM_SYS	0x04
+#define AM_DIR	0x10
+#define AM_ARC	0x20
+
+struct FIL
+{
+	FILE* pFile;
+	FSIZE_t fptr;
+	FSIZE_t objsize;
+};
+
+struct DIR
+{
+	void* pIterator;
+	TCHAR Pattern[256];
+};
+
+struct FILINFO
+{
+	FSIZE_t fsize;
+	WORD fdate;
+	WORD ftime;
+	BYTE fattrib;
+	TCHAR fname[256];
+};
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode);
+FRESULT f_close(FIL* fp);
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br);
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw);
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs);
+FRESULT f_unlink(const TCHAR* path);
+FRESULT f_findfirst(DIR* dp, FILINFO* fno, const TCHAR* path, const TCHAR* pattern);
+FRESULT f_findnext(DIR* dp, FILINFO* fno);
+FRESULT f_closedir(DIR* dp);
+
+#define f_tell(fp) ((fp)->fptr)
+#define f_size(fp) ((fp)->objsize)
+
+// Not part of FatFs; maps a drive name such as "SD" onto a host directory
+void f_mapdrive(const TCHAR* drive, const char* pHostPath);
+
+#endif